@@ -1,11 +1,20 @@
 #include "alsa_out.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <iostream>
 
 #include <alsa/asoundlib.h>
 
 
-AlsaPlayback::AlsaPlayback(int rate, int ch) : sample_rate(rate), channels(ch) {
+namespace {
+hibiki::AudioDeviceRegistration registration("alsa", 100, [](const hibiki::AudioDeviceOptions& options) {
+    return std::unique_ptr<hibiki::AudioDevice>(
+        new AlsaPlayback(options.sample_rate, options.channels, options.block_size, options.buffer_blocks));
+});
+} // namespace
+
+AlsaPlayback::AlsaPlayback(int rate, int ch, int block, int buffer_blocks) : sample_rate(rate), channels(ch), block_size(block) {
     if (snd_pcm_open(&pcm_handle, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0) {
         std::cerr << "Cannot open ALSA audio device" << std::endl;
         return;
@@ -17,16 +26,28 @@ AlsaPlayback::AlsaPlayback(int rate, int ch) : sample_rate(rate), channels(ch) {
                   << " (" << snd_pcm_info_get_name(info) << ")\n" << std::flush;
     }
 
+    unsigned int latency_us = 50000;
+    if (buffer_blocks > 0) latency_us = (unsigned int)((int64_t)buffer_blocks * block_size * 1000000 / sample_rate);
     int err = snd_pcm_set_params(pcm_handle, 
                                  SND_PCM_FORMAT_FLOAT_LE, 
                                  SND_PCM_ACCESS_RW_INTERLEAVED, 
                                  channels, 
                                  sample_rate, 
                                  1,     // allow resampling
-                                 50000); // 50ms latency
+                                 latency_us);
     if (err < 0) {
         std::cerr << "ALSA parameter setting failed: " << snd_strerror(err) << std::endl;
     }
+
+    // Status timestamps on the monotonic clock, which steady_clock is on Linux.
+    snd_pcm_sw_params_t* sw_params;
+    snd_pcm_sw_params_alloca(&sw_params);
+    if (snd_pcm_sw_params_current(pcm_handle, sw_params) == 0) {
+        snd_pcm_sw_params_set_tstamp_mode(pcm_handle, sw_params, SND_PCM_TSTAMP_ENABLE);
+        snd_pcm_sw_params_set_tstamp_type(pcm_handle, sw_params, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+        err = snd_pcm_sw_params(pcm_handle, sw_params);
+        if (err < 0) std::cerr << "ALSA timestamps unavailable: " << snd_strerror(err) << std::endl;
+    }
 }
 
 AlsaPlayback::~AlsaPlayback() {
@@ -37,6 +58,35 @@ AlsaPlayback::~AlsaPlayback() {
     }
 }
 
+// Draining leaves the PCM in SETUP, where the hardware is stopped; prepare
+// rearms it and the next write starts it again.
+void AlsaPlayback::pause() {
+    if (pcm_handle) snd_pcm_drain(pcm_handle);
+}
+
+void AlsaPlayback::resume() {
+    if (!pcm_handle) return;
+    int err = snd_pcm_prepare(pcm_handle);
+    if (err < 0) std::cerr << "ALSA prepare failed: " << snd_strerror(err) << std::endl;
+}
+
+// The block being rendered is written after all frames still queued, so it
+// starts playing delay frames after the status was taken. Before the stream
+// runs there is no timestamp and the estimate starts from now.
+std::chrono::steady_clock::time_point AlsaPlayback::output_time() const {
+    using Clock = std::chrono::steady_clock;
+    snd_pcm_status_t* status;
+    snd_pcm_status_alloca(&status);
+    if (!pcm_handle || snd_pcm_status(pcm_handle, status) < 0) return AudioDevice::output_time();
+    snd_htimestamp_t stamp;
+    snd_pcm_status_get_htstamp(status, &stamp);
+    auto taken = stamp.tv_sec == 0 && stamp.tv_nsec == 0
+                     ? Clock::now()
+                     : Clock::time_point(std::chrono::seconds(stamp.tv_sec) + std::chrono::nanoseconds(stamp.tv_nsec));
+    const snd_pcm_sframes_t delay = std::max<snd_pcm_sframes_t>(snd_pcm_status_get_delay(status), 0);
+    return taken + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((double)delay / sample_rate));
+}
+
 bool AlsaPlayback::is_ready() const { 
     return pcm_handle != nullptr; 
 }
@@ -45,6 +95,7 @@ void AlsaPlayback::write(const std::vector<float>& interleaved_data, int num_fra
     if (!pcm_handle) return;
     snd_pcm_sframes_t frames = snd_pcm_writei(pcm_handle, interleaved_data.data(), num_frames);
     if (frames < 0) {
+        if (frames == -EPIPE || frames == -ESTRPIPE) xruns++;
         frames = snd_pcm_recover(pcm_handle, frames, 0);
         if (frames < 0) {
             std::cerr << "ALSA write failed: " << snd_strerror(frames) << std::endl;
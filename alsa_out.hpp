@@ -1,18 +1,33 @@
 #pragma once
 
+#include "audio_device.hpp"
+
+#include <cstdint>
 #include <vector>
 
 
 typedef struct _snd_pcm snd_pcm_t;
 
-class AlsaPlayback {
+class AlsaPlayback : public hibiki::BlockingAudioDevice {
     snd_pcm_t *pcm_handle = nullptr;
     int sample_rate;
     int channels;
+    int block_size;
+    uint32_t xruns = 0;
 public:
-    AlsaPlayback(int rate = 44100, int ch = 2);
+    // buffer_blocks > 0 sizes the ALSA buffer in blocks instead of 50 ms.
+    AlsaPlayback(int rate = 44100, int ch = 2, int block = 512, int buffer_blocks = 0);
     ~AlsaPlayback();
 
-    bool is_ready() const;
-    void write(const std::vector<float>& interleaved_data, int num_frames);
+    bool is_ready() const override;
+    void write(const std::vector<float>& interleaved_data, int num_frames) override;
+    int get_sample_rate() const override { return sample_rate; }
+    int get_channels() const override { return channels; }
+    int get_block_size() const override { return block_size; }
+    uint32_t xrun_count() const override { return xruns; }
+    // From the device's timestamp and delay, which count every queued frame.
+    std::chrono::steady_clock::time_point output_time() const override;
+    bool can_pause() const override { return true; }
+    void pause() override;
+    void resume() override;
 };
@@ -0,0 +1,146 @@
+#include "analyzer.hpp"
+#include "dsp.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+namespace hibiki {
+
+AnalyzerSettings AnalyzerSettings::Clamped() const {
+    AnalyzerSettings s = *this;
+    s.fft_size = (int)std::bit_ceil((unsigned)std::clamp(fft_size, kMinFftSize, kMaxFftSize));
+    s.overlap = std::clamp(overlap, 0.0f, kMaxOverlap);
+    s.scope_points = std::clamp(scope_points, 1, kMaxScopePoints);
+    s.scope_ms = std::clamp(scope_ms, 1.0f, 10000.0f);
+    s.interval_ms = std::max(interval_ms, 1);
+    return s;
+}
+
+RealFft::RealFft(int size) : size_(size), re_(size / 2), im_(size / 2) {
+    const int half_size = size / 2;
+    const int bits = std::countr_zero((unsigned)half_size);
+    bit_reverse_.resize(half_size);
+    for (int k = 0; k < half_size; ++k) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) reversed |= ((k >> b) & 1) << (bits - 1 - b);
+        bit_reverse_[k] = reversed;
+    }
+    stage_re_.resize(std::max(half_size - 1, 1));
+    stage_im_.resize(stage_re_.size());
+    for (int half = 1; half < half_size; half *= 2) {
+        for (int j = 0; j < half; ++j) {
+            const double angle = -std::numbers::pi * j / half;
+            stage_re_[half - 1 + j] = (float)std::cos(angle);
+            stage_im_[half - 1 + j] = (float)std::sin(angle);
+        }
+    }
+    split_re_.resize(half_size + 1);
+    split_im_.resize(half_size + 1);
+    for (int k = 0; k <= half_size; ++k) {
+        const double angle = -2.0 * std::numbers::pi * k / size;
+        split_re_[k] = (float)std::cos(angle);
+        split_im_[k] = (float)std::sin(angle);
+    }
+}
+
+void RealFft::PowerSpectrum(const float* input, float* power) {
+    const int half_size = size_ / 2;
+    for (int k = 0; k < half_size; ++k) {
+        re_[bit_reverse_[k]] = input[2 * k];
+        im_[bit_reverse_[k]] = input[2 * k + 1];
+    }
+    for (int half = 1; half < half_size; half *= 2) {
+        dsp::FftStage(re_.data(), im_.data(), stage_re_.data() + half - 1, stage_im_.data() + half - 1, half_size, half);
+    }
+    // With Z the FFT of the pairs, the even and odd samples' spectra are
+    // (Z[k] + conj(Z[-k])) / 2 and -i (Z[k] - conj(Z[-k])) / 2.
+    for (int k = 0; k <= half_size; ++k) {
+        const int a = k % half_size, b = (half_size - k) % half_size;
+        const float even_re = 0.5f * (re_[a] + re_[b]), even_im = 0.5f * (im_[a] - im_[b]);
+        const float diff_re = 0.5f * (re_[a] - re_[b]), diff_im = 0.5f * (im_[a] + im_[b]);
+        const float x_re = even_re + split_re_[k] * diff_im + split_im_[k] * diff_re;
+        const float x_im = even_im - split_re_[k] * diff_re + split_im_[k] * diff_im;
+        power[k] = x_re * x_re + x_im * x_im;
+    }
+}
+
+Analyzer::Analyzer(double sample_rate, const AnalyzerSettings& settings)
+    : sample_rate_(sample_rate),
+      settings_(settings.Clamped()),
+      fft_(settings_.fft_size),
+      hop_(std::max(1, (int)std::lround(settings_.fft_size * (1.0 - settings_.overlap)))),
+      window_(settings_.fft_size),
+      history_(settings_.fft_size),
+      windowed_(settings_.fft_size),
+      power_(settings_.fft_size / 2 + 1),
+      power_sum_(settings_.fft_size / 2 + 1),
+      spectrum_(settings_.fft_size / 2 + 1),
+      scope_(std::max<int64_t>(settings_.scope_points, std::llround(settings_.scope_ms * sample_rate / 1000.0))) {
+    // Periodic Hann; a sine on a bin then reads its peak level.
+    double sum = 0.0;
+    for (int i = 0; i < settings_.fft_size; ++i) {
+        window_[i] = (float)(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / settings_.fft_size));
+        sum += window_[i];
+    }
+    magnitude_scale_ = (float)(2.0 / sum);
+}
+
+void Analyzer::Process(const float* l, const float* r, int n) {
+    const int mask = settings_.fft_size - 1;
+    const int scope_size = (int)scope_.size();
+    for (int i = 0; i < n; ++i) {
+        const float x = 0.5f * (l[i] + r[i]);
+        history_[history_pos_] = x;
+        history_pos_ = (history_pos_ + 1) & mask;
+        scope_[scope_pos_] = x;
+        if (++scope_pos_ == scope_size) scope_pos_ = 0;
+        ++history_count_;
+        if (++since_fft_ >= hop_ && history_count_ >= settings_.fft_size) {
+            RunFft();
+            since_fft_ = 0;
+        }
+    }
+}
+
+void Analyzer::RunFft() {
+    const int size = settings_.fft_size;
+    const int oldest = history_pos_;
+    for (int i = 0; i < size; ++i) windowed_[i] = history_[(oldest + i) & (size - 1)] * window_[i];
+    fft_.PowerSpectrum(windowed_.data(), power_.data());
+    dsp::Add(power_sum_.data(), power_.data(), (int)power_.size());
+    ++ffts_;
+}
+
+void Analyzer::TakeFrame(AnalysisFrame& frame) {
+    if (ffts_ > 0) {
+        for (size_t k = 0; k < spectrum_.size(); ++k) {
+            const double magnitude = std::sqrt(power_sum_[k] / ffts_) * magnitude_scale_;
+            const double db = magnitude > 0.0 ? 20.0 * std::log10(magnitude) : -HUGE_VAL;
+            spectrum_[k] = (uint8_t)std::clamp(std::lround((db + 127.5) * 2.0), 0L, 255L);
+        }
+        std::fill(power_sum_.begin(), power_sum_.end(), 0.0f);
+        ffts_ = 0;
+    }
+    frame.sample_rate = sample_rate_;
+    frame.fft_size = settings_.fft_size;
+    frame.spectrum.assign(spectrum_.begin(), spectrum_.end());
+
+    const int64_t scope_size = (int64_t)scope_.size();
+    const int points = settings_.scope_points;
+    auto quantize = [](float x) { return (int8_t)std::clamp(std::lround(x * 127.0f), -127L, 127L); };
+    frame.scope.resize(2 * points);
+    for (int p = 0; p < points; ++p) {
+        const int64_t begin = p * scope_size / points, end = (p + 1) * scope_size / points;
+        float lo = scope_[(scope_pos_ + begin) % scope_size], hi = lo;
+        for (int64_t i = begin + 1; i < end; ++i) {
+            const float x = scope_[(scope_pos_ + i) % scope_size];
+            lo = std::min(lo, x);
+            hi = std::max(hi, x);
+        }
+        frame.scope[2 * p] = quantize(lo);
+        frame.scope[2 * p + 1] = quantize(hi);
+    }
+}
+
+} // namespace hibiki
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace hibiki {
+
+// What an analyzer tap computes and how often it reports.
+struct AnalyzerSettings {
+    int fft_size = 2048;     // a power of two, kMinFftSize to kMaxFftSize
+    float overlap = 0.5f;    // of consecutive FFT windows, 0 to kMaxOverlap
+    int scope_points = 256;  // min/max pairs per scope trace
+    float scope_ms = 50.0f;  // time the scope trace spans
+    int interval_ms = 33;    // between frames
+
+    static constexpr int kMinFftSize = 64;
+    static constexpr int kMaxFftSize = 16384;
+    static constexpr float kMaxOverlap = 0.9375f;
+    static constexpr int kMaxScopePoints = 4096;
+
+    // Brings every field into range.
+    AnalyzerSettings Clamped() const;
+    bool operator==(const AnalyzerSettings&) const = default;
+};
+
+// One report of an analyzer tap, quantized for the wire.
+struct AnalysisFrame {
+    int track_index = 0;
+    double sample_rate = 0.0;
+    int fft_size = 0;
+    // Bins 0 to fft_size / 2 of the power averaged over the FFTs since the
+    // previous frame, in half dB above -127.5 dBFS: dB = value / 2 - 127.5.
+    // A full-scale sine on a bin reads 255.
+    std::vector<uint8_t> spectrum;
+    // scope_points (min, max) pairs over the last scope_ms, oldest first, in
+    // 1/127ths of full scale.
+    std::vector<int8_t> scope;
+};
+
+// Power spectrum of real input: a complex FFT of half the size over the even
+// and odd samples, split into the real spectrum afterwards. The butterflies
+// run on dsp::Kernels::fft_stage.
+class RealFft {
+public:
+    explicit RealFft(int size);
+
+    int size() const { return size_; }
+    // power[k] = |X[k]|^2 for k = 0 to size / 2.
+    void PowerSpectrum(const float* input, float* power);
+
+private:
+    int size_;
+    std::vector<int> bit_reverse_;
+    // Twiddles of each stage, stage by stage: half of them for a stage of
+    // groups of 2 * half points, starting at half - 1.
+    std::vector<float> stage_re_, stage_im_;
+    // exp(-2 pi i k / size) for the split, k = 0 to size / 2.
+    std::vector<float> split_re_, split_im_;
+    std::vector<float> re_, im_;
+};
+
+// Spectrum and scope of the mono downmix of one stereo source. Not
+// thread-safe; MeterWorker runs the taps on its thread.
+class Analyzer {
+public:
+    Analyzer(double sample_rate, const AnalyzerSettings& settings);
+
+    void Process(const float* l, const float* r, int n);
+    // Fills frame from what was processed since the previous one. Without a
+    // new FFT in between, the spectrum repeats.
+    void TakeFrame(AnalysisFrame& frame);
+
+    const AnalyzerSettings& settings() const { return settings_; }
+
+private:
+    void RunFft();
+
+    double sample_rate_;
+    AnalyzerSettings settings_;
+    RealFft fft_;
+    int hop_;
+    std::vector<float> window_;
+    float magnitude_scale_;
+
+    // The last fft_size samples, a ring, and how many came since the last FFT.
+    std::vector<float> history_;
+    int history_pos_ = 0;
+    int64_t history_count_ = 0;
+    int since_fft_ = 0;
+    std::vector<float> windowed_;
+    std::vector<float> power_, power_sum_;
+    int ffts_ = 0;
+    std::vector<uint8_t> spectrum_;
+
+    std::vector<float> scope_;
+    int scope_pos_ = 0;
+};
+
+} // namespace hibiki
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "analyzer.hpp"
+
+#include <cmath>
+#include <complex>
+#include <numbers>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+
+std::vector<float> Sine(int n, double freq, double amplitude) {
+    std::vector<float> out(n);
+    for (int i = 0; i < n; ++i) out[i] = (float)(amplitude * std::sin(2.0 * std::numbers::pi * freq * i / kSampleRate));
+    return out;
+}
+
+TEST(AnalyzerTest, FftMatchesDft) {
+    constexpr int kSize = 64;
+    std::vector<float> input(kSize);
+    for (int i = 0; i < kSize; ++i) input[i] = (float)std::sin(0.37 * i * i) + 0.25f;
+    hibiki::RealFft fft(kSize);
+    std::vector<float> power(kSize / 2 + 1);
+    fft.PowerSpectrum(input.data(), power.data());
+    for (int k = 0; k <= kSize / 2; ++k) {
+        std::complex<double> sum;
+        for (int i = 0; i < kSize; ++i) sum += (double)input[i] * std::polar(1.0, -2.0 * std::numbers::pi * k * i / kSize);
+        EXPECT_NEAR(power[k], std::norm(sum), 1e-3 * (1.0 + std::norm(sum))) << k;
+    }
+}
+
+TEST(AnalyzerTest, SineOnABinReadsItsLevel) {
+    hibiki::AnalyzerSettings settings;
+    settings.fft_size = 1024;
+    hibiki::Analyzer analyzer(kSampleRate, settings);
+    // Bin 64, at -20 dBFS: 215 in half dB over -127.5.
+    auto sine = Sine(4096, 64 * kSampleRate / 1024, 0.1);
+    analyzer.Process(sine.data(), sine.data(), (int)sine.size());
+    hibiki::AnalysisFrame frame;
+    analyzer.TakeFrame(frame);
+    ASSERT_EQ(frame.spectrum.size(), 513u);
+    EXPECT_NEAR(frame.spectrum[64], 215, 1);
+    // Hann leaks into the next bin at -6 dB and hardly beyond.
+    EXPECT_NEAR(frame.spectrum[65], 203, 1);
+    EXPECT_LT(frame.spectrum[70], 100);
+}
+
+TEST(AnalyzerTest, SpectrumWaitsForAFullWindow) {
+    hibiki::AnalyzerSettings settings;
+    settings.fft_size = 1024;
+    settings.overlap = 0.75f;
+    hibiki::Analyzer analyzer(kSampleRate, settings);
+    auto sine = Sine(1023, 1000.0, 0.5);
+    analyzer.Process(sine.data(), sine.data(), (int)sine.size());
+    hibiki::AnalysisFrame frame;
+    analyzer.TakeFrame(frame);
+    EXPECT_EQ(frame.spectrum[21], 0);
+    analyzer.Process(sine.data(), sine.data(), 1);
+    analyzer.TakeFrame(frame);
+    EXPECT_GT(frame.spectrum[21], 200);
+    // Without a new window, the last spectrum repeats.
+    analyzer.TakeFrame(frame);
+    EXPECT_GT(frame.spectrum[21], 200);
+}
+
+TEST(AnalyzerTest, ScopeKeepsMinimaAndMaxima) {
+    hibiki::AnalyzerSettings settings;
+    settings.scope_points = 4;
+    settings.scope_ms = 1.0f; // 48 samples, 12 per point
+    hibiki::Analyzer analyzer(kSampleRate, settings);
+    std::vector<float> l(48, 0.0f), r(48, 0.0f);
+    l[5] = 1.0f;
+    r[5] = 1.0f;
+    l[30] = -0.5f;
+    r[30] = -0.5f;
+    l[47] = 2.0f;
+    analyzer.Process(l.data(), r.data(), 48);
+    hibiki::AnalysisFrame frame;
+    analyzer.TakeFrame(frame);
+    EXPECT_EQ(frame.scope, (std::vector<int8_t>{0, 127, 0, 0, -64, 0, 0, 127}));
+}
+
+} // namespace
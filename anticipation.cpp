@@ -0,0 +1,278 @@
+#include "anticipation.hpp"
+#include "realtime.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace hibiki {
+
+namespace {
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Spins before a waiting claim gives way, in case the holder shares its CPU.
+constexpr int kSpinsBeforeYield = 64;
+
+} // namespace
+
+Anticipator::Anticipator(ProjectState& state, double sample_rate, int block_size, int lookahead_blocks, int num_threads,
+                         std::function<void(int)> thread_init, int max_tracks)
+    : state_(state),
+      block_info_{sample_rate, block_size, state.bpm, false},
+      lookahead_blocks_(std::max(1, lookahead_blocks)),
+      storage_((size_t)max_tracks * lookahead_blocks_ * 2 * block_size),
+      lanes_(max_tracks) {
+    float* buffer = storage_.data();
+    for (auto& lane : lanes_) {
+        lane.ring.resize(lookahead_blocks_);
+        for (auto& b : lane.ring) {
+            b.left = buffer;
+            b.right = buffer + block_size;
+            buffer += 2 * block_size;
+        }
+    }
+    rt::Prefault(storage_.data(), storage_.size() * sizeof(float));
+    for (int i = 0; i < num_threads; ++i) threads_.emplace_back([this, i, thread_init] { WorkerLoop(i, thread_init); });
+}
+
+Anticipator::~Anticipator() {
+    quit_.store(true);
+    wake_.fetch_add(1);
+    wake_.notify_all();
+    for (auto& t : threads_) t.join();
+
+    // Tracks that outlive the engine carry on from what was heard.
+    std::lock_guard<std::mutex> lock(state_.tracks_mutex);
+    const uint64_t block = played_.load();
+    for (auto& lane : lanes_) {
+        Track* track = lane.track.load();
+        auto it = state_.tracks.find(lane.track_index);
+        if (track && it != state_.tracks.end() && it->second.get() == track) SyncPosition(lane, *track, block, true);
+    }
+}
+
+void Anticipator::Claim(Lane& lane) {
+    // Whoever holds a lane renders at most one block before letting go.
+    for (int spins = 0; lane.claimed.exchange(true, std::memory_order_acquire); ++spins) {
+        if (spins < kSpinsBeforeYield) {
+            CpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+Anticipator::Lane* Anticipator::FindLane(const Track* track) {
+    for (auto& lane : lanes_) {
+        if (lane.track.load(std::memory_order_relaxed) == track) return &lane;
+    }
+    return nullptr;
+}
+
+void Anticipator::BeginBlock(const RenderPlan* plan, int64_t transport_frame) {
+    const uint64_t block = played_.load(std::memory_order_relaxed);
+    frame_origin_.store(transport_frame - (int64_t)block * block_info_.block_size, std::memory_order_release);
+    auto find_node = [&](const Track* track) -> const RenderPlan::Node* {
+        if (!plan) return nullptr;
+        for (const auto& node : plan->nodes) {
+            if (node.track == track) return &node;
+        }
+        return nullptr;
+    };
+
+    for (auto& lane : lanes_) {
+        Track* track = lane.track.load(std::memory_order_relaxed);
+        if (!track) continue;
+        const RenderPlan::Node* node = find_node(track);
+        if (node && IsEligible(*node)) continue;
+        Claim(lane);
+        // A track that left the plan may be gone already; one that is still in
+        // it renders just in time from this block on.
+        if (node) SyncPosition(lane, *track, block, true);
+        lane.track.store(nullptr, std::memory_order_relaxed);
+        lane.claimed.store(false, std::memory_order_release);
+    }
+
+    if (!plan) return;
+    for (const auto& node : plan->nodes) {
+        if (!IsEligible(node) || FindLane(node.track)) continue;
+        Lane* lane = FindLane(nullptr);
+        if (!lane) break;
+        // Until now the track rendered just in time, so its position is this block's.
+        Claim(*lane);
+        for (auto& b : lane->ring) b.index = UINT64_MAX;
+        lane->read.store(0, std::memory_order_relaxed);
+        lane->write.store(0, std::memory_order_relaxed);
+        lane->next_block = block;
+        lane->generation = node.track->render_generation.load(std::memory_order_acquire);
+        lane->seek = node.track->seek_generation.load(std::memory_order_acquire);
+        lane->track_index = node.track->index;
+        lane->track.store(node.track, std::memory_order_relaxed);
+        lane->claimed.store(false, std::memory_order_release);
+    }
+}
+
+bool Anticipator::TakeBlock(Track& track, const BlockInfo& block, bool& playing) {
+    Lane* lane = FindLane(&track);
+    if (!lane) return false;
+    const uint64_t index = played_.load(std::memory_order_relaxed);
+    if (TakeReady(*lane, track, index, playing)) return true;
+
+    // Not rendered yet, or thrown away: render it here, as without look-ahead.
+    // A thread busy with this lane finishes its block first; it may be this one.
+    Claim(*lane);
+    if (!TakeReady(*lane, track, index, playing)) {
+        HIBIKI_TRACE_SCOPE("Anticipator::Miss");
+        state_.stats.lookahead_misses.fetch_add(1, std::memory_order_relaxed);
+        SyncPosition(*lane, track, index, false);
+        track.heard_slot = track.playing_slot;
+        track.heard_time_sec = track.current_time_sec;
+        {
+            ScopedTimer timer(track.render_time);
+            playing = track.RenderClipBlock(block, nullptr, track.output_l.data(), track.output_r.data());
+        }
+        lane->next_block = index + 1;
+        lane->read.store(lane->write.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+    lane->claimed.store(false, std::memory_order_release);
+    return true;
+}
+
+void Anticipator::EndBlock() {
+    played_.fetch_add(1, std::memory_order_release);
+    wake_.fetch_add(1, std::memory_order_release);
+    wake_.notify_all();
+}
+
+bool Anticipator::TakeReady(Lane& lane, Track& track, uint64_t block, bool& playing) {
+    const uint32_t generation = track.render_generation.load(std::memory_order_acquire);
+    const uint32_t seek = track.seek_generation.load(std::memory_order_acquire);
+    uint64_t read = lane.read.load(std::memory_order_relaxed);
+    const uint64_t write = lane.write.load(std::memory_order_acquire);
+    bool found = false;
+    for (; read < write; ++read) {
+        const Block& b = lane.ring[read % lane.ring.size()];
+        // Stale and late blocks are skipped; early ones stay for later.
+        if (b.generation != generation || b.seek != seek || b.index < block) continue;
+        if (b.index > block) break;
+        std::copy_n(b.left, block_info_.block_size, track.output_l.data());
+        std::copy_n(b.right, block_info_.block_size, track.output_r.data());
+        playing = b.playing;
+        track.heard_slot = b.before.slot;
+        track.heard_time_sec = b.before.time_sec;
+        found = true;
+        ++read;
+        break;
+    }
+    lane.read.store(read, std::memory_order_release);
+    return found;
+}
+
+BlockInfo Anticipator::BlockAt(uint64_t block) const {
+    BlockInfo info = block_info_;
+    info.tempo = state_.bpm;
+    info.transport_frame = frame_origin_.load(std::memory_order_acquire) + (int64_t)block * info.block_size;
+    return info;
+}
+
+const Anticipator::Block* Anticipator::FindBlock(const Lane& lane, uint64_t block) const {
+    // Blocks stay in the ring after they are read, until overwritten.
+    const uint64_t write = lane.write.load(std::memory_order_relaxed);
+    const uint64_t size = lane.ring.size();
+    for (uint64_t pos = write; pos > 0 && pos + size > write; --pos) {
+        const Block& b = lane.ring[(pos - 1) % size];
+        if (b.index == block && b.seek == lane.seek) return &b;
+    }
+    return nullptr;
+}
+
+void Anticipator::SyncPosition(Lane& lane, Track& track, uint64_t block, bool rewind) {
+    const uint32_t generation = track.render_generation.load(std::memory_order_acquire);
+    const uint32_t seek = track.seek_generation.load(std::memory_order_acquire);
+    if (seek != lane.seek) {
+        // PlayClip or Stop put the position where the next block to be heard starts.
+        lane.next_block = block;
+    } else if ((rewind || generation != lane.generation) && block < lane.next_block) {
+        // Go back to where the track was before that block, to render it again.
+        if (const Block* b = FindBlock(lane, block)) {
+            track.playing_slot = b->before.slot;
+            track.current_time_sec = b->before.time_sec;
+            track.current_midi_idx = b->before.midi_idx;
+            track.launched_frame = b->before.launched_frame;
+            track.follow_slot = b->before.follow_slot;
+        }
+        lane.next_block = block;
+    }
+    lane.generation = generation;
+    lane.seek = seek;
+    // Fell behind what was heard: catch up without rendering.
+    for (; lane.next_block < block; ++lane.next_block) track.AdvancePlayback(BlockAt(lane.next_block));
+}
+
+bool Anticipator::RenderAhead(Lane& lane, Track& track) {
+    const uint64_t block = played_.load(std::memory_order_acquire);
+    SyncPosition(lane, track, block, false);
+    const uint64_t write = lane.write.load(std::memory_order_relaxed);
+    if (write - lane.read.load(std::memory_order_acquire) >= lane.ring.size()) return false;
+    if (lane.next_block >= block + lane.ring.size()) return false;
+
+    HIBIKI_TRACE_SCOPE("Anticipator::RenderAhead");
+    Block& b = lane.ring[write % lane.ring.size()];
+    b.index = lane.next_block;
+    b.generation = lane.generation;
+    b.seek = lane.seek;
+    b.before = {track.playing_slot, track.current_time_sec, track.current_midi_idx, track.launched_frame, track.follow_slot};
+    {
+        ScopedTimer timer(track.render_time);
+        b.playing = track.RenderClipBlock(BlockAt(lane.next_block), nullptr, b.left, b.right);
+    }
+    lane.next_block++;
+    lane.write.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+bool Anticipator::Fill(Lane& lane) {
+    if (!lane.track.load(std::memory_order_relaxed)) return false;
+    bool expected = false;
+    if (!lane.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) return false;
+
+    bool rendered = false;
+    Track* track = lane.track.load(std::memory_order_relaxed);
+    std::unique_lock<std::mutex> tracks_lock(state_.tracks_mutex, std::try_to_lock);
+    if (track && tracks_lock) {
+        auto it = state_.tracks.find(lane.track_index);
+        if (it != state_.tracks.end() && it->second.get() == track) {
+            std::unique_lock<std::mutex> track_lock(track->mutex, std::try_to_lock);
+            if (track_lock) rendered = RenderAhead(lane, *track);
+        }
+    }
+    lane.claimed.store(false, std::memory_order_release);
+    return rendered;
+}
+
+void Anticipator::WorkerLoop(int index, const std::function<void(int)>& thread_init) {
+    trace::SetThreadName("lookahead");
+    if (thread_init) thread_init(index);
+    uint64_t seen = wake_.load(std::memory_order_acquire);
+    while (!quit_.load()) {
+        bool progress = false;
+        for (auto& lane : lanes_) progress |= Fill(lane);
+        if (!progress) {
+            // Everything is far enough ahead, or busy: wait for the next block.
+            wake_.wait(seen, std::memory_order_acquire);
+            seen = wake_.load(std::memory_order_acquire);
+        }
+    }
+}
+
+} // namespace hibiki
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "project.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace hibiki {
+
+// Anticipative rendering. Clip tracks without live input (not return tracks,
+// no sidechain) render the same whenever they are rendered, so background
+// threads render them a few blocks ahead into per-track rings. The audio
+// thread then only copies their finished blocks and applies the mixer
+// strip, which stays immediate; return tracks and sidechained tracks are
+// still rendered just in time. A plugin that takes too long for one block
+// is absorbed by the blocks queued behind it.
+//
+// Each track's playback position runs ahead with the renders. Every block
+// in a ring is tagged with the track's render and seek generations; once
+// either moves on (see Track::Invalidate), the queued blocks are dropped and
+// rendered again from the position of the next block to be heard. If a
+// block is not ready in time, the audio thread renders it itself.
+//
+// The threads take state.tracks_mutex and the track's mutex, without
+// waiting, around every block, so they never render a track while it is
+// being changed or destroyed. The audio thread waits for a thread that is
+// rendering a block of the lane it needs, so the threads should run at the
+// render workers' priority; see thread_init.
+class Anticipator {
+public:
+    // lookahead_blocks is how far ahead each track is rendered; max_tracks
+    // caps how many tracks are anticipated, the rest render just in time.
+    // thread_init runs on each thread as it starts.
+    Anticipator(ProjectState& state, double sample_rate, int block_size, int lookahead_blocks, int num_threads,
+                std::function<void(int)> thread_init = {}, int max_tracks = 64);
+    // Puts the tracks back at the position that was heard last.
+    ~Anticipator();
+
+    Anticipator(const Anticipator&) = delete;
+    Anticipator& operator=(const Anticipator&) = delete;
+
+    // Audio thread, before the tracks of a block are rendered: hands the
+    // eligible tracks of the plan to rings and takes back the others.
+    // transport_frame is the block's transport position; the blocks after it
+    // are rendered as if the transport keeps running.
+    void BeginBlock(const RenderPlan* plan, int64_t transport_frame);
+    // Audio thread, or a render worker during the block: puts the track's
+    // pre-fader output for this block in output_l/r and sets playing as
+    // RenderClipBlock would. Returns false if the track is not anticipated.
+    bool TakeBlock(Track& track, const BlockInfo& block, bool& playing);
+    // Audio thread, once the block is done.
+    void EndBlock();
+
+    static bool IsEligible(const RenderPlan::Node& node) { return !node.track->is_return && node.sidechain == -1; }
+
+    int lookahead_blocks() const { return lookahead_blocks_; }
+
+private:
+    struct Cursor {
+        int slot;
+        double time_sec;
+        int midi_idx;
+        int64_t launched_frame;
+        int follow_slot;
+    };
+    struct Block {
+        uint64_t index = UINT64_MAX; // position in the engine's block sequence
+        uint32_t generation = 0;
+        uint32_t seek = 0;
+        bool playing = false;
+        Cursor before{};
+        float* left = nullptr;
+        float* right = nullptr;
+    };
+    // One anticipated track. Blocks are written by whoever holds claimed and
+    // read by the audio thread: a single-producer, single-consumer ring.
+    struct Lane {
+        std::atomic<Track*> track{nullptr};
+        int track_index = -1;
+        std::atomic<bool> claimed{false};
+        std::vector<Block> ring;
+        std::atomic<uint64_t> read{0};
+        std::atomic<uint64_t> write{0};
+        // Where the track's playback position is, in blocks, and which
+        // generations it follows. Only touched while claimed.
+        uint64_t next_block = 0;
+        uint32_t generation = 0;
+        uint32_t seek = 0;
+    };
+
+    void WorkerLoop(int index, const std::function<void(int)>& thread_init);
+    bool Fill(Lane& lane);
+    bool RenderAhead(Lane& lane, Track& track);
+    bool TakeReady(Lane& lane, Track& track, uint64_t block, bool& playing);
+    void SyncPosition(Lane& lane, Track& track, uint64_t block, bool rewind);
+    const Block* FindBlock(const Lane& lane, uint64_t block) const;
+    Lane* FindLane(const Track* track);
+    BlockInfo BlockAt(uint64_t block) const;
+    void Claim(Lane& lane);
+
+    ProjectState& state_;
+    BlockInfo block_info_;
+    int lookahead_blocks_;
+    std::vector<float> storage_;
+    std::vector<Lane> lanes_;
+
+    // Index of the block being heard, or next to be, in the engine's sequence,
+    // and the transport position block 0 would have had.
+    std::atomic<uint64_t> played_{0};
+    std::atomic<int64_t> frame_origin_{0};
+    std::atomic<uint64_t> wake_{0};
+    std::atomic<bool> quit_{false};
+    std::vector<std::thread> threads_;
+};
+
+} // namespace hibiki
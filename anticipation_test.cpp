@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 256;
+constexpr int kLookahead = 4;
+
+// A looping ramp, so that a block from the wrong position shows.
+std::unique_ptr<hibiki::Clip> RampClip(float scale) {
+    auto clip = std::make_unique<hibiki::Clip>();
+    clip->type = hibiki::Clip::Type::AUDIO;
+    clip->sample_rate = kSampleRate;
+    const int64_t frames = 10 * kBlockSize + 17;
+    clip->audio = hibiki::PlanarAudio(2, frames);
+    for (int c = 0; c < 2; ++c) {
+        for (int64_t i = 0; i < frames; ++i) clip->audio.channel(c)[i] = scale * i / frames;
+    }
+    clip->duration_sec = frames / kSampleRate;
+    clip->is_loop = true;
+    return clip;
+}
+
+void SetUpTrack(hibiki::ProjectState& state, int index) {
+    auto* track = hibiki::GetOrCreateTrack(state, index);
+    track->InsertClip(0, RampClip(0.5f));
+    track->InsertClip(1, RampClip(-0.25f));
+    track->PlayClip(0);
+}
+
+// Gives the look-ahead threads time to get ahead before each block.
+void ProcessBlocks(hibiki::Engine& engine, int count, std::vector<float>& out) {
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    for (int i = 0; i < count; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        engine.Process(l.data(), r.data());
+        out.insert(out.end(), l.begin(), l.end());
+    }
+}
+
+TEST(AnticipationTest, MatchesJustInTimeRendering) {
+    hibiki::ProjectState live_state, ahead_state;
+    for (int i = 0; i < 3; ++i) {
+        SetUpTrack(live_state, i);
+        SetUpTrack(ahead_state, i);
+    }
+    hibiki::Engine live(live_state, kSampleRate, kBlockSize, 0);
+    hibiki::Engine ahead(ahead_state, kSampleRate, kBlockSize, 0);
+    ahead.SetLookahead(kLookahead, 2);
+    EXPECT_EQ(ahead.lookahead_blocks(), kLookahead);
+
+    std::vector<float> expected, actual;
+    ProcessBlocks(live, 40, expected);
+    ProcessBlocks(ahead, 40, actual);
+    EXPECT_EQ(actual, expected);
+    // The first block of each track is rendered in the callback; the rest
+    // should mostly have been ready.
+    EXPECT_LT(ahead_state.stats.lookahead_misses.load(), 3u * 40 / 2);
+}
+
+TEST(AnticipationTest, ChangesDropQueuedBlocks) {
+    hibiki::ProjectState state;
+    SetUpTrack(state, 0);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    engine.SetLookahead(kLookahead, 1);
+    std::vector<float> out;
+    ProcessBlocks(engine, 10, out);
+
+    // Replacing the clip takes effect with the very next block.
+    auto* track = state.tracks[0].get();
+    {
+        std::lock_guard<std::mutex> tracks_lock(state.tracks_mutex);
+        track->InsertClip(0, RampClip(1.0f));
+    }
+    out.clear();
+    ProcessBlocks(engine, 1, out);
+    const float* ramp = track->clips[0]->audio.channel(0);
+    EXPECT_FLOAT_EQ(out[5], ramp[10 * kBlockSize + 5]);
+
+    // So does switching clips, from the start of the new one.
+    track->PlayClip(1);
+    out.clear();
+    ProcessBlocks(engine, 2, out);
+    EXPECT_FLOAT_EQ(out[kBlockSize + 3], track->clips[1]->audio.channel(0)[kBlockSize + 3]);
+}
+
+TEST(AnticipationTest, LaunchesLandOnTheSameFrames) {
+    hibiki::ProjectState live_state, ahead_state;
+    for (auto* state : {&live_state, &ahead_state}) {
+        for (int i = 0; i < 2; ++i) {
+            auto* track = hibiki::GetOrCreateTrack(*state, i);
+            track->InsertClip(0, RampClip(0.5f));
+            track->InsertClip(1, RampClip(-0.25f));
+            track->SetFollowAction(1, hibiki::FollowAction::kPrevious, 0.5);
+        }
+        state->launch_quantization = (int)hibiki::LaunchQuantization::kBeat;
+        state->launches.Push({hibiki::LaunchRequest::Kind::kClip, 0, 0});
+    }
+    hibiki::Engine live(live_state, kSampleRate, kBlockSize, 0);
+    hibiki::Engine ahead(ahead_state, kSampleRate, kBlockSize, 0);
+    ahead.SetLookahead(kLookahead, 2);
+
+    // A beat at 120 bpm is 93.75 blocks.
+    std::vector<float> expected, actual;
+    ProcessBlocks(live, 20, expected);
+    ProcessBlocks(ahead, 20, actual);
+    live_state.launches.Push({hibiki::LaunchRequest::Kind::kScene, -1, 1});
+    ahead_state.launches.Push({hibiki::LaunchRequest::Kind::kScene, -1, 1});
+    ProcessBlocks(live, 160, expected);
+    ProcessBlocks(ahead, 160, actual);
+    EXPECT_EQ(actual, expected);
+    EXPECT_EQ(ahead_state.tracks[1]->playing_slot, 0);
+}
+
+TEST(AnticipationTest, PlayheadShowsWhatIsHeard) {
+    hibiki::ProjectState state;
+    SetUpTrack(state, 0);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    engine.SetLookahead(kLookahead, 1);
+    engine.SetPlayheadInterval(std::chrono::nanoseconds(1));
+    std::vector<float> out;
+    ProcessBlocks(engine, 10, out);
+
+    // The track's own position has run ahead with the renders.
+    auto playhead = engine.TakePlayhead();
+    ASSERT_NE(playhead, nullptr);
+    ASSERT_EQ(playhead->tracks.size(), 1u);
+    EXPECT_EQ(playhead->tracks[0].slot_index, 0);
+    EXPECT_NEAR(playhead->tracks[0].position_sec, 9 * kBlockSize / kSampleRate, 1e-9);
+}
+
+TEST(AnticipationTest, PositionIsRewoundWhenTheEngineGoes) {
+    hibiki::ProjectState state;
+    SetUpTrack(state, 0);
+    {
+        hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+        engine.SetLookahead(kLookahead, 1);
+        std::vector<float> out;
+        ProcessBlocks(engine, 3, out);
+    }
+    EXPECT_NEAR(state.tracks[0]->current_time_sec, 3 * kBlockSize / kSampleRate, 1e-9);
+}
+
+TEST(AnticipationTest, ThreadInitRunsOnEachThread) {
+    hibiki::ProjectState state;
+    std::mutex mutex;
+    std::vector<int> started;
+    {
+        hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+        engine.SetLookahead(kLookahead, 3, [&](int thread) {
+            std::lock_guard<std::mutex> lock(mutex);
+            started.push_back(thread);
+        });
+    }
+    std::sort(started.begin(), started.end());
+    EXPECT_EQ(started, (std::vector<int>{0, 1, 2}));
+}
+
+TEST(AnticipationTest, ReturnTracksStillSumAnticipatedTracks) {
+    hibiki::ProjectState state;
+    SetUpTrack(state, 0);
+    hibiki::SetReturnTrack(state, 1, true);
+    ASSERT_TRUE(hibiki::SetTrackOutput(state, 0, 1));
+    state.tracks[1]->mixer.volume = 0.5f;
+
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 1);
+    engine.SetLookahead(kLookahead, 1);
+    std::vector<float> out;
+    ProcessBlocks(engine, 4, out);
+    const float* ramp = state.tracks[0]->clips[0]->audio.channel(0);
+    EXPECT_NEAR(out[3 * kBlockSize + 100], 0.5f * ramp[3 * kBlockSize + 100], 1e-6f);
+}
+
+} // namespace
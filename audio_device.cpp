@@ -0,0 +1,123 @@
+#include "audio_device.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace hibiki {
+
+namespace {
+
+struct Backend {
+    int priority;
+    AudioDeviceFactory factory;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, Backend> backends;
+};
+
+// Constructed on first use so static registrations in other translation
+// units don't depend on initialization order.
+Registry& GetRegistry() {
+    static Registry* registry = [] {
+        auto* r = new Registry;
+        r->backends["null"] = {-1000, [](const AudioDeviceOptions& options) {
+            return std::unique_ptr<AudioDevice>(new NullAudioDevice(options));
+        }};
+        return r;
+    }();
+    return *registry;
+}
+
+} // namespace
+
+std::chrono::steady_clock::time_point AudioDevice::output_time() const {
+    using Clock = std::chrono::steady_clock;
+    return Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                              std::chrono::duration<double>((double)get_block_size() / get_sample_rate()));
+}
+
+void BlockingAudioDevice::run(const RenderCallback& render) {
+    int block_size = get_block_size();
+    std::vector<float> interleaved((size_t)block_size * get_channels());
+    bool more = true;
+    while (more) {
+        more = render(interleaved.data(), block_size);
+        write(interleaved, block_size);
+    }
+}
+
+void NullAudioDevice::run(const RenderCallback& render) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<float> interleaved((size_t)options_.block_size * options_.channels);
+    const bool free_running = options_.clock_ratio <= 0.0;
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options_.block_size / (options_.sample_rate * std::max(options_.clock_ratio, 1e-9))));
+
+    // The simulated device holds one block in flight: a block is due when
+    // the previous one finishes playing.
+    auto deadline = Clock::now() + period;
+    bool more = true;
+    while (more) {
+        more = render(interleaved.data(), options_.block_size);
+        if (free_running) continue;
+        auto now = Clock::now();
+        if (now > deadline) {
+            xruns_.fetch_add(1, std::memory_order_relaxed);
+            deadline = now;
+        } else {
+            std::this_thread::sleep_until(deadline);
+        }
+        deadline += period;
+    }
+}
+
+void RegisterAudioDevice(const std::string& name, int priority, AudioDeviceFactory factory) {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.backends[name] = {priority, std::move(factory)};
+}
+
+std::vector<std::string> AudioDeviceNames() {
+    auto& registry = GetRegistry();
+    std::vector<std::pair<int, std::string>> sorted;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& [name, backend] : registry.backends) sorted.push_back({-backend.priority, name});
+    }
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<std::string> names;
+    for (auto& entry : sorted) names.push_back(std::move(entry.second));
+    return names;
+}
+
+std::unique_ptr<AudioDevice> OpenAudioDevice(const std::string& name, const AudioDeviceOptions& options) {
+    std::vector<std::string> candidates = name.empty() ? AudioDeviceNames() : std::vector<std::string>{name};
+    for (const auto& candidate : candidates) {
+        AudioDeviceFactory factory;
+        {
+            auto& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            auto it = registry.backends.find(candidate);
+            if (it == registry.backends.end()) {
+                std::cerr << "Unknown audio device: " << candidate << std::endl;
+                continue;
+            }
+            factory = it->second.factory;
+        }
+        auto device = factory(options);
+        if (device && device->is_ready()) {
+            std::cerr << "Audio device: " << candidate << " (" << device->get_sample_rate() << " Hz, "
+                      << device->get_channels() << " channels, " << device->get_block_size() << " frames)" << std::endl;
+            return device;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace hibiki
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace hibiki {
+
+struct AudioDeviceOptions {
+    int sample_rate = 44100;
+    int channels = 2;
+    int block_size = 512;
+    // Null device only: speed of the simulated clock relative to real time.
+    // 0 renders blocks back to back as fast as the callback returns.
+    double clock_ratio = 1.0;
+    // JACK only: stereo per-track output ports, and whether the engine
+    // drives the JACK transport and timebase.
+    int stem_ports = 0;
+    bool transport_sync = false;
+    // Device buffer as a number of blocks, for backends that size their own
+    // buffer; 0 keeps the backend's default.
+    int buffer_blocks = 0;
+};
+
+// An audio output the engine renders into. Backends register themselves
+// under a name; the playback thread opens one and hands it a render callback.
+class AudioDevice {
+public:
+    // Fills num_frames interleaved frames of get_channels() channels.
+    // Returning false stops the device.
+    using RenderCallback = std::function<bool(float* interleaved, int num_frames)>;
+
+    virtual ~AudioDevice() = default;
+
+    virtual bool is_ready() const = 0;
+    // Calls render once per block, paced by the device, until it returns false.
+    // The block from that last call is still played before run returns.
+    virtual void run(const RenderCallback& render) = 0;
+
+    // The device may not honor the requested options.
+    virtual int get_sample_rate() const = 0;
+    virtual int get_channels() const = 0;
+    virtual int get_block_size() const = 0;
+    // Underruns since the device was opened.
+    virtual uint32_t xrun_count() const = 0;
+    // Called inside the render callback: when the first frame of the block
+    // being rendered reaches the DAC, on the steady clock. The default
+    // assumes the block plays once the one before it has, a block from now.
+    virtual std::chrono::steady_clock::time_point output_time() const;
+
+    // Per-track outputs ("stems") for routing into other applications. Only
+    // valid inside the render callback; the frames belong to the block being
+    // rendered. Tracks at or beyond stem_count() are dropped.
+    virtual int stem_count() const { return 0; }
+    virtual void write_stem(int track_index, const float* left, const float* right, int num_frames) {}
+    // Called inside the render callback with the engine's play state and
+    // tempo, for backends with a shared transport.
+    virtual void set_transport(bool rolling, double bpm) {}
+
+    // Idle support, called between run() calls: pause() lets the queued audio
+    // play out and stops the stream so the hardware and the audio thread can
+    // sleep; resume() makes it ready for the next run(). Backends that cannot
+    // stop without side effects keep can_pause() false and keep running.
+    virtual bool can_pause() const { return false; }
+    virtual void pause() {}
+    virtual void resume() {}
+};
+
+// Base for push-model backends whose write() blocks until the device has
+// room for another block.
+class BlockingAudioDevice : public AudioDevice {
+public:
+    void run(const RenderCallback& render) override;
+    virtual void write(const std::vector<float>& interleaved_data, int num_frames) = 0;
+};
+
+// Runs on its own clock with no hardware, for CI and load tests.
+class NullAudioDevice : public AudioDevice {
+public:
+    explicit NullAudioDevice(const AudioDeviceOptions& options) : options_(options) {}
+
+    bool is_ready() const override { return true; }
+    void run(const RenderCallback& render) override;
+    int get_sample_rate() const override { return options_.sample_rate; }
+    int get_channels() const override { return options_.channels; }
+    int get_block_size() const override { return options_.block_size; }
+    // Blocks that finished more than a block period late on the simulated clock.
+    uint32_t xrun_count() const override { return xruns_.load(std::memory_order_relaxed); }
+    // The clock restarts with each run().
+    bool can_pause() const override { return true; }
+
+private:
+    AudioDeviceOptions options_;
+    std::atomic<uint32_t> xruns_{0};
+};
+
+using AudioDeviceFactory = std::function<std::unique_ptr<AudioDevice>(const AudioDeviceOptions&)>;
+
+// Registers a backend, normally from a static initializer in its own
+// translation unit. Higher priorities are tried first when no name is given.
+void RegisterAudioDevice(const std::string& name, int priority, AudioDeviceFactory factory);
+
+struct AudioDeviceRegistration {
+    AudioDeviceRegistration(const std::string& name, int priority, AudioDeviceFactory factory) {
+        RegisterAudioDevice(name, priority, std::move(factory));
+    }
+};
+
+// Registered backend names, highest priority first. "null" is always present
+// and comes last.
+std::vector<std::string> AudioDeviceNames();
+
+// Opens the named backend, or with an empty name the first one that comes up
+// ready. Returns nullptr if the name is unknown or the device is not ready.
+std::unique_ptr<AudioDevice> OpenAudioDevice(const std::string& name, const AudioDeviceOptions& options);
+
+} // namespace hibiki
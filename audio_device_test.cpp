@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "audio_device.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+hibiki::AudioDeviceOptions Options(double clock_ratio) {
+    hibiki::AudioDeviceOptions options;
+    options.sample_rate = 48000;
+    options.channels = 2;
+    options.block_size = 480;
+    options.clock_ratio = clock_ratio;
+    return options;
+}
+
+class FakeDevice : public hibiki::NullAudioDevice {
+public:
+    explicit FakeDevice(bool ready) : NullAudioDevice(Options(0.0)), ready_(ready) {}
+    bool is_ready() const override { return ready_; }
+
+private:
+    bool ready_;
+};
+
+// Keeps the first sample of every block written.
+class RecordingDevice : public hibiki::BlockingAudioDevice {
+public:
+    bool is_ready() const override { return true; }
+    int get_sample_rate() const override { return 48000; }
+    int get_channels() const override { return 2; }
+    int get_block_size() const override { return 64; }
+    uint32_t xrun_count() const override { return 0; }
+    void write(const std::vector<float>& interleaved_data, int) override { written.push_back(interleaved_data[0]); }
+
+    std::vector<float> written;
+};
+
+TEST(AudioDeviceTest, NullIsAlwaysRegisteredLast) {
+    hibiki::AudioDeviceRegistration registration("fake", 10, [](const hibiki::AudioDeviceOptions&) {
+        return std::unique_ptr<hibiki::AudioDevice>(new FakeDevice(true));
+    });
+    auto names = hibiki::AudioDeviceNames();
+    ASSERT_GE(names.size(), 2u);
+    EXPECT_EQ(names.back(), "null");
+    EXPECT_NE(std::find(names.begin(), names.end(), "fake"), names.end());
+    EXPECT_EQ(hibiki::OpenAudioDevice("no such device", Options(1.0)), nullptr);
+}
+
+TEST(AudioDeviceTest, FallsBackPastDevicesThatAreNotReady) {
+    hibiki::RegisterAudioDevice("broken", 1000, [](const hibiki::AudioDeviceOptions&) {
+        return std::unique_ptr<hibiki::AudioDevice>(new FakeDevice(false));
+    });
+    EXPECT_EQ(hibiki::OpenAudioDevice("broken", Options(1.0)), nullptr);
+    auto device = hibiki::OpenAudioDevice("", Options(1.0));
+    ASSERT_NE(device, nullptr);
+    EXPECT_TRUE(device->is_ready());
+}
+
+TEST(AudioDeviceTest, NullDeviceRunsUntilCallbackStops) {
+    auto device = hibiki::OpenAudioDevice("null", Options(0.0));
+    ASSERT_NE(device, nullptr);
+    EXPECT_EQ(device->get_block_size(), 480);
+    int blocks = 0;
+    device->run([&](float* interleaved, int num_frames) {
+        EXPECT_EQ(num_frames, 480);
+        std::fill_n(interleaved, num_frames * 2, 1.0f);
+        return ++blocks < 1000;
+    });
+    EXPECT_EQ(blocks, 1000);
+    EXPECT_EQ(device->xrun_count(), 0u);
+}
+
+TEST(AudioDeviceTest, BlockingDeviceWritesTheLastBlock) {
+    RecordingDevice device;
+    int blocks = 0;
+    device.run([&](float* interleaved, int num_frames) {
+        std::fill_n(interleaved, num_frames * 2, (float)++blocks);
+        return blocks < 3;
+    });
+    EXPECT_EQ(device.written, (std::vector<float>{1.0f, 2.0f, 3.0f}));
+}
+
+TEST(AudioDeviceTest, NullDeviceFollowsSimulatedClock) {
+    // 25 blocks of 10 ms at four times real time.
+    auto device = hibiki::OpenAudioDevice("null", Options(4.0));
+    int blocks = 0;
+    auto start = std::chrono::steady_clock::now();
+    device->run([&](float*, int) { return ++blocks < 25; });
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(55));
+}
+
+TEST(AudioDeviceTest, NullDeviceCountsLateBlocksAsXruns) {
+    auto device = hibiki::OpenAudioDevice("null", Options(1.0));
+    int blocks = 0;
+    device->run([&](float*, int) {
+        if (blocks == 2) std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        return ++blocks < 5;
+    });
+    EXPECT_EQ(device->xrun_count(), 1u);
+}
+
+TEST(AudioDeviceTest, OutputTimeDefaultsToOneBlockAhead) {
+    auto device = hibiki::OpenAudioDevice("null", Options(1.0));
+    ASSERT_NE(device, nullptr);
+    auto before = std::chrono::steady_clock::now();
+    auto output = device->output_time();
+    EXPECT_GE(output - before, std::chrono::milliseconds(10));
+    EXPECT_LE(output - std::chrono::steady_clock::now(), std::chrono::milliseconds(10));
+}
+
+} // namespace
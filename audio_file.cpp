@@ -1,4 +1,5 @@
 #include "audio_file.hpp"
+#include "dsp.hpp"
 #include <fstream>
 #include <cstdint>
 
@@ -39,14 +40,7 @@ bool LoadWav(const std::string& path, std::vector<float>& out_data, int& out_cha
             std::vector<int16_t> pcm(num_samples);
             f.read((char*)pcm.data(), size);
             out_data.resize(num_samples);
-            for (int i = 0; i < num_samples; ++i) {
-                out_data[i] = pcm[i] / 32768.0f;
-            }
-            float max_val = 0.0f;
-            for (size_t i = 0; i < out_data.size(); ++i) {
-                float abs_val = std::abs(out_data[i]);
-                if (abs_val > max_val) max_val = abs_val;
-            }
+            dsp::Int16ToFloat(out_data.data(), pcm.data(), num_samples);
             // we don't normalize here, we just load
 
             out_channels = channels;
@@ -1,16 +1,152 @@
 #include "clip.hpp"
 #include "audio_file.hpp"
+#include "dsp.hpp"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <new>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace hibiki {
 
+PlanarAudio::PlanarAudio(int num_channels, int64_t num_frames)
+    : num_channels_(num_channels), num_frames_(num_frames) {
+    stride_ = (num_frames + kPadFrames - 1) / kPadFrames * kPadFrames;
+    size_t count = (size_t)(stride_ * num_channels);
+    if (count == 0) return;
+    data_.reset(static_cast<float*>(::operator new[](count * sizeof(float), std::align_val_t{kAlignment})));
+    std::fill_n(data_.get(), count, 0.0f);
+}
+
+PlanarAudio::PlanarAudio(const PlanarAudio& other) : PlanarAudio(other.num_channels_, other.num_frames_) {
+    if (data_) std::memcpy(data_.get(), other.data_.get(), (size_t)(stride_ * num_channels_) * sizeof(float));
+}
+
+PlanarAudio& PlanarAudio::operator=(const PlanarAudio& other) {
+    if (this != &other) *this = PlanarAudio(other);
+    return *this;
+}
+
+PlanarAudio::PlanarAudio(PlanarAudio&& other) noexcept
+    : data_(std::move(other.data_)),
+      num_channels_(std::exchange(other.num_channels_, 0)),
+      num_frames_(std::exchange(other.num_frames_, 0)),
+      stride_(std::exchange(other.stride_, 0)) {}
+
+PlanarAudio& PlanarAudio::operator=(PlanarAudio&& other) noexcept {
+    data_ = std::move(other.data_);
+    num_channels_ = std::exchange(other.num_channels_, 0);
+    num_frames_ = std::exchange(other.num_frames_, 0);
+    stride_ = std::exchange(other.stride_, 0);
+    return *this;
+}
+
+PlanarAudio PlanarAudio::MapTemporary(int num_channels, int64_t num_frames, const std::string& dir) {
+#if defined(_WIN32)
+    (void)dir;
+    return PlanarAudio(num_channels, num_frames);
+#else
+    PlanarAudio audio;
+    int64_t stride = (num_frames + kPadFrames - 1) / kPadFrames * kPadFrames;
+    size_t bytes = (size_t)(stride * num_channels) * sizeof(float);
+    if (bytes == 0) return audio;
+
+    std::string path = dir + "/hibiki-XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0) return audio;
+    unlink(path.c_str());
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, (off_t)bytes) == 0) p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return audio;
+
+    // A fresh file reads as zeros, and mmap is page aligned.
+    audio.data_ = std::unique_ptr<float[], AlignedDelete>(static_cast<float*>(p), AlignedDelete{bytes});
+    audio.num_channels_ = num_channels;
+    audio.num_frames_ = num_frames;
+    audio.stride_ = stride;
+    return audio;
+#endif
+}
+
+void PlanarAudio::AlignedDelete::operator()(float* p) const {
+#if !defined(_WIN32)
+    if (mapped_bytes > 0) {
+        munmap(p, mapped_bytes);
+        return;
+    }
+#endif
+    ::operator delete[](p, std::align_val_t{kAlignment});
+}
+
+namespace {
+
+// Mono clips read channel 0 for both outputs; wider clips play their first two channels.
+template <int kChannels>
+void CopyFrames(const PlanarAudio& audio, int64_t from, float* out_l, float* out_r, int n) {
+    static_assert(kChannels == 1 || kChannels == 2);
+    std::memcpy(out_l, audio.channel(0) + from, n * sizeof(float));
+    std::memcpy(out_r, audio.channel(kChannels - 1) + from, n * sizeof(float));
+}
+
+template <int kChannels>
+void RenderFrames(const PlanarAudio& audio, bool is_loop, int64_t pos, float* out_l, float* out_r, int n) {
+    const int64_t length = audio.num_frames();
+    int done = 0;
+    while (done < n) {
+        if (pos >= length) {
+            if (!is_loop || length == 0) {
+                std::fill(out_l + done, out_l + n, 0.0f);
+                std::fill(out_r + done, out_r + n, 0.0f);
+                return;
+            }
+            pos %= length;
+        }
+        int chunk = (int)std::min<int64_t>(n - done, length - pos);
+        CopyFrames<kChannels>(audio, pos, out_l + done, out_r + done, chunk);
+        done += chunk;
+        pos += chunk;
+    }
+}
+
+} // namespace
+
+std::vector<float> WaveformSummary(const PlanarAudio& audio, int num_points) {
+    if (audio.empty()) return {};
+    std::vector<float> summary(num_points);
+    int64_t num_frames = audio.num_frames();
+    int64_t samples_per_point = std::max<int64_t>(num_frames / num_points, 1);
+    const float* first = audio.channel(0);
+
+    for (int i = 0; i < num_points; i++) {
+        int64_t begin = std::min<int64_t>(i * samples_per_point, num_frames);
+        int64_t end = std::min<int64_t>(begin + samples_per_point, num_frames);
+        summary[i] = dsp::AbsPeak(first + begin, (int)(end - begin));
+    }
+    return summary;
+}
+
+void RenderAudioClip(const Clip& clip, int64_t start_frame, float* out_l, float* out_r, int num_frames) {
+    start_frame = std::max<int64_t>(start_frame, 0);
+    if (clip.audio.num_channels() == 1) {
+        RenderFrames<1>(clip.audio, clip.is_loop, start_frame, out_l, out_r, num_frames);
+    } else if (clip.audio.num_channels() >= 2) {
+        RenderFrames<2>(clip.audio, clip.is_loop, start_frame, out_l, out_r, num_frames);
+    } else {
+        std::fill(out_l, out_l + num_frames, 0.0f);
+        std::fill(out_r, out_r + num_frames, 0.0f);
+    }
+}
+
 std::unique_ptr<Clip> LoadClip(const std::string& path, bool is_loop) {
     auto clip = MaybeLoadClip(path, is_loop);
     if (clip) {
-        auto ret = std::make_unique<Clip>();
-        *ret = *clip;
-        return ret;
+        return std::make_unique<Clip>(std::move(*clip));
     }
     return nullptr;
 }
@@ -21,29 +157,26 @@ std::expected<Clip, std::string> MaybeLoadClip(const std::string& path, bool is_
     clip.is_loop = is_loop;
 
     if (path.size() > 4 && path.substr(path.size() - 4) == ".wav") {
-        if (!LoadWav(path, clip.audio_data, clip.num_channels, clip.duration_sec)) {
+        std::vector<float> interleaved;
+        int num_channels = 0;
+        if (!LoadWav(path, interleaved, num_channels, clip.duration_sec) || num_channels <= 0) {
             return std::unexpected("Cannot load wav: " + path);
         }
         clip.type = Clip::Type::AUDIO;
 
-        // Generate waveform summary for AUDIO clips
-        if (!clip.audio_data.empty()) {
-            int num_points = 256;
-            clip.waveform_summary.resize(num_points);
-            int samples_per_point = clip.audio_data.size() / (clip.num_channels * num_points);
-            if (samples_per_point < 1) samples_per_point = 1;
-
-            for (int i = 0; i < num_points; i++) {
-                float max_val = 0;
-                for (int j = 0; j < samples_per_point; j++) {
-                    int idx = (i * samples_per_point + j) * clip.num_channels;
-                    if (idx < (int)clip.audio_data.size()) {
-                        max_val = std::max(max_val, std::abs(clip.audio_data[idx]));
-                    }
-                }
-                clip.waveform_summary[i] = max_val;
+        int64_t num_frames = (int64_t)interleaved.size() / num_channels;
+        clip.audio = PlanarAudio(num_channels, num_frames);
+        if (num_channels == 2) {
+            dsp::Deinterleave2(clip.audio.channel(0), clip.audio.channel(1), interleaved.data(), (int)num_frames);
+        } else {
+            for (int c = 0; c < num_channels; ++c) {
+                float* dst = clip.audio.channel(c);
+                for (int64_t i = 0; i < num_frames; ++i) dst[i] = interleaved[i * num_channels + c];
             }
         }
+
+        // Generate waveform summary for AUDIO clips
+        clip.waveform_summary = WaveformSummary(clip.audio);
     } else {
         auto events = hibiki::parseMidi(path);
         if (events.empty()) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <vector>
 #include <string>
@@ -8,19 +10,82 @@
 
 namespace hibiki {
 
+// Planar float audio. Every channel starts on a 64-byte boundary and is
+// zero-padded to a whole number of cache lines, so vector loops and memcpy
+// can run over any channel without alignment or tail handling.
+class PlanarAudio {
+public:
+    static constexpr size_t kAlignment = 64;
+    static constexpr int64_t kPadFrames = kAlignment / sizeof(float);
+
+    PlanarAudio() = default;
+    PlanarAudio(int num_channels, int64_t num_frames);
+    PlanarAudio(const PlanarAudio& other);
+    PlanarAudio& operator=(const PlanarAudio& other);
+    PlanarAudio(PlanarAudio&& other) noexcept;
+    PlanarAudio& operator=(PlanarAudio&& other) noexcept;
+
+    // Same layout, backed by an unlinked temporary file in dir mapped into
+    // memory, so that under memory pressure the kernel can drop the pages
+    // and read them back instead of swapping. Returns an empty PlanarAudio if
+    // the file cannot be created; memory-backed on Windows.
+    static PlanarAudio MapTemporary(int num_channels, int64_t num_frames, const std::string& dir);
+    bool file_backed() const { return data_.get_deleter().mapped_bytes > 0; }
+
+    int num_channels() const { return num_channels_; }
+    int64_t num_frames() const { return num_frames_; }
+    bool empty() const { return num_frames_ == 0; }
+
+    float* channel(int c) { return data_.get() + c * stride_; }
+    const float* channel(int c) const { return data_.get() + c * stride_; }
+    // All channels including padding, as one allocation.
+    const float* data() const { return data_.get(); }
+    size_t byte_size() const { return (size_t)(stride_ * num_channels_) * sizeof(float); }
+
+private:
+    struct AlignedDelete {
+        size_t mapped_bytes; // nonzero for MapTemporary
+        void operator()(float* p) const;
+    };
+    std::unique_ptr<float[], AlignedDelete> data_;
+    int num_channels_ = 0;
+    int64_t num_frames_ = 0;
+    int64_t stride_ = 0;
+};
+
+// What a launched clip does once it has played for its follow time.
+enum class FollowAction {
+    kNone = 0,
+    kStop = 1,
+    kAgain = 2,
+    kNext = 3,     // next occupied slot of the track, wrapping around
+    kPrevious = 4, // previous occupied slot, wrapping around
+    kFirst = 5,
+};
+
 struct Clip {
     enum Type { MIDI, AUDIO } type;
     std::vector<hibiki::MidiEvent> midi_events;
-    std::vector<float> audio_data;
-    int num_channels = 0;
+    PlanarAudio audio;
     double sample_rate = 0.0;
     double duration_sec = 0.0;
     std::vector<float> waveform_summary;
     std::string path;
     bool is_loop = false;
+    FollowAction follow_action = FollowAction::kNone;
+    // Follow time in beats from the launch; 0 for the clip's length.
+    double follow_beats = 0.0;
 };
 
 std::unique_ptr<Clip> LoadClip(const std::string& path, bool is_loop = false);
 std::expected<Clip, std::string> MaybeLoadClip(const std::string& path, bool is_loop = false);
 
+// Peak of the first channel over num_points equal slices, for the clip overview.
+std::vector<float> WaveformSummary(const PlanarAudio& audio, int num_points = 256);
+
+// Copies num_frames frames of an audio clip starting at start_frame into out_l/out_r.
+// Mono clips are duplicated to both outputs. Looping clips wrap around with at most
+// one extra bulk copy per block; one-shot clips are zero-filled past their end.
+void RenderAudioClip(const Clip& clip, int64_t start_frame, float* out_l, float* out_r, int num_frames);
+
 } // namespace hibiki
@@ -7,7 +7,7 @@ TEST(ClipTest, LoadAudioClip) {
     ASSERT_NE(clip, nullptr);
     EXPECT_EQ(clip->type, hibiki::Clip::Type::AUDIO);
     EXPECT_TRUE(clip->is_loop);
-    EXPECT_GT(clip->audio_data.size(), 0);
+    EXPECT_GT(clip->audio.num_frames(), 0);
     EXPECT_GT(clip->duration_sec, 0.0);
 }
 
@@ -19,3 +19,49 @@ TEST(ClipTest, LoadMidiClip) {
     EXPECT_GT(clip->midi_events.size(), 0);
     EXPECT_GT(clip->duration_sec, 0.0);
 }
+
+TEST(ClipTest, AudioIsPlanarAndAligned) {
+    auto clip = hibiki::LoadClip(hibiki::find_test_file("testdata/loop140.wav"));
+    ASSERT_NE(clip, nullptr);
+    ASSERT_GT(clip->audio.num_channels(), 0);
+    for (int c = 0; c < clip->audio.num_channels(); ++c) {
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(clip->audio.channel(c)) % hibiki::PlanarAudio::kAlignment, 0u);
+    }
+}
+
+TEST(ClipTest, RenderAudioClipWrapsLoop) {
+    hibiki::Clip clip;
+    clip.type = hibiki::Clip::Type::AUDIO;
+    clip.audio = hibiki::PlanarAudio(2, 10);
+    for (int i = 0; i < 10; ++i) {
+        clip.audio.channel(0)[i] = (float)i;
+        clip.audio.channel(1)[i] = (float)-i;
+    }
+    float l[8], r[8];
+
+    clip.is_loop = true;
+    hibiki::RenderAudioClip(clip, 6, l, r, 8);
+    const float expected[] = {6, 7, 8, 9, 0, 1, 2, 3};
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_EQ(l[i], expected[i]);
+        EXPECT_EQ(r[i], -expected[i]);
+    }
+
+    clip.is_loop = false;
+    hibiki::RenderAudioClip(clip, 6, l, r, 8);
+    const float one_shot[] = {6, 7, 8, 9, 0, 0, 0, 0};
+    for (int i = 0; i < 8; ++i) EXPECT_EQ(l[i], one_shot[i]);
+}
+
+TEST(ClipTest, RenderMonoClipToBothChannels) {
+    hibiki::Clip clip;
+    clip.type = hibiki::Clip::Type::AUDIO;
+    clip.audio = hibiki::PlanarAudio(1, 4);
+    for (int i = 0; i < 4; ++i) clip.audio.channel(0)[i] = 0.25f * i;
+    float l[4], r[4];
+    hibiki::RenderAudioClip(clip, 0, l, r, 4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(l[i], 0.25f * i);
+        EXPECT_EQ(r[i], 0.25f * i);
+    }
+}
@@ -10,6 +10,8 @@ struct CoreAudioPlayback::Impl {
     int sampleRate;
     int channels;
     bool ready = false;
+    std::atomic<bool> started{false};
+    std::atomic<uint32_t> underflows{0};
 
     // A simple ring buffer to bridge push (write) and pull (callback)
     std::vector<float> ringBuffer;
@@ -67,6 +69,9 @@ static OSStatus PlaybackCallback(void* inRefCon,
 
     if (available < needed) {
         // Underflow
+        if (impl->started.load(std::memory_order_relaxed)) {
+            impl->underflows.fetch_add(1, std::memory_order_relaxed);
+        }
         std::fill(outL, outL + inNumberFrames, 0.0f);
         std::fill(outR, outR + inNumberFrames, 0.0f);
         return noErr;
@@ -82,7 +87,13 @@ static OSStatus PlaybackCallback(void* inRefCon,
     return noErr;
 }
 
-CoreAudioPlayback::CoreAudioPlayback(int rate, int ch) : impl(std::make_unique<Impl>(rate, ch)) {
+namespace {
+hibiki::AudioDeviceRegistration registration("coreaudio", 100, [](const hibiki::AudioDeviceOptions& options) {
+    return std::unique_ptr<hibiki::AudioDevice>(new CoreAudioPlayback(options.sample_rate, options.channels, options.block_size));
+});
+} // namespace
+
+CoreAudioPlayback::CoreAudioPlayback(int rate, int ch, int block) : impl(std::make_unique<Impl>(rate, ch)), block_size(block) {
     AudioComponentDescription desc;
     desc.componentType = kAudioUnitType_Output;
     desc.componentSubType = kAudioUnitSubType_DefaultOutput;
@@ -161,4 +172,36 @@ void CoreAudioPlayback::write(const std::vector<float>& interleaved_data, int nu
     }
 
     impl->writeData(interleaved_data.data(), count);
+    impl->started.store(true, std::memory_order_relaxed);
+}
+
+void CoreAudioPlayback::pause() {
+    if (!impl->ready) return;
+    // Let the ring buffer play out before stopping the unit. The callback
+    // only consumes whole periods, so give up once it stops making progress;
+    // whatever is left is silence from the idle engine.
+    size_t available = impl->getAvailableRead();
+    while (available > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        size_t now = impl->getAvailableRead();
+        if (now >= available) break;
+        available = now;
+    }
+    AudioOutputUnitStop(impl->audioUnit);
+    impl->started.store(false, std::memory_order_relaxed);
+}
+
+void CoreAudioPlayback::resume() {
+    if (!impl->ready) return;
+    if (AudioOutputUnitStart(impl->audioUnit) != noErr) {
+        std::cerr << "CoreAudio: Failed to restart AudioUnit" << std::endl;
+    }
+}
+
+int CoreAudioPlayback::get_sample_rate() const {
+    return impl->sampleRate;
+}
+
+uint32_t CoreAudioPlayback::xrun_count() const {
+    return impl->underflows.load(std::memory_order_relaxed);
 }
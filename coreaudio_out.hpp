@@ -1,17 +1,30 @@
 #pragma once
 
+#include "audio_device.hpp"
+
 #include <vector>
 #include <atomic>
+#include <cstdint>
 #include <memory>
 
-class CoreAudioPlayback {
+class CoreAudioPlayback : public hibiki::BlockingAudioDevice {
 public:
     struct Impl;
-    CoreAudioPlayback(int rate = 44100, int ch = 2);
+    CoreAudioPlayback(int rate = 44100, int ch = 2, int block = 512);
     ~CoreAudioPlayback();
 
-    bool is_ready() const;
-    void write(const std::vector<float>& interleaved_data, int num_frames);
+    bool is_ready() const override;
+    void write(const std::vector<float>& interleaved_data, int num_frames) override;
+    int get_sample_rate() const override;
+    // The output unit is always stereo.
+    int get_channels() const override { return 2; }
+    int get_block_size() const override { return block_size; }
+    // Callbacks that found the ring buffer short since playback started.
+    uint32_t xrun_count() const override;
+    bool can_pause() const override { return true; }
+    void pause() override;
+    void resume() override;
 
     std::unique_ptr<Impl> impl;
+    int block_size;
 };
@@ -0,0 +1,71 @@
+#include "cpu_governor.hpp"
+#include <sstream>
+
+namespace hibiki {
+
+const char* GovernorActionName(GovernorAction::Kind kind) {
+    switch (kind) {
+    case GovernorAction::Kind::kBypassPlugin: return "bypass";
+    case GovernorAction::Kind::kUseFrozen: return "frozen";
+    case GovernorAction::Kind::kCutTrack: return "cut";
+    }
+    return "";
+}
+
+std::vector<GovernorAction> CpuGovernor::Update(const EngineStatsReport& report, const std::set<int>& essential) {
+    std::vector<GovernorAction> actions;
+    if (settings_.policy == GovernorPolicy::kOff || report.deadline_us <= 0.0) return actions;
+    const double budget_us = report.deadline_us * settings_.track_budget;
+
+    for (const auto& track : report.tracks) {
+        if (track.time.count == 0 || track.time.max_us <= budget_us || cut_.count(track.track_index)) {
+            overloaded_.erase(track.track_index);
+            continue;
+        }
+        if (++overloaded_[track.track_index] < settings_.overload_intervals) continue;
+        overloaded_.erase(track.track_index);
+
+        // Bypassed plugins do not run, so they never come out heaviest.
+        const EngineStatsReport::Plugin* heaviest = nullptr;
+        for (const auto& plugin : track.plugins) {
+            if (plugin.time.max_us > 0.0 && (!heaviest || plugin.time.max_us > heaviest->time.max_us)) heaviest = &plugin;
+        }
+        std::ostringstream reason;
+        reason << "track " << track.track_index << " took up to " << (int)track.time.max_us << " us of a "
+               << (int)report.deadline_us << " us block for " << settings_.overload_intervals << " intervals";
+        if (heaviest) reason << "; heaviest plugin " << heaviest->name << " " << (int)heaviest->time.max_us << " us";
+        int plugin_index = heaviest ? heaviest->plugin_index : -1;
+
+        switch (settings_.policy) {
+        case GovernorPolicy::kBypass:
+            if (heaviest) actions.push_back({GovernorAction::Kind::kBypassPlugin, track.track_index, plugin_index, reason.str()});
+            break;
+        case GovernorPolicy::kFreeze:
+            actions.push_back({GovernorAction::Kind::kUseFrozen, track.track_index, plugin_index, reason.str()});
+            break;
+        case GovernorPolicy::kCutTracks: {
+            int victim = essential.count(track.track_index) ? -1 : track.track_index;
+            if (victim == -1) {
+                double victim_us = 0.0;
+                for (const auto& other : report.tracks) {
+                    if (essential.count(other.track_index) || cut_.count(other.track_index)) continue;
+                    if (other.time.max_us > victim_us) {
+                        victim = other.track_index;
+                        victim_us = other.time.max_us;
+                    }
+                }
+                if (victim == -1) break;
+                reason << "; track is essential, cutting track " << victim;
+            }
+            cut_.insert(victim);
+            actions.push_back({GovernorAction::Kind::kCutTrack, victim, -1, reason.str()});
+            break;
+        }
+        case GovernorPolicy::kOff:
+            break;
+        }
+    }
+    return actions;
+}
+
+} // namespace hibiki
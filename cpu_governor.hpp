@@ -0,0 +1,60 @@
+#pragma once
+
+#include "engine_stats.hpp"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace hibiki {
+
+// What the governor does to a plugin chain that keeps overrunning its budget.
+enum class GovernorPolicy {
+    kOff = 0,
+    // Bypass the heaviest plugin of the chain.
+    kBypass = 1,
+    // Play the track's frozen render instead of its chain.
+    kFreeze = 2,
+    // Silence the track, or if it is essential, the heaviest track that is not.
+    kCutTracks = 3,
+};
+
+struct GovernorSettings {
+    GovernorPolicy policy = GovernorPolicy::kOff;
+    // Share of the block deadline one track's chain may take in its worst block.
+    double track_budget = 0.5;
+    // Consecutive stats intervals over budget before the governor steps in.
+    int overload_intervals = 3;
+};
+
+struct GovernorAction {
+    enum class Kind { kBypassPlugin, kUseFrozen, kCutTrack };
+    Kind kind;
+    int track_index;
+    // Heaviest plugin of the overloaded chain, or -1.
+    int plugin_index;
+    std::string reason;
+};
+
+const char* GovernorActionName(GovernorAction::Kind kind);
+
+// Watches per-track and per-plugin timings in the engine's stats reports and
+// decides which chain to degrade when one keeps exceeding its share of the
+// block. Actions are sticky: a plugin that spiked once is likely to spike
+// again, so nothing is restored until the settings are applied anew.
+class CpuGovernor {
+public:
+    explicit CpuGovernor(const GovernorSettings& settings) : settings_(settings) {}
+
+    // essential holds the tracks kCutTracks must never silence.
+    std::vector<GovernorAction> Update(const EngineStatsReport& report, const std::set<int>& essential);
+
+    const GovernorSettings& settings() const { return settings_; }
+
+private:
+    GovernorSettings settings_;
+    std::map<int, int> overloaded_; // track index -> consecutive intervals
+    std::set<int> cut_;
+};
+
+} // namespace hibiki
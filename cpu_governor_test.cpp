@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "cpu_governor.hpp"
+
+namespace {
+
+hibiki::EngineStatsReport::Track Track(int index, double max_us, std::vector<double> plugin_us = {}) {
+    hibiki::EngineStatsReport::Track track{index, {100, max_us / 2, max_us}, {}};
+    for (size_t i = 0; i < plugin_us.size(); ++i) {
+        track.plugins.push_back({(int)i, "plugin " + std::to_string(i), {100, plugin_us[i] / 2, plugin_us[i]}});
+    }
+    return track;
+}
+
+hibiki::EngineStatsReport Report(std::vector<hibiki::EngineStatsReport::Track> tracks) {
+    hibiki::EngineStatsReport report;
+    report.deadline_us = 10000.0;
+    report.tracks = std::move(tracks);
+    return report;
+}
+
+hibiki::GovernorSettings Settings(hibiki::GovernorPolicy policy) {
+    hibiki::GovernorSettings settings;
+    settings.policy = policy;
+    settings.track_budget = 0.5;
+    settings.overload_intervals = 2;
+    return settings;
+}
+
+TEST(CpuGovernorTest, BypassesHeaviestPluginAfterSustainedOverload) {
+    hibiki::CpuGovernor governor(Settings(hibiki::GovernorPolicy::kBypass));
+    auto heavy = Report({Track(0, 7000, {1000, 5500, 500}), Track(1, 1000)});
+    EXPECT_TRUE(governor.Update(heavy, {}).empty());
+    EXPECT_TRUE(governor.Update(Report({Track(0, 2000, {500, 1000, 500})}), {}).empty()); // Streak broken.
+    EXPECT_TRUE(governor.Update(heavy, {}).empty());
+    auto actions = governor.Update(heavy, {});
+    ASSERT_EQ(actions.size(), 1u);
+    EXPECT_EQ(actions[0].kind, hibiki::GovernorAction::Kind::kBypassPlugin);
+    EXPECT_EQ(actions[0].track_index, 0);
+    EXPECT_EQ(actions[0].plugin_index, 1);
+    EXPECT_NE(actions[0].reason.find("plugin 1"), std::string::npos);
+}
+
+TEST(CpuGovernorTest, FreezePolicyNamesTheChain) {
+    hibiki::CpuGovernor governor(Settings(hibiki::GovernorPolicy::kFreeze));
+    auto heavy = Report({Track(3, 9000, {9000})});
+    governor.Update(heavy, {});
+    auto actions = governor.Update(heavy, {});
+    ASSERT_EQ(actions.size(), 1u);
+    EXPECT_EQ(actions[0].kind, hibiki::GovernorAction::Kind::kUseFrozen);
+    EXPECT_EQ(actions[0].track_index, 3);
+}
+
+TEST(CpuGovernorTest, CutsHeaviestNonEssentialTrack) {
+    hibiki::CpuGovernor governor(Settings(hibiki::GovernorPolicy::kCutTracks));
+    auto heavy = Report({Track(0, 8000), Track(1, 3000), Track(2, 4000)});
+    governor.Update(heavy, {0});
+    auto actions = governor.Update(heavy, {0});
+    ASSERT_EQ(actions.size(), 1u);
+    EXPECT_EQ(actions[0].kind, hibiki::GovernorAction::Kind::kCutTrack);
+    EXPECT_EQ(actions[0].track_index, 2);
+
+    // The next time round the remaining candidate goes, then nothing is left.
+    governor.Update(heavy, {0});
+    actions = governor.Update(heavy, {0});
+    ASSERT_EQ(actions.size(), 1u);
+    EXPECT_EQ(actions[0].track_index, 1);
+    governor.Update(heavy, {0});
+    EXPECT_TRUE(governor.Update(heavy, {0}).empty());
+}
+
+TEST(CpuGovernorTest, OffDoesNothing) {
+    hibiki::CpuGovernor governor(Settings(hibiki::GovernorPolicy::kOff));
+    auto heavy = Report({Track(0, 9000, {9000})});
+    for (int i = 0; i < 5; ++i) EXPECT_TRUE(governor.Update(heavy, {}).empty());
+}
+
+} // namespace
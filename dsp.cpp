@@ -0,0 +1,699 @@
+#include "dsp.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define HIBIKI_DSP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define HIBIKI_TARGET(isa)
+#else
+#define HIBIKI_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace hibiki::dsp {
+
+namespace {
+
+constexpr float kInt16ToFloat = 1.0f / 32768.0f;
+constexpr float kFloatToInt16 = 32767.0f;
+
+// Scalar reference implementations. Vector kernels use these for their tails,
+// and the tests compare every vector kernel against them.
+
+void AddGainRampScalar(float* dst, const float* src, int n, float g0, float g1) {
+    if (g0 == g1) {
+        for (int i = 0; i < n; ++i) dst[i] += src[i] * g0;
+        return;
+    }
+    float step = (g1 - g0) / n;
+    for (int i = 0; i < n; ++i) dst[i] += src[i] * (g0 + step * (float)i);
+}
+
+void ApplyGainRampScalar(float* buf, int n, float g0, float g1) {
+    if (g0 == g1) {
+        for (int i = 0; i < n; ++i) buf[i] *= g0;
+        return;
+    }
+    float step = (g1 - g0) / n;
+    for (int i = 0; i < n; ++i) buf[i] *= g0 + step * (float)i;
+}
+
+float AbsPeakScalar(const float* src, int n) {
+    float peak = 0.0f;
+    for (int i = 0; i < n; ++i) peak = std::max(peak, std::abs(src[i]));
+    return peak;
+}
+
+float SumSquaresScalar(const float* src, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; ++i) sum += src[i] * src[i];
+    return sum;
+}
+
+float Upsample4AbsPeakScalar(const float* src, int n, const float* taps, int num_taps) {
+    float peak = 0.0f;
+    for (int i = 0; i < n; ++i) {
+        float acc[4] = {};
+        for (int k = 0; k < num_taps; ++k) {
+            for (int p = 0; p < 4; ++p) acc[p] += taps[k * 4 + p] * src[i - k];
+        }
+        for (float y : acc) peak = std::max(peak, std::abs(y));
+    }
+    return peak;
+}
+
+void FftStageScalar(float* re, float* im, const float* wr, const float* wi, int n, int half) {
+    for (int g = 0; g < n; g += 2 * half) {
+        for (int j = 0; j < half; ++j) {
+            const int a = g + j, b = a + half;
+            const float tr = wr[j] * re[b] - wi[j] * im[b];
+            const float ti = wr[j] * im[b] + wi[j] * re[b];
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+        }
+    }
+}
+
+void Interleave2Scalar(float* dst, const float* l, const float* r, int n) {
+    for (int i = 0; i < n; ++i) {
+        dst[i * 2] = l[i];
+        dst[i * 2 + 1] = r[i];
+    }
+}
+
+void Deinterleave2Scalar(float* l, float* r, const float* src, int n) {
+    for (int i = 0; i < n; ++i) {
+        l[i] = src[i * 2];
+        r[i] = src[i * 2 + 1];
+    }
+}
+
+void Int16ToFloatScalar(float* dst, const int16_t* src, int n) {
+    for (int i = 0; i < n; ++i) dst[i] = src[i] * kInt16ToFloat;
+}
+
+void FloatToInt16Scalar(int16_t* dst, const float* src, int n) {
+    for (int i = 0; i < n; ++i) {
+        float v = std::clamp(src[i] * kFloatToInt16, -32768.0f, 32767.0f);
+        dst[i] = (int16_t)std::lrintf(v);
+    }
+}
+
+constexpr Kernels kScalarKernels = {
+    Isa::kScalar, "scalar",
+    AddGainRampScalar, ApplyGainRampScalar, AbsPeakScalar, SumSquaresScalar, Upsample4AbsPeakScalar, FftStageScalar,
+    Interleave2Scalar, Deinterleave2Scalar, Int16ToFloatScalar, FloatToInt16Scalar,
+};
+
+#if HIBIKI_DSP_X86
+
+// ---------------------------------------------------------------- SSE2
+
+HIBIKI_TARGET("sse2")
+float HorizontalMax128(__m128 v) {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+HIBIKI_TARGET("sse2")
+float HorizontalSum128(__m128 v) {
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(v);
+}
+
+HIBIKI_TARGET("sse2")
+void AddGainRampSse2(float* dst, const float* src, int n, float g0, float g1) {
+    int i = 0;
+    if (g0 == g1) {
+        __m128 g = _mm_set1_ps(g0);
+        for (; i + 4 <= n; i += 4) {
+            __m128 d = _mm_loadu_ps(dst + i);
+            _mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+        }
+        for (; i < n; ++i) dst[i] += src[i] * g0;
+        return;
+    }
+    float step = (g1 - g0) / n;
+    const __m128 iota = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 vstep = _mm_set1_ps(step);
+    const __m128 vg0 = _mm_set1_ps(g0);
+    for (; i + 4 <= n; i += 4) {
+        __m128 g = _mm_add_ps(vg0, _mm_mul_ps(vstep, _mm_add_ps(_mm_set1_ps((float)i), iota)));
+        __m128 d = _mm_loadu_ps(dst + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    }
+    for (; i < n; ++i) dst[i] += src[i] * (g0 + step * (float)i);
+}
+
+HIBIKI_TARGET("sse2")
+void ApplyGainRampSse2(float* buf, int n, float g0, float g1) {
+    int i = 0;
+    float step = (g1 - g0) / n;
+    const __m128 iota = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 vstep = _mm_set1_ps(step);
+    const __m128 vg0 = _mm_set1_ps(g0);
+    for (; i + 4 <= n; i += 4) {
+        __m128 g = g0 == g1 ? vg0 : _mm_add_ps(vg0, _mm_mul_ps(vstep, _mm_add_ps(_mm_set1_ps((float)i), iota)));
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+    }
+    for (; i < n; ++i) buf[i] *= g0 == g1 ? g0 : g0 + step * (float)i;
+}
+
+HIBIKI_TARGET("sse2")
+float AbsPeakSse2(const float* src, int n) {
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 m = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) m = _mm_max_ps(m, _mm_and_ps(_mm_loadu_ps(src + i), mask));
+    return std::max(HorizontalMax128(m), AbsPeakScalar(src + i, n - i));
+}
+
+HIBIKI_TARGET("sse2")
+float SumSquaresSse2(const float* src, int n) {
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+    }
+    return HorizontalSum128(acc) + SumSquaresScalar(src + i, n - i);
+}
+
+// One output sample's four phases per vector.
+HIBIKI_TARGET("sse2")
+float Upsample4AbsPeakSse2(const float* src, int n, const float* taps, int num_taps) {
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 m = _mm_setzero_ps();
+    for (int i = 0; i < n; ++i) {
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < num_taps; ++k) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(taps + k * 4), _mm_set1_ps(src[i - k])));
+        m = _mm_max_ps(m, _mm_and_ps(acc, mask));
+    }
+    return HorizontalMax128(m);
+}
+
+// Stages narrower than a vector stay scalar; they are the first two or so.
+HIBIKI_TARGET("sse2")
+void FftStageSse2(float* re, float* im, const float* wr, const float* wi, int n, int half) {
+    if (half < 4) return FftStageScalar(re, im, wr, wi, n, half);
+    for (int g = 0; g < n; g += 2 * half) {
+        for (int j = 0; j < half; j += 4) {
+            float* ra = re + g + j;
+            float* ia = im + g + j;
+            __m128 vwr = _mm_loadu_ps(wr + j), vwi = _mm_loadu_ps(wi + j);
+            __m128 rb = _mm_loadu_ps(ra + half), ib = _mm_loadu_ps(ia + half);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(vwr, rb), _mm_mul_ps(vwi, ib));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(vwr, ib), _mm_mul_ps(vwi, rb));
+            __m128 r = _mm_loadu_ps(ra), i = _mm_loadu_ps(ia);
+            _mm_storeu_ps(ra + half, _mm_sub_ps(r, tr));
+            _mm_storeu_ps(ia + half, _mm_sub_ps(i, ti));
+            _mm_storeu_ps(ra, _mm_add_ps(r, tr));
+            _mm_storeu_ps(ia, _mm_add_ps(i, ti));
+        }
+    }
+}
+
+HIBIKI_TARGET("sse2")
+void Interleave2Sse2(float* dst, const float* l, const float* r, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 vl = _mm_loadu_ps(l + i);
+        __m128 vr = _mm_loadu_ps(r + i);
+        _mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(vl, vr));
+        _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(vl, vr));
+    }
+    Interleave2Scalar(dst + i * 2, l + i, r + i, n - i);
+}
+
+HIBIKI_TARGET("sse2")
+void Deinterleave2Sse2(float* l, float* r, const float* src, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(src + i * 2);
+        __m128 b = _mm_loadu_ps(src + i * 2 + 4);
+        _mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    Deinterleave2Scalar(l + i, r + i, src + i * 2, n - i);
+}
+
+HIBIKI_TARGET("sse2")
+void Int16ToFloatSse2(float* dst, const int16_t* src, int n) {
+    const __m128 scale = _mm_set1_ps(kInt16ToFloat);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    Int16ToFloatScalar(dst + i, src + i, n - i);
+}
+
+HIBIKI_TARGET("sse2")
+void FloatToInt16Sse2(int16_t* dst, const float* src, int n) {
+    const __m128 scale = _mm_set1_ps(kFloatToInt16);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    FloatToInt16Scalar(dst + i, src + i, n - i);
+}
+
+constexpr Kernels kSse2Kernels = {
+    Isa::kSse2, "sse2",
+    AddGainRampSse2, ApplyGainRampSse2, AbsPeakSse2, SumSquaresSse2, Upsample4AbsPeakSse2, FftStageSse2,
+    Interleave2Sse2, Deinterleave2Sse2, Int16ToFloatSse2, FloatToInt16Sse2,
+};
+
+// ---------------------------------------------------------------- AVX2
+
+HIBIKI_TARGET("avx2")
+void AddGainRampAvx2(float* dst, const float* src, int n, float g0, float g1) {
+    int i = 0;
+    float step = g0 == g1 ? 0.0f : (g1 - g0) / n;
+    const __m256 iota = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 vstep = _mm256_set1_ps(step);
+    const __m256 vg0 = _mm256_set1_ps(g0);
+    if (g0 == g1) {
+        for (; i + 8 <= n; i += 8) {
+            __m256 d = _mm256_loadu_ps(dst + i);
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(src + i), vg0)));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            __m256 g = _mm256_add_ps(vg0, _mm256_mul_ps(vstep, _mm256_add_ps(_mm256_set1_ps((float)i), iota)));
+            __m256 d = _mm256_loadu_ps(dst + i);
+            _mm256_storeu_ps(dst + i, _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+        }
+    }
+    for (; i < n; ++i) dst[i] += src[i] * (g0 + step * (float)i);
+}
+
+HIBIKI_TARGET("avx2")
+void ApplyGainRampAvx2(float* buf, int n, float g0, float g1) {
+    int i = 0;
+    float step = g0 == g1 ? 0.0f : (g1 - g0) / n;
+    const __m256 iota = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 vstep = _mm256_set1_ps(step);
+    const __m256 vg0 = _mm256_set1_ps(g0);
+    for (; i + 8 <= n; i += 8) {
+        __m256 g = _mm256_add_ps(vg0, _mm256_mul_ps(vstep, _mm256_add_ps(_mm256_set1_ps((float)i), iota)));
+        _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+    }
+    for (; i < n; ++i) buf[i] *= g0 + step * (float)i;
+}
+
+HIBIKI_TARGET("avx2")
+float AbsPeakAvx2(const float* src, int n) {
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 m = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) m = _mm256_max_ps(m, _mm256_and_ps(_mm256_loadu_ps(src + i), mask));
+    __m128 m4 = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    return std::max(HorizontalMax128(m4), AbsPeakScalar(src + i, n - i));
+}
+
+HIBIKI_TARGET("avx2")
+float SumSquaresAvx2(const float* src, int n) {
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(src + i);
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(v, v));
+    }
+    __m128 s4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    return HorizontalSum128(s4) + SumSquaresScalar(src + i, n - i);
+}
+
+// Two output samples' phases per vector.
+HIBIKI_TARGET("avx2")
+float Upsample4AbsPeakAvx2(const float* src, int n, const float* taps, int num_taps) {
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256i pairs = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    __m256 m = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int k = 0; k < num_taps; ++k) {
+            __m128 x = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(src + i - k)));
+            __m256 xx = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(x), pairs);
+            __m256 t = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(taps + k * 4));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(t, xx));
+        }
+        m = _mm256_max_ps(m, _mm256_and_ps(acc, mask));
+    }
+    __m128 m4 = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    return std::max(HorizontalMax128(m4), Upsample4AbsPeakScalar(src + i, n - i, taps, num_taps));
+}
+
+HIBIKI_TARGET("avx2")
+void FftStageAvx2(float* re, float* im, const float* wr, const float* wi, int n, int half) {
+    if (half < 8) return FftStageSse2(re, im, wr, wi, n, half);
+    for (int g = 0; g < n; g += 2 * half) {
+        for (int j = 0; j < half; j += 8) {
+            float* ra = re + g + j;
+            float* ia = im + g + j;
+            __m256 vwr = _mm256_loadu_ps(wr + j), vwi = _mm256_loadu_ps(wi + j);
+            __m256 rb = _mm256_loadu_ps(ra + half), ib = _mm256_loadu_ps(ia + half);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(vwr, rb), _mm256_mul_ps(vwi, ib));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(vwr, ib), _mm256_mul_ps(vwi, rb));
+            __m256 r = _mm256_loadu_ps(ra), i = _mm256_loadu_ps(ia);
+            _mm256_storeu_ps(ra + half, _mm256_sub_ps(r, tr));
+            _mm256_storeu_ps(ia + half, _mm256_sub_ps(i, ti));
+            _mm256_storeu_ps(ra, _mm256_add_ps(r, tr));
+            _mm256_storeu_ps(ia, _mm256_add_ps(i, ti));
+        }
+    }
+}
+
+HIBIKI_TARGET("avx2")
+void Interleave2Avx2(float* dst, const float* l, const float* r, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 vl = _mm256_loadu_ps(l + i);
+        __m256 vr = _mm256_loadu_ps(r + i);
+        __m256 lo = _mm256_unpacklo_ps(vl, vr);
+        __m256 hi = _mm256_unpackhi_ps(vl, vr);
+        _mm256_storeu_ps(dst + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dst + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    Interleave2Scalar(dst + i * 2, l + i, r + i, n - i);
+}
+
+HIBIKI_TARGET("avx2")
+void Deinterleave2Avx2(float* l, float* r, const float* src, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_loadu_ps(src + i * 2);
+        __m256 b = _mm256_loadu_ps(src + i * 2 + 8);
+        __m256 el = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 er = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        el = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(el), _MM_SHUFFLE(3, 1, 2, 0)));
+        er = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(er), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(l + i, el);
+        _mm256_storeu_ps(r + i, er);
+    }
+    Deinterleave2Scalar(l + i, r + i, src + i * 2, n - i);
+}
+
+HIBIKI_TARGET("avx2")
+void Int16ToFloatAvx2(float* dst, const int16_t* src, int n) {
+    const __m256 scale = _mm256_set1_ps(kInt16ToFloat);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+    }
+    Int16ToFloatScalar(dst + i, src + i, n - i);
+}
+
+HIBIKI_TARGET("avx2")
+void FloatToInt16Avx2(int16_t* dst, const float* src, int n) {
+    const __m256 scale = _mm256_set1_ps(kFloatToInt16);
+    const __m256 lo = _mm256_set1_ps(-32768.0f);
+    const __m256 hi = _mm256_set1_ps(32767.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lo), hi);
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    FloatToInt16Scalar(dst + i, src + i, n - i);
+}
+
+constexpr Kernels kAvx2Kernels = {
+    Isa::kAvx2, "avx2",
+    AddGainRampAvx2, ApplyGainRampAvx2, AbsPeakAvx2, SumSquaresAvx2, Upsample4AbsPeakAvx2, FftStageAvx2,
+    Interleave2Avx2, Deinterleave2Avx2, Int16ToFloatAvx2, FloatToInt16Avx2,
+};
+
+// ---------------------------------------------------------------- AVX-512
+
+HIBIKI_TARGET("avx512f")
+__m512 Iota512() {
+    return _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                          8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+}
+
+HIBIKI_TARGET("avx512f")
+void AddGainRampAvx512(float* dst, const float* src, int n, float g0, float g1) {
+    int i = 0;
+    float step = g0 == g1 ? 0.0f : (g1 - g0) / n;
+    const __m512 iota = Iota512();
+    const __m512 vstep = _mm512_set1_ps(step);
+    const __m512 vg0 = _mm512_set1_ps(g0);
+    if (g0 == g1) {
+        for (; i + 16 <= n; i += 16) {
+            __m512 d = _mm512_loadu_ps(dst + i);
+            _mm512_storeu_ps(dst + i, _mm512_add_ps(d, _mm512_mul_ps(_mm512_loadu_ps(src + i), vg0)));
+        }
+    } else {
+        for (; i + 16 <= n; i += 16) {
+            __m512 g = _mm512_add_ps(vg0, _mm512_mul_ps(vstep, _mm512_add_ps(_mm512_set1_ps((float)i), iota)));
+            __m512 d = _mm512_loadu_ps(dst + i);
+            _mm512_storeu_ps(dst + i, _mm512_add_ps(d, _mm512_mul_ps(_mm512_loadu_ps(src + i), g)));
+        }
+    }
+    for (; i < n; ++i) dst[i] += src[i] * (g0 + step * (float)i);
+}
+
+HIBIKI_TARGET("avx512f")
+void ApplyGainRampAvx512(float* buf, int n, float g0, float g1) {
+    int i = 0;
+    float step = g0 == g1 ? 0.0f : (g1 - g0) / n;
+    const __m512 iota = Iota512();
+    const __m512 vstep = _mm512_set1_ps(step);
+    const __m512 vg0 = _mm512_set1_ps(g0);
+    for (; i + 16 <= n; i += 16) {
+        __m512 g = _mm512_add_ps(vg0, _mm512_mul_ps(vstep, _mm512_add_ps(_mm512_set1_ps((float)i), iota)));
+        _mm512_storeu_ps(buf + i, _mm512_mul_ps(_mm512_loadu_ps(buf + i), g));
+    }
+    for (; i < n; ++i) buf[i] *= g0 + step * (float)i;
+}
+
+HIBIKI_TARGET("avx512f")
+float AbsPeakAvx512(const float* src, int n) {
+    __m512 m = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) m = _mm512_max_ps(m, _mm512_abs_ps(_mm512_loadu_ps(src + i)));
+    return std::max(_mm512_reduce_max_ps(m), AbsPeakScalar(src + i, n - i));
+}
+
+HIBIKI_TARGET("avx512f")
+float SumSquaresAvx512(const float* src, int n) {
+    __m512 acc = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(src + i);
+        acc = _mm512_add_ps(acc, _mm512_mul_ps(v, v));
+    }
+    return _mm512_reduce_add_ps(acc) + SumSquaresScalar(src + i, n - i);
+}
+
+// Four output samples' phases per vector.
+HIBIKI_TARGET("avx512f")
+float Upsample4AbsPeakAvx512(const float* src, int n, const float* taps, int num_taps) {
+    const __m512i quads = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+    __m512 m = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m512 acc = _mm512_setzero_ps();
+        for (int k = 0; k < num_taps; ++k) {
+            __m512 x = _mm512_permutexvar_ps(quads, _mm512_castps128_ps512(_mm_loadu_ps(src + i - k)));
+            __m512 t = _mm512_broadcast_f32x4(_mm_loadu_ps(taps + k * 4));
+            acc = _mm512_fmadd_ps(t, x, acc);
+        }
+        m = _mm512_max_ps(m, _mm512_abs_ps(acc));
+    }
+    return std::max(_mm512_reduce_max_ps(m), Upsample4AbsPeakScalar(src + i, n - i, taps, num_taps));
+}
+
+HIBIKI_TARGET("avx512f")
+void FftStageAvx512(float* re, float* im, const float* wr, const float* wi, int n, int half) {
+    if (half < 16) return FftStageAvx2(re, im, wr, wi, n, half);
+    for (int g = 0; g < n; g += 2 * half) {
+        for (int j = 0; j < half; j += 16) {
+            float* ra = re + g + j;
+            float* ia = im + g + j;
+            __m512 vwr = _mm512_loadu_ps(wr + j), vwi = _mm512_loadu_ps(wi + j);
+            __m512 rb = _mm512_loadu_ps(ra + half), ib = _mm512_loadu_ps(ia + half);
+            __m512 tr = _mm512_sub_ps(_mm512_mul_ps(vwr, rb), _mm512_mul_ps(vwi, ib));
+            __m512 ti = _mm512_add_ps(_mm512_mul_ps(vwr, ib), _mm512_mul_ps(vwi, rb));
+            __m512 r = _mm512_loadu_ps(ra), i = _mm512_loadu_ps(ia);
+            _mm512_storeu_ps(ra + half, _mm512_sub_ps(r, tr));
+            _mm512_storeu_ps(ia + half, _mm512_sub_ps(i, ti));
+            _mm512_storeu_ps(ra, _mm512_add_ps(r, tr));
+            _mm512_storeu_ps(ia, _mm512_add_ps(i, ti));
+        }
+    }
+}
+
+HIBIKI_TARGET("avx512f")
+void Interleave2Avx512(float* dst, const float* l, const float* r, int n) {
+    const __m512i idx_lo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i idx_hi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 vl = _mm512_loadu_ps(l + i);
+        __m512 vr = _mm512_loadu_ps(r + i);
+        _mm512_storeu_ps(dst + i * 2, _mm512_permutex2var_ps(vl, idx_lo, vr));
+        _mm512_storeu_ps(dst + i * 2 + 16, _mm512_permutex2var_ps(vl, idx_hi, vr));
+    }
+    Interleave2Scalar(dst + i * 2, l + i, r + i, n - i);
+}
+
+HIBIKI_TARGET("avx512f")
+void Deinterleave2Avx512(float* l, float* r, const float* src, int n) {
+    const __m512i idx_even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i idx_odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 a = _mm512_loadu_ps(src + i * 2);
+        __m512 b = _mm512_loadu_ps(src + i * 2 + 16);
+        _mm512_storeu_ps(l + i, _mm512_permutex2var_ps(a, idx_even, b));
+        _mm512_storeu_ps(r + i, _mm512_permutex2var_ps(a, idx_odd, b));
+    }
+    Deinterleave2Scalar(l + i, r + i, src + i * 2, n - i);
+}
+
+HIBIKI_TARGET("avx512f")
+void Int16ToFloatAvx512(float* dst, const int16_t* src, int n) {
+    const __m512 scale = _mm512_set1_ps(kInt16ToFloat);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+        _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(x), scale));
+    }
+    Int16ToFloatScalar(dst + i, src + i, n - i);
+}
+
+HIBIKI_TARGET("avx512f")
+void FloatToInt16Avx512(int16_t* dst, const float* src, int n) {
+    const __m512 scale = _mm512_set1_ps(kFloatToInt16);
+    const __m512 lo = _mm512_set1_ps(-32768.0f);
+    const __m512 hi = _mm512_set1_ps(32767.0f);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_min_ps(_mm512_max_ps(_mm512_mul_ps(_mm512_loadu_ps(src + i), scale), lo), hi);
+        __m256i packed = _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(v));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    FloatToInt16Scalar(dst + i, src + i, n - i);
+}
+
+constexpr Kernels kAvx512Kernels = {
+    Isa::kAvx512, "avx512",
+    AddGainRampAvx512, ApplyGainRampAvx512, AbsPeakAvx512, SumSquaresAvx512, Upsample4AbsPeakAvx512, FftStageAvx512,
+    Interleave2Avx512, Deinterleave2Avx512, Int16ToFloatAvx512, FloatToInt16Avx512,
+};
+
+bool CpuSupports(Isa isa) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    int max_leaf = regs[0];
+    __cpuid(regs, 1);
+    bool sse2 = (regs[3] & (1 << 26)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymm_enabled = (xcr0 & 0x6) == 0x6;
+    bool zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+    bool avx2 = false, avx512f = false;
+    if (max_leaf >= 7) {
+        __cpuidex(regs, 7, 0);
+        avx2 = (regs[1] & (1 << 5)) != 0;
+        avx512f = (regs[1] & (1 << 16)) != 0;
+    }
+    switch (isa) {
+        case Isa::kScalar: return true;
+        case Isa::kSse2: return sse2;
+        case Isa::kAvx2: return avx2 && ymm_enabled;
+        case Isa::kAvx512: return avx512f && zmm_enabled;
+    }
+    return false;
+#else
+    // __builtin_cpu_supports also checks that the OS saves the wider registers.
+    __builtin_cpu_init();
+    switch (isa) {
+        case Isa::kScalar: return true;
+        case Isa::kSse2: return __builtin_cpu_supports("sse2");
+        case Isa::kAvx2: return __builtin_cpu_supports("avx2");
+        case Isa::kAvx512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#endif
+}
+
+#else // HIBIKI_DSP_X86
+
+bool CpuSupports(Isa isa) {
+    return isa == Isa::kScalar;
+}
+
+#endif // HIBIKI_DSP_X86
+
+const Kernels* Select() {
+    // HIBIKI_DSP_ISA=scalar|sse2|avx2|avx512 caps the instruction set, e.g. for A/B benchmarks.
+    Isa limit = Isa::kAvx512;
+    if (const char* env = std::getenv("HIBIKI_DSP_ISA")) {
+        if (std::strcmp(env, "scalar") == 0) limit = Isa::kScalar;
+        else if (std::strcmp(env, "sse2") == 0) limit = Isa::kSse2;
+        else if (std::strcmp(env, "avx2") == 0) limit = Isa::kAvx2;
+    }
+    for (Isa isa : {Isa::kAvx512, Isa::kAvx2, Isa::kSse2}) {
+        if (isa > limit) continue;
+        if (const Kernels* k = ForIsa(isa)) return k;
+    }
+    return &kScalarKernels;
+}
+
+} // namespace
+
+const Kernels* ForIsa(Isa isa) {
+    if (!CpuSupports(isa)) return nullptr;
+    switch (isa) {
+        case Isa::kScalar: return &kScalarKernels;
+#if HIBIKI_DSP_X86
+        case Isa::kSse2: return &kSse2Kernels;
+        case Isa::kAvx2: return &kAvx2Kernels;
+        case Isa::kAvx512: return &kAvx512Kernels;
+#else
+        default: return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+const Kernels& Active() {
+    static const Kernels* active = Select();
+    return *active;
+}
+
+float Rms(const float* src, int n) {
+    if (n <= 0) return 0.0f;
+    return std::sqrt(Active().sum_squares(src, n) / n);
+}
+
+} // namespace hibiki::dsp
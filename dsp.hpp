@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hibiki::dsp {
+
+// Instruction set a kernel table is compiled for.
+enum class Isa { kScalar, kSse2, kAvx2, kAvx512 };
+
+// Table of block-processing kernels. One table exists per instruction set;
+// the best one supported by the running CPU is picked once at startup.
+struct Kernels {
+    Isa isa;
+    const char* name;
+
+    // dst[i] += src[i] * g(i), where g ramps linearly from g0 (i = 0) towards g1 (i = n).
+    void (*add_gain_ramp)(float* dst, const float* src, int n, float g0, float g1);
+    // buf[i] *= g(i) with the same ramp as add_gain_ramp.
+    void (*apply_gain_ramp)(float* buf, int n, float g0, float g1);
+    // max(|src[i]|)
+    float (*abs_peak)(const float* src, int n);
+    // sum(src[i]^2)
+    float (*sum_squares)(const float* src, int n);
+    // max(|y[j]|) over the 4n outputs of a 4x polyphase interpolator,
+    // y[4i + p] = sum(taps[4k + p] * src[i - k]) for k < num_taps; reads
+    // num_taps - 1 samples before src.
+    float (*upsample4_abs_peak)(const float* src, int n, const float* taps, int num_taps);
+    // One radix-2 FFT stage over n complex points in split re/im arrays: for
+    // each group of 2 * half points and j < half, with b = a + half,
+    // (x[a], x[b]) = (x[a] + w[j] * x[b], x[a] - w[j] * x[b]).
+    void (*fft_stage)(float* re, float* im, const float* wr, const float* wi, int n, int half);
+    // dst = {l0, r0, l1, r1, ...}
+    void (*interleave2)(float* dst, const float* l, const float* r, int n);
+    // Inverse of interleave2.
+    void (*deinterleave2)(float* l, float* r, const float* src, int n);
+    // 16-bit PCM to [-1, 1) float.
+    void (*int16_to_float)(float* dst, const int16_t* src, int n);
+    // [-1, 1] float to saturated, rounded 16-bit PCM.
+    void (*float_to_int16)(int16_t* dst, const float* src, int n);
+};
+
+// Kernels chosen via CPUID on first use.
+const Kernels& Active();
+
+// Kernels for a specific instruction set, or nullptr if the build or the CPU lacks it.
+const Kernels* ForIsa(Isa isa);
+
+inline void AddGainRamp(float* dst, const float* src, int n, float g0, float g1) {
+    Active().add_gain_ramp(dst, src, n, g0, g1);
+}
+inline void Add(float* dst, const float* src, int n) {
+    Active().add_gain_ramp(dst, src, n, 1.0f, 1.0f);
+}
+inline void ApplyGainRamp(float* buf, int n, float g0, float g1) {
+    Active().apply_gain_ramp(buf, n, g0, g1);
+}
+inline float AbsPeak(const float* src, int n) {
+    return Active().abs_peak(src, n);
+}
+float Rms(const float* src, int n);
+inline float Upsample4AbsPeak(const float* src, int n, const float* taps, int num_taps) {
+    return Active().upsample4_abs_peak(src, n, taps, num_taps);
+}
+inline void FftStage(float* re, float* im, const float* wr, const float* wi, int n, int half) {
+    Active().fft_stage(re, im, wr, wi, n, half);
+}
+inline void Interleave2(float* dst, const float* l, const float* r, int n) {
+    Active().interleave2(dst, l, r, n);
+}
+inline void Deinterleave2(float* l, float* r, const float* src, int n) {
+    Active().deinterleave2(l, r, src, n);
+}
+inline void Int16ToFloat(float* dst, const int16_t* src, int n) {
+    Active().int16_to_float(dst, src, n);
+}
+inline void FloatToInt16(int16_t* dst, const float* src, int n) {
+    Active().float_to_int16(dst, src, n);
+}
+
+} // namespace hibiki::dsp
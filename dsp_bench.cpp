@@ -0,0 +1,135 @@
+#include <benchmark/benchmark.h>
+#include "dsp.hpp"
+
+#include <vector>
+
+namespace {
+
+using hibiki::dsp::Isa;
+using hibiki::dsp::Kernels;
+
+constexpr int kBlockSize = 512;
+
+const Kernels* KernelsOrSkip(benchmark::State& state) {
+    auto kernels = hibiki::dsp::ForIsa(static_cast<Isa>(state.range(0)));
+    if (!kernels) {
+        state.SkipWithError("instruction set not supported");
+        return nullptr;
+    }
+    state.SetLabel(kernels->name);
+    return kernels;
+}
+
+void BM_AddGainRamp(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<float> dst(kBlockSize, 0.0f), src(kBlockSize, 0.5f);
+    for (auto _ : state) {
+        kernels->add_gain_ramp(dst.data(), src.data(), kBlockSize, 0.2f, 0.8f);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kBlockSize);
+}
+
+void BM_AbsPeak(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<float> src(kBlockSize, -0.25f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(kernels->abs_peak(src.data(), kBlockSize));
+    }
+    state.SetItemsProcessed(state.iterations() * kBlockSize);
+}
+
+void BM_SumSquares(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<float> src(kBlockSize, 0.25f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(kernels->sum_squares(src.data(), kBlockSize));
+    }
+    state.SetItemsProcessed(state.iterations() * kBlockSize);
+}
+
+void BM_Upsample4AbsPeak(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    constexpr int kTaps = 12;
+    std::vector<float> src(kBlockSize + kTaps, 0.25f), taps(kTaps * 4, 0.1f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(kernels->upsample4_abs_peak(src.data() + kTaps - 1, kBlockSize, taps.data(), kTaps));
+    }
+    state.SetItemsProcessed(state.iterations() * kBlockSize);
+}
+
+void BM_FftStage(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<float> re(kBlockSize, 0.5f), im(kBlockSize, 0.25f), wr(kBlockSize / 2, 0.7f), wi(kBlockSize / 2, -0.7f);
+    for (auto _ : state) {
+        kernels->fft_stage(re.data(), im.data(), wr.data(), wi.data(), kBlockSize, kBlockSize / 4);
+        benchmark::DoNotOptimize(re.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kBlockSize);
+}
+
+void BM_Interleave2(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<float> l(kBlockSize, 0.1f), r(kBlockSize, 0.2f), dst(kBlockSize * 2);
+    for (auto _ : state) {
+        kernels->interleave2(dst.data(), l.data(), r.data(), kBlockSize);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kBlockSize);
+}
+
+void BM_Deinterleave2(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<float> src(kBlockSize * 2, 0.1f), l(kBlockSize), r(kBlockSize);
+    for (auto _ : state) {
+        kernels->deinterleave2(l.data(), r.data(), src.data(), kBlockSize);
+        benchmark::DoNotOptimize(l.data());
+        benchmark::DoNotOptimize(r.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kBlockSize);
+}
+
+void BM_Int16ToFloat(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<int16_t> src(kBlockSize * 2, 1234);
+    std::vector<float> dst(kBlockSize * 2);
+    for (auto _ : state) {
+        kernels->int16_to_float(dst.data(), src.data(), (int)src.size());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * src.size());
+}
+
+void BM_FloatToInt16(benchmark::State& state) {
+    auto kernels = KernelsOrSkip(state);
+    if (!kernels) return;
+    std::vector<float> src(kBlockSize * 2, 0.3f);
+    std::vector<int16_t> dst(kBlockSize * 2);
+    for (auto _ : state) {
+        kernels->float_to_int16(dst.data(), src.data(), (int)src.size());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * src.size());
+}
+
+#define HIBIKI_DSP_BENCHMARK(fn) BENCHMARK(fn)->DenseRange(static_cast<int>(Isa::kScalar), static_cast<int>(Isa::kAvx512))
+
+HIBIKI_DSP_BENCHMARK(BM_AddGainRamp);
+HIBIKI_DSP_BENCHMARK(BM_AbsPeak);
+HIBIKI_DSP_BENCHMARK(BM_SumSquares);
+HIBIKI_DSP_BENCHMARK(BM_Upsample4AbsPeak);
+HIBIKI_DSP_BENCHMARK(BM_FftStage);
+HIBIKI_DSP_BENCHMARK(BM_Interleave2);
+HIBIKI_DSP_BENCHMARK(BM_Deinterleave2);
+HIBIKI_DSP_BENCHMARK(BM_Int16ToFloat);
+HIBIKI_DSP_BENCHMARK(BM_FloatToInt16);
+
+} // namespace
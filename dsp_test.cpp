@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include "dsp.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+using hibiki::dsp::Isa;
+using hibiki::dsp::Kernels;
+
+// Odd length so every kernel also runs its scalar tail.
+constexpr int kLength = 1027;
+
+std::vector<float> RandomSignal(int n, unsigned seed, float amplitude = 1.0f) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-amplitude, amplitude);
+    std::vector<float> v(n);
+    for (auto& x : v) x = dist(rng);
+    return v;
+}
+
+class DspKernelTest : public testing::TestWithParam<Isa> {
+protected:
+    void SetUp() override {
+        kernels = hibiki::dsp::ForIsa(GetParam());
+        if (!kernels) GTEST_SKIP() << "CPU does not support this instruction set";
+        scalar = hibiki::dsp::ForIsa(Isa::kScalar);
+        ASSERT_NE(scalar, nullptr);
+    }
+
+    const Kernels* kernels = nullptr;
+    const Kernels* scalar = nullptr;
+};
+
+TEST_P(DspKernelTest, AddGainRamp) {
+    auto src = RandomSignal(kLength, 1);
+    for (auto [g0, g1] : {std::pair{1.0f, 1.0f}, std::pair{0.0f, 1.0f}, std::pair{0.8f, 0.25f}}) {
+        auto expected = RandomSignal(kLength, 2);
+        auto actual = expected;
+        scalar->add_gain_ramp(expected.data(), src.data(), kLength, g0, g1);
+        kernels->add_gain_ramp(actual.data(), src.data(), kLength, g0, g1);
+        for (int i = 0; i < kLength; ++i) ASSERT_NEAR(actual[i], expected[i], 1e-6f) << i;
+    }
+}
+
+TEST_P(DspKernelTest, ApplyGainRamp) {
+    for (auto [g0, g1] : {std::pair{0.5f, 0.5f}, std::pair{1.0f, 0.0f}}) {
+        auto expected = RandomSignal(kLength, 3);
+        auto actual = expected;
+        scalar->apply_gain_ramp(expected.data(), kLength, g0, g1);
+        kernels->apply_gain_ramp(actual.data(), kLength, g0, g1);
+        for (int i = 0; i < kLength; ++i) ASSERT_NEAR(actual[i], expected[i], 1e-6f) << i;
+    }
+}
+
+TEST_P(DspKernelTest, AbsPeak) {
+    auto src = RandomSignal(kLength, 4, 0.5f);
+    src[kLength - 1] = -0.9f;  // in the tail
+    EXPECT_FLOAT_EQ(kernels->abs_peak(src.data(), kLength), 0.9f);
+    src[100] = -0.95f;  // in the vector body
+    EXPECT_FLOAT_EQ(kernels->abs_peak(src.data(), kLength), 0.95f);
+    EXPECT_FLOAT_EQ(kernels->abs_peak(src.data(), 0), 0.0f);
+}
+
+TEST_P(DspKernelTest, SumSquares) {
+    auto src = RandomSignal(kLength, 5);
+    float expected = scalar->sum_squares(src.data(), kLength);
+    EXPECT_NEAR(kernels->sum_squares(src.data(), kLength), expected, expected * 1e-5f);
+}
+
+TEST_P(DspKernelTest, Upsample4AbsPeak) {
+    constexpr int kTaps = 12;
+    auto taps = RandomSignal(kTaps * 4, 9, 0.5f);
+    auto src = RandomSignal(kLength + kTaps, 10);
+    const float* start = src.data() + kTaps - 1;
+    float expected = scalar->upsample4_abs_peak(start, kLength, taps.data(), kTaps);
+    EXPECT_NEAR(kernels->upsample4_abs_peak(start, kLength, taps.data(), kTaps), expected, expected * 1e-5f);
+    // Shorter than one vector: only the tail runs.
+    expected = scalar->upsample4_abs_peak(start, 3, taps.data(), kTaps);
+    EXPECT_NEAR(kernels->upsample4_abs_peak(start, 3, taps.data(), kTaps), expected, expected * 1e-5f);
+}
+
+TEST_P(DspKernelTest, FftStage) {
+    constexpr int kPoints = 64;
+    for (int half = 1; half < kPoints; half *= 2) {
+        auto wr = RandomSignal(half, 11), wi = RandomSignal(half, 12);
+        auto expected_re = RandomSignal(kPoints, 13), expected_im = RandomSignal(kPoints, 14);
+        auto actual_re = expected_re, actual_im = expected_im;
+        scalar->fft_stage(expected_re.data(), expected_im.data(), wr.data(), wi.data(), kPoints, half);
+        kernels->fft_stage(actual_re.data(), actual_im.data(), wr.data(), wi.data(), kPoints, half);
+        for (int i = 0; i < kPoints; ++i) {
+            ASSERT_NEAR(actual_re[i], expected_re[i], 1e-5f) << half << " " << i;
+            ASSERT_NEAR(actual_im[i], expected_im[i], 1e-5f) << half << " " << i;
+        }
+    }
+}
+
+TEST_P(DspKernelTest, InterleaveRoundTrip) {
+    auto l = RandomSignal(kLength, 6);
+    auto r = RandomSignal(kLength, 7);
+    std::vector<float> expected(kLength * 2), actual(kLength * 2);
+    scalar->interleave2(expected.data(), l.data(), r.data(), kLength);
+    kernels->interleave2(actual.data(), l.data(), r.data(), kLength);
+    EXPECT_EQ(actual, expected);
+
+    std::vector<float> l2(kLength), r2(kLength);
+    kernels->deinterleave2(l2.data(), r2.data(), actual.data(), kLength);
+    EXPECT_EQ(l2, l);
+    EXPECT_EQ(r2, r);
+}
+
+TEST_P(DspKernelTest, FormatConversion) {
+    std::vector<int16_t> pcm(kLength);
+    for (int i = 0; i < kLength; ++i) pcm[i] = (int16_t)(i * 64 - 32768);
+    std::vector<float> expected(kLength), actual(kLength);
+    scalar->int16_to_float(expected.data(), pcm.data(), kLength);
+    kernels->int16_to_float(actual.data(), pcm.data(), kLength);
+    EXPECT_EQ(actual, expected);
+
+    auto src = RandomSignal(kLength, 8, 1.5f);  // includes values that must saturate
+    std::vector<int16_t> expected16(kLength), actual16(kLength);
+    scalar->float_to_int16(expected16.data(), src.data(), kLength);
+    kernels->float_to_int16(actual16.data(), src.data(), kLength);
+    EXPECT_EQ(actual16, expected16);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllIsas, DspKernelTest,
+                         testing::Values(Isa::kScalar, Isa::kSse2, Isa::kAvx2, Isa::kAvx512),
+                         [](const testing::TestParamInfo<Isa>& info) {
+                             switch (info.param) {
+                                 case Isa::kScalar: return "Scalar";
+                                 case Isa::kSse2: return "Sse2";
+                                 case Isa::kAvx2: return "Avx2";
+                                 case Isa::kAvx512: return "Avx512";
+                             }
+                             return "Unknown";
+                         });
+
+TEST(DspTest, Rms) {
+    std::vector<float> square(256);
+    for (size_t i = 0; i < square.size(); ++i) square[i] = (i % 2) ? 0.5f : -0.5f;
+    EXPECT_NEAR(hibiki::dsp::Rms(square.data(), (int)square.size()), 0.5f, 1e-6f);
+    EXPECT_FLOAT_EQ(hibiki::dsp::Rms(square.data(), 0), 0.0f);
+}
+
+} // namespace
@@ -0,0 +1,247 @@
+#include "engine.hpp"
+#include "dsp.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <utility>
+
+namespace hibiki {
+
+namespace {
+
+// -100 dBFS.
+constexpr float kSilenceThreshold = 1e-5f;
+
+} // namespace
+
+Engine::Engine(ProjectState& state, double sample_rate, int block_size, int num_workers,
+               std::function<void(int)> worker_init)
+    : state_(state),
+      sample_rate_(sample_rate),
+      block_size_(std::clamp(block_size, 1, kMaxBlockSize)),
+      block_period_(std::chrono::duration_cast<StatsClock::duration>(std::chrono::duration<double>(block_size_ / sample_rate))),
+      executor_(num_workers, std::move(worker_init)),
+      send_ramp_frames_(std::max<int64_t>(1, std::llround(kGainRampSeconds * sample_rate))) {
+    state_.stats.deadline_us.store(std::chrono::duration<double, std::micro>(block_period_).count(), std::memory_order_relaxed);
+    playhead_.tracks.reserve(PlayheadReport::kMaxTracks);
+}
+
+void Engine::SetIdleAfter(StatsClock::duration duration) {
+    idle_after_blocks_ = duration.count() > 0 ? std::max<int64_t>(1, duration / block_period_) : 0;
+    silent_blocks_ = 0;
+}
+
+void Engine::SetLookahead(int blocks, int num_threads, std::function<void(int)> thread_init) {
+    anticipator_.reset();
+    if (blocks > 0) {
+        anticipator_ = std::make_unique<Anticipator>(state_, sample_rate_, block_size_, blocks, std::max(1, num_threads),
+                                                     std::move(thread_init));
+    }
+}
+
+bool Engine::Process(float* left, float* right) {
+    HIBIKI_TRACE_SCOPE("Engine::Process");
+    // Nothing may be read from the state before this; see
+    // ProjectState::render_plan and WaitForBlockBoundary.
+    state_.rendering_block.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto block_start = StatsClock::now();
+
+    std::fill_n(left, block_size_, 0.0f);
+    std::fill_n(right, block_size_, 0.0f);
+
+    bool any_playing = false;
+    const RenderPlan* plan = state_.render_plan.load(std::memory_order_acquire);
+    int64_t transport = state_.transport_frame.load(std::memory_order_relaxed);
+    if (plan && state_.launch_holds.load(std::memory_order_acquire) == 0) ScheduleLaunches(*plan, transport);
+    const int64_t block_frame = std::max<int64_t>(transport, 0);
+    if (anticipator_) anticipator_->BeginBlock(plan, block_frame);
+    if (plan) any_playing = RenderTracks(*plan, block_frame, left, right);
+    if (anticipator_) anticipator_->EndBlock();
+    const bool pending = plan && FinishLaunches(*plan, block_frame + block_size_);
+    state_.transport_frame.store(any_playing || pending ? block_frame + block_size_ : -1, std::memory_order_release);
+
+    state_.master.Process(left, right, block_size_, sample_rate_, !state_.master.mute.load(std::memory_order_relaxed));
+    if (meter_) meter_->Push(MeterWorker::kMaster, left, right, block_size_);
+
+    if (idle_after_blocks_ > 0) {
+        bool silent = !any_playing && std::max(dsp::AbsPeak(left, block_size_), dsp::AbsPeak(right, block_size_)) < kSilenceThreshold;
+        silent_blocks_ = silent ? silent_blocks_ + 1 : 0;
+    }
+
+    if (!any_playing) {
+        if (state_.is_playing) {
+            std::lock_guard<std::mutex> llock(state_.levels_mutex);
+            for (auto& p : state_.track_levels) p.second = {0, 0};
+            state_.is_playing = false;
+        }
+    } else {
+        state_.is_playing = true;
+    }
+
+    auto render_time = StatsClock::now() - block_start;
+    state_.stats.block_render.Record(render_time);
+    if (render_time > block_period_) state_.stats.overruns.fetch_add(1, std::memory_order_relaxed);
+
+    if (playhead_interval_.count() > 0 && block_start - last_playhead_ >= playhead_interval_) {
+        last_playhead_ = block_start;
+        FillPlayhead(plan, transport < 0 ? -1 : block_frame);
+    }
+
+    // The plan must not be touched past this point; it may be freed.
+    state_.blocks_rendered.fetch_add(1, std::memory_order_release);
+    state_.rendering_block.store(false, std::memory_order_release);
+    return any_playing;
+}
+
+void Engine::ScheduleLaunches(const RenderPlan& plan, int64_t& transport_frame) {
+    LaunchRequest request;
+    while (state_.launches.Pop(request)) {
+        // From a stopped transport, launches start right away, on the downbeat.
+        if (transport_frame < 0) transport_frame = 0;
+        const auto quantization = request.kind == LaunchRequest::Kind::kStopAll
+                                      ? LaunchQuantization::kNone
+                                      : (LaunchQuantization)state_.launch_quantization.load(std::memory_order_relaxed);
+        const int64_t frame = QuantizeLaunch(transport_frame, quantization, state_.bpm, sample_rate_);
+        for (const auto& node : plan.nodes) {
+            Track* track = node.track;
+            if (track->is_return) continue;
+            switch (request.kind) {
+                case LaunchRequest::Kind::kClip:
+                    if (track->index == request.track_index) track->ScheduleLaunch(request.slot, frame);
+                    break;
+                case LaunchRequest::Kind::kScene:
+                    if (track->clip_set.load(std::memory_order_acquire)->clips.count(request.slot)) track->ScheduleLaunch(request.slot, frame);
+                    break;
+                case LaunchRequest::Kind::kStopAll:
+                    track->ScheduleLaunch(-1, frame);
+                    break;
+            }
+        }
+    }
+}
+
+bool Engine::FinishLaunches(const RenderPlan& plan, int64_t end_frame) {
+    bool pending = false;
+    for (const auto& node : plan.nodes) {
+        const int64_t frame = node.track->launch_frame.load(std::memory_order_relaxed);
+        if (frame < 0) continue;
+        if (frame < end_frame) {
+            node.track->launch_frame.store(-1, std::memory_order_relaxed);
+        } else {
+            pending = true;
+        }
+    }
+    return pending;
+}
+
+bool Engine::RenderTracks(const RenderPlan& plan, int64_t transport_frame, float* left, float* right) {
+    bool any_solo = false;
+    for (const auto& node : plan.nodes) any_solo |= node.track->mixer.solo.load(std::memory_order_relaxed);
+    BlockInfo block{sample_rate_, block_size_, state_.bpm, any_solo, transport_frame};
+    const int block_size = block_size_;
+
+    // Sends ramp from their previous levels from the first block of a new
+    // plan. The first plan an engine sees has nothing to ramp from.
+    if (plan.generation != plan_generation_) {
+        plan_frames_ = plan_generation_ == 0 ? send_ramp_frames_ : 0;
+        plan_generation_ = plan.generation;
+    }
+    const int64_t ramp_start = plan_frames_;
+    plan_frames_ = std::min(plan_frames_ + block_size, send_ramp_frames_);
+    auto send_gain = [&](const RenderPlan::Input& input, int64_t frame) {
+        return input.previous_gain + (input.gain - input.previous_gain) * (float)frame / (float)send_ramp_frames_;
+    };
+
+    // A node runs once all of its inputs and its sidechain source are
+    // done, so it may read their output buffers without locking.
+    executor_.Run(plan.graph, [&](int n) {
+        const auto& node = plan.nodes[n];
+        Track* track = node.track;
+
+        if (track->is_return) {
+            std::fill_n(track->output_l.data(), block_size, 0.0f);
+            std::fill_n(track->output_r.data(), block_size, 0.0f);
+            for (const auto& input : node.inputs) {
+                const Track* source = plan.nodes[input.node].track;
+                if (!source->active) continue;
+                int ramped = 0;
+                if (input.gain != input.previous_gain && ramp_start < send_ramp_frames_) {
+                    ramped = (int)std::min<int64_t>(block_size, send_ramp_frames_ - ramp_start);
+                    const float g0 = send_gain(input, ramp_start), g1 = send_gain(input, ramp_start + ramped);
+                    dsp::AddGainRamp(track->output_l.data(), source->output_l.data(), ramped, g0, g1);
+                    dsp::AddGainRamp(track->output_r.data(), source->output_r.data(), ramped, g0, g1);
+                }
+                if (ramped < block_size) {
+                    dsp::AddGainRamp(track->output_l.data() + ramped, source->output_l.data() + ramped,
+                                     block_size - ramped, input.gain, input.gain);
+                    dsp::AddGainRamp(track->output_r.data() + ramped, source->output_r.data() + ramped,
+                                     block_size - ramped, input.gain, input.gain);
+                }
+            }
+        }
+
+        float* sidechain[2] = {nullptr, nullptr};
+        if (node.sidechain != -1) {
+            Track* source = plan.nodes[node.sidechain].track;
+            sidechain[0] = source->output_l.data();
+            sidechain[1] = source->output_r.data();
+        }
+        bool playing;
+        if (anticipator_ && anticipator_->TakeBlock(*track, block, playing)) {
+            track->MixBlock(block, playing);
+        } else {
+            track->heard_slot = track->playing_slot;
+            track->heard_time_sec = track->current_time_sec;
+            track->RenderBlock(block, node.sidechain != -1 ? sidechain : nullptr);
+        }
+    });
+
+    bool any_playing = false;
+    for (const auto& node : plan.nodes) {
+        Track* track = node.track;
+        if (track->active && !track->is_return) any_playing = true;
+        if (track->active && node.to_master) {
+            dsp::Add(left, track->output_l.data(), block_size);
+            dsp::Add(right, track->output_r.data(), block_size);
+        }
+        if (track->active && track_output_sink_) track_output_sink_(track->index, track->output_l.data(), track->output_r.data());
+        if (track->active && meter_) meter_->Push(track->index, track->output_l.data(), track->output_r.data(), block_size);
+    }
+    if (any_playing) {
+        std::lock_guard<std::mutex> llock(state_.levels_mutex);
+        for (const auto& node : plan.nodes) {
+            // A track that stopped reads silent rather than its last level.
+            auto& level = state_.track_levels[node.track->index];
+            level = node.track->active ? std::pair(node.track->peak_l, node.track->peak_r) : std::pair(0.0f, 0.0f);
+        }
+    }
+    return any_playing;
+}
+
+void Engine::FillPlayhead(const RenderPlan* plan, int64_t transport_frame) {
+    playhead_.transport_frame = transport_frame;
+    playhead_.bpm = state_.bpm;
+    playhead_.sample_rate = sample_rate_;
+    playhead_.tracks.clear();
+    if (plan) {
+        for (const auto& node : plan->nodes) {
+            const Track* track = node.track;
+            if (track->is_return || track->heard_slot < 0) continue;
+            const auto& clips = track->clip_set.load(std::memory_order_acquire)->clips;
+            auto it = clips.find(track->heard_slot);
+            if (it == clips.end()) continue;
+            if (playhead_.tracks.size() == PlayheadReport::kMaxTracks) break;
+            playhead_.tracks.push_back({track->index, track->heard_slot, track->heard_time_sec, it->second->duration_sec,
+                                        it->second->is_loop});
+        }
+    }
+    playhead_ready_ = true;
+}
+
+const PlayheadReport* Engine::TakePlayhead() {
+    return std::exchange(playhead_ready_, false) ? &playhead_ : nullptr;
+}
+
+} // namespace hibiki
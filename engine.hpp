@@ -0,0 +1,98 @@
+#pragma once
+
+#include "anticipation.hpp"
+#include "engine_stats.hpp"
+#include "meter.hpp"
+#include "project.hpp"
+#include "render_graph.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace hibiki {
+
+// Device-independent render core. Each Process call renders one block of the
+// project's current render plan to a stereo pair of buffers; the audio device
+// thread, tests and benchmarks all drive the engine the same way.
+class Engine {
+public:
+    // block_size is clamped to kMaxBlockSize.
+    // worker_init runs on each render worker thread as it starts.
+    Engine(ProjectState& state, double sample_rate, int block_size, int num_workers = GraphExecutor::DefaultWorkerCount(),
+           std::function<void(int)> worker_init = {});
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    // Renders the next block into left and right, which must hold block_size()
+    // samples, after the master strip. Returns whether any clip is playing.
+    // Also updates the track levels and the load counters in the project state,
+    // which a StatsReporter drains.
+    bool Process(float* left, float* right);
+
+    // Playhead prepared by the last Process call, every interval set by
+    // SetPlayheadInterval; zero, the default, prepares none. The position is
+    // the block's start; dac_time is left for the caller, who knows the device.
+    // The report stays valid until the next Process call.
+    void SetPlayheadInterval(StatsClock::duration interval) { playhead_interval_ = interval; }
+    const PlayheadReport* TakePlayhead();
+
+    // Receives the post-fader output of every active track, including return
+    // tracks, during Process. For devices that expose per-track outputs.
+    using TrackOutputSink = std::function<void(int track_index, const float* left, const float* right)>;
+    void SetTrackOutputSink(TrackOutputSink sink) { track_output_sink_ = std::move(sink); }
+
+    // After this long with no clip playing and a silent output (so plugin
+    // tails have decayed), idle() turns true and the device thread may park.
+    // Zero, the default, never idles.
+    void SetIdleAfter(StatsClock::duration duration);
+    bool idle() const { return idle_after_blocks_ > 0 && silent_blocks_ >= idle_after_blocks_; }
+    // Restarts the silence count, e.g. after waking from idle.
+    void ResetIdle() { silent_blocks_ = 0; }
+
+    // Renders tracks without live input this many blocks ahead on num_threads
+    // background threads (see anticipation.hpp); 0, the default, renders every
+    // track just in time. thread_init runs on each of those threads as it
+    // starts. Call before the first Process.
+    void SetLookahead(int blocks, int num_threads, std::function<void(int)> thread_init = {});
+    int lookahead_blocks() const { return anticipator_ ? anticipator_->lookahead_blocks() : 0; }
+
+    // Copies the post-fader output of every active track, and the master
+    // output, to the meter worker during Process; nullptr, the default, stops.
+    void SetMeter(MeterWorker* meter) { meter_ = meter; }
+
+    double sample_rate() const { return sample_rate_; }
+    int block_size() const { return block_size_; }
+    StatsClock::duration block_period() const { return block_period_; }
+
+private:
+    bool RenderTracks(const RenderPlan& plan, int64_t transport_frame, float* left, float* right);
+    // Hands queued launches to their tracks, on the grid from transport_frame,
+    // and starts a stopped transport at 0 for them.
+    void ScheduleLaunches(const RenderPlan& plan, int64_t& transport_frame);
+    // Drops launches that happened before end_frame; returns whether any are left.
+    bool FinishLaunches(const RenderPlan& plan, int64_t end_frame);
+    void FillPlayhead(const RenderPlan* plan, int64_t transport_frame);
+
+    ProjectState& state_;
+    double sample_rate_;
+    int block_size_;
+    StatsClock::duration block_period_;
+    GraphExecutor executor_;
+    // The plan the last block rendered and how far into its send ramps it got.
+    uint64_t plan_generation_ = 0;
+    int64_t plan_frames_ = 0;
+    int64_t send_ramp_frames_;
+
+    StatsClock::duration playhead_interval_{};
+    StatsClock::time_point last_playhead_;
+    PlayheadReport playhead_; // tracks reserved for PlayheadReport::kMaxTracks
+    bool playhead_ready_ = false;
+    TrackOutputSink track_output_sink_;
+    MeterWorker* meter_ = nullptr;
+    int64_t idle_after_blocks_ = 0;
+    int64_t silent_blocks_ = 0;
+    std::unique_ptr<Anticipator> anticipator_;
+};
+
+} // namespace hibiki
@@ -0,0 +1,144 @@
+#include <benchmark/benchmark.h>
+#include "audio_file.hpp"
+#include "clip.hpp"
+#include "engine.hpp"
+#include "hibiki_response_generated.h"
+#include "midi.hpp"
+#include "test_utils.hpp"
+
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 512;
+
+std::unique_ptr<hibiki::Clip> MakeAudioClip() {
+    auto clip = std::make_unique<hibiki::Clip>();
+    clip->type = hibiki::Clip::Type::AUDIO;
+    clip->sample_rate = kSampleRate;
+    clip->audio = hibiki::PlanarAudio(2, (int64_t)kSampleRate * 4);
+    for (int c = 0; c < 2; ++c) {
+        float* dst = clip->audio.channel(c);
+        for (int64_t i = 0; i < clip->audio.num_frames(); ++i) dst[i] = (float)((i % 200) - 100) / 100.0f;
+    }
+    clip->duration_sec = 4.0;
+    clip->is_loop = true;
+    return clip;
+}
+
+// Sixteenth notes over four bars at 120 bpm, cycling through two octaves.
+std::unique_ptr<hibiki::Clip> MakeMidiClip() {
+    auto clip = std::make_unique<hibiki::Clip>();
+    clip->type = hibiki::Clip::Type::MIDI;
+    for (int i = 0; i < 64; ++i) {
+        double t = i * 0.125;
+        clip->midi_events.push_back({t, 0x90, 0, (uint8_t)(48 + i % 24), 100});
+        clip->midi_events.push_back({t + 0.1, 0x80, 0, (uint8_t)(48 + i % 24), 0});
+    }
+    clip->duration_sec = 8.0;
+    clip->is_loop = true;
+    return clip;
+}
+
+// Time per iteration is the cost of one block. range(0): tracks, range(1): render workers.
+void RenderTracks(benchmark::State& state, bool midi) {
+    hibiki::ProjectState project;
+    for (int t = 0; t < state.range(0); ++t) {
+        auto track = hibiki::GetOrCreateTrack(project, t);
+        track->InsertClip(0, midi ? MakeMidiClip() : MakeAudioClip());
+        track->playing_slot = 0;
+    }
+    project.stats.interval_ms = 0;
+    hibiki::Engine engine(project, kSampleRate, kBlockSize, (int)state.range(1));
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    for (auto _ : state) {
+        engine.Process(l.data(), r.data());
+        benchmark::DoNotOptimize(l.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_RenderAudioTracks(benchmark::State& state) { RenderTracks(state, false); }
+void BM_RenderMidiTracks(benchmark::State& state) { RenderTracks(state, true); }
+
+size_t FileSize(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return in ? (size_t)in.tellg() : 0;
+}
+
+void BM_ParseMidi(benchmark::State& state) {
+    std::string path = hibiki::find_test_file("testdata/rickroll.mid");
+    for (auto _ : state) {
+        auto events = hibiki::parseMidi(path);
+        benchmark::DoNotOptimize(events.data());
+    }
+    state.SetBytesProcessed(state.iterations() * FileSize(path));
+}
+
+void BM_LoadWav(benchmark::State& state) {
+    std::string path = hibiki::find_test_file("testdata/bb140.wav");
+    std::vector<float> data;
+    int channels = 0;
+    double duration = 0.0;
+    for (auto _ : state) {
+        if (!hibiki::LoadWav(path, data, channels, duration)) {
+            state.SkipWithError("cannot load testdata/bb140.wav");
+            return;
+        }
+        benchmark::DoNotOptimize(data.data());
+    }
+    state.SetBytesProcessed(state.iterations() * FileSize(path));
+}
+
+void BM_WaveformSummary(benchmark::State& state) {
+    auto clip = MakeAudioClip();
+    for (auto _ : state) {
+        auto summary = hibiki::WaveformSummary(clip->audio);
+        benchmark::DoNotOptimize(summary.data());
+    }
+    state.SetItemsProcessed(state.iterations() * clip->audio.num_frames());
+}
+
+void BM_BuildTrackLevels(benchmark::State& state) {
+    flatbuffers::FlatBufferBuilder builder(512);
+    std::vector<flatbuffers::Offset<hibiki::ipc::TrackLevel>> level_offsets;
+    for (auto _ : state) {
+        builder.Clear();
+        level_offsets.clear();
+        for (int t = 0; t < state.range(0); ++t) {
+            level_offsets.push_back(hibiki::ipc::CreateTrackLevel(builder, t, 0.5f, 0.25f));
+        }
+        auto levels_vec = builder.CreateVector(level_offsets);
+        auto levels_off = hibiki::ipc::CreateTrackLevels(builder, levels_vec);
+        builder.Finish(hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_TrackLevels, levels_off.Union()));
+        benchmark::DoNotOptimize(builder.GetBufferPointer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_BuildClipWaveform(benchmark::State& state) {
+    auto clip = MakeAudioClip();
+    auto summary = hibiki::WaveformSummary(clip->audio);
+    flatbuffers::FlatBufferBuilder builder(2048);
+    for (auto _ : state) {
+        builder.Clear();
+        auto waveform_vec = builder.CreateVector(summary);
+        auto waveform_off = hibiki::ipc::CreateClipWaveform(builder, 0, 0, waveform_vec);
+        builder.Finish(hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_ClipWaveform, waveform_off.Union()));
+        benchmark::DoNotOptimize(builder.GetBufferPointer());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_RenderAudioTracks)->ArgsProduct({{1, 8, 32}, {0, 3}})->ArgNames({"tracks", "workers"});
+BENCHMARK(BM_RenderMidiTracks)->ArgsProduct({{1, 8, 32}, {0, 3}})->ArgNames({"tracks", "workers"});
+BENCHMARK(BM_ParseMidi);
+BENCHMARK(BM_LoadWav);
+BENCHMARK(BM_WaveformSummary);
+BENCHMARK(BM_BuildTrackLevels)->Arg(8)->Arg(64);
+BENCHMARK(BM_BuildClipWaveform);
+
+} // namespace
@@ -0,0 +1,38 @@
+#include "engine_stats.hpp"
+
+#include <algorithm>
+
+namespace hibiki {
+
+void TimingStats::Record(StatsClock::duration elapsed) {
+    uint64_t ns = (uint64_t)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    total_ns_.fetch_add(ns, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+TimingStats::Summary TimingStats::Drain() {
+    Summary summary;
+    summary.count = count_.exchange(0, std::memory_order_relaxed);
+    uint64_t total_ns = total_ns_.exchange(0, std::memory_order_relaxed);
+    summary.max_us = max_ns_.exchange(0, std::memory_order_relaxed) / 1000.0;
+    if (summary.count > 0) summary.avg_us = total_ns / 1000.0 / summary.count;
+    return summary;
+}
+
+void JitterHistogram::Record(StatsClock::duration deviation) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(deviation).count();
+    if (us < 0) us = -us;
+    auto it = std::upper_bound(kBucketLimitsUs.begin(), kBucketLimitsUs.end(), us);
+    buckets_[it - kBucketLimitsUs.begin()].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::array<uint32_t, JitterHistogram::kNumBuckets> JitterHistogram::Drain() {
+    std::array<uint32_t, kNumBuckets> counts;
+    for (int i = 0; i < kNumBuckets; ++i) counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+    return counts;
+}
+
+} // namespace hibiki
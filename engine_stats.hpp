@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hibiki {
+
+using StatsClock = std::chrono::steady_clock;
+
+// Wall-time statistics of a recurring job, such as one track or one plugin
+// rendering a block. Recording and draining are lock-free so the audio thread
+// and render workers never block on the stats reporter.
+class TimingStats {
+public:
+    struct Summary {
+        uint32_t count = 0;
+        double avg_us = 0.0;
+        double max_us = 0.0;
+    };
+
+    void Record(StatsClock::duration elapsed);
+    // Returns everything recorded since the previous call and starts over.
+    Summary Drain();
+
+private:
+    std::atomic<uint64_t> total_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+    std::atomic<uint32_t> count_{0};
+};
+
+// Records the lifetime of the scope into a TimingStats.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(TimingStats& stats) : stats_(stats), start_(StatsClock::now()) {}
+    ~ScopedTimer() { stats_.Record(StatsClock::now() - start_); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    TimingStats& stats_;
+    StatsClock::time_point start_;
+};
+
+// Histogram of how far block periods stray from their nominal length.
+class JitterHistogram {
+public:
+    // Upper bounds in microseconds; the last bucket takes everything larger.
+    static constexpr std::array<int, 7> kBucketLimitsUs = {50, 100, 250, 500, 1000, 2000, 5000};
+    static constexpr int kNumBuckets = (int)kBucketLimitsUs.size() + 1;
+
+    void Record(StatsClock::duration deviation);
+    std::array<uint32_t, kNumBuckets> Drain();
+
+private:
+    std::array<std::atomic<uint32_t>, kNumBuckets> buckets_{};
+};
+
+// Engine-wide load counters, reported to the GUI as an EngineStats notification.
+// Per-track and per-plugin timings live next to the track and plugin they measure.
+struct EngineStats {
+    // Reporting period in milliseconds; 0 turns the notification off.
+    std::atomic<int> interval_ms{500};
+
+    // Nominal length of a block of the running engine.
+    std::atomic<double> deadline_us{0.0};
+    TimingStats block_render;          // render time of a whole block
+    std::atomic<uint32_t> overruns{0}; // blocks that rendered slower than real time
+    std::atomic<uint32_t> xruns{0};    // device xruns, added by the playback thread
+    JitterHistogram jitter;
+    // Anticipated track blocks that were not ready in time and were rendered
+    // by the audio thread after all.
+    std::atomic<uint32_t> lookahead_misses{0};
+};
+
+// Snapshot of one reporting period, sent as an EngineStats notification.
+struct EngineStatsReport {
+    struct Plugin {
+        int plugin_index;
+        std::string name;
+        TimingStats::Summary time;
+    };
+    struct Track {
+        int track_index;
+        TimingStats::Summary time;
+        std::vector<Plugin> plugins;
+    };
+
+    double deadline_us = 0.0;
+    TimingStats::Summary block;
+    uint32_t overruns = 0;
+    uint32_t xruns = 0;
+    std::array<uint32_t, JitterHistogram::kNumBuckets> jitter{};
+    uint32_t lookahead_misses = 0;
+    std::vector<Track> tracks;
+};
+
+// Where playback is at the start of a block, sent as a Playhead notification.
+// The GUI extrapolates from dac_time, when that block's first frame leaves
+// the device, so it can draw smoothly between notifications.
+struct PlayheadReport {
+    struct Track {
+        int track_index;
+        int slot_index;
+        double position_sec;
+        double duration_sec;
+        bool is_loop;
+    };
+
+    // Transport frame of the block, or -1 with the transport stopped.
+    int64_t transport_frame = -1;
+    double bpm = 0.0;
+    double sample_rate = 0.0;
+    StatsClock::time_point dac_time;
+    // Tracks that are playing a clip, the first kMaxTracks of them, so that
+    // the audio thread can fill a report it reserved once.
+    static constexpr size_t kMaxTracks = 256;
+    std::vector<Track> tracks;
+};
+
+} // namespace hibiki
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "engine_stats.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST(EngineStatsTest, TimingStatsSummarisesAndResets) {
+    hibiki::TimingStats stats;
+    stats.Record(100us);
+    stats.Record(300us);
+    auto summary = stats.Drain();
+    EXPECT_EQ(summary.count, 2u);
+    EXPECT_DOUBLE_EQ(summary.avg_us, 200.0);
+    EXPECT_DOUBLE_EQ(summary.max_us, 300.0);
+
+    auto empty = stats.Drain();
+    EXPECT_EQ(empty.count, 0u);
+    EXPECT_DOUBLE_EQ(empty.avg_us, 0.0);
+    EXPECT_DOUBLE_EQ(empty.max_us, 0.0);
+}
+
+TEST(EngineStatsTest, ConcurrentRecordsAreNotLost) {
+    hibiki::TimingStats stats;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&stats, t] {
+            for (int i = 0; i < 10000; ++i) stats.Record(std::chrono::microseconds(t + 1));
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    auto summary = stats.Drain();
+    EXPECT_EQ(summary.count, 40000u);
+    EXPECT_DOUBLE_EQ(summary.avg_us, 2.5);
+    EXPECT_DOUBLE_EQ(summary.max_us, 4.0);
+}
+
+TEST(EngineStatsTest, ScopedTimerRecordsOnce) {
+    hibiki::TimingStats stats;
+    { hibiki::ScopedTimer timer(stats); }
+    EXPECT_EQ(stats.Drain().count, 1u);
+}
+
+TEST(EngineStatsTest, JitterBuckets) {
+    hibiki::JitterHistogram jitter;
+    jitter.Record(10us);
+    jitter.Record(-10us); // early and late periods count alike
+    jitter.Record(50us);  // limits are exclusive
+    jitter.Record(700us);
+    jitter.Record(1s);
+    auto counts = jitter.Drain();
+    EXPECT_EQ(counts[0], 2u);
+    EXPECT_EQ(counts[1], 1u);
+    EXPECT_EQ(counts[4], 1u);
+    EXPECT_EQ(counts[hibiki::JitterHistogram::kNumBuckets - 1], 1u);
+    EXPECT_EQ(jitter.Drain()[0], 0u);
+}
@@ -0,0 +1,351 @@
+#include <gtest/gtest.h>
+#include "engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 256;
+
+// Puts a looping stereo clip of constant value in the slot.
+void AddConstantClip(hibiki::Track* track, int slot, float value) {
+    auto clip = std::make_unique<hibiki::Clip>();
+    clip->type = hibiki::Clip::Type::AUDIO;
+    clip->sample_rate = kSampleRate;
+    clip->audio = hibiki::PlanarAudio(2, (int64_t)kSampleRate);
+    for (int c = 0; c < 2; ++c) std::fill_n(clip->audio.channel(c), (int64_t)kSampleRate, value);
+    clip->duration_sec = 1.0;
+    clip->is_loop = true;
+    track->InsertClip(slot, std::move(clip));
+}
+
+// Starts a looping stereo clip of constant value on the track.
+void PlayConstantClip(hibiki::Track* track, float value) {
+    AddConstantClip(track, 0, value);
+    track->playing_slot = 0;
+}
+
+// Renders blocks until the transport reaches frame, which must fall within a
+// block, and returns that block's left channel and the offset of frame in it.
+std::pair<std::vector<float>, int> RenderUntil(hibiki::Engine& engine, hibiki::ProjectState& state, int64_t frame) {
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    while (true) {
+        const int64_t start = std::max<int64_t>(state.transport_frame.load(), 0);
+        engine.Process(l.data(), r.data());
+        if (frame < start + kBlockSize) return {l, (int)(frame - start)};
+    }
+}
+
+TEST(EngineTest, EmptyProjectIsSilent) {
+    hibiki::ProjectState state;
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize, 1.0f), r(kBlockSize, 1.0f);
+    EXPECT_FALSE(engine.Process(l.data(), r.data()));
+    EXPECT_EQ(l, std::vector<float>(kBlockSize, 0.0f));
+    EXPECT_EQ(r, std::vector<float>(kBlockSize, 0.0f));
+    EXPECT_EQ(state.blocks_rendered.load(), 1u);
+}
+
+TEST(EngineTest, RendersAudioClipsAndLevels) {
+    hibiki::ProjectState state;
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 0), 0.25f);
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 1), 0.5f);
+
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 2);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    EXPECT_TRUE(engine.Process(l.data(), r.data()));
+    EXPECT_FLOAT_EQ(l[kBlockSize / 2], 0.75f);
+    EXPECT_FLOAT_EQ(r[kBlockSize / 2], 0.75f);
+    EXPECT_TRUE(state.is_playing);
+    EXPECT_FLOAT_EQ(state.track_levels[1].first, 0.5f);
+    EXPECT_DOUBLE_EQ(state.tracks[0]->current_time_sec, kBlockSize / kSampleRate);
+
+    // A stopped track reads silent while the others play on.
+    state.tracks[1]->Stop();
+    engine.Process(l.data(), r.data());
+    EXPECT_FLOAT_EQ(state.track_levels[1].first, 0.0f);
+    EXPECT_FLOAT_EQ(state.track_levels[0].first, 0.25f);
+}
+
+TEST(EngineTest, DeletedClipsOutliveTheRunningBlock) {
+    hibiki::ProjectState state;
+    hibiki::Track* track = hibiki::GetOrCreateTrack(state, 0);
+    PlayConstantClip(track, 0.5f);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+
+    // A block that loaded the old set may still play from it.
+    const hibiki::ClipSet* old_set = track->clip_set.load();
+    ASSERT_TRUE(track->DeleteClip(0));
+    EXPECT_EQ(old_set->clips.count(0), 1u);
+    EXPECT_EQ(track->clip_set.load()->clips.count(0), 0u);
+    EXPECT_FALSE(engine.Process(l.data(), r.data()));
+
+    hibiki::ReleaseRetiredClips(state, *track);
+    std::vector<std::unique_ptr<hibiki::ClipSet>> retired;
+    track->TakeRetiredClips(retired);
+    EXPECT_TRUE(retired.empty());
+}
+
+TEST(EngineTest, GroupBusSumsRoutedTracks) {
+    hibiki::ProjectState state;
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 0), 0.5f);
+    hibiki::SetReturnTrack(state, 1, true);
+    state.tracks[1]->mixer.mute = true;
+    ASSERT_TRUE(hibiki::SetTrackOutput(state, 0, 1));
+
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 1);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    // The track only reaches the master through its muted bus.
+    engine.Process(l.data(), r.data());
+    engine.Process(l.data(), r.data());
+    EXPECT_FLOAT_EQ(l[kBlockSize / 2], 0.0f);
+    EXPECT_FLOAT_EQ(state.tracks[1]->peak_l, 0.0f);
+    EXPECT_FLOAT_EQ(state.tracks[0]->peak_l, 0.5f);
+}
+
+TEST(EngineTest, SendLevelChangesAreRamped) {
+    hibiki::ProjectState state;
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 0), 0.5f);
+    hibiki::SetReturnTrack(state, 1, true);
+    ASSERT_TRUE(hibiki::SetSend(state, 0, 1, 1.0f));
+    const std::vector<float>& send = state.tracks[1]->output_l;
+
+    // The first plan an engine renders starts at its levels.
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 1);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    EXPECT_FLOAT_EQ(send[0], 0.5f);
+
+    // A new level is reached over 480 frames, not in one step.
+    ASSERT_TRUE(hibiki::SetSend(state, 0, 1, 0.5f));
+    engine.Process(l.data(), r.data());
+    EXPECT_NEAR(send[0], 0.5f, 1e-3f);
+    EXPECT_LT(send[kBlockSize - 1], 0.5f);
+    EXPECT_GT(send[kBlockSize - 1], 0.25f);
+    engine.Process(l.data(), r.data());
+    EXPECT_GT(send[0], 0.25f);
+    EXPECT_FLOAT_EQ(send[kBlockSize - 1], 0.25f);
+}
+
+TEST(EngineTest, TrackOutputSinkSeesEachActiveTrack) {
+    hibiki::ProjectState state;
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 0), 0.25f);
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 2), 0.5f);
+    hibiki::GetOrCreateTrack(state, 5);
+
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::map<int, float> stems;
+    engine.SetTrackOutputSink([&](int track_index, const float* left, const float*) { stems[track_index] = left[kBlockSize - 1]; });
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    EXPECT_EQ(stems, (std::map<int, float>{{0, 0.25f}, {2, 0.5f}}));
+}
+
+TEST(EngineTest, ScenesStartOnTheDownbeatOfEveryTrack) {
+    hibiki::ProjectState state;
+    state.bpm = 130.0; // bars fall between blocks
+    for (int i = 0; i < 2; ++i) {
+        auto* track = hibiki::GetOrCreateTrack(state, i);
+        AddConstantClip(track, 0, 0.25f);
+        AddConstantClip(track, 1, 0.5f);
+    }
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 2);
+
+    // From a stopped transport the launch is immediate.
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kClip, 0, 0}));
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    EXPECT_FLOAT_EQ(l[0], 0.25f);
+    for (int i = 0; i < 10; ++i) engine.Process(l.data(), r.data());
+
+    // The scene waits for the next bar and switches both tracks on its frame.
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kScene, -1, 1}));
+    const int64_t bar = std::llround(4 * 60.0 / 130.0 * kSampleRate);
+    auto [block, offset] = RenderUntil(engine, state, bar);
+    ASSERT_GT(offset, 0);
+    EXPECT_FLOAT_EQ(block[offset - 1], 0.25f);
+    EXPECT_FLOAT_EQ(block[offset], 1.0f);
+    EXPECT_EQ(state.tracks[1]->launch_frame.load(), -1);
+
+    // Stopping everything is not quantized.
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kStopAll}));
+    EXPECT_FALSE(engine.Process(l.data(), r.data()));
+    EXPECT_FLOAT_EQ(l[0], 0.0f);
+    engine.Process(l.data(), r.data());
+    EXPECT_EQ(state.transport_frame.load(), -1);
+}
+
+TEST(EngineTest, FollowActionsSwitchClipsOnTheirFrame) {
+    hibiki::ProjectState state;
+    auto* track = hibiki::GetOrCreateTrack(state, 0);
+    AddConstantClip(track, 0, 0.25f);
+    AddConstantClip(track, 1, 0.5f);
+    track->SetFollowAction(0, hibiki::FollowAction::kNext, 1.0);
+    track->SetFollowAction(1, hibiki::FollowAction::kStop, 0.5);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kClip, 0, 0}));
+
+    // A beat at 120 bpm, then half a beat.
+    auto [first, offset] = RenderUntil(engine, state, 24000);
+    EXPECT_FLOAT_EQ(first[offset - 1], 0.25f);
+    EXPECT_FLOAT_EQ(first[offset], 0.5f);
+    auto [second, stop] = RenderUntil(engine, state, 36000);
+    EXPECT_FLOAT_EQ(second[stop - 1], 0.5f);
+    EXPECT_FLOAT_EQ(second[stop], 0.0f);
+    EXPECT_EQ(track->playing_slot, -1);
+}
+
+TEST(EngineTest, LaunchingAnEmptySlotKeepsPlaying) {
+    hibiki::ProjectState state;
+    state.launch_quantization = (int)hibiki::LaunchQuantization::kNone;
+    hibiki::Track* track = hibiki::GetOrCreateTrack(state, 0);
+    AddConstantClip(track, 0, 0.5f);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kClip, 0, 0}));
+    engine.Process(l.data(), r.data());
+
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kClip, 0, 5}));
+    EXPECT_TRUE(engine.Process(l.data(), r.data()));
+    EXPECT_EQ(track->playing_slot, 0);
+    EXPECT_FLOAT_EQ(l[kBlockSize - 1], 0.5f);
+}
+
+TEST(EngineTest, HeldLaunchesWaitForTheRelease) {
+    hibiki::ProjectState state;
+    state.launch_quantization = (int)hibiki::LaunchQuantization::kNone;
+    for (int i = 0; i < 2; ++i) AddConstantClip(hibiki::GetOrCreateTrack(state, i), 0, 0.25f);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+
+    state.launch_holds++;
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kClip, 0, 0}));
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    EXPECT_FALSE(engine.Process(l.data(), r.data()));
+    ASSERT_TRUE(state.launches.Push({hibiki::LaunchRequest::Kind::kClip, 1, 0}));
+    state.launch_holds--;
+
+    // Both start together, in the first block after the release.
+    engine.Process(l.data(), r.data());
+    EXPECT_FLOAT_EQ(l[0], 0.5f);
+}
+
+TEST(EngineTest, HeldPublishingReachesOneBlock) {
+    hibiki::ProjectState state;
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 0), 0.5f);
+    hibiki::SetReturnTrack(state, 1, true);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    const hibiki::RenderPlan* plan = state.current_plan.get();
+
+    hibiki::HoldPublishing(state);
+    ASSERT_TRUE(hibiki::SetTrackOutput(state, 0, 1));
+    hibiki::SetMixer(state, 1, [](auto& mixer) { mixer.volume = 0.5f; });
+    hibiki::SetMixer(state, hibiki::kMasterStrip, [](auto& mixer) { mixer.volume = 0.5f; });
+    // Feedback is still refused while held.
+    EXPECT_FALSE(hibiki::SetTrackOutput(state, 1, 1));
+    engine.Process(l.data(), r.data());
+    EXPECT_EQ(state.current_plan.get(), plan);
+    EXPECT_FLOAT_EQ(l[kBlockSize - 1], 0.5f);
+
+    hibiki::ReleasePublishing(state);
+    EXPECT_NE(state.current_plan.get(), plan);
+    EXPECT_FLOAT_EQ(state.tracks[1]->mixer.volume, 0.5f);
+    EXPECT_FLOAT_EQ(state.master.volume, 0.5f);
+    // Routed through the bus, both gains start ramping in the same block and
+    // are reached once the ramp has run its 480 frames.
+    engine.Process(l.data(), r.data());
+    engine.Process(l.data(), r.data());
+    EXPECT_FLOAT_EQ(l[kBlockSize - 1], 0.125f);
+}
+
+TEST(EngineTest, MetersTracksAndMaster) {
+    hibiki::ProjectState state;
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 1), 0.5f);
+    state.master.volume = 0.5f;
+    std::promise<hibiki::MeterReport> reported;
+    bool done = false;
+    hibiki::MeterWorker meter([&](const hibiki::MeterReport& report) {
+        if (done || report.sources.size() < 2) return;
+        done = true;
+        reported.set_value(report);
+    });
+    meter.SetSampleRate(kSampleRate);
+    meter.SetInterval(0);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    engine.SetMeter(&meter);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    for (int i = 0; i < 4; ++i) engine.Process(l.data(), r.data());
+    meter.SetInterval(1);
+
+    auto report = reported.get_future().get();
+    ASSERT_EQ(report.sources.size(), 2u);
+    EXPECT_EQ(report.sources[0].track_index, hibiki::MeterWorker::kMaster);
+    EXPECT_EQ(report.sources[1].track_index, 1);
+    EXPECT_NEAR(report.sources[1].reading.peak_db, -6.02f, 0.01f);
+    // The master strip ramps towards its volume over the first two blocks.
+    EXPECT_LT(report.sources[0].reading.rms_db, report.sources[1].reading.rms_db - 3.0f);
+}
+
+TEST(EngineTest, IdlesAfterSustainedSilence) {
+    hibiki::ProjectState state;
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    EXPECT_FALSE(engine.idle());
+
+    engine.SetIdleAfter(engine.block_period() * 3);
+    for (int i = 0; i < 2; ++i) engine.Process(l.data(), r.data());
+    EXPECT_FALSE(engine.idle());
+    engine.Process(l.data(), r.data());
+    EXPECT_TRUE(engine.idle());
+
+    PlayConstantClip(hibiki::GetOrCreateTrack(state, 0), 0.5f);
+    engine.Process(l.data(), r.data());
+    EXPECT_FALSE(engine.idle());
+}
+
+TEST(EngineTest, PreparesPlayheadWhenDue) {
+    hibiki::ProjectState state;
+    AddConstantClip(hibiki::GetOrCreateTrack(state, 2), 4, 0.5f);
+    state.launch_quantization = (int)hibiki::LaunchQuantization::kNone;
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    engine.SetPlayheadInterval(std::chrono::milliseconds(1));
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    engine.Process(l.data(), r.data());
+    const hibiki::PlayheadReport* playhead = engine.TakePlayhead();
+    ASSERT_NE(playhead, nullptr);
+    EXPECT_EQ(playhead->transport_frame, -1);
+    EXPECT_TRUE(playhead->tracks.empty());
+
+    state.launches.Push({hibiki::LaunchRequest::Kind::kClip, 2, 4});
+    for (int i = 0; i < 3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        engine.Process(l.data(), r.data());
+    }
+    // The position is that of the last block's first frame.
+    playhead = engine.TakePlayhead();
+    ASSERT_NE(playhead, nullptr);
+    EXPECT_EQ(playhead->transport_frame, 2 * kBlockSize);
+    EXPECT_DOUBLE_EQ(playhead->sample_rate, kSampleRate);
+    ASSERT_EQ(playhead->tracks.size(), 1u);
+    EXPECT_EQ(playhead->tracks[0].track_index, 2);
+    EXPECT_EQ(playhead->tracks[0].slot_index, 4);
+    EXPECT_NEAR(playhead->tracks[0].position_sec, 2 * kBlockSize / kSampleRate, 1e-9);
+    EXPECT_DOUBLE_EQ(playhead->tracks[0].duration_sec, 1.0);
+    EXPECT_EQ(engine.TakePlayhead(), nullptr);
+}
+
+} // namespace
@@ -0,0 +1,264 @@
+#include "freeze.hpp"
+#include "realtime.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace hibiki {
+
+namespace {
+
+PlanarAudio AllocateRender(int64_t num_frames, const FreezeOptions& options, bool& spilled) {
+    size_t bytes = (size_t)num_frames * 2 * sizeof(float);
+    if (!options.spill_dir.empty() && bytes > options.spill_bytes) {
+        auto audio = PlanarAudio::MapTemporary(2, num_frames, options.spill_dir);
+        if (!audio.empty()) {
+            spilled |= audio.file_backed();
+            return audio;
+        }
+    }
+    return PlanarAudio(2, num_frames);
+}
+
+using Chain = std::vector<std::unique_ptr<Vst3Plugin>>;
+
+// Offline instances of the track's plugins, set up like a saved project
+// would restore them, so that the live chain keeps playing during the render.
+bool CopyChain(const Chain& live, double sample_rate, Chain& copies, std::string& error) {
+    for (const auto& p : live) {
+        auto copy = std::make_unique<Vst3Plugin>();
+        if (!copy->load(p->getPath(), p->getPluginIndex(), sample_rate)) {
+            error = "plugin " + p->getName() + " failed to load for the freeze";
+            return false;
+        }
+        for (int i = 0; i < p->getParameterCount(); ++i) {
+            VstParamInfo info;
+            if (p->getParameterInfo(i, info)) copy->setParameterValue(info.id, p->getParameterValue(info.id));
+        }
+        if (!copy->resume(true)) {
+            error = "a plugin refused offline processing";
+            return false;
+        }
+        copies.push_back(std::move(copy));
+    }
+    return true;
+}
+
+// Renders one clip through the chain the same way Track::RenderBlock does,
+// minus the mixer strip, which still applies live. Sidechain inputs are not
+// available offline.
+std::unique_ptr<Clip> RenderClip(const Chain& plugins, const Clip& clip, const FreezeOptions& options, bool& spilled) {
+    HIBIKI_TRACE_SCOPE("Freeze::RenderClip");
+    const double sample_rate = options.sample_rate;
+    const int64_t frames = clip.type == Clip::Type::AUDIO ? clip.audio.num_frames() : std::llround(clip.duration_sec * sample_rate);
+    const int64_t max_tail = (int64_t)(options.max_tail_sec * sample_rate);
+    int64_t tail = 0;
+    for (const auto& p : plugins) tail = std::max<int64_t>(tail, std::min<int64_t>(p->getTailSamples(), max_tail));
+    const int64_t total = frames + tail;
+
+    PlanarAudio render = AllocateRender(total, options, spilled);
+    HostProcessContext context{sample_rate, options.tempo, 4, 4, 0, 0.0};
+    std::vector<MidiNoteEvent> events;
+    int midi_idx = 0;
+    for (int64_t pos = 0; pos < total; pos += options.block_size) {
+        const int n = (int)std::min<int64_t>(options.block_size, total - pos);
+        float* out[] = {render.channel(0) + pos, render.channel(1) + pos};
+        context.continuousTimeSamples = pos;
+        context.projectTimeMusic = pos / sample_rate * (options.tempo / 60.0);
+
+        events.clear();
+        if (clip.type == Clip::Type::MIDI) {
+            midi_idx = GatherMidiBlock(clip, midi_idx, pos / sample_rate, sample_rate, n, events);
+        } else if (pos < frames) {
+            // Past the end the buffer stays silent for the tail, even for loops.
+            RenderAudioClip(clip, pos, out[0], out[1], (int)std::min<int64_t>(n, frames - pos));
+        }
+
+        for (size_t i = 0; i < plugins.size(); ++i) {
+            auto& p = plugins[i];
+            if (clip.type == Clip::Type::MIDI && i == 0 && p->isInstrument()) {
+                p->process(nullptr, out, n, context, events);
+            } else if (clip.type == Clip::Type::MIDI || !p->isInstrument()) {
+                p->process(out, out, n, context, {});
+            }
+        }
+    }
+
+    // A loop wraps its tail onto its start, as the next pass would have heard it.
+    if (clip.is_loop && tail > 0 && frames > 0) {
+        PlanarAudio loop = AllocateRender(frames, options, spilled);
+        for (int c = 0; c < 2; ++c) {
+            std::copy_n(render.channel(c), frames, loop.channel(c));
+            for (int64_t i = frames; i < total; ++i) loop.channel(c)[(i - frames) % frames] += render.channel(c)[i];
+        }
+        render = std::move(loop);
+    }
+
+    auto frozen = std::make_unique<Clip>();
+    frozen->type = Clip::Type::AUDIO;
+    frozen->sample_rate = sample_rate;
+    frozen->duration_sec = render.num_frames() / sample_rate;
+    frozen->is_loop = clip.is_loop;
+    frozen->path = clip.path;
+    frozen->audio = std::move(render);
+    // Spilled renders are left for the kernel to page in and out.
+    if (!frozen->audio.file_backed()) rt::Prefault(frozen->audio.data(), frozen->audio.byte_size());
+    return frozen;
+}
+
+// Claims the track for a freeze or unfreeze, from expected to claimed, and
+// counts the job in state.freeze_jobs until EndJob.
+Track* BeginJob(ProjectState& state, int track_index, Track::FreezeState expected, Track::FreezeState claimed,
+                FreezeResult& result) {
+    std::lock_guard<std::mutex> lock(state.tracks_mutex);
+    auto it = state.tracks.find(track_index);
+    if (it == state.tracks.end()) {
+        result.error = "no such track";
+        return nullptr;
+    }
+    Track* track = it->second.get();
+    std::lock_guard<std::mutex> track_lock(track->mutex);
+    auto current = track->freeze_state.load();
+    result.frozen = current == Track::FreezeState::kFrozen;
+    if (current != expected) {
+        result.error = current == Track::FreezeState::kBusy || current == Track::FreezeState::kRendering
+                           ? "track is busy"
+                       : result.frozen ? "track is frozen"
+                                       : "track is not frozen";
+        return nullptr;
+    }
+    track->freeze_state.store(claimed, std::memory_order_release);
+    track->Invalidate();
+    state.freeze_jobs++;
+    return track;
+}
+
+// Ends the job; the track may be destroyed from here on.
+void EndJob(ProjectState& state, Track& track, Track::FreezeState final_state) {
+    std::lock_guard<std::mutex> lock(state.tracks_mutex);
+    track.freeze_state.store(final_state, std::memory_order_release);
+    track.Invalidate();
+    state.freeze_jobs--;
+    state.freeze_jobs_cv.notify_all();
+}
+
+} // namespace
+
+FreezeResult FreezeTrack(ProjectState& state, int track_index, const FreezeOptions& options) {
+    FreezeResult result;
+    result.track_index = track_index;
+    {
+        std::lock_guard<std::mutex> lock(state.tracks_mutex);
+        auto it = state.tracks.find(track_index);
+        if (it != state.tracks.end() && it->second->is_return) {
+            result.error = "return tracks take live input and cannot be frozen";
+            return result;
+        }
+    }
+    Track* track = BeginJob(state, track_index, Track::FreezeState::kLive, Track::FreezeState::kRendering, result);
+    if (!track) return result;
+    // From here on the clips and plugins cannot change under us, while the
+    // audio thread keeps playing them.
+    auto start = StatsClock::now();
+    Chain copies;
+    if (!CopyChain(track->plugins, options.sample_rate, copies, result.error)) {
+        EndJob(state, *track, Track::FreezeState::kLive);
+        return result;
+    }
+
+    std::map<int, std::unique_ptr<Clip>> renders;
+    for (const auto& [slot, clip] : track->clips) {
+        renders[slot] = RenderClip(copies, *clip, options, result.spilled);
+        result.audio_sec += renders[slot]->duration_sec;
+    }
+    copies.clear();
+
+    // The renders take over at a block boundary; after it the audio thread
+    // leaves the live plugins alone.
+    track->frozen_clips = std::move(renders);
+    track->freeze_state.store(Track::FreezeState::kFrozen, std::memory_order_release);
+    track->Invalidate();
+    WaitForBlockBoundary(state);
+    // The governor's bypasses do not outlive the chain they relieved.
+    for (auto& p : track->plugins) {
+        p->suspend();
+        p->setBypassed(false);
+    }
+    EndJob(state, *track, Track::FreezeState::kFrozen);
+
+    result.render_sec = std::chrono::duration<double>(StatsClock::now() - start).count();
+    result.ok = true;
+    result.frozen = true;
+    return result;
+}
+
+FreezeResult UnfreezeTrack(ProjectState& state, int track_index) {
+    FreezeResult result;
+    result.track_index = track_index;
+    Track* track = BeginJob(state, track_index, Track::FreezeState::kFrozen, Track::FreezeState::kBusy, result);
+    if (!track) return result;
+    WaitForBlockBoundary(state);
+
+    result.ok = true;
+    for (auto& p : track->plugins) {
+        if (!p->resume(false)) {
+            result.ok = false;
+            result.error = "plugin " + p->getName() + " failed to resume";
+        }
+    }
+    track->frozen_clips.clear();
+    EndJob(state, *track, Track::FreezeState::kLive);
+    result.frozen = false;
+    return result;
+}
+
+FreezeWorker::FreezeWorker(ProjectState& state, const FreezeOptions& options, Callback done)
+    : state_(state), options_(options), done_(std::move(done)), thread_([this] { Run(); }) {}
+
+FreezeWorker::~FreezeWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        jobs_.clear();
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void FreezeWorker::Freeze(int track_index) {
+    Enqueue(track_index, true);
+}
+
+void FreezeWorker::Unfreeze(int track_index) {
+    Enqueue(track_index, false);
+}
+
+void FreezeWorker::Enqueue(int track_index, bool freeze) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.emplace_back(track_index, freeze);
+    }
+    cv_.notify_one();
+}
+
+void FreezeWorker::Run() {
+    trace::SetThreadName("freeze");
+    while (true) {
+        std::pair<int, bool> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return stop_ || !jobs_.empty(); });
+            if (stop_) return;
+            job = jobs_.front();
+            jobs_.pop_front();
+        }
+        FreezeOptions options = options_;
+        options.sample_rate = state_.sample_rate;
+        options.tempo = state_.bpm;
+        auto result = job.second ? FreezeTrack(state_, job.first, options) : UnfreezeTrack(state_, job.first);
+        if (done_) done_(result);
+    }
+}
+
+} // namespace hibiki
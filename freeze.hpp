@@ -0,0 +1,80 @@
+#pragma once
+
+#include "project.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace hibiki {
+
+struct FreezeOptions {
+    double sample_rate = 44100.0;
+    double tempo = 120.0;
+    int block_size = kMaxBlockSize;
+    // Plugin tails are rendered for up to this long: after a one-shot clip,
+    // or folded back into the start of a loop.
+    double max_tail_sec = 10.0;
+    // Renders larger than spill_bytes go to a temporary file in spill_dir
+    // (see PlanarAudio::MapTemporary). An empty spill_dir keeps all renders
+    // in memory.
+    size_t spill_bytes = 64 << 20;
+    std::string spill_dir;
+};
+
+struct FreezeResult {
+    int track_index = -1;
+    bool ok = false;
+    // Whether the track is frozen after the job.
+    bool frozen = false;
+    std::string error;
+    double audio_sec = 0.0;  // total length of the frozen renders
+    double render_sec = 0.0; // wall time spent rendering them
+    bool spilled = false;    // some renders live in a temporary file
+};
+
+// Renders every clip of the track through offline copies of its plugin chain,
+// as fast as they go, then plays the renders in place of the chain and
+// suspends the plugins. The copies take the plugins' parameter values, as a
+// saved project would. Blocks until done; the track keeps playing live
+// meanwhile. Return tracks cannot be frozen.
+FreezeResult FreezeTrack(ProjectState& state, int track_index, const FreezeOptions& options);
+
+// Resumes the plugins in real-time mode and drops the renders.
+FreezeResult UnfreezeTrack(ProjectState& state, int track_index);
+
+// Runs freeze and unfreeze jobs one at a time on a background thread and
+// reports each result through the callback, on that thread. Jobs take the
+// sample rate and tempo from the project state when they start.
+class FreezeWorker {
+public:
+    using Callback = std::function<void(const FreezeResult&)>;
+
+    FreezeWorker(ProjectState& state, const FreezeOptions& options, Callback done);
+    // Finishes the running job and drops the queued ones.
+    ~FreezeWorker();
+
+    FreezeWorker(const FreezeWorker&) = delete;
+    FreezeWorker& operator=(const FreezeWorker&) = delete;
+
+    void Freeze(int track_index);
+    void Unfreeze(int track_index);
+
+private:
+    void Enqueue(int track_index, bool freeze);
+    void Run();
+
+    ProjectState& state_;
+    FreezeOptions options_;
+    Callback done_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::pair<int, bool>> jobs_; // track index, freeze or unfreeze
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace hibiki
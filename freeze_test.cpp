@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include "engine.hpp"
+#include "freeze.hpp"
+#include "test_utils.hpp"
+
+#include <filesystem>
+#include <future>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 256;
+constexpr int kGain = 1; // class index in the hibiki_test_plugins module
+
+std::string BundlePath() {
+    std::string so = hibiki::find_test_file("hibiki_test_plugins.vst3/Contents/x86_64-linux/hibiki_test_plugins.so");
+    return so.substr(0, so.find(".vst3") + 5);
+}
+
+// Half a second of a ramp, so that renders can be compared sample by sample.
+void AddRampClip(hibiki::Track* track, bool is_loop) {
+    auto clip = std::make_unique<hibiki::Clip>();
+    clip->type = hibiki::Clip::Type::AUDIO;
+    clip->sample_rate = kSampleRate;
+    const int64_t frames = (int64_t)kSampleRate / 2;
+    clip->audio = hibiki::PlanarAudio(2, frames);
+    for (int c = 0; c < 2; ++c) {
+        for (int64_t i = 0; i < frames; ++i) clip->audio.channel(c)[i] = (float)i / frames;
+    }
+    clip->duration_sec = 0.5;
+    clip->is_loop = is_loop;
+    track->InsertClip(0, std::move(clip));
+}
+
+hibiki::FreezeOptions Options() {
+    hibiki::FreezeOptions options;
+    options.sample_rate = kSampleRate;
+    options.block_size = kBlockSize;
+    return options;
+}
+
+TEST(FreezeTest, FrozenTrackPlaysItsRender) {
+    hibiki::ProjectState state;
+    auto* track = hibiki::GetOrCreateTrack(state, 0);
+    AddRampClip(track, true);
+
+    auto result = hibiki::FreezeTrack(state, 0, Options());
+    ASSERT_TRUE(result.ok) << result.error;
+    EXPECT_TRUE(result.frozen);
+    EXPECT_DOUBLE_EQ(result.audio_sec, 0.5);
+    EXPECT_EQ(track->freeze_state.load(), hibiki::Track::FreezeState::kFrozen);
+    ASSERT_EQ(track->frozen_clips.size(), 1u);
+
+    // Without plugins the render is the clip itself.
+    track->PlayClip(0);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    engine.Process(l.data(), r.data());
+    const float* ramp = track->clips[0]->audio.channel(0) + kBlockSize;
+    for (int i = 0; i < kBlockSize; i += 37) EXPECT_FLOAT_EQ(l[i], ramp[i]);
+
+    // Frozen tracks are locked.
+    EXPECT_FALSE(track->DeleteClip(0));
+    EXPECT_FALSE(hibiki::FreezeTrack(state, 0, Options()).ok);
+
+    result = hibiki::UnfreezeTrack(state, 0);
+    EXPECT_TRUE(result.ok) << result.error;
+    EXPECT_FALSE(result.frozen);
+    EXPECT_TRUE(track->frozen_clips.empty());
+    EXPECT_TRUE(track->DeleteClip(0));
+}
+
+TEST(FreezeTest, TrackPlaysLiveWhileItsFreezeRenders) {
+    hibiki::ProjectState state;
+    auto* track = hibiki::GetOrCreateTrack(state, 0);
+    AddRampClip(track, true);
+    track->PlayClip(0);
+    // As FreezeTrack leaves it until the renders are swapped in.
+    track->freeze_state = hibiki::Track::FreezeState::kRendering;
+
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    engine.Process(l.data(), r.data());
+    const float* ramp = track->clips[0]->audio.channel(0) + kBlockSize;
+    for (int i = 0; i < kBlockSize; i += 37) EXPECT_FLOAT_EQ(l[i], ramp[i]);
+
+    // It is locked all the same.
+    EXPECT_FALSE(track->DeleteClip(0));
+    EXPECT_FALSE(hibiki::FreezeTrack(state, 0, Options()).ok);
+}
+
+TEST(FreezeTest, RefusesReturnAndUnknownTracks) {
+    hibiki::ProjectState state;
+    hibiki::SetReturnTrack(state, 1, true);
+    EXPECT_FALSE(hibiki::FreezeTrack(state, 1, Options()).ok);
+    EXPECT_FALSE(hibiki::FreezeTrack(state, 7, Options()).ok);
+    EXPECT_FALSE(hibiki::UnfreezeTrack(state, 1).ok);
+}
+
+TEST(FreezeTest, SpillsLargeRendersToDisk) {
+    hibiki::ProjectState state;
+    AddRampClip(hibiki::GetOrCreateTrack(state, 0), false);
+    auto options = Options();
+    options.spill_dir = std::filesystem::temp_directory_path().string();
+    options.spill_bytes = 0;
+
+    auto result = hibiki::FreezeTrack(state, 0, options);
+    ASSERT_TRUE(result.ok) << result.error;
+    EXPECT_TRUE(result.spilled);
+    const auto& frozen = state.tracks[0]->frozen_clips[0]->audio;
+    EXPECT_TRUE(frozen.file_backed());
+    EXPECT_FLOAT_EQ(frozen.channel(1)[1000], state.tracks[0]->clips[0]->audio.channel(1)[1000]);
+}
+
+TEST(FreezeTest, WorkerReportsEachJob) {
+    hibiki::ProjectState state;
+    state.sample_rate = kSampleRate;
+    AddRampClip(hibiki::GetOrCreateTrack(state, 0), true);
+
+    std::promise<hibiki::FreezeResult> frozen, thawed;
+    int calls = 0;
+    hibiki::FreezeWorker worker(state, Options(), [&](const hibiki::FreezeResult& result) {
+        (calls++ == 0 ? frozen : thawed).set_value(result);
+    });
+    worker.Freeze(0);
+    worker.Unfreeze(0);
+    EXPECT_TRUE(frozen.get_future().get().frozen);
+    EXPECT_FALSE(thawed.get_future().get().frozen);
+}
+
+TEST(FreezeTest, RendersThroughPluginChainOffline) {
+    hibiki::ProjectState state;
+    auto* track = hibiki::GetOrCreateTrack(state, 0);
+    AddRampClip(track, false);
+    ASSERT_EQ(track->LoadPlugin(BundlePath(), kGain, kSampleRate), 0);
+    track->plugins[0]->setParameterValue(0, 0.25); // gain 0.5
+
+    auto result = hibiki::FreezeTrack(state, 0, Options());
+    ASSERT_TRUE(result.ok) << result.error;
+    EXPECT_TRUE(track->plugins[0]->isSuspended());
+    const float* in = track->clips[0]->audio.channel(0);
+    const float* out = track->frozen_clips[0]->audio.channel(0);
+    for (int i = 1000; i < 20000; i += 997) EXPECT_NEAR(out[i], in[i] * 0.5f, 1e-4f);
+
+    ASSERT_TRUE(hibiki::UnfreezeTrack(state, 0).ok);
+    EXPECT_FALSE(track->plugins[0]->isSuspended());
+}
+
+} // namespace
@@ -1,5 +1,7 @@
 #include "ipc.hpp"
+#include "trace.hpp"
 #include "vst3_host.hpp"
+#include <chrono>
 #include <iostream>
 #include <mutex>
 #include "hibiki_request_generated.h"
@@ -7,7 +9,25 @@
 
 namespace hibiki {
 
+namespace {
+
+// Set by RequestScope on the thread handling a request.
+thread_local uint32_t current_sequence = 0;
+thread_local std::vector<AckResult>* current_acks = nullptr;
+
+// Wraps a response in a Notification with the sequence id of the request
+// being handled, if any, and sends it.
+template <typename T>
+void sendResponse(flatbuffers::FlatBufferBuilder& builder, hibiki::ipc::Response type, flatbuffers::Offset<T> response) {
+    auto nf_off = hibiki::ipc::CreateNotification(builder, type, response.Union(), current_sequence);
+    builder.Finish(nf_off);
+    sendNotification(builder.GetBufferPointer(), builder.GetSize());
+}
+
+} // namespace
+
 void sendNotification(const uint8_t* buf, size_t size) {
+    HIBIKI_TRACE_SCOPE("sendNotification");
     static std::mutex cout_mutex;
     std::lock_guard<std::mutex> lock(cout_mutex);
     uint32_t msg_size = static_cast<uint32_t>(size);
@@ -16,13 +36,26 @@ void sendNotification(const uint8_t* buf, size_t size) {
     std::cout.flush();
 }
 
+RequestScope::RequestScope(uint32_t sequence, std::vector<AckResult>* acks)
+    : previous_sequence_(current_sequence), previous_acks_(current_acks) {
+    current_sequence = sequence;
+    current_acks = acks;
+}
+
+RequestScope::~RequestScope() {
+    current_sequence = previous_sequence_;
+    current_acks = previous_acks_;
+}
+
 void sendAck(const char* cmd_type, bool success) {
+    if (current_acks) {
+        current_acks->push_back({cmd_type, success, current_sequence});
+        return;
+    }
     flatbuffers::FlatBufferBuilder builder(128);
     auto cmd_type_off = builder.CreateString(cmd_type);
     auto ack_off = hibiki::ipc::CreateAcknowledge(builder, cmd_type_off, success);
-    auto nf_off = hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_Acknowledge, ack_off.Union());
-    builder.Finish(nf_off);
-    sendNotification(builder.GetBufferPointer(), builder.GetSize());
+    sendResponse(builder, hibiki::ipc::Response_Acknowledge, ack_off);
 }
 
 void sendParamList(int track_idx, int plugin_idx, const std::string& plugin_name, bool is_instrument, const std::vector<VstParamInfo>& params) {
@@ -35,18 +68,14 @@ void sendParamList(int track_idx, int plugin_idx, const std::string& plugin_name
     auto params_vec = builder.CreateVector(param_offsets);
     auto name_off = builder.CreateString(plugin_name.c_str());
     auto list_off = hibiki::ipc::CreateParamList(builder, track_idx, plugin_idx, name_off, is_instrument, params_vec);
-    auto nf_off = hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_ParamList, list_off.Union());
-    builder.Finish(nf_off);
-    sendNotification(builder.GetBufferPointer(), builder.GetSize());
+    sendResponse(builder, hibiki::ipc::Response_ParamList, list_off);
 }
 
 void sendLog(const std::string& msg) {
     flatbuffers::FlatBufferBuilder builder(512);
     auto msg_off = builder.CreateString(msg.c_str());
     auto log_off = hibiki::ipc::CreateLog(builder, msg_off);
-    auto nf_off = hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_Log, log_off.Union());
-    builder.Finish(nf_off);
-    sendNotification(builder.GetBufferPointer(), builder.GetSize());
+    sendResponse(builder, hibiki::ipc::Response_Log, log_off);
 }
 
 void sendClipInfo(int track_idx, int slot_index, const std::string& name, const std::string& path) {
@@ -54,17 +83,133 @@ void sendClipInfo(int track_idx, int slot_index, const std::string& name, const
     auto name_off = builder.CreateString(name.c_str());
     auto path_off = builder.CreateString(path.c_str());
     auto clip_off = hibiki::ipc::CreateClipInfo(builder, track_idx, slot_index, name_off, path_off);
-    auto nf_off = hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_ClipInfo, clip_off.Union());
-    builder.Finish(nf_off);
-    sendNotification(builder.GetBufferPointer(), builder.GetSize());
+    sendResponse(builder, hibiki::ipc::Response_ClipInfo, clip_off);
 }
 
 void sendClearProject() {
     flatbuffers::FlatBufferBuilder builder(128);
     auto clear_off = hibiki::ipc::CreateClearProject(builder);
-    auto nf_off = hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_ClearProject, clear_off.Union());
-    builder.Finish(nf_off);
-    sendNotification(builder.GetBufferPointer(), builder.GetSize());
+    sendResponse(builder, hibiki::ipc::Response_ClearProject, clear_off);
+}
+
+void sendEngineStats(const EngineStatsReport& report) {
+    flatbuffers::FlatBufferBuilder builder(1024);
+    std::vector<flatbuffers::Offset<hibiki::ipc::TrackLoad>> track_offsets;
+    for (const auto& track : report.tracks) {
+        std::vector<flatbuffers::Offset<hibiki::ipc::PluginLoad>> plugin_offsets;
+        for (const auto& plugin : track.plugins) {
+            auto name_off = builder.CreateString(plugin.name.c_str());
+            plugin_offsets.push_back(hibiki::ipc::CreatePluginLoad(builder, plugin.plugin_index, name_off,
+                                                                   plugin.time.avg_us, plugin.time.max_us));
+        }
+        auto plugins_vec = builder.CreateVector(plugin_offsets);
+        track_offsets.push_back(hibiki::ipc::CreateTrackLoad(builder, track.track_index, track.time.avg_us,
+                                                             track.time.max_us, plugins_vec));
+    }
+    auto tracks_vec = builder.CreateVector(track_offsets);
+    auto limits_vec = builder.CreateVector(JitterHistogram::kBucketLimitsUs.data(), JitterHistogram::kBucketLimitsUs.size());
+    auto jitter_vec = builder.CreateVector(report.jitter.data(), report.jitter.size());
+    auto stats_off = hibiki::ipc::CreateEngineStats(builder, report.block.count, report.deadline_us,
+                                                    report.block.avg_us, report.block.max_us,
+                                                    report.overruns, report.xruns, limits_vec, jitter_vec, tracks_vec,
+                                                    report.lookahead_misses);
+    sendResponse(builder, hibiki::ipc::Response_EngineStats, stats_off);
+}
+
+void sendPlayhead(const PlayheadReport& report) {
+    flatbuffers::FlatBufferBuilder builder(256);
+    std::vector<flatbuffers::Offset<hibiki::ipc::TrackPosition>> track_offsets;
+    for (const auto& track : report.tracks) {
+        track_offsets.push_back(hibiki::ipc::CreateTrackPosition(builder, track.track_index, track.slot_index,
+                                                                 track.position_sec, track.duration_sec, track.is_loop));
+    }
+    auto tracks_vec = builder.CreateVector(track_offsets);
+    const int64_t dac_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(report.dac_time.time_since_epoch()).count();
+    auto playhead_off = hibiki::ipc::CreatePlayhead(builder, report.transport_frame, (float)report.bpm,
+                                                    (int)report.sample_rate, dac_time_ns, tracks_vec);
+    sendResponse(builder, hibiki::ipc::Response_Playhead, playhead_off);
+}
+
+void sendMeters(const MeterReport& report) {
+    flatbuffers::FlatBufferBuilder builder(64 + report.sources.size() * sizeof(hibiki::ipc::TrackMeter));
+    std::vector<hibiki::ipc::TrackMeter> meters;
+    meters.reserve(report.sources.size());
+    for (const auto& source : report.sources) {
+        const auto& r = source.reading;
+        meters.emplace_back(source.track_index, r.rms_db, r.peak_db, r.true_peak_db, r.true_peak_max_db, r.momentary_lufs,
+                            r.short_term_lufs, r.integrated_lufs);
+    }
+    auto meters_vec = builder.CreateVectorOfStructs(meters);
+    auto meters_off = hibiki::ipc::CreateMeters(builder, meters_vec, report.dropped_blocks);
+    sendResponse(builder, hibiki::ipc::Response_Meters, meters_off);
+}
+
+void sendAnalysis(const AnalysisFrame& frame) {
+    flatbuffers::FlatBufferBuilder builder(64 + frame.spectrum.size() + frame.scope.size());
+    auto spectrum_vec = builder.CreateVector(frame.spectrum);
+    auto scope_vec = builder.CreateVector(frame.scope);
+    auto analysis_off = hibiki::ipc::CreateAnalysis(builder, frame.track_index, (int)frame.sample_rate, frame.fft_size,
+                                                    spectrum_vec, scope_vec);
+    sendResponse(builder, hibiki::ipc::Response_Analysis, analysis_off);
+}
+
+void sendLevelDeltas(const std::vector<LevelDeltaEncoder::Delta>& deltas, bool full) {
+    flatbuffers::FlatBufferBuilder builder(64 + deltas.size() * sizeof(hibiki::ipc::LevelDelta));
+    std::vector<hibiki::ipc::LevelDelta> levels;
+    levels.reserve(deltas.size());
+    for (const auto& delta : deltas) levels.emplace_back((int16_t)delta.track_index, delta.peak_l, delta.peak_r);
+    auto levels_vec = builder.CreateVectorOfStructs(levels);
+    auto deltas_off = hibiki::ipc::CreateLevelDeltas(builder, levels_vec, full);
+    sendResponse(builder, hibiki::ipc::Response_LevelDeltas, deltas_off);
+}
+
+void sendBatchResult(const std::vector<AckResult>& results) {
+    flatbuffers::FlatBufferBuilder builder(64 + results.size() * 48);
+    std::vector<flatbuffers::Offset<hibiki::ipc::BatchItemResult>> result_offsets;
+    for (const auto& result : results) {
+        auto cmd_type_off = builder.CreateString(result.command_type);
+        result_offsets.push_back(hibiki::ipc::CreateBatchItemResult(builder, result.sequence, cmd_type_off, result.success));
+    }
+    auto results_vec = builder.CreateVector(result_offsets);
+    auto batch_off = hibiki::ipc::CreateBatchResult(builder, results_vec);
+    sendResponse(builder, hibiki::ipc::Response_BatchResult, batch_off);
+}
+
+void sendRealtimeStatus(const rt::Status& status) {
+    flatbuffers::FlatBufferBuilder builder(256);
+    auto step_off = builder.CreateString(status.step);
+    auto detail_off = builder.CreateString(status.detail);
+    auto status_off = hibiki::ipc::CreateRealtimeStatus(builder, step_off, status.ok, detail_off);
+    sendResponse(builder, hibiki::ipc::Response_RealtimeStatus, status_off);
+}
+
+void sendLatencyChange(int previous_block_size, int block_size, float latency_ms, const std::string& reason) {
+    flatbuffers::FlatBufferBuilder builder(256);
+    auto reason_off = builder.CreateString(reason);
+    auto change_off = hibiki::ipc::CreateLatencyChange(builder, previous_block_size, block_size, latency_ms, reason_off);
+    sendResponse(builder, hibiki::ipc::Response_LatencyChange, change_off);
+}
+
+void sendIdleState(bool idle, float wake_latency_us) {
+    flatbuffers::FlatBufferBuilder builder(64);
+    auto idle_off = hibiki::ipc::CreateIdleState(builder, idle, wake_latency_us);
+    sendResponse(builder, hibiki::ipc::Response_IdleState, idle_off);
+}
+
+void sendGovernorAction(const GovernorAction& action) {
+    flatbuffers::FlatBufferBuilder builder(256);
+    auto action_off = builder.CreateString(GovernorActionName(action.kind));
+    auto reason_off = builder.CreateString(action.reason);
+    auto governor_off = hibiki::ipc::CreateGovernorAction(builder, action.track_index, action.plugin_index, action_off, reason_off);
+    sendResponse(builder, hibiki::ipc::Response_GovernorAction, governor_off);
+}
+
+void sendTrackFreeze(int track_index, bool ok, bool frozen, float audio_sec, float render_sec, bool spilled,
+                     const std::string& error) {
+    flatbuffers::FlatBufferBuilder builder(256);
+    auto error_off = builder.CreateString(error);
+    auto freeze_off = hibiki::ipc::CreateTrackFreeze(builder, track_index, ok, frozen, audio_sec, render_sec, spilled, error_off);
+    sendResponse(builder, hibiki::ipc::Response_TrackFreeze, freeze_off);
 }
 
 } // namespace hibiki
@@ -5,15 +5,55 @@
 #include <cstdint>
 #include <cstddef>
 
+#include "cpu_governor.hpp"
+#include "engine_stats.hpp"
+#include "meter.hpp"
+#include "realtime.hpp"
+#include "telemetry.hpp"
 #include "vst3_host.hpp"
 
 namespace hibiki {
 
+// The result of one command of a batch.
+struct AckResult {
+    std::string command_type;
+    bool success;
+    uint32_t sequence;
+};
+
+// While alive, the notifications this thread sends carry the sequence id of
+// the request it is handling. With acks set, sendAck adds to it instead of
+// sending, for a batch's BatchResult.
+class RequestScope {
+public:
+    explicit RequestScope(uint32_t sequence, std::vector<AckResult>* acks = nullptr);
+    ~RequestScope();
+
+    RequestScope(const RequestScope&) = delete;
+    RequestScope& operator=(const RequestScope&) = delete;
+
+private:
+    uint32_t previous_sequence_;
+    std::vector<AckResult>* previous_acks_;
+};
+
 void sendNotification(const uint8_t* buf, size_t size);
 void sendAck(const char* cmd_type, bool success);
+void sendBatchResult(const std::vector<AckResult>& results);
 void sendParamList(int track_idx, int plugin_idx, const std::string& plugin_name, bool is_instrument, const std::vector<VstParamInfo>& params);
 void sendLog(const std::string& msg);
 void sendClipInfo(int track_idx, int slot_index, const std::string& name, const std::string& path);
 void sendClearProject();
+void sendEngineStats(const EngineStatsReport& report);
+void sendPlayhead(const PlayheadReport& report);
+void sendMeters(const MeterReport& report);
+void sendAnalysis(const AnalysisFrame& frame);
+void sendLevelDeltas(const std::vector<LevelDeltaEncoder::Delta>& deltas, bool full);
+void sendRealtimeStatus(const rt::Status& status);
+void sendLatencyChange(int previous_block_size, int block_size, float latency_ms, const std::string& reason);
+void sendIdleState(bool idle, float wake_latency_us);
+void sendGovernorAction(const GovernorAction& action);
+void sendTrackFreeze(int track_index, bool ok, bool frozen, float audio_sec, float render_sec, bool spilled,
+                     const std::string& error);
 
 } // namespace hibiki
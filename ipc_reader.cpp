@@ -0,0 +1,102 @@
+#include "ipc_reader.hpp"
+#include "project.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace hibiki {
+
+MessageReader::MessageReader(std::istream& in) : queue_(std::make_shared<Queue>()) {
+    std::thread(Run, std::ref(in), queue_).detach();
+}
+
+void MessageReader::Run(std::istream& in, std::shared_ptr<Queue> queue) {
+    while (true) {
+        uint32_t msg_size = 0;
+        in.read(reinterpret_cast<char*>(&msg_size), sizeof(msg_size));
+        if (in.eof()) break;
+        if (in.fail()) {
+            std::cerr << "BACKEND ERROR: Failed to read message size from stdin" << std::endl;
+            break;
+        }
+        if (msg_size > kMaxMessageSize) {
+            std::cerr << "BACKEND ERROR: Message size too large: " << msg_size << std::endl;
+            break;
+        }
+        std::vector<uint8_t> message(msg_size);
+        in.read(reinterpret_cast<char*>(message.data()), msg_size);
+        if (in.fail()) {
+            std::cerr << "BACKEND ERROR: Failed to read message payload from stdin" << std::endl;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->messages.push_back(std::move(message));
+        }
+        queue->cv.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->closed = true;
+    }
+    queue->cv.notify_one();
+}
+
+bool MessageReader::Take(std::vector<std::vector<uint8_t>>& messages) {
+    messages.clear();
+    std::unique_lock<std::mutex> lock(queue_->mutex);
+    queue_->cv.wait(lock, [&] { return !queue_->messages.empty() || queue_->closed; });
+    if (queue_->messages.empty()) return false;
+    messages.assign(std::make_move_iterator(queue_->messages.begin()), std::make_move_iterator(queue_->messages.end()));
+    queue_->messages.clear();
+    return true;
+}
+
+size_t ParamCoalescer::KeyHash::operator()(const Key& key) const {
+    size_t h = std::hash<int>()(key.track_index);
+    h = h * 31 + std::hash<int>()(key.plugin_index);
+    return h * 31 + std::hash<uint32_t>()(key.param_id);
+}
+
+void ParamCoalescer::Add(const ParamUpdate& update) {
+    auto [it, inserted] = slots_.try_emplace({update.track_index, update.plugin_index, update.param_id}, updates_.size());
+    if (inserted) {
+        updates_.push_back(update);
+    } else {
+        updates_[it->second].value = update.value;
+    }
+}
+
+int ParamCoalescer::Apply(ProjectState& state) {
+    if (updates_.empty()) return 0;
+    HIBIKI_TRACE_SCOPE("ApplyParams");
+    int applied = 0;
+    {
+        std::lock_guard<std::mutex> lock(state.tracks_mutex);
+        Track* track = nullptr;
+        int track_index = 0;
+        for (const auto& update : updates_) {
+            // Updates mostly come in runs on one track.
+            if (!track || update.track_index != track_index) {
+                auto it = state.tracks.find(update.track_index);
+                track = it != state.tracks.end() ? it->second.get() : nullptr;
+                track_index = update.track_index;
+            }
+            if (!track || update.plugin_index < 0 || update.plugin_index >= (int)track->plugins.size()) continue;
+            track->plugins[update.plugin_index]->setParameterValue(update.param_id, update.value);
+            if (touched_.empty() || touched_.back() != track) touched_.push_back(track);
+            ++applied;
+        }
+        std::sort(touched_.begin(), touched_.end());
+        touched_.erase(std::unique(touched_.begin(), touched_.end()), touched_.end());
+        for (Track* t : touched_) t->Invalidate();
+    }
+    updates_.clear();
+    slots_.clear();
+    touched_.clear();
+    if (applied > 0) WakeAudio(state);
+    return applied;
+}
+
+} // namespace hibiki
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace hibiki {
+
+struct ProjectState;
+class Track;
+
+// Reads the GUI's length-prefixed messages on a thread of its own, so that
+// the IPC loop can take everything that arrived while it was busy at once.
+class MessageReader {
+public:
+    static constexpr uint32_t kMaxMessageSize = 1024 * 1024;
+
+    // The stream must outlive the reading thread, which ends with the
+    // stream. The destructor does not wait for it: a read from a pipe
+    // cannot be interrupted.
+    explicit MessageReader(std::istream& in);
+
+    MessageReader(const MessageReader&) = delete;
+    MessageReader& operator=(const MessageReader&) = delete;
+
+    // Waits for a message, then replaces messages with all that are queued,
+    // oldest first. False once the stream has ended and all were taken.
+    bool Take(std::vector<std::vector<uint8_t>>& messages);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::vector<uint8_t>> messages;
+        bool closed = false;
+    };
+    static void Run(std::istream& in, std::shared_ptr<Queue> queue);
+
+    std::shared_ptr<Queue> queue_;
+};
+
+// A SetParamValue from the GUI.
+struct ParamUpdate {
+    int track_index;
+    int plugin_index;
+    uint32_t param_id;
+    float value;
+};
+
+// Collapses the parameter updates taken from MessageReader together to the
+// latest value of each (track, plugin, parameter), so that a knob dragged
+// faster than the IPC loop turns around costs one update per turn.
+class ParamCoalescer {
+public:
+    void Add(const ParamUpdate& update);
+    // Distinct parameters waiting.
+    size_t size() const { return updates_.size(); }
+    bool empty() const { return updates_.empty(); }
+    // Sets the waiting values in the order their parameters first came, under
+    // one tracks_mutex lock, invalidates each track touched once and wakes
+    // the audio thread. Updates of missing tracks or plugins are dropped.
+    // Returns how many were set.
+    int Apply(ProjectState& state);
+
+private:
+    struct Key {
+        int track_index;
+        int plugin_index;
+        uint32_t param_id;
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    std::vector<ParamUpdate> updates_;
+    std::unordered_map<Key, size_t, KeyHash> slots_;
+    std::vector<Track*> touched_;
+};
+
+} // namespace hibiki
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include "ipc_reader.hpp"
+#include "project.hpp"
+#include "test_utils.hpp"
+
+#include <string>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kGain = 1; // class index in the hibiki_test_plugins module
+constexpr int kTurnsPerSecond = 100; // IPC loop turns while the GUI floods it
+constexpr int kKnobs = 4;            // parameters being dragged at once
+
+bool LoadGain(benchmark::State& state, hibiki::ProjectState& project) {
+    std::string so = hibiki::find_test_file("hibiki_test_plugins.vst3/Contents/x86_64-linux/hibiki_test_plugins.so");
+    if (hibiki::GetOrCreateTrack(project, 0)->LoadPlugin(so.substr(0, so.find(".vst3") + 5), kGain, kSampleRate) != 0) {
+        state.SkipWithError("cannot load hibiki_test_plugins");
+        return false;
+    }
+    return true;
+}
+
+// Time per iteration is one IPC loop turn, in which range(0) / 100 updates
+// per second arrive. Coalesced, the plugin calls, lock and wake stay the
+// same however many arrive; only the adding grows.
+void BM_ParamUpdatesCoalesced(benchmark::State& state) {
+    hibiki::ProjectState project;
+    if (!LoadGain(state, project)) return;
+    hibiki::ParamCoalescer params;
+    const int per_turn = (int)state.range(0) / kTurnsPerSecond;
+    for (auto _ : state) {
+        for (int i = 0; i < per_turn; ++i) params.Add({0, 0, (uint32_t)(i % kKnobs), (float)i / per_turn});
+        benchmark::DoNotOptimize(params.Apply(project));
+    }
+    state.SetItemsProcessed(state.iterations() * per_turn);
+}
+
+// The same turn with each update applied on its own, as it was handled
+// before the reader coalesced them.
+void BM_ParamUpdatesOneByOne(benchmark::State& state) {
+    hibiki::ProjectState project;
+    if (!LoadGain(state, project)) return;
+    hibiki::ParamCoalescer params;
+    const int per_turn = (int)state.range(0) / kTurnsPerSecond;
+    for (auto _ : state) {
+        for (int i = 0; i < per_turn; ++i) {
+            params.Add({0, 0, (uint32_t)(i % kKnobs), (float)i / per_turn});
+            benchmark::DoNotOptimize(params.Apply(project));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * per_turn);
+}
+
+BENCHMARK(BM_ParamUpdatesCoalesced)->Arg(1000)->Arg(10000)->Arg(100000)->ArgName("per_sec");
+BENCHMARK(BM_ParamUpdatesOneByOne)->Arg(1000)->Arg(10000)->Arg(100000)->ArgName("per_sec");
+
+} // namespace
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "ipc_reader.hpp"
+#include "project.hpp"
+#include "test_utils.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kGain = 1; // class index in the hibiki_test_plugins module
+
+std::string BundlePath() {
+    std::string so = hibiki::find_test_file("hibiki_test_plugins.vst3/Contents/x86_64-linux/hibiki_test_plugins.so");
+    return so.substr(0, so.find(".vst3") + 5);
+}
+
+void AppendMessage(std::string& stream, const std::string& payload) {
+    uint32_t size = (uint32_t)payload.size();
+    stream.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    stream += payload;
+}
+
+// Everything the reader delivers until the stream ends.
+std::vector<std::string> TakeAll(hibiki::MessageReader& reader) {
+    std::vector<std::string> all;
+    std::vector<std::vector<uint8_t>> messages;
+    while (reader.Take(messages)) {
+        for (const auto& message : messages) all.emplace_back(message.begin(), message.end());
+    }
+    return all;
+}
+
+TEST(IpcReaderTest, ReaderDeliversMessagesInOrder) {
+    std::string data;
+    AppendMessage(data, "first");
+    AppendMessage(data, "");
+    AppendMessage(data, "third");
+    std::istringstream in(data);
+    hibiki::MessageReader reader(in);
+    EXPECT_EQ(TakeAll(reader), (std::vector<std::string>{"first", "", "third"}));
+}
+
+TEST(IpcReaderTest, ReaderStopsAtBadFrames) {
+    std::string data;
+    AppendMessage(data, "kept");
+    uint32_t too_large = hibiki::MessageReader::kMaxMessageSize + 1;
+    data.append(reinterpret_cast<const char*>(&too_large), sizeof(too_large));
+    AppendMessage(data, "never read");
+    std::istringstream in(data);
+    hibiki::MessageReader reader(in);
+    EXPECT_EQ(TakeAll(reader), (std::vector<std::string>{"kept"}));
+
+    // A truncated payload ends the stream too.
+    std::string truncated;
+    AppendMessage(truncated, "whole");
+    AppendMessage(truncated, "cut short");
+    truncated.resize(truncated.size() - 3);
+    std::istringstream in2(truncated);
+    hibiki::MessageReader reader2(in2);
+    EXPECT_EQ(TakeAll(reader2), (std::vector<std::string>{"whole"}));
+}
+
+TEST(IpcReaderTest, CoalescerSetsLatestValueOnce) {
+    hibiki::ProjectState state;
+    auto* track = hibiki::GetOrCreateTrack(state, 0);
+    ASSERT_EQ(track->LoadPlugin(BundlePath(), kGain, kSampleRate), 0);
+    const uint32_t generation = track->render_generation;
+    const uint64_t wakes = state.wake_generation;
+
+    hibiki::ParamCoalescer params;
+    params.Add({0, 0, 0, 0.1f});
+    params.Add({0, 5, 0, 0.2f}); // no such plugin
+    params.Add({9, 0, 0, 0.3f}); // no such track
+    params.Add({0, 0, 0, 0.25f});
+    params.Add({0, 0, 0, 0.75f});
+    EXPECT_EQ(params.size(), 3u);
+
+    EXPECT_EQ(params.Apply(state), 1);
+    EXPECT_TRUE(params.empty());
+    EXPECT_NEAR(track->plugins[0]->getParameterValue(0), 0.75, 1e-6);
+    EXPECT_EQ(track->render_generation, generation + 1);
+    EXPECT_EQ(state.wake_generation, wakes + 1);
+
+    // Nothing waiting, nothing done.
+    EXPECT_EQ(params.Apply(state), 0);
+    EXPECT_EQ(state.wake_generation, wakes + 1);
+}
+
+} // namespace
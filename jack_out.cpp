@@ -0,0 +1,231 @@
+#include "jack_out.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <jack/jack.h>
+#include <jack/transport.h>
+
+namespace {
+hibiki::AudioDeviceRegistration registration("jack", 200, [](const hibiki::AudioDeviceOptions& options) {
+    return std::unique_ptr<hibiki::AudioDevice>(new JackPlayback(options));
+});
+
+constexpr double kTicksPerBeat = 1920.0;
+constexpr int kBeatsPerBar = 4;
+} // namespace
+
+struct JackPlayback::Impl {
+    jack_client_t* client = nullptr;
+    int channels = 2;
+    int block_size = 512;
+    bool transport_sync = false;
+    std::vector<jack_port_t*> outputs;
+    std::vector<jack_port_t*> stems; // Left and right per track.
+
+    // Only touched from the process callback while running.
+    const RenderCallback* render = nullptr;
+    std::vector<float> interleaved;
+    std::vector<float*> output_buffers;
+    std::vector<float*> stem_buffers;
+    int offset = 0;
+    bool rolling = false;
+
+    std::atomic<bool> running{false};
+    std::atomic<uint32_t> xruns{0};
+    std::atomic<double> bpm{120.0};
+
+    static int Process(jack_nframes_t nframes, void* arg);
+    static int Xrun(void* arg);
+    static void Shutdown(void* arg);
+    static void Timebase(jack_transport_state_t state, jack_nframes_t nframes, jack_position_t* pos, int new_pos, void* arg);
+};
+
+int JackPlayback::Impl::Process(jack_nframes_t nframes, void* arg) {
+    auto* impl = static_cast<Impl*>(arg);
+    for (size_t i = 0; i < impl->outputs.size(); ++i) {
+        impl->output_buffers[i] = static_cast<float*>(jack_port_get_buffer(impl->outputs[i], nframes));
+        std::fill_n(impl->output_buffers[i], nframes, 0.0f);
+    }
+    for (size_t i = 0; i < impl->stems.size(); ++i) {
+        impl->stem_buffers[i] = static_cast<float*>(jack_port_get_buffer(impl->stems[i], nframes));
+        std::fill_n(impl->stem_buffers[i], nframes, 0.0f);
+    }
+    if (!impl->running.load(std::memory_order_acquire)) return 0;
+
+    // The engine's block size is fixed; a server period it does not divide
+    // (after a buffer size change) is played as silence.
+    if (nframes % impl->block_size != 0) {
+        impl->xruns.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    for (int off = 0; off < (int)nframes; off += impl->block_size) {
+        impl->offset = off;
+        const bool more = (*impl->render)(impl->interleaved.data(), impl->block_size);
+        for (int c = 0; c < impl->channels; ++c) {
+            float* dst = impl->output_buffers[c] + off;
+            for (int i = 0; i < impl->block_size; ++i) dst[i] = impl->interleaved[i * impl->channels + c];
+        }
+        // The last block is played; the rest of the period stays silent.
+        if (!more) {
+            impl->running.store(false, std::memory_order_release);
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int JackPlayback::Impl::Xrun(void* arg) {
+    static_cast<Impl*>(arg)->xruns.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+void JackPlayback::Impl::Shutdown(void* arg) {
+    std::cerr << "JACK server shut down" << std::endl;
+    static_cast<Impl*>(arg)->running.store(false, std::memory_order_release);
+}
+
+// Bar/beat/tick for the current frame at a constant tempo in 4/4.
+void JackPlayback::Impl::Timebase(jack_transport_state_t, jack_nframes_t, jack_position_t* pos, int, void* arg) {
+    auto* impl = static_cast<Impl*>(arg);
+    double bpm = impl->bpm.load(std::memory_order_relaxed);
+    double beats = pos->frame / (double)pos->frame_rate * bpm / 60.0;
+    double bar = std::floor(beats / kBeatsPerBar);
+    double beat_in_bar = beats - bar * kBeatsPerBar;
+
+    pos->valid = JackPositionBBT;
+    pos->beats_per_bar = kBeatsPerBar;
+    pos->beat_type = 4;
+    pos->ticks_per_beat = kTicksPerBeat;
+    pos->beats_per_minute = bpm;
+    pos->bar = (int32_t)bar + 1;
+    pos->beat = (int32_t)beat_in_bar + 1;
+    pos->tick = (int32_t)((beat_in_bar - std::floor(beat_in_bar)) * kTicksPerBeat);
+    pos->bar_start_tick = bar * kBeatsPerBar * kTicksPerBeat;
+}
+
+JackPlayback::JackPlayback(const hibiki::AudioDeviceOptions& options) : impl(std::make_unique<Impl>()) {
+    jack_status_t status;
+    impl->client = jack_client_open("hibiki", JackNoStartServer, &status);
+    if (!impl->client) {
+        std::cerr << "Cannot connect to a JACK server (status 0x" << std::hex << status << std::dec << ")" << std::endl;
+        return;
+    }
+
+    impl->channels = std::max(options.channels, 1);
+    int period = (int)jack_get_buffer_size(impl->client);
+    impl->block_size = std::min(period, options.block_size);
+    impl->transport_sync = options.transport_sync;
+    impl->interleaved.resize((size_t)impl->block_size * impl->channels);
+
+    for (int c = 0; c < impl->channels; ++c) {
+        std::string name = "out_" + std::to_string(c + 1);
+        impl->outputs.push_back(jack_port_register(impl->client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0));
+    }
+    for (int t = 0; t < options.stem_ports; ++t) {
+        for (const char* side : {"_L", "_R"}) {
+            std::string name = "track_" + std::to_string(t) + side;
+            impl->stems.push_back(jack_port_register(impl->client, name.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0));
+        }
+    }
+    if (std::find(impl->outputs.begin(), impl->outputs.end(), nullptr) != impl->outputs.end() ||
+        std::find(impl->stems.begin(), impl->stems.end(), nullptr) != impl->stems.end()) {
+        std::cerr << "Cannot register JACK ports" << std::endl;
+        jack_client_close(impl->client);
+        impl->client = nullptr;
+        return;
+    }
+    impl->output_buffers.resize(impl->outputs.size());
+    impl->stem_buffers.resize(impl->stems.size());
+
+    jack_set_process_callback(impl->client, &Impl::Process, impl.get());
+    jack_set_xrun_callback(impl->client, &Impl::Xrun, impl.get());
+    jack_on_shutdown(impl->client, &Impl::Shutdown, impl.get());
+    if (impl->transport_sync) {
+        // Conditional: leave an existing timebase master (a DAW) in charge.
+        if (jack_set_timebase_callback(impl->client, 1, &Impl::Timebase, impl.get()) != 0) {
+            std::cerr << "JACK timebase already has a master; following it" << std::endl;
+        }
+    }
+}
+
+JackPlayback::~JackPlayback() {
+    if (impl->client) jack_client_close(impl->client);
+}
+
+bool JackPlayback::is_ready() const {
+    return impl->client != nullptr;
+}
+
+void JackPlayback::run(const RenderCallback& render) {
+    if (!impl->client) return;
+    impl->render = &render;
+    impl->running.store(true, std::memory_order_release);
+    if (jack_activate(impl->client) != 0) {
+        std::cerr << "Cannot activate JACK client" << std::endl;
+        impl->running.store(false);
+        return;
+    }
+
+    // Main outputs go to the system playback ports; stems are left for the
+    // user to route.
+    if (const char** ports = jack_get_ports(impl->client, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | JackPortIsInput)) {
+        for (size_t c = 0; c < impl->outputs.size() && ports[c]; ++c) {
+            jack_connect(impl->client, jack_port_name(impl->outputs[c]), ports[c]);
+        }
+        jack_free(ports);
+    }
+
+    while (impl->running.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    jack_deactivate(impl->client);
+    if (impl->transport_sync && impl->rolling) jack_transport_stop(impl->client);
+    impl->render = nullptr;
+}
+
+int JackPlayback::get_sample_rate() const {
+    return impl->client ? (int)jack_get_sample_rate(impl->client) : 0;
+}
+
+int JackPlayback::get_channels() const {
+    return impl->channels;
+}
+
+int JackPlayback::get_block_size() const {
+    return impl->block_size;
+}
+
+uint32_t JackPlayback::xrun_count() const {
+    return impl->xruns.load(std::memory_order_relaxed);
+}
+
+int JackPlayback::stem_count() const {
+    return (int)impl->stems.size() / 2;
+}
+
+void JackPlayback::write_stem(int track_index, const float* left, const float* right, int num_frames) {
+    if (track_index < 0 || track_index >= stem_count()) return;
+    std::copy_n(left, num_frames, impl->stem_buffers[track_index * 2] + impl->offset);
+    std::copy_n(right, num_frames, impl->stem_buffers[track_index * 2 + 1] + impl->offset);
+}
+
+void JackPlayback::set_transport(bool rolling, double bpm) {
+    if (!impl->transport_sync) return;
+    impl->bpm.store(bpm, std::memory_order_relaxed);
+    // Both calls are safe from the process thread.
+    if (rolling != impl->rolling) {
+        impl->rolling = rolling;
+        if (rolling) {
+            jack_transport_start(impl->client);
+        } else {
+            jack_transport_stop(impl->client);
+        }
+    }
+}
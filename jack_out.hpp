@@ -0,0 +1,34 @@
+#pragma once
+
+#include "audio_device.hpp"
+
+#include <cstdint>
+#include <memory>
+
+// JACK client. The server's process callback drives rendering, so run() only
+// waits; output goes to "out_N" ports, and track N to "track_N_L/R" stem ports
+// when stems are requested. Never starts a server of its own.
+class JackPlayback : public hibiki::AudioDevice {
+public:
+    struct Impl;
+    explicit JackPlayback(const hibiki::AudioDeviceOptions& options);
+    ~JackPlayback();
+
+    bool is_ready() const override;
+    void run(const RenderCallback& render) override;
+    // Sample rate and buffer size are the server's; a server period longer
+    // than the requested block size is rendered in several blocks.
+    int get_sample_rate() const override;
+    int get_channels() const override;
+    int get_block_size() const override;
+    uint32_t xrun_count() const override;
+
+    int stem_count() const override;
+    void write_stem(int track_index, const float* left, const float* right, int num_frames) override;
+    // With transport_sync, starts and stops the JACK transport with the engine
+    // and, unless another client already is, acts as timebase master.
+    void set_transport(bool rolling, double bpm) override;
+
+private:
+    std::unique_ptr<Impl> impl;
+};
@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+#include "jack_out.hpp"
+
+#include <algorithm>
+
+namespace {
+
+hibiki::AudioDeviceOptions Options() {
+    hibiki::AudioDeviceOptions options;
+    options.block_size = 256;
+    options.stem_ports = 2;
+    options.transport_sync = true;
+    return options;
+}
+
+TEST(JackOutTest, ServerDrivesRenderCallback) {
+    JackPlayback jack(Options());
+    if (!jack.is_ready()) GTEST_SKIP() << "no JACK server running";
+    EXPECT_GT(jack.get_sample_rate(), 0);
+    EXPECT_LE(jack.get_block_size(), 256);
+    EXPECT_EQ(jack.stem_count(), 2);
+
+    std::vector<float> stem(jack.get_block_size(), 0.5f);
+    int blocks = 0;
+    jack.run([&](float* interleaved, int num_frames) {
+        EXPECT_EQ(num_frames, jack.get_block_size());
+        std::fill_n(interleaved, num_frames * jack.get_channels(), 0.0f);
+        jack.write_stem(1, stem.data(), stem.data(), num_frames);
+        jack.write_stem(7, stem.data(), stem.data(), num_frames); // Dropped.
+        jack.set_transport(blocks < 10, 128.0);
+        return ++blocks < 20;
+    });
+    EXPECT_EQ(blocks, 20);
+}
+
+TEST(JackOutTest, RegisteredAsHighestPriorityBackend) {
+    auto names = hibiki::AudioDeviceNames();
+    ASSERT_FALSE(names.empty());
+    EXPECT_EQ(names.front(), "jack");
+}
+
+} // namespace
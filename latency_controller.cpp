@@ -0,0 +1,71 @@
+#include "latency_controller.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace hibiki {
+
+namespace {
+
+constexpr int kMaxQuietBackoff = 16;
+
+int PowerOfTwoAtLeast(int n) {
+    int p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+} // namespace
+
+LatencyController::LatencyController(const LatencyPolicy& policy, int block_size)
+    : policy_(policy), block_size_(block_size), quiet_needed_(std::max(policy.quiet_intervals, 1)) {
+    policy_.min_block = PowerOfTwoAtLeast(std::max(policy_.min_block, 1));
+    policy_.max_block = std::max(PowerOfTwoAtLeast(policy_.max_block), policy_.min_block);
+}
+
+std::optional<LatencyDecision> LatencyController::Update(const EngineStatsReport& report) {
+    if (report.block.count == 0 || report.deadline_us <= 0.0) return std::nullopt;
+    double load = report.block.max_us / report.deadline_us;
+    bool missed = report.xruns > 0 || report.overruns > 0;
+
+    if (missed || load > policy_.high_load) {
+        overloaded_++;
+        quiet_ = 0;
+    } else if (load < policy_.low_load) {
+        quiet_++;
+        overloaded_ = 0;
+    } else {
+        overloaded_ = 0;
+        quiet_ = 0;
+    }
+
+    std::ostringstream reason;
+    if (overloaded_ >= policy_.overload_intervals && block_size_ < policy_.max_block) {
+        int next = std::clamp(PowerOfTwoAtLeast(block_size_ + 1), policy_.min_block, policy_.max_block);
+        reason << "overloaded for " << overloaded_ << " intervals (" << report.xruns << " xruns, "
+               << report.overruns << " overruns, peak load " << (int)(load * 100) << "%)";
+        if (last_change_was_lower_) quiet_needed_ = std::min(quiet_needed_ * 2, policy_.quiet_intervals * kMaxQuietBackoff);
+        last_change_was_lower_ = false;
+        overloaded_ = 0;
+        quiet_ = 0;
+        block_size_ = next;
+        return LatencyDecision{next, reason.str()};
+    }
+    if (quiet_ >= quiet_needed_ && block_size_ > policy_.min_block) {
+        int next = std::clamp(PowerOfTwoAtLeast(block_size_) / 2, policy_.min_block, policy_.max_block);
+        reason << "quiet for " << quiet_ << " intervals (peak load " << (int)(load * 100) << "%)";
+        last_change_was_lower_ = true;
+        overloaded_ = 0;
+        quiet_ = 0;
+        block_size_ = next;
+        return LatencyDecision{next, reason.str()};
+    }
+    return std::nullopt;
+}
+
+void LatencyController::SetBlockSize(int block_size) {
+    block_size_ = block_size;
+    overloaded_ = 0;
+    quiet_ = 0;
+}
+
+} // namespace hibiki
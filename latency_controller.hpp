@@ -0,0 +1,57 @@
+#pragma once
+
+#include "engine_stats.hpp"
+#include <optional>
+#include <string>
+
+namespace hibiki {
+
+// Limits and thresholds for adaptive buffer sizing. Block sizes move between
+// powers of two within [min_block, max_block].
+struct LatencyPolicy {
+    int min_block = 64;
+    int max_block = 2048;
+    // A stats interval is overloaded if it had xruns or overruns, or its worst
+    // block took more than high_load of the deadline.
+    double high_load = 0.75;
+    // It is quiet if it had neither and its worst block stayed under low_load,
+    // so that half the block size still leaves headroom.
+    double low_load = 0.3;
+    // Consecutive intervals needed before raising or lowering the block size.
+    int overload_intervals = 2;
+    int quiet_intervals = 20;
+};
+
+struct LatencyDecision {
+    int block_size;
+    std::string reason;
+};
+
+// Watches the engine's stats reports and decides when the device should run
+// with a larger or smaller block. Each lowering that has to be undone doubles
+// the quiet time needed for the next one, so the block size settles instead
+// of oscillating around the machine's limit.
+class LatencyController {
+public:
+    LatencyController(const LatencyPolicy& policy, int block_size);
+
+    // Returns the new block size when one is due; the caller applies it at its
+    // next safe point and keeps feeding reports to this controller.
+    std::optional<LatencyDecision> Update(const EngineStatsReport& report);
+    // The block size the device was reopened with, which it may not have
+    // taken from the last decision. Counting starts over; the backoff stays.
+    void SetBlockSize(int block_size);
+
+    int block_size() const { return block_size_; }
+    int quiet_intervals_needed() const { return quiet_needed_; }
+
+private:
+    LatencyPolicy policy_;
+    int block_size_;
+    int overloaded_ = 0;
+    int quiet_ = 0;
+    int quiet_needed_;
+    bool last_change_was_lower_ = false;
+};
+
+} // namespace hibiki
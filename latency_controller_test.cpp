@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "latency_controller.hpp"
+
+namespace {
+
+hibiki::EngineStatsReport Report(double load, uint32_t xruns = 0) {
+    hibiki::EngineStatsReport report;
+    report.deadline_us = 10000.0;
+    report.block.count = 100;
+    report.block.max_us = (float)(load * report.deadline_us);
+    report.xruns = xruns;
+    return report;
+}
+
+hibiki::LatencyPolicy Policy() {
+    hibiki::LatencyPolicy policy;
+    policy.min_block = 128;
+    policy.max_block = 1024;
+    policy.overload_intervals = 2;
+    policy.quiet_intervals = 3;
+    return policy;
+}
+
+TEST(LatencyControllerTest, RaisesAfterSustainedOverload) {
+    hibiki::LatencyController controller(Policy(), 256);
+    EXPECT_FALSE(controller.Update(Report(0.5, 1)));
+    EXPECT_FALSE(controller.Update(Report(0.5)));  // A normal interval resets the streak.
+    EXPECT_FALSE(controller.Update(Report(0.9)));
+    auto decision = controller.Update(Report(0.5, 2));
+    ASSERT_TRUE(decision);
+    EXPECT_EQ(decision->block_size, 512);
+    EXPECT_NE(decision->reason.find("overloaded"), std::string::npos);
+}
+
+TEST(LatencyControllerTest, LowersAfterQuietPeriodAndStaysInBounds) {
+    hibiki::LatencyController controller(Policy(), 256);
+    for (int i = 0; i < 2; ++i) EXPECT_FALSE(controller.Update(Report(0.1)));
+    auto decision = controller.Update(Report(0.1));
+    ASSERT_TRUE(decision);
+    EXPECT_EQ(decision->block_size, 128);
+    for (int i = 0; i < 10; ++i) EXPECT_FALSE(controller.Update(Report(0.1)));
+    EXPECT_EQ(controller.block_size(), 128);
+}
+
+TEST(LatencyControllerTest, BacksOffAfterALoweringFails) {
+    hibiki::LatencyController controller(Policy(), 256);
+    for (int i = 0; i < 3; ++i) controller.Update(Report(0.1));
+    ASSERT_EQ(controller.block_size(), 128);
+    controller.Update(Report(0.9));
+    ASSERT_TRUE(controller.Update(Report(0.9)));
+    EXPECT_EQ(controller.block_size(), 256);
+    EXPECT_EQ(controller.quiet_intervals_needed(), 6);
+}
+
+TEST(LatencyControllerTest, NewBlockSizeKeepsTheBackoff) {
+    hibiki::LatencyController controller(Policy(), 256);
+    for (int i = 0; i < 3; ++i) controller.Update(Report(0.1));
+    controller.Update(Report(0.9));
+    ASSERT_TRUE(controller.Update(Report(0.9)));
+    ASSERT_EQ(controller.quiet_intervals_needed(), 6);
+
+    // The device came back with 512 rather than the 256 decided.
+    controller.SetBlockSize(512);
+    EXPECT_EQ(controller.block_size(), 512);
+    EXPECT_EQ(controller.quiet_intervals_needed(), 6);
+    for (int i = 0; i < 5; ++i) EXPECT_FALSE(controller.Update(Report(0.1)));
+    auto decision = controller.Update(Report(0.1));
+    ASSERT_TRUE(decision);
+    EXPECT_EQ(decision->block_size, 256);
+}
+
+TEST(LatencyControllerTest, IgnoresEmptyReports) {
+    hibiki::LatencyController controller(Policy(), 256);
+    hibiki::EngineStatsReport empty;
+    for (int i = 0; i < 10; ++i) EXPECT_FALSE(controller.Update(empty));
+}
+
+} // namespace
@@ -0,0 +1,63 @@
+#include "launch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace hibiki {
+
+bool LaunchQueue::Push(const LaunchRequest& request) {
+    const uint64_t write = write_.load(std::memory_order_relaxed);
+    if (write - read_.load(std::memory_order_acquire) >= kCapacity) return false;
+    ring_[write % kCapacity] = request;
+    write_.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+bool LaunchQueue::Pop(LaunchRequest& request) {
+    const uint64_t read = read_.load(std::memory_order_relaxed);
+    if (read == write_.load(std::memory_order_acquire)) return false;
+    request = ring_[read % kCapacity];
+    read_.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+int64_t QuantizeLaunch(int64_t frame, LaunchQuantization quantization, double bpm, double sample_rate) {
+    double beats = 0.0;
+    switch (quantization) {
+        case LaunchQuantization::kNone: return frame;
+        case LaunchQuantization::kBar: beats = 4.0; break;
+        case LaunchQuantization::kBeat: beats = 1.0; break;
+        case LaunchQuantization::kSixteenth: beats = 0.25; break;
+    }
+    const double grid = beats * 60.0 / bpm * sample_rate;
+    // Grid points are rounded to whole frames, so look one before the estimate.
+    int64_t k = std::max<int64_t>(0, (int64_t)std::floor(frame / grid) - 1);
+    while (std::llround(k * grid) < frame) ++k;
+    return std::llround(k * grid);
+}
+
+int64_t FollowFrames(const Clip& clip, double bpm, double sample_rate) {
+    const double sec = clip.follow_beats > 0.0 ? clip.follow_beats * 60.0 / bpm : clip.duration_sec;
+    return std::max<int64_t>(1, std::llround(sec * sample_rate));
+}
+
+int FollowSlot(const std::map<int, const Clip*>& clips, int slot, FollowAction action) {
+    if (clips.empty()) return -1;
+    switch (action) {
+        case FollowAction::kNone:
+        case FollowAction::kStop: return -1;
+        case FollowAction::kAgain: return clips.count(slot) ? slot : -1;
+        case FollowAction::kFirst: return clips.begin()->first;
+        case FollowAction::kNext: {
+            auto it = clips.upper_bound(slot);
+            return it != clips.end() ? it->first : clips.begin()->first;
+        }
+        case FollowAction::kPrevious: {
+            auto it = clips.lower_bound(slot);
+            return it != clips.begin() ? std::prev(it)->first : clips.rbegin()->first;
+        }
+    }
+    return -1;
+}
+
+} // namespace hibiki
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "clip.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+
+namespace hibiki {
+
+// Grid that clip and scene launches wait for, relative to the transport.
+// Bars are four beats; the engine only knows 4/4.
+enum class LaunchQuantization {
+    kNone = 0,
+    kBar = 1,
+    kBeat = 2,
+    kSixteenth = 3,
+};
+
+struct LaunchRequest {
+    enum class Kind {
+        kClip,    // slot on track_index; -1 stops the track, an empty slot does nothing
+        kScene,   // slot on every track that has a clip there
+        kStopAll, // every track, at the start of the next block
+    };
+    Kind kind = Kind::kClip;
+    int track_index = -1;
+    int slot = -1;
+};
+
+// Launch requests from the IPC thread to the engine: a bounded
+// single-producer, single-consumer ring, so the audio thread never waits.
+class LaunchQueue {
+public:
+    static constexpr size_t kCapacity = 256;
+
+    // Producer side. Returns false if the queue is full.
+    bool Push(const LaunchRequest& request);
+    // Consumer side, the audio thread.
+    bool Pop(LaunchRequest& request);
+
+private:
+    std::array<LaunchRequest, kCapacity> ring_;
+    std::atomic<uint64_t> read_{0};
+    std::atomic<uint64_t> write_{0};
+};
+
+// First transport frame at or after frame that lies on the grid.
+int64_t QuantizeLaunch(int64_t frame, LaunchQuantization quantization, double bpm, double sample_rate);
+
+// Frames from a clip's launch to its follow action.
+int64_t FollowFrames(const Clip& clip, double bpm, double sample_rate);
+
+// Slot the follow action of the clip in slot moves to, or -1 to stop.
+int FollowSlot(const std::map<int, const Clip*>& clips, int slot, FollowAction action);
+
+} // namespace hibiki
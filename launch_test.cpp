@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "launch.hpp"
+
+#include <cmath>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+
+TEST(LaunchTest, QuantizesToTheNextGridPoint) {
+    // At 120 bpm a beat is 24000 frames and a bar 96000.
+    using hibiki::LaunchQuantization;
+    EXPECT_EQ(hibiki::QuantizeLaunch(0, LaunchQuantization::kBar, 120.0, kSampleRate), 0);
+    EXPECT_EQ(hibiki::QuantizeLaunch(1, LaunchQuantization::kBar, 120.0, kSampleRate), 96000);
+    EXPECT_EQ(hibiki::QuantizeLaunch(96000, LaunchQuantization::kBar, 120.0, kSampleRate), 96000);
+    EXPECT_EQ(hibiki::QuantizeLaunch(30000, LaunchQuantization::kBeat, 120.0, kSampleRate), 48000);
+    EXPECT_EQ(hibiki::QuantizeLaunch(30000, LaunchQuantization::kSixteenth, 120.0, kSampleRate), 30000);
+    EXPECT_EQ(hibiki::QuantizeLaunch(30001, LaunchQuantization::kSixteenth, 120.0, kSampleRate), 36000);
+    EXPECT_EQ(hibiki::QuantizeLaunch(12345, LaunchQuantization::kNone, 120.0, kSampleRate), 12345);
+
+    // Grid points that fall between frames round to the nearest one.
+    const int64_t beat = hibiki::QuantizeLaunch(1, LaunchQuantization::kBeat, 130.0, kSampleRate);
+    EXPECT_EQ(beat, std::llround(60.0 / 130.0 * kSampleRate));
+    EXPECT_EQ(hibiki::QuantizeLaunch(beat, LaunchQuantization::kBeat, 130.0, kSampleRate), beat);
+}
+
+TEST(LaunchTest, FollowActionsPickSlots) {
+    hibiki::Clip clip;
+    std::map<int, const hibiki::Clip*> clips;
+    for (int slot : {1, 3, 6}) clips[slot] = &clip;
+    using hibiki::FollowAction;
+    EXPECT_EQ(hibiki::FollowSlot(clips, 3, FollowAction::kNext), 6);
+    EXPECT_EQ(hibiki::FollowSlot(clips, 6, FollowAction::kNext), 1);
+    EXPECT_EQ(hibiki::FollowSlot(clips, 3, FollowAction::kPrevious), 1);
+    EXPECT_EQ(hibiki::FollowSlot(clips, 1, FollowAction::kPrevious), 6);
+    EXPECT_EQ(hibiki::FollowSlot(clips, 6, FollowAction::kFirst), 1);
+    EXPECT_EQ(hibiki::FollowSlot(clips, 3, FollowAction::kAgain), 3);
+    EXPECT_EQ(hibiki::FollowSlot(clips, 3, FollowAction::kStop), -1);
+
+    clip.duration_sec = 1.5;
+    EXPECT_EQ(hibiki::FollowFrames(clip, 120.0, kSampleRate), 72000);
+    clip.follow_beats = 4.0;
+    EXPECT_EQ(hibiki::FollowFrames(clip, 120.0, kSampleRate), 96000);
+}
+
+TEST(LaunchTest, QueueKeepsOrderAndRefusesWhenFull) {
+    hibiki::LaunchQueue queue;
+    for (size_t i = 0; i < hibiki::LaunchQueue::kCapacity; ++i) {
+        ASSERT_TRUE(queue.Push({hibiki::LaunchRequest::Kind::kClip, (int)i, 0}));
+    }
+    EXPECT_FALSE(queue.Push({hibiki::LaunchRequest::Kind::kStopAll}));
+    hibiki::LaunchRequest request;
+    ASSERT_TRUE(queue.Pop(request));
+    EXPECT_EQ(request.track_index, 0);
+    EXPECT_TRUE(queue.Push({hibiki::LaunchRequest::Kind::kStopAll}));
+    for (size_t i = 1; i < hibiki::LaunchQueue::kCapacity; ++i) ASSERT_TRUE(queue.Pop(request));
+    ASSERT_TRUE(queue.Pop(request));
+    EXPECT_EQ(request.kind, hibiki::LaunchRequest::Kind::kStopAll);
+    EXPECT_FALSE(queue.Pop(request));
+}
+
+} // namespace
@@ -1,24 +1,28 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "audio_device.hpp"
+#include "dsp.hpp"
 #include "midi.hpp"
+#include "realtime.hpp"
+#include "trace.hpp"
 
-#if defined(__APPLE__)
-#include "coreaudio_out.hpp"
-#elif !defined(_WIN32)
-#include "alsa_out.hpp"
-#else
-#include "win32_out.hpp"
+#if defined(_WIN32)
 #include <fcntl.h>
 #include <io.h>
 #endif
@@ -29,200 +33,109 @@
 #include "hibiki_project_generated.h"
 
 #include "ipc.hpp"
+#include "ipc_reader.hpp"
 #include "audio_file.hpp"
 #include "clip.hpp"
+#include "engine.hpp"
+#include "freeze.hpp"
+#include "latency_controller.hpp"
+#include "meter.hpp"
+#include "telemetry.hpp"
 #include "track.hpp"
 #include "project.hpp"
+#include "stats_reporter.hpp"
 
 namespace hibiki {
 
-void playback_thread(ProjectState& state) {
-#if defined(__APPLE__)
-  CoreAudioPlayback alsa(44100, 2);
-  float sample_rate = 44100.0f;
-  int actual_channels = 2;
-#elif !defined(_WIN32)
-  AlsaPlayback alsa(44100, 2);
-  float sample_rate = 44100.0f;
-  int actual_channels = 2;
-#else
-  Win32Playback alsa(44100, 2);
-  float sample_rate = (float)alsa.get_sample_rate();
-  int actual_channels = alsa.get_channels();
-#endif
-    state.sample_rate = (double)sample_rate;
-    if (!alsa.is_ready()) return;
-
-    int block_size = 512;
-
-    alignas(32) float bufferL[512];
-    alignas(32) float bufferR[512];
-    float* outChannels[] = {bufferL, bufferR};
+namespace {
+
+// Device buffer in adaptive mode, so that the block size sets the latency.
+constexpr int kAdaptiveBufferBlocks = 3;
+
+// Renders into an opened device until quit. Returns the new block size when
+// the latency controller, or a change of adaptive mode or look-ahead, needs the
+// device reopened; the engine is rebuilt around the new size at that safe point.
+// With idle_after set, a stopped and silent engine pauses the device and
+// parks this thread until WakeAudio, keeping the engine and its plugins.
+std::optional<LatencyDecision> RunDevice(ProjectState& state, AudioDevice& device, StatsReporter& reporter, MeterWorker& meter,
+                                         bool adaptive, StatsClock::duration idle_after) {
+    const double sample_rate = device.get_sample_rate();
+    const int actual_channels = device.get_channels();
+    state.sample_rate = sample_rate;
+
+    int block_size = device.get_block_size();
+    hibiki::Engine engine(state, sample_rate, block_size, GraphExecutor::DefaultWorkerCount(), [](int worker) {
+        auto statuses = rt::ConfigureCurrentThread("render worker " + std::to_string(worker), rt::WorkerThreadConfig());
+        for (const auto& status : statuses) sendRealtimeStatus(status);
+    });
+    block_size = engine.block_size();
+    const int lookahead = state.lookahead_blocks.load();
+    // The audio thread may wait for a look-ahead thread to finish a block, so
+    // they run at the render workers' priority.
+    engine.SetLookahead(lookahead, std::max(1, GraphExecutor::DefaultWorkerCount() / 2), [](int thread) {
+        auto statuses = rt::ConfigureCurrentThread("lookahead " + std::to_string(thread), rt::WorkerThreadConfig());
+        for (const auto& status : statuses) sendRealtimeStatus(status);
+    });
+    if (device.can_pause()) engine.SetIdleAfter(idle_after);
+    engine.SetMeter(&meter);
+    if (device.stem_count() > 0) {
+        engine.SetTrackOutputSink([&](int track_index, const float* left, const float* right) {
+            device.write_stem(track_index, left, right, block_size);
+        });
+    }
 
-    HostProcessContext context;
-    context.sampleRate = sample_rate;
-    context.tempo = state.bpm;
-    context.timeSigNumerator = 4;
-    context.timeSigDenominator = 4;
+    reporter.SetBlockSize(block_size);
+    std::optional<LatencyDecision> change;
+    bool latency_change = false;
 
-    double time_per_block = block_size / (double)sample_rate;
     std::vector<float> mixBufferL(block_size);
     std::vector<float> mixBufferR(block_size);
-    std::vector<float> interleaved(block_size * actual_channels);
-
-    int level_counter = 0;
-
-    while (!state.quit) {
-
-        std::fill(mixBufferL.begin(), mixBufferL.end(), 0.0f);
-        std::fill(mixBufferR.begin(), mixBufferR.end(), 0.0f);
-
-        bool any_playing = false;
-
-        {
-            // std::lock_guard<std::mutex> lock(state.tracks_mutex); // Mutex removed from POD
-            for (auto& pair : state.tracks) {
-                Track* track = pair.second.get();
-                // std::lock_guard<std::mutex> tlock(track->mutex);
-
-                if (track->playing_slot == -1) continue;
-
-                any_playing = true;
-                auto& clip = track->clips[track->playing_slot];
-
-                context.continuousTimeSamples = track->current_time_sec * sample_rate;
-                context.projectTimeMusic = track->current_time_sec * (context.tempo / 60.0);
-
-                std::fill(bufferL, bufferL + block_size, 0.0f);
-                std::fill(bufferR, bufferR + block_size, 0.0f);
-
-                if (clip->type == Clip::Type::MIDI) {
-                    const auto& events = clip->midi_events;
-                    int num_midi_events = events.size();
-
-                    std::vector<MidiNoteEvent> blockEvents;
-                    int search_idx = track->current_midi_idx;
-                    
-                    while (search_idx < num_midi_events) {
-                        auto& me = events[search_idx];
-                        if (me.seconds >= track->current_time_sec + time_per_block) break;
 
-                        if (me.seconds >= track->current_time_sec) {
-                            if (hibiki::isNoteOn(me) || hibiki::isNoteOff(me)) {
-                                MidiNoteEvent e;
-                                e.sampleOffset = std::max(0, (int)((me.seconds - track->current_time_sec) * sample_rate));
-                                if (e.sampleOffset >= block_size) e.sampleOffset = block_size - 1;
-                                e.channel = me.channel;
-                                e.pitch = me.note;
-
-                                if (hibiki::isNoteOff(me)) {
-                                    e.isNoteOn = false;
-                                    e.velocity = 0;
-                                } else {
-                                    e.isNoteOn = true;
-                                    e.velocity = me.velocity / 127.0f;
-                                }
-                                blockEvents.push_back(e);
-                            }
-                        }
-                        search_idx++;
-                    }
-                    track->current_midi_idx = search_idx;
-
-                    for (size_t i = 0; i < track->plugins.size(); ++i) {
-                        auto& p = track->plugins[i];
-                        if (i == 0 && p->isInstrument()) {
-                            p->process(nullptr, outChannels, block_size, context, blockEvents);
-                        } else {
-                            p->process(outChannels, outChannels, block_size, context, {});
-                        }
-                    }
-                } else if (clip->type == Clip::Type::AUDIO) {
-                    // Simple audio playback
-                    int start_sample = (int)(track->current_time_sec * sample_rate);
-                    for (int i = 0; i < block_size; ++i) {
-                        int sample_pos = start_sample + i;
-                        if (clip->num_channels == 2) {
-                            if (sample_pos * 2 + 1 < (int)clip->audio_data.size()) {
-                                bufferL[i] = clip->audio_data[sample_pos * 2];
-                                bufferR[i] = clip->audio_data[sample_pos * 2 + 1];
-                            }
-                        } else if (clip->num_channels == 1) {
-                            if (sample_pos < (int)clip->audio_data.size()) {
-                                bufferL[i] = bufferR[i] = clip->audio_data[sample_pos];
-                            }
-                        }
-                    }
-
-                    // Process through effects
-                    for (size_t i = 0; i < track->plugins.size(); ++i) {
-                        auto& p = track->plugins[i];
-                        if (p->isInstrument()) continue; // Audio clips bypass instruments
-                        p->process(outChannels, outChannels, block_size, context, {});
-                    }
-                }
-
-                for (int i = 0; i < block_size; ++i) {
-                    mixBufferL[i] += bufferL[i];
-                    mixBufferR[i] += bufferR[i];
-                }
-
-                track->current_time_sec += time_per_block;
-                if (track->current_time_sec >= clip->duration_sec) {
-                    if (clip->is_loop) {
-                        track->current_time_sec = fmod(track->current_time_sec, clip->duration_sec);
-                        track->current_midi_idx = 0; // Reset MIDI search for next block
-                    } else {
-                        track->playing_slot = -1;
-                    }
-                }
-
-                // Calculate levels
-                float peakL = 0, peakR = 0;
-                for (int i = 0; i < block_size; i++) {
-                    peakL = std::max(peakL, std::abs(bufferL[i]));
-                    peakR = std::max(peakR, std::abs(bufferR[i]));
-                }
-                if (any_playing) {
-                    std::lock_guard<std::mutex> llock(state.levels_mutex);
-                    state.track_levels[track->index] = {peakL, peakR};
-                }
-            }
+    StatsClock::time_point previous_block_start;
+    uint32_t reported_xruns = 0;
+    uint64_t wake_seen = 0;
+    std::optional<StatsClock::time_point> woken_at;
+
+    auto render = [&](float* interleaved, int num_frames) {
+        wake_seen = state.wake_generation.load();
+        // The device still plays the block of the call that stops it.
+        auto stop = [&] {
+            std::fill_n(interleaved, (size_t)num_frames * actual_channels, 0.0f);
+            return false;
+        };
+        if (state.quit) return stop();
+        if (state.adaptive_latency.load(std::memory_order_relaxed) != adaptive) {
+            change = LatencyDecision{block_size, adaptive ? "adaptive latency off" : "adaptive latency on"};
+            return stop();
         }
-        
-        if (!any_playing) {
-            if (state.is_playing) {
-                std::lock_guard<std::mutex> llock(state.levels_mutex);
-                for (auto& p : state.track_levels) p.second = {0, 0};
-                state.is_playing = false;
-            }
-        } else {
-            state.is_playing = true;
+        if (state.lookahead_blocks.load(std::memory_order_relaxed) != lookahead) {
+            change = LatencyDecision{block_size, "look-ahead changed"};
+            return stop();
         }
+        if (reporter.latency_change_pending()) {
+            latency_change = true;
+            return stop();
+        }
+        auto block_start = StatsClock::now();
+        if (previous_block_start != StatsClock::time_point()) {
+            state.stats.jitter.Record(block_start - previous_block_start - engine.block_period());
+        }
+        previous_block_start = block_start;
 
-        level_counter++;
-        if (level_counter >= 10) { // Send levels periodically
-            level_counter = 0;
-            flatbuffers::FlatBufferBuilder builder(512);
-            std::vector<flatbuffers::Offset<hibiki::ipc::TrackLevel>> level_offsets;
-            {
-                std::lock_guard<std::mutex> llock(state.levels_mutex);
-                for (auto& pair : state.track_levels) {
-                    level_offsets.push_back(hibiki::ipc::CreateTrackLevel(builder, pair.first, pair.second.first, pair.second.second));
-                }
-            }
-            auto levels_vec = builder.CreateVector(level_offsets);
-            auto levels_off = hibiki::ipc::CreateTrackLevels(builder, levels_vec);
-            auto nf_off = hibiki::ipc::CreateNotification(builder, hibiki::ipc::Response_TrackLevels, levels_off.Union());
-            builder.Finish(nf_off);
-            // We need a thread-safe way to send notifications if main thread is also sending
-            // For now, assume playback_thread can write to cout too, but we should be careful with mutex
-            // Actually main.cpp sendNotification doesn't have a mutex. Let's add one.
-            sendNotification(builder.GetBufferPointer(), builder.GetSize());
+        engine.SetPlayheadInterval(std::chrono::milliseconds(state.playhead_interval_ms.load(std::memory_order_relaxed)));
+        engine.Process(mixBufferL.data(), mixBufferR.data());
+        device.set_transport(state.is_playing, state.bpm);
+        if (const PlayheadReport* playhead = engine.TakePlayhead()) reporter.PostPlayhead(*playhead, device.output_time());
+
+        if (const uint32_t xruns = device.xrun_count(); xruns != reported_xruns) {
+            state.stats.xruns.fetch_add(xruns - reported_xruns, std::memory_order_relaxed);
+            reported_xruns = xruns;
         }
 
-        if (actual_channels >= 2) {
-            for (int i = 0; i < block_size; ++i) {
+        if (actual_channels == 2) {
+            hibiki::dsp::Interleave2(interleaved, mixBufferL.data(), mixBufferR.data(), num_frames);
+        } else if (actual_channels > 2) {
+            for (int i = 0; i < num_frames; ++i) {
                 interleaved[i * actual_channels + 0] = mixBufferL[i];
                 interleaved[i * actual_channels + 1] = mixBufferR[i];
                 for (int c = 2; c < actual_channels; ++c) {
@@ -231,12 +144,114 @@ void playback_thread(ProjectState& state) {
             }
         } else {
             // Mono
-            for (int i = 0; i < block_size; ++i) {
-                interleaved[i] = (mixBufferL[i] + mixBufferR[i]) * 0.5f;
-            }
+            std::fill_n(interleaved, num_frames, 0.0f);
+            hibiki::dsp::AddGainRamp(interleaved, mixBufferL.data(), num_frames, 0.5f, 0.5f);
+            hibiki::dsp::AddGainRamp(interleaved, mixBufferR.data(), num_frames, 0.5f, 0.5f);
+        }
+        if (woken_at) {
+            reporter.PostIdleState(false, std::chrono::duration<float, std::micro>(StatsClock::now() - *woken_at).count());
+            woken_at.reset();
         }
+        // The block just rendered is still written out before a reopen or idle.
+        return !change && !engine.idle();
+    };
 
-        alsa.write(interleaved, block_size);
+    while (true) {
+        device.run(render);
+        if (latency_change) {
+            change = reporter.TakeLatencyDecision();
+            latency_change = false;
+            if (!change) continue;
+        }
+        if (change || !engine.idle() || state.quit) break;
+        device.pause();
+        reporter.PostIdleState(true, 0.0f);
+        woken_at = WaitForWake(state, wake_seen);
+        engine.ResetIdle();
+        if (state.quit) break;
+        device.resume();
+        previous_block_start = StatsClock::time_point();
+    }
+    return change;
+}
+
+} // namespace
+
+// HIBIKI_AUDIO_DEVICE picks a backend by name (see --devices), otherwise the
+// first one that opens is used, falling back to the null device.
+// HIBIKI_AUDIO_CLOCK_RATIO sets the null device's speed; 0 runs free.
+// HIBIKI_JACK_STEMS adds per-track JACK ports for the first N tracks and
+// HIBIKI_JACK_TRANSPORT=1 drives the JACK transport.
+// HIBIKI_ADAPTIVE_LATENCY=1 starts with adaptive block sizing on.
+// HIBIKI_CPU_GOVERNOR=bypass|freeze|cut starts with that governor policy.
+// HIBIKI_LOOKAHEAD_BLOCKS renders tracks without live input that many blocks
+// ahead on background threads.
+// HIBIKI_LAUNCH_QUANTIZATION=none|bar|beat|16th sets the launch grid (bar).
+// HIBIKI_IDLE_MS is how long the transport must be stopped and the output
+// silent before the device is paused (default 2000, 0 never idles).
+// HIBIKI_PLAYHEAD_MS is the period of Playhead notifications (default 50, 0
+// sends none), HIBIKI_LEVELS_MS that of LevelDeltas (default 100).
+void playback_thread(ProjectState& state, StatsReporter& reporter, MeterWorker& meter) {
+    AudioDeviceOptions options;
+    const char* device_name = std::getenv("HIBIKI_AUDIO_DEVICE");
+    if (const char* ratio = std::getenv("HIBIKI_AUDIO_CLOCK_RATIO")) options.clock_ratio = std::atof(ratio);
+    if (const char* stems = std::getenv("HIBIKI_JACK_STEMS")) options.stem_ports = std::atoi(stems);
+    if (const char* sync = std::getenv("HIBIKI_JACK_TRANSPORT")) options.transport_sync = std::string(sync) == "1";
+    if (const char* adaptive = std::getenv("HIBIKI_ADAPTIVE_LATENCY")) state.adaptive_latency = std::string(adaptive) == "1";
+    if (const char* governor = std::getenv("HIBIKI_CPU_GOVERNOR")) {
+        std::string policy = governor;
+        GovernorPolicy value = policy == "bypass" ? GovernorPolicy::kBypass
+                               : policy == "freeze" ? GovernorPolicy::kFreeze
+                               : policy == "cut" ? GovernorPolicy::kCutTracks
+                                                 : GovernorPolicy::kOff;
+        state.governor_policy = (int)value;
+        state.governor_generation++;
+    }
+    if (const char* lookahead = std::getenv("HIBIKI_LOOKAHEAD_BLOCKS")) state.lookahead_blocks = std::clamp(std::atoi(lookahead), 0, 64);
+    if (const char* quantization = std::getenv("HIBIKI_LAUNCH_QUANTIZATION")) {
+        std::string grid = quantization;
+        LaunchQuantization value = grid == "none" ? LaunchQuantization::kNone
+                                   : grid == "beat" ? LaunchQuantization::kBeat
+                                   : grid == "16th" ? LaunchQuantization::kSixteenth
+                                                    : LaunchQuantization::kBar;
+        state.launch_quantization = (int)value;
+    }
+    std::chrono::milliseconds idle_after(2000);
+    if (const char* idle = std::getenv("HIBIKI_IDLE_MS")) idle_after = std::chrono::milliseconds(std::atoi(idle));
+    if (const char* playhead = std::getenv("HIBIKI_PLAYHEAD_MS")) state.playhead_interval_ms = std::max(std::atoi(playhead), 0);
+    if (const char* levels = std::getenv("HIBIKI_LEVELS_MS")) state.level_interval_ms = std::max(std::atoi(levels), 0);
+    trace::SetThreadName("audio");
+    for (const auto& status : rt::ConfigureCurrentThread("audio", rt::AudioThreadConfig())) sendRealtimeStatus(status);
+
+    // The latency controller lives across reopens, so that its backoff
+    // survives the block size changes it asks for.
+    std::optional<bool> adaptive_set;
+    while (!state.quit) {
+        bool adaptive = state.adaptive_latency.load();
+        if (adaptive_set != adaptive) {
+            std::optional<LatencyPolicy> policy;
+            if (adaptive) {
+                policy.emplace();
+                policy->min_block = state.min_block_size.load();
+                policy->max_block = state.max_block_size.load();
+            }
+            reporter.SetLatencyPolicy(policy);
+            adaptive_set = adaptive;
+        }
+        options.buffer_blocks = adaptive ? kAdaptiveBufferBlocks : 0;
+        auto device = OpenAudioDevice(device_name ? device_name : "", options);
+        if (!device) {
+            sendLog("No audio device available");
+            return;
+        }
+        meter.SetSampleRate(device->get_sample_rate());
+        int previous_block_size = device->get_block_size();
+        auto change = RunDevice(state, *device, reporter, meter, adaptive, idle_after);
+        if (!change) break;
+        options.block_size = change->block_size;
+        int buffer_blocks = state.adaptive_latency.load() ? kAdaptiveBufferBlocks : 1;
+        float latency_ms = (float)(change->block_size * buffer_blocks * 1000.0 / device->get_sample_rate());
+        sendLatencyChange(previous_block_size, change->block_size, latency_ms, change->reason);
     }
 }
 
@@ -248,6 +263,10 @@ int main(int argc, char** argv) {
         Vst3Plugin::listPlugins(argv[2]);
         return 0;
     }
+    if (argc >= 2 && std::string(argv[1]) == "--devices") {
+        for (const auto& name : hibiki::AudioDeviceNames()) std::cout << name << "\n";
+        return 0;
+    }
 
 #ifdef _WIN32
   // Ensure binary mode for IPC on Windows
@@ -255,41 +274,70 @@ int main(int argc, char** argv) {
   _setmode(_fileno(stdout), _O_BINARY);
 #endif
 
-    hibiki::ProjectState state;
-    std::thread audio_thread(hibiki::playback_thread, std::ref(state));
-
-    while (true) {
-        uint32_t msg_size = 0;
-        std::cin.read(reinterpret_cast<char*>(&msg_size), sizeof(msg_size));
-        if (std::cin.eof()) break;
-        if (std::cin.fail()) {
-            std::cerr << "BACKEND ERROR: Failed to read message size from stdin" << std::endl;
-            break;
-        }
-
-        if (msg_size > 1024 * 1024) { // 1MB limit for safety
-            std::cerr << "BACKEND ERROR: Message size too large: " << msg_size << std::endl;
-            break;
-        }
-
-        std::unique_ptr<uint8_t[]> buffer(new uint8_t[msg_size]);
-        std::cin.read(reinterpret_cast<char*>(buffer.get()), msg_size);
-        if (std::cin.fail()) {
-            std::cerr << "BACKEND ERROR: Failed to read message payload from stdin" << std::endl;
-            break;
-        }
+    // HIBIKI_TRACE=1 records from startup; SIGUSR1 dumps the trace to HIBIKI_TRACE_FILE.
+    if (const char* env = std::getenv("HIBIKI_TRACE")) hibiki::trace::SetEnabled(std::string(env) == "1");
+#if !defined(_WIN32)
+    const char* trace_file = std::getenv("HIBIKI_TRACE_FILE");
+    hibiki::trace::DumpOnSignal(SIGUSR1, trace_file ? trace_file : (std::filesystem::temp_directory_path() / "hibiki-trace.json").string());
+#endif
+    hibiki::trace::SetThreadName("ipc");
+    hibiki::sendRealtimeStatus(hibiki::rt::LockMemory());
 
-        auto request = hibiki::ipc::GetRequest(buffer.get());
+    hibiki::ProjectState state;
+    // HIBIKI_FREEZE_DIR (default: the temp directory) takes frozen renders
+    // larger than HIBIKI_FREEZE_SPILL_MB (default 64; 0 keeps all in memory).
+    hibiki::FreezeOptions freeze_options;
+    const char* freeze_dir = std::getenv("HIBIKI_FREEZE_DIR");
+    freeze_options.spill_dir = freeze_dir ? freeze_dir : std::filesystem::temp_directory_path().string();
+    if (const char* spill_mb = std::getenv("HIBIKI_FREEZE_SPILL_MB")) {
+        freeze_options.spill_bytes = (size_t)std::atoll(spill_mb) << 20;
+        if (freeze_options.spill_bytes == 0) freeze_options.spill_dir.clear();
+    }
+    hibiki::FreezeWorker freezer(state, freeze_options, [](const hibiki::FreezeResult& result) {
+        hibiki::sendTrackFreeze(result.track_index, result.ok, result.frozen, (float)result.audio_sec,
+                                (float)result.render_sec, result.spilled, result.error);
+    });
+    // Outlives the devices, so integrated loudness and analyzer taps span
+    // device changes. HIBIKI_METER_MS is the period of Meters (default 100, 0
+    // sends none).
+    hibiki::MeterWorker meter(hibiki::sendMeters, hibiki::sendAnalysis);
+    if (const char* meter_ms = std::getenv("HIBIKI_METER_MS")) meter.SetInterval(std::max(std::atoi(meter_ms), 0));
+    // The playback thread only bumps load counters and posts notifications;
+    // this builds the EngineStats reports from them, runs the CPU governor
+    // and latency controller, and sends what was posted.
+    hibiki::StatsReporter::Telemetry telemetry;
+    telemetry.playhead = hibiki::sendPlayhead;
+    telemetry.levels = hibiki::sendLevelDeltas;
+    telemetry.idle = hibiki::sendIdleState;
+    hibiki::StatsReporter reporter(
+        state, hibiki::sendEngineStats,
+        [&freezer](const hibiki::GovernorAction& action) {
+            if (action.kind == hibiki::GovernorAction::Kind::kUseFrozen) freezer.Freeze(action.track_index);
+            hibiki::sendGovernorAction(action);
+        },
+        telemetry);
+    std::thread audio_thread(hibiki::playback_thread, std::ref(state), std::ref(reporter), std::ref(meter));
+
+    hibiki::ParamCoalescer params;
+    // Handles the command of one request; returns false for Quit.
+    auto handle_command = [&](const hibiki::ipc::Request* request) {
         auto command_type = request->command_type();
 
         if (command_type == hibiki::ipc::Command_LoadPlugin) {
+            HIBIKI_TRACE_SCOPE("LoadPlugin");
             auto cmd = request->command_as_LoadPlugin();
             int tidx = cmd->track_index();
             std::string vpath = cmd->path()->str();
             int pidx = cmd->plugin_index();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            auto track = hibiki::GetOrCreateTrack(state, tidx);
-            int target_idx = track->LoadPlugin(vpath, pidx, state.sample_rate);
+            // Loading can take a while; the audio and look-ahead threads carry on meanwhile.
+            auto loaded = std::make_unique<Vst3Plugin>();
+            hibiki::Track* track = nullptr;
+            int target_idx = -1;
+            if (loaded->load(vpath, pidx, state.sample_rate)) {
+                std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                track = hibiki::GetOrCreateTrack(state, tidx);
+                target_idx = track->InsertPlugin(std::move(loaded));
+            }
             if (target_idx != -1) {
                 std::vector<VstParamInfo> params;
                 auto& plugin = track->plugins[target_idx];
@@ -300,9 +348,14 @@ int main(int argc, char** argv) {
                     }
                 }
                 hibiki::sendParamList(tidx, target_idx, plugin->getName(), plugin->isInstrument(), params);
+                // A replaced instrument is freed once it has faded out, and
+                // the audio clips an instrument drops after the block.
+                hibiki::ReleaseRetiredPlugins(state, *track);
+                hibiki::ReleaseRetiredClips(state, *track);
             } else {
                 hibiki::sendLog("Failed to load plugin: " + vpath);
             }
+            hibiki::sendAck("LOAD_PLUGIN", target_idx != -1);
         } else if (command_type == hibiki::ipc::Command_SaveProject) {
             auto cmd = request->command_as_SaveProject();
             std::lock_guard<std::mutex> lock(state.tracks_mutex);
@@ -310,18 +363,26 @@ int main(int argc, char** argv) {
             hibiki::sendAck("SAVE_PROJECT", true);
         } else if (command_type == hibiki::ipc::Command_LoadProject) {
             auto cmd = request->command_as_LoadProject();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
             hibiki::LoadProject(state, cmd->path()->str());
             hibiki::sendAck("LOAD_PROJECT", true);
         } else if (command_type == hibiki::ipc::Command_LoadClip) {
+            HIBIKI_TRACE_SCOPE("LoadClip");
             auto cmd = request->command_as_LoadClip();
             int tidx = cmd->track_index();
             int sidx = cmd->slot_index();
             std::string mpath = cmd->path()->str();
             bool is_loop = cmd->is_loop();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            auto track = hibiki::GetOrCreateTrack(state, tidx);
-            if (track->LoadClip(sidx, mpath, is_loop)) {
+            hibiki::Track* track = nullptr;
+            bool loaded = false;
+            {
+                std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                track = hibiki::GetOrCreateTrack(state, tidx);
+                loaded = track->LoadClip(sidx, mpath, is_loop);
+            }
+            // An audio clip drops the track's instrument.
+            hibiki::ReleaseRetiredPlugins(state, *track);
+            hibiki::ReleaseRetiredClips(state, *track);
+            if (loaded) {
                 hibiki::sendAck("LOAD_CLIP", true);
                 // Extract filename from path
                 std::string name = mpath;
@@ -332,6 +393,7 @@ int main(int argc, char** argv) {
                 hibiki::sendClipInfo(tidx, sidx, name, mpath);
             } else {
                 hibiki::sendLog("Failed to load clip: " + mpath);
+                hibiki::sendAck("LOAD_CLIP", false);
             }
         } else if (command_type == hibiki::ipc::Command_SetClipLoop) {
             auto cmd = request->command_as_SetClipLoop();
@@ -341,37 +403,40 @@ int main(int argc, char** argv) {
         } else if (command_type == hibiki::ipc::Command_Play) {
             hibiki::sendAck("PLAY", true);
         } else if (command_type == hibiki::ipc::Command_Stop) {
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            for (auto& pair : state.tracks) {
-                pair.second->Stop();
-            }
-            hibiki::sendAck("STOP", true);
+            // Queued behind earlier launches, so that none of them outlives the stop.
+            hibiki::sendAck("STOP", state.launches.Push({hibiki::LaunchRequest::Kind::kStopAll}));
         } else if (command_type == hibiki::ipc::Command_PlayClip) {
             auto cmd = request->command_as_PlayClip();
             int tidx = cmd->track_index();
             int sidx = cmd->slot_index();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            auto track = hibiki::GetOrCreateTrack(state, tidx);
-            track->PlayClip(sidx);
-            hibiki::sendAck("PLAY_CLIP", true);
+            {
+                std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                hibiki::GetOrCreateTrack(state, tidx);
+            }
+            bool queued = state.launches.Push({hibiki::LaunchRequest::Kind::kClip, tidx, sidx});
+            hibiki::WakeAudio(state);
+            hibiki::sendAck("PLAY_CLIP", queued);
         } else if (command_type == hibiki::ipc::Command_StopTrack) {
             auto cmd = request->command_as_StopTrack();
             int tidx = cmd->track_index();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            auto track = hibiki::GetOrCreateTrack(state, tidx);
-            track->Stop();
-            hibiki::sendAck("STOP_TRACK", true);
+            {
+                std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                hibiki::GetOrCreateTrack(state, tidx);
+            }
+            hibiki::sendAck("STOP_TRACK", state.launches.Push({hibiki::LaunchRequest::Kind::kClip, tidx, -1}));
         } else if (command_type == hibiki::ipc::Command_RemovePlugin) {
             auto cmd = request->command_as_RemovePlugin();
             int tidx = cmd->track_index();
             int pidx = cmd->plugin_index();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            auto track = hibiki::GetOrCreateTrack(state, tidx);
-            if (track->RemovePlugin(pidx)) {
-                hibiki::sendAck("REMOVE_PLUGIN", true);
-            } else {
-                hibiki::sendAck("REMOVE_PLUGIN", false);
+            hibiki::Track* track = nullptr;
+            bool removed = false;
+            {
+                std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                track = hibiki::GetOrCreateTrack(state, tidx);
+                removed = track->RemovePlugin(pidx);
             }
+            hibiki::sendAck("REMOVE_PLUGIN", removed);
+            hibiki::ReleaseRetiredPlugins(state, *track);
         } else if (command_type == hibiki::ipc::Command_ShowPluginGui) {
             auto cmd = request->command_as_ShowPluginGui();
             int track_idx = cmd->track_index();
@@ -384,18 +449,10 @@ int main(int argc, char** argv) {
                 }
             }
         } else if (command_type == hibiki::ipc::Command_SetParamValue) {
+            // Only those inside a Batch come here; see the reader loop.
             auto cmd = request->command_as_SetParamValue();
-            int track_idx = cmd->track_index();
-            int plugin_idx = cmd->plugin_index();
-            uint32_t param_id = cmd->param_id();
-            float value = cmd->value();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            if (state.tracks.count(track_idx)) {
-                auto& plugins = state.tracks[track_idx]->plugins;
-                if (plugin_idx >= 0 && plugin_idx < (int)plugins.size()) {
-                    plugins[plugin_idx]->setParameterValue(param_id, value);
-                }
-            }
+            params.Add({cmd->track_index(), cmd->plugin_index(), cmd->param_id(), cmd->value()});
+            params.Apply(state);
         // Disable Scrub, UpdateParams, ClearProject routing to track temporary
         // } else if (command_type == hibiki::ipc::Command_UpdateParams) {
         //     auto cmd = request->command_as_UpdateParams();
@@ -417,32 +474,260 @@ int main(int argc, char** argv) {
         //     hibiki::sendAck("SCRUB", true);
         } else if (command_type == hibiki::ipc::Command_SetBpm) {
             auto cmd = request->command_as_SetBpm();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
             state.bpm = cmd->bpm();
+            for (auto& pair : state.tracks) pair.second->Invalidate();
             hibiki::sendAck("SET_BPM", true);
         } else if (command_type == hibiki::ipc::Command_PlayScene) {
             auto cmd = request->command_as_PlayScene();
             int sidx = cmd->slot_index();
-            std::lock_guard<std::mutex> lock(state.tracks_mutex);
-            for (auto& pair : state.tracks) {
-                pair.second->PlayClip(sidx);
-            }
-            hibiki::sendAck("PLAY_SCENE", true);
+            // One request, so that every track gets the same start frame.
+            bool queued = state.launches.Push({hibiki::LaunchRequest::Kind::kScene, -1, sidx});
+            hibiki::WakeAudio(state);
+            hibiki::sendAck("PLAY_SCENE", queued);
         } else if (command_type == hibiki::ipc::Command_DeleteClip) {
             auto cmd = request->command_as_DeleteClip();
             int track_idx = cmd->track_index();
             int slot_index = cmd->slot_index();
-            if (hibiki::GetOrCreateTrack(state, track_idx)->DeleteClip(slot_index)) {
+            hibiki::Track* track = nullptr;
+            bool deleted = false;
+            {
+                std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                track = hibiki::GetOrCreateTrack(state, track_idx);
+                deleted = track->DeleteClip(slot_index);
+            }
+            if (deleted) {
+                hibiki::ReleaseRetiredClips(state, *track);
                 hibiki::sendAck("DELETE_CLIP", true);
                 hibiki::sendClipInfo(track_idx, slot_index, "", "");
             } else {
                 hibiki::sendAck("DELETE_CLIP", false);
             }
+        } else if (command_type == hibiki::ipc::Command_SetTrackVolume) {
+            auto cmd = request->command_as_SetTrackVolume();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            hibiki::SetMixer(state, cmd->track_index(), [&](auto& mixer) { mixer.volume = std::max(cmd->volume(), 0.0f); });
+            hibiki::sendAck("SET_TRACK_VOLUME", true);
+        } else if (command_type == hibiki::ipc::Command_SetTrackPan) {
+            auto cmd = request->command_as_SetTrackPan();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            hibiki::SetMixer(state, cmd->track_index(), [&](auto& mixer) { mixer.pan = std::clamp(cmd->pan(), -1.0f, 1.0f); });
+            hibiki::sendAck("SET_TRACK_PAN", true);
+        } else if (command_type == hibiki::ipc::Command_SetTrackMute) {
+            auto cmd = request->command_as_SetTrackMute();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            hibiki::SetMixer(state, cmd->track_index(), [&](auto& mixer) { mixer.mute = cmd->mute(); });
+            hibiki::sendAck("SET_TRACK_MUTE", true);
+        } else if (command_type == hibiki::ipc::Command_SetTrackSolo) {
+            auto cmd = request->command_as_SetTrackSolo();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            hibiki::SetMixer(state, cmd->track_index(), [&](auto& mixer) { mixer.solo = cmd->solo(); });
+            hibiki::sendAck("SET_TRACK_SOLO", true);
+        } else if (command_type == hibiki::ipc::Command_SetMasterVolume) {
+            auto cmd = request->command_as_SetMasterVolume();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            hibiki::SetMixer(state, hibiki::kMasterStrip, [&](auto& mixer) { mixer.volume = std::max(cmd->volume(), 0.0f); });
+            hibiki::sendAck("SET_MASTER_VOLUME", true);
+        } else if (command_type == hibiki::ipc::Command_SetReturnTrack) {
+            auto cmd = request->command_as_SetReturnTrack();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            hibiki::SetReturnTrack(state, cmd->track_index(), cmd->is_return());
+            hibiki::sendAck("SET_RETURN_TRACK", true);
+        } else if (command_type == hibiki::ipc::Command_SetSend) {
+            auto cmd = request->command_as_SetSend();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            bool ok = hibiki::SetSend(state, cmd->track_index(), cmd->return_index(), cmd->level());
+            if (!ok) {
+                hibiki::sendLog("Rejected send " + std::to_string(cmd->track_index()) + " -> " +
+                                std::to_string(cmd->return_index()) + ": not a return track or would create feedback");
+            }
+            hibiki::sendAck("SET_SEND", ok);
+        } else if (command_type == hibiki::ipc::Command_SetTrackOutput) {
+            auto cmd = request->command_as_SetTrackOutput();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            bool ok = hibiki::SetTrackOutput(state, cmd->track_index(), cmd->output_index());
+            if (!ok) {
+                hibiki::sendLog("Rejected output " + std::to_string(cmd->track_index()) + " -> " +
+                                std::to_string(cmd->output_index()) + ": not a return track or would create feedback");
+            }
+            hibiki::sendAck("SET_TRACK_OUTPUT", ok);
+        } else if (command_type == hibiki::ipc::Command_SetSidechain) {
+            auto cmd = request->command_as_SetSidechain();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            bool ok = hibiki::SetSidechain(state, cmd->track_index(), cmd->source_index());
+            if (!ok) {
+                hibiki::sendLog("Rejected sidechain " + std::to_string(cmd->source_index()) + " -> " +
+                                std::to_string(cmd->track_index()) + ": unknown track or would create feedback");
+            }
+            hibiki::sendAck("SET_SIDECHAIN", ok);
+        } else if (command_type == hibiki::ipc::Command_SetStatsInterval) {
+            auto cmd = request->command_as_SetStatsInterval();
+            state.stats.interval_ms = std::max(cmd->interval_ms(), 0);
+            hibiki::sendAck("SET_STATS_INTERVAL", true);
+        } else if (command_type == hibiki::ipc::Command_SetMeterInterval) {
+            meter.SetInterval(std::max(request->command_as_SetMeterInterval()->interval_ms(), 0));
+            hibiki::sendAck("SET_METER_INTERVAL", true);
+        } else if (command_type == hibiki::ipc::Command_ResetLoudness) {
+            meter.Reset();
+            hibiki::sendAck("RESET_LOUDNESS", true);
+        } else if (command_type == hibiki::ipc::Command_SetAnalyzerTap) {
+            auto cmd = request->command_as_SetAnalyzerTap();
+            if (cmd->enabled()) {
+                hibiki::AnalyzerSettings settings;
+                settings.fft_size = cmd->fft_size();
+                settings.overlap = cmd->overlap();
+                settings.scope_points = cmd->scope_points();
+                settings.scope_ms = cmd->scope_ms();
+                settings.interval_ms = cmd->interval_ms();
+                meter.SetTap(cmd->track_index(), settings);
+            } else {
+                meter.RemoveTap(cmd->track_index());
+            }
+            hibiki::sendAck("SET_ANALYZER_TAP", true);
+        } else if (command_type == hibiki::ipc::Command_Subscribe) {
+            auto cmd = request->command_as_Subscribe();
+            const int interval_ms = std::max(cmd->interval_ms(), 0);
+            bool ok = true;
+            switch ((hibiki::TelemetryTopic)cmd->topic()) {
+                case hibiki::TelemetryTopic::kLevels:
+                    state.level_interval_ms = interval_ms;
+                    state.level_threshold_db = cmd->threshold_db();
+                    state.level_subscriptions++;
+                    break;
+                case hibiki::TelemetryTopic::kTransport:
+                    state.playhead_interval_ms = interval_ms;
+                    break;
+                case hibiki::TelemetryTopic::kStats:
+                    state.stats.interval_ms = interval_ms;
+                    break;
+                case hibiki::TelemetryTopic::kMeters:
+                    meter.SetInterval(interval_ms);
+                    meter.SetThreshold(cmd->threshold_db());
+                    break;
+                default:
+                    ok = false;
+            }
+            hibiki::sendAck("SUBSCRIBE", ok);
+        } else if (command_type == hibiki::ipc::Command_SetTracing) {
+            auto cmd = request->command_as_SetTracing();
+            if (cmd->clear()) hibiki::trace::Clear();
+            hibiki::trace::SetEnabled(cmd->enabled());
+            hibiki::sendAck("SET_TRACING", true);
+        } else if (command_type == hibiki::ipc::Command_DumpTrace) {
+            auto cmd = request->command_as_DumpTrace();
+            bool ok = cmd->path() && hibiki::trace::WriteChromeJson(cmd->path()->str());
+            hibiki::sendAck("DUMP_TRACE", ok);
+        } else if (command_type == hibiki::ipc::Command_SetAdaptiveLatency) {
+            auto cmd = request->command_as_SetAdaptiveLatency();
+            if (cmd->min_block_size() > 0) state.min_block_size = std::min(cmd->min_block_size(), hibiki::kMaxBlockSize);
+            if (cmd->max_block_size() > 0) state.max_block_size = std::min(cmd->max_block_size(), hibiki::kMaxBlockSize);
+            state.adaptive_latency = cmd->enabled();
+            hibiki::WakeAudio(state);
+            hibiki::sendAck("SET_ADAPTIVE_LATENCY", true);
+        } else if (command_type == hibiki::ipc::Command_SetCpuGovernor) {
+            auto cmd = request->command_as_SetCpuGovernor();
+            bool ok = cmd->policy() >= 0 && cmd->policy() <= (int)hibiki::GovernorPolicy::kCutTracks;
+            if (ok) {
+                state.governor_policy = cmd->policy();
+                if (cmd->track_budget() > 0.0f) state.governor_track_budget = cmd->track_budget();
+                if (cmd->overload_intervals() > 0) state.governor_overload_intervals = cmd->overload_intervals();
+                state.governor_generation++;
+            }
+            hibiki::sendAck("SET_CPU_GOVERNOR", ok);
+        } else if (command_type == hibiki::ipc::Command_SetTrackEssential) {
+            auto cmd = request->command_as_SetTrackEssential();
+            std::lock_guard<std::mutex> lock(state.tracks_mutex);
+            hibiki::GetOrCreateTrack(state, cmd->track_index())->essential = cmd->essential();
+            hibiki::sendAck("SET_TRACK_ESSENTIAL", true);
+        } else if (command_type == hibiki::ipc::Command_FreezeTrack) {
+            freezer.Freeze(request->command_as_FreezeTrack()->track_index());
+            hibiki::sendAck("FREEZE_TRACK", true);
+        } else if (command_type == hibiki::ipc::Command_UnfreezeTrack) {
+            freezer.Unfreeze(request->command_as_UnfreezeTrack()->track_index());
+            hibiki::sendAck("UNFREEZE_TRACK", true);
+        } else if (command_type == hibiki::ipc::Command_SetLookahead) {
+            state.lookahead_blocks = std::clamp(request->command_as_SetLookahead()->blocks(), 0, 64);
+            hibiki::WakeAudio(state);
+            hibiki::sendAck("SET_LOOKAHEAD", true);
+        } else if (command_type == hibiki::ipc::Command_SetLaunchQuantization) {
+            int quantization = request->command_as_SetLaunchQuantization()->quantization();
+            bool ok = quantization >= (int)hibiki::LaunchQuantization::kNone && quantization <= (int)hibiki::LaunchQuantization::kSixteenth;
+            if (ok) state.launch_quantization = quantization;
+            hibiki::sendAck("SET_LAUNCH_QUANTIZATION", ok);
+        } else if (command_type == hibiki::ipc::Command_SetFollowAction) {
+            auto cmd = request->command_as_SetFollowAction();
+            bool ok = cmd->action() >= (int)hibiki::FollowAction::kNone && cmd->action() <= (int)hibiki::FollowAction::kFirst;
+            if (ok) {
+                std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                hibiki::GetOrCreateTrack(state, cmd->track_index())
+                    ->SetFollowAction(cmd->slot_index(), (hibiki::FollowAction)cmd->action(), cmd->beats());
+            }
+            hibiki::sendAck("SET_FOLLOW_ACTION", ok);
         } else if (command_type == hibiki::ipc::Command_Quit) {
-            state.quit = true;
-            break;
+            return false;
+        }
+        return true;
+    };
+
+    // Everything that arrived while a turn ran is handled in the next.
+    hibiki::MessageReader reader(std::cin);
+    std::vector<std::vector<uint8_t>> messages;
+    bool quit = false;
+    while (!quit && reader.Take(messages)) {
+        HIBIKI_TRACE_SCOPE("HandleRequests");
+        for (const auto& message : messages) {
+            auto request = hibiki::ipc::GetRequest(message.data());
+            // Parameter changes wait for the end of the turn, each
+            // parameter's latest only, unless another command comes after them.
+            if (auto cmd = request->command_as_SetParamValue()) {
+                params.Add({cmd->track_index(), cmd->plugin_index(), cmd->param_id(), cmd->value()});
+                continue;
+            }
+            params.Apply(state);
+            if (auto batch = request->command_as_Batch()) {
+                HIBIKI_TRACE_SCOPE("Batch");
+                std::vector<hibiki::AckResult> results;
+                // Launches are held back until all are queued, and the routing
+                // and mixer changes published once after the last item, so
+                // that they all reach the same block.
+                state.launch_holds++;
+                {
+                    std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                    hibiki::HoldPublishing(state);
+                }
+                const auto* items = batch->requests();
+                for (flatbuffers::uoffset_t i = 0; items && i < items->size(); ++i) {
+                    const auto* item = items->Get(i);
+                    const uint32_t sequence = item->sequence() ? item->sequence() : request->sequence();
+                    if (item->command_type() == hibiki::ipc::Command_Batch) {
+                        results.push_back({"BATCH", false, sequence});
+                        continue;
+                    }
+                    hibiki::RequestScope scope(sequence, &results);
+                    const size_t acks = results.size();
+                    quit = !handle_command(item);
+                    if (results.size() == acks) results.push_back({hibiki::ipc::EnumNameCommand(item->command_type()), true, sequence});
+                    if (quit) break;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(state.tracks_mutex);
+                    hibiki::ReleasePublishing(state);
+                }
+                state.launch_holds--;
+                hibiki::WakeAudio(state);
+                hibiki::RequestScope scope(request->sequence());
+                hibiki::sendBatchResult(results);
+            } else {
+                hibiki::RequestScope scope(request->sequence());
+                quit = !handle_command(request);
+            }
+            if (quit) break;
         }
+        if (!quit) params.Apply(state);
     }
 
+    state.quit = true;
+    hibiki::WakeAudio(state);
     if (audio_thread.joinable()) audio_thread.join();
     return 0;
 }
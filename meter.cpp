@@ -0,0 +1,349 @@
+#include "meter.hpp"
+#include "dsp.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+namespace hibiki {
+
+namespace {
+
+constexpr auto kPollInterval = std::chrono::milliseconds(5);
+
+float ToDb(double linear) {
+    return linear > 0.0 ? std::max((float)(20.0 * std::log10(linear)), kMeterFloorDb) : kMeterFloorDb;
+}
+
+// BS.1770 loudness of a mean square summed over the channels.
+double ToLufs(double mean_square) {
+    return mean_square > 0.0 ? -0.691 + 10.0 * std::log10(mean_square) : -HUGE_VAL;
+}
+
+bool Moved(const LoudnessMeter::Reading& a, const LoudnessMeter::Reading& b, float threshold_db) {
+    for (auto field : {&LoudnessMeter::Reading::rms_db, &LoudnessMeter::Reading::peak_db,
+                       &LoudnessMeter::Reading::true_peak_db, &LoudnessMeter::Reading::true_peak_max_db,
+                       &LoudnessMeter::Reading::momentary_lufs, &LoudnessMeter::Reading::short_term_lufs,
+                       &LoudnessMeter::Reading::integrated_lufs}) {
+        if (std::abs(a.*field - b.*field) >= threshold_db) return true;
+    }
+    return false;
+}
+
+double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 30; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser-windowed sinc interpolator, 4 phases, each normalised to unity gain
+// at DC. Reads within 0.3 dB of the true peak up to 0.45 fs.
+std::vector<float> TruePeakTaps(int taps_per_phase) {
+    const int n = 4 * taps_per_phase;
+    const double centre = (n - 1) / 2.0;
+    constexpr double kBeta = 3.0;
+    std::vector<double> h(n);
+    for (int j = 0; j < n; ++j) {
+        const double t = (j - centre) / 4.0;
+        const double sinc = t == 0.0 ? 1.0 : std::sin(std::numbers::pi * t) / (std::numbers::pi * t);
+        const double x = (j - centre) / centre;
+        h[j] = sinc * BesselI0(kBeta * std::sqrt(1.0 - x * x)) / BesselI0(kBeta);
+    }
+    std::vector<float> taps(n);
+    for (int p = 0; p < 4; ++p) {
+        double gain = 0.0;
+        for (int j = p; j < n; j += 4) gain += h[j];
+        for (int j = p; j < n; j += 4) taps[j] = (float)(h[j] / gain);
+    }
+    return taps;
+}
+
+} // namespace
+
+// K-weighting coefficients for any sample rate, from the analog prototypes
+// of the BS.1770 filters.
+LoudnessMeter::LoudnessMeter(double sample_rate)
+    : step_frames_(std::max(1, (int)std::lround(sample_rate / 10.0))),
+      taps_(TruePeakTaps(kTruePeakTaps)),
+      history_l_(kTruePeakTaps - 1, 0.0f),
+      history_r_(kTruePeakTaps - 1, 0.0f) {
+    {
+        const double f0 = 1681.974450955533, gain_db = 3.999843853973347, q = 0.7071752369554196;
+        const double k = std::tan(std::numbers::pi * f0 / sample_rate);
+        const double vh = std::pow(10.0, gain_db / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        const Biquad shelf{(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                           2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+        shelf_ = {shelf, shelf};
+    }
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        const double k = std::tan(std::numbers::pi * f0 / sample_rate);
+        const double a0 = 1.0 + k / q + k * k;
+        const Biquad high_pass{1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+        high_pass_ = {high_pass, high_pass};
+    }
+}
+
+void LoudnessMeter::Process(const float* l, const float* r, int n) {
+    const auto& kernels = dsp::Active();
+    raw_energy_ += (double)kernels.sum_squares(l, n) + kernels.sum_squares(r, n);
+    raw_frames_ += n;
+    peak_ = std::max({peak_, kernels.abs_peak(l, n), kernels.abs_peak(r, n)});
+    true_peak_ = std::max({true_peak_, TruePeak(history_l_, l, n), TruePeak(history_r_, r, n)});
+    true_peak_max_ = std::max(true_peak_max_, true_peak_);
+
+    if ((int)weighted_l_.size() < n) {
+        weighted_l_.resize(n);
+        weighted_r_.resize(n);
+    }
+    for (int done = 0; done < n;) {
+        const int chunk = std::min(n - done, step_frames_ - step_pos_);
+        for (int i = 0; i < chunk; ++i) {
+            weighted_l_[i] = (float)high_pass_[0].Run(shelf_[0].Run(l[done + i]));
+            weighted_r_[i] = (float)high_pass_[1].Run(shelf_[1].Run(r[done + i]));
+        }
+        step_energy_ += (double)kernels.sum_squares(weighted_l_.data(), chunk) + kernels.sum_squares(weighted_r_.data(), chunk);
+        step_pos_ += chunk;
+        done += chunk;
+        if (step_pos_ == step_frames_) EndStep();
+    }
+}
+
+float LoudnessMeter::TruePeak(std::vector<float>& history, const float* src, int n) {
+    // The interpolator reads kTruePeakTaps - 1 samples back, into history.
+    const int keep = kTruePeakTaps - 1;
+    history.resize(keep + n);
+    std::copy_n(src, n, history.begin() + keep);
+    const float peak = dsp::Upsample4AbsPeak(history.data() + keep, n, taps_.data(), kTruePeakTaps);
+    std::copy(history.end() - keep, history.end(), history.begin());
+    history.resize(keep);
+    return peak;
+}
+
+void LoudnessMeter::EndStep() {
+    steps_[step_count_ % kStepsShortTerm] = step_energy_;
+    step_count_++;
+    step_energy_ = 0.0;
+    step_pos_ = 0;
+
+    // Gating blocks are 400 ms long and start every 100 ms.
+    if (step_count_ < kStepsMomentary) return;
+    double energy = 0.0;
+    for (int i = 1; i <= kStepsMomentary; ++i) energy += steps_[(step_count_ - i) % kStepsShortTerm];
+    const double mean_square = energy / ((double)kStepsMomentary * step_frames_);
+    const double lufs = ToLufs(mean_square);
+    if (lufs < kHistogramMin) return;
+    const int bin = std::min((int)((lufs - kHistogramMin) / (kHistogramMax - kHistogramMin) * kHistogramBins), kHistogramBins - 1);
+    gated_energy_[bin] += mean_square;
+    gated_count_[bin]++;
+}
+
+float LoudnessMeter::WindowLoudness(int steps) const {
+    // Until the window has filled, over what there is.
+    const int have = (int)std::min<int64_t>(steps, step_count_);
+    if (have == 0) return kMeterFloorDb;
+    double energy = 0.0;
+    for (int i = 1; i <= have; ++i) energy += steps_[(step_count_ - i) % kStepsShortTerm];
+    return std::max((float)ToLufs(energy / ((double)have * step_frames_)), kMeterFloorDb);
+}
+
+float LoudnessMeter::IntegratedLoudness() const {
+    double energy = 0.0;
+    uint64_t count = 0;
+    for (int i = 0; i < kHistogramBins; ++i) {
+        energy += gated_energy_[i];
+        count += gated_count_[i];
+    }
+    if (count == 0) return kMeterFloorDb;
+    // The relative gate, 10 LU below the absolute-gated loudness, lands on a
+    // bin; the bins whose centre clears it count.
+    const double gate = ToLufs(energy / count) - 10.0;
+    energy = 0.0;
+    count = 0;
+    for (int i = 0; i < kHistogramBins; ++i) {
+        const double centre = kHistogramMin + (i + 0.5) * (kHistogramMax - kHistogramMin) / kHistogramBins;
+        if (centre < gate) continue;
+        energy += gated_energy_[i];
+        count += gated_count_[i];
+    }
+    return count == 0 ? kMeterFloorDb : (float)ToLufs(energy / count);
+}
+
+LoudnessMeter::Reading LoudnessMeter::TakeReading() {
+    Reading reading;
+    reading.rms_db = raw_frames_ > 0 ? ToDb(std::sqrt(raw_energy_ / (2.0 * raw_frames_))) : kMeterFloorDb;
+    reading.peak_db = ToDb(peak_);
+    reading.true_peak_db = ToDb(true_peak_);
+    reading.true_peak_max_db = ToDb(true_peak_max_);
+    reading.momentary_lufs = WindowLoudness(kStepsMomentary);
+    reading.short_term_lufs = WindowLoudness(kStepsShortTerm);
+    reading.integrated_lufs = IntegratedLoudness();
+    raw_energy_ = 0.0;
+    raw_frames_ = 0;
+    peak_ = 0.0f;
+    true_peak_ = 0.0f;
+    return reading;
+}
+
+void LoudnessMeter::Reset() {
+    gated_energy_.fill(0.0);
+    gated_count_.fill(0);
+    true_peak_max_ = 0.0f;
+}
+
+MeterWorker::MeterWorker(Callback report, AnalysisCallback analysis, int ring_frames)
+    : report_(std::move(report)),
+      analysis_(std::move(analysis)),
+      ring_(std::bit_ceil((size_t)ring_frames * 2)),
+      mask_(ring_.size() - 1),
+      thread_([this] { Run(); }) {}
+
+MeterWorker::~MeterWorker() {
+    quit_.store(true);
+    thread_.join();
+}
+
+// A block is a header of two floats, the source and the frame count, then
+// the left and the right channel; it may wrap around the end of the ring.
+void MeterWorker::Push(int source, const float* l, const float* r, int n) {
+    const uint64_t write = write_.load(std::memory_order_relaxed);
+    const uint64_t size = 2 + 2 * (uint64_t)n;
+    if (write + size - read_.load(std::memory_order_acquire) > ring_.size()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const int32_t header_values[2] = {source, n};
+    float header[2];
+    std::memcpy(header, header_values, sizeof(header));
+    CopyIn(write, header, 2);
+    CopyIn(write + 2, l, n);
+    CopyIn(write + 2 + n, r, n);
+    write_.store(write + size, std::memory_order_release);
+}
+
+bool MeterWorker::Pop(uint64_t end, int& source, int& n) {
+    const uint64_t read = read_.load(std::memory_order_relaxed);
+    if (read == end) return false;
+    float header[2];
+    CopyOut(read, header, 2);
+    int32_t header_values[2];
+    std::memcpy(header_values, header, sizeof(header));
+    source = header_values[0];
+    n = header_values[1];
+    if ((int)block_l_.size() < n) {
+        block_l_.resize(n);
+        block_r_.resize(n);
+    }
+    CopyOut(read + 2, block_l_.data(), n);
+    CopyOut(read + 2 + n, block_r_.data(), n);
+    read_.store(read + 2 + 2 * (uint64_t)n, std::memory_order_release);
+    return true;
+}
+
+void MeterWorker::CopyIn(uint64_t pos, const float* src, int count) {
+    const size_t start = pos & mask_;
+    const size_t first = std::min<size_t>(count, ring_.size() - start);
+    std::copy_n(src, first, ring_.data() + start);
+    std::copy_n(src + first, count - first, ring_.data());
+}
+
+void MeterWorker::CopyOut(uint64_t pos, float* dst, int count) const {
+    const size_t start = pos & mask_;
+    const size_t first = std::min<size_t>(count, ring_.size() - start);
+    std::copy_n(ring_.data() + start, first, dst);
+    std::copy_n(ring_.data(), count - first, dst + first);
+}
+
+void MeterWorker::SetTap(int source, const AnalyzerSettings& settings) {
+    std::lock_guard<std::mutex> lock(taps_mutex_);
+    tap_settings_[source] = settings.Clamped();
+    taps_changed_.store(true);
+}
+
+void MeterWorker::RemoveTap(int source) {
+    std::lock_guard<std::mutex> lock(taps_mutex_);
+    tap_settings_.erase(source);
+    taps_changed_.store(true);
+}
+
+// Brings taps_ in line with tap_settings_, keeping the analyzers whose
+// settings are unchanged unless rebuild is set.
+void MeterWorker::UpdateTaps(double sample_rate, bool rebuild) {
+    std::lock_guard<std::mutex> lock(taps_mutex_);
+    std::erase_if(taps_, [&](const auto& entry) { return !tap_settings_.count(entry.first); });
+    for (const auto& [source, settings] : tap_settings_) {
+        auto it = taps_.find(source);
+        if (it != taps_.end() && !rebuild && it->second.analyzer.settings() == settings) continue;
+        if (it != taps_.end()) taps_.erase(it);
+        taps_.emplace(source, Tap{Analyzer(sample_rate, settings), false, {}});
+    }
+}
+
+void MeterWorker::Run() {
+    trace::SetThreadName("meter");
+    auto last_report = std::chrono::steady_clock::now();
+    double sample_rate = 0.0;
+    while (!quit_.load()) {
+        const double new_rate = sample_rate_.load(std::memory_order_relaxed);
+        const bool rate_changed = new_rate != sample_rate;
+        sample_rate = new_rate;
+        if (taps_changed_.exchange(false) || rate_changed) UpdateTaps(sample_rate, rate_changed);
+        {
+            HIBIKI_TRACE_SCOPE("MeterWorker::Drain");
+            // Only what is there now, so that a flood of blocks cannot hold
+            // the reports up.
+            const uint64_t end = write_.load(std::memory_order_acquire);
+            int source, n;
+            while (Pop(end, source, n)) {
+                auto& entry = sources_.try_emplace(source, Source{LoudnessMeter(sample_rate), sample_rate}).first->second;
+                if (entry.sample_rate != sample_rate) entry = Source{LoudnessMeter(sample_rate), sample_rate};
+                entry.meter.Process(block_l_.data(), block_r_.data(), n);
+                entry.fresh = true;
+                if (auto tap = taps_.find(source); tap != taps_.end()) {
+                    tap->second.analyzer.Process(block_l_.data(), block_r_.data(), n);
+                    tap->second.fresh = true;
+                }
+            }
+        }
+        if (reset_.exchange(false, std::memory_order_relaxed)) {
+            for (auto& [index, entry] : sources_) entry.meter.Reset();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        const int interval_ms = interval_ms_.load(std::memory_order_relaxed);
+        if (interval_ms > 0 && now - last_report >= std::chrono::milliseconds(interval_ms)) {
+            last_report = now;
+            MeterReport report;
+            const float threshold = threshold_db_.load(std::memory_order_relaxed);
+            for (auto& [index, entry] : sources_) {
+                if (!entry.fresh) continue;
+                entry.fresh = false;
+                auto reading = entry.meter.TakeReading();
+                if (!Moved(entry.sent, reading, threshold)) continue;
+                entry.sent = reading;
+                report.sources.push_back({index, reading});
+            }
+            report.dropped_blocks = dropped_.exchange(0, std::memory_order_relaxed);
+            if (report_ && (!report.sources.empty() || report.dropped_blocks > 0)) report_(report);
+        }
+        for (auto& [index, tap] : taps_) {
+            if (!tap.fresh || now - tap.last_frame < std::chrono::milliseconds(tap.analyzer.settings().interval_ms)) continue;
+            HIBIKI_TRACE_SCOPE("MeterWorker::Analyze");
+            tap.fresh = false;
+            tap.last_frame = now;
+            frame_.track_index = index;
+            tap.analyzer.TakeFrame(frame_);
+            if (analysis_) analysis_(frame_);
+        }
+        std::this_thread::sleep_for(kPollInterval);
+    }
+}
+
+} // namespace hibiki
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "analyzer.hpp"
+
+namespace hibiki {
+
+// Readings below this, silence included, are reported as this.
+constexpr float kMeterFloorDb = -144.0f;
+
+// Broadcast metering of one stereo signal after ITU-R BS.1770-4 and EBU R 128:
+// K-weighted momentary (400 ms), short-term (3 s) and gated integrated
+// loudness, 4x oversampled true peak, and plain RMS and sample peak.
+// Not thread-safe; see MeterWorker.
+class LoudnessMeter {
+public:
+    struct Reading {
+        // Since the previous reading.
+        float rms_db = kMeterFloorDb;
+        float peak_db = kMeterFloorDb;
+        float true_peak_db = kMeterFloorDb;
+        // Since Reset.
+        float true_peak_max_db = kMeterFloorDb;
+        float momentary_lufs = kMeterFloorDb;
+        float short_term_lufs = kMeterFloorDb;
+        float integrated_lufs = kMeterFloorDb;
+    };
+
+    explicit LoudnessMeter(double sample_rate);
+
+    void Process(const float* l, const float* r, int n);
+    Reading TakeReading();
+    // Starts the integrated loudness and the true-peak maximum over.
+    void Reset();
+
+private:
+    // Transposed direct form II, in double: the high-pass stage sits far
+    // below the sample rate.
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+        double z1 = 0.0, z2 = 0.0;
+        double Run(double x) {
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+    static constexpr int kTruePeakTaps = 12; // per phase
+    // 100 ms steps; short-term loudness spans 30 of them.
+    static constexpr int kStepsShortTerm = 30;
+    static constexpr int kStepsMomentary = 4;
+    // Gating blocks from -70 LUFS (the absolute gate) to +5 LUFS.
+    static constexpr int kHistogramBins = 1000;
+    static constexpr double kHistogramMin = -70.0;
+    static constexpr double kHistogramMax = 5.0;
+
+    void EndStep();
+    float WindowLoudness(int steps) const;
+    float IntegratedLoudness() const;
+    float TruePeak(std::vector<float>& history, const float* src, int n);
+
+    int step_frames_;
+    std::array<Biquad, 2> shelf_;
+    std::array<Biquad, 2> high_pass_;
+    std::vector<float> weighted_l_, weighted_r_;
+
+    double step_energy_ = 0.0;
+    int step_pos_ = 0;
+    // Sum of squares of each finished step, a ring of the last 30.
+    std::array<double, kStepsShortTerm> steps_{};
+    int64_t step_count_ = 0;
+    std::array<double, kHistogramBins> gated_energy_{};
+    std::array<uint32_t, kHistogramBins> gated_count_{};
+
+    double raw_energy_ = 0.0;
+    int64_t raw_frames_ = 0;
+    float peak_ = 0.0f;
+    float true_peak_ = 0.0f;
+    float true_peak_max_ = 0.0f;
+    std::vector<float> taps_;
+    std::vector<float> history_l_, history_r_;
+};
+
+// Every interval, one LoudnessMeter::Reading per source that sent blocks
+// during it.
+struct MeterReport {
+    struct Source {
+        int track_index; // MeterWorker::kMaster for the master bus
+        LoudnessMeter::Reading reading;
+    };
+    std::vector<Source> sources;
+    // Blocks lost because the worker fell behind.
+    uint32_t dropped_blocks = 0;
+};
+
+// Runs the meters and the analyzer taps on a background thread. The audio
+// thread only copies each block of every track and of the master bus into a
+// lock-free ring; the worker drains it every few milliseconds and reports
+// through the callbacks.
+class MeterWorker {
+public:
+    static constexpr int kMaster = -1;
+    using Callback = std::function<void(const MeterReport&)>;
+    using AnalysisCallback = std::function<void(const AnalysisFrame&)>;
+
+    // ring_frames bounds how many stereo frames, over all sources, may wait.
+    explicit MeterWorker(Callback report, AnalysisCallback analysis = {}, int ring_frames = 1 << 18);
+    ~MeterWorker();
+
+    MeterWorker(const MeterWorker&) = delete;
+    MeterWorker& operator=(const MeterWorker&) = delete;
+
+    // Audio thread: queues a copy of the block, or drops it if there is no room.
+    void Push(int source, const float* l, const float* r, int n);
+    // Report period; 0 stops the reports, not the metering.
+    void SetInterval(int interval_ms) { interval_ms_.store(interval_ms, std::memory_order_relaxed); }
+    // Leaves a source out of a report unless one of its readings moved by at
+    // least this since it was last reported; 0, the default, reports all.
+    void SetThreshold(float threshold_db) { threshold_db_.store(threshold_db, std::memory_order_relaxed); }
+    // Starts every source's integrated loudness and true-peak maximum over.
+    void Reset() { reset_.store(true, std::memory_order_relaxed); }
+    // Of the blocks pushed from now on (44.1 kHz until set); a change starts
+    // the meters and taps over.
+    void SetSampleRate(double sample_rate) { sample_rate_.store(sample_rate, std::memory_order_relaxed); }
+
+    // Any thread: analyzes a source with the given settings, replacing its
+    // tap if it had one, which sends an AnalysisFrame every
+    // settings.interval_ms while the source plays.
+    void SetTap(int source, const AnalyzerSettings& settings);
+    void RemoveTap(int source);
+
+private:
+    void Run();
+    // Takes the next block before the ring position end.
+    bool Pop(uint64_t end, int& source, int& n);
+    void CopyIn(uint64_t pos, const float* src, int count);
+    void CopyOut(uint64_t pos, float* dst, int count) const;
+
+    void UpdateTaps(double sample_rate, bool rebuild);
+
+    std::atomic<double> sample_rate_{44100.0};
+    Callback report_;
+    AnalysisCallback analysis_;
+    std::vector<float> ring_;
+    uint64_t mask_;
+    std::atomic<uint64_t> write_{0};
+    std::atomic<uint64_t> read_{0};
+    std::atomic<uint32_t> dropped_{0};
+    std::atomic<int> interval_ms_{100};
+    std::atomic<float> threshold_db_{0.0f};
+    std::atomic<bool> reset_{false};
+    std::atomic<bool> quit_{false};
+    std::mutex taps_mutex_;
+    std::map<int, AnalyzerSettings> tap_settings_;
+    std::atomic<bool> taps_changed_{false};
+
+    // Worker thread only.
+    struct Source {
+        LoudnessMeter meter;
+        double sample_rate;
+        bool fresh = false; // got blocks since the last report
+        LoudnessMeter::Reading sent{};
+    };
+    struct Tap {
+        Analyzer analyzer;
+        bool fresh = false;
+        std::chrono::steady_clock::time_point last_frame;
+    };
+    std::vector<float> block_l_, block_r_;
+    std::map<int, Source> sources_;
+    std::map<int, Tap> taps_;
+    AnalysisFrame frame_;
+    std::thread thread_;
+};
+
+} // namespace hibiki
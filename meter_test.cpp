@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "meter.hpp"
+
+#include <cmath>
+#include <future>
+#include <numbers>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 480;
+
+// Feeds seconds of a sine of the given peak level to both channels.
+void FeedSine(hibiki::LoudnessMeter& meter, double seconds, double level_db, double freq = 1000.0, double phase = 0.0) {
+    const double amplitude = std::pow(10.0, level_db / 20.0);
+    std::vector<float> block(kBlockSize);
+    const int64_t frames = std::llround(seconds * kSampleRate);
+    for (int64_t pos = 0; pos < frames; pos += kBlockSize) {
+        for (int i = 0; i < kBlockSize; ++i) {
+            block[i] = (float)(amplitude * std::sin(2.0 * std::numbers::pi * freq * (pos + i) / kSampleRate + phase));
+        }
+        meter.Process(block.data(), block.data(), kBlockSize);
+    }
+}
+
+// EBU Tech 3341, test 1: -23 dBFS per channel reads -23 LUFS.
+TEST(MeterTest, SineReadsItsLoudness) {
+    hibiki::LoudnessMeter meter(kSampleRate);
+    FeedSine(meter, 20.0, -23.0);
+    auto reading = meter.TakeReading();
+    EXPECT_NEAR(reading.momentary_lufs, -23.0f, 0.1f);
+    EXPECT_NEAR(reading.short_term_lufs, -23.0f, 0.1f);
+    EXPECT_NEAR(reading.integrated_lufs, -23.0f, 0.1f);
+    EXPECT_NEAR(reading.rms_db, -26.01f, 0.05f);
+    EXPECT_NEAR(reading.peak_db, -23.0f, 0.05f);
+}
+
+// EBU Tech 3341, test 3: the relative gate leaves out the quiet parts.
+TEST(MeterTest, IntegratedLoudnessIsGated) {
+    hibiki::LoudnessMeter meter(kSampleRate);
+    FeedSine(meter, 10.0, -36.0);
+    FeedSine(meter, 60.0, -23.0);
+    FeedSine(meter, 10.0, -36.0);
+    auto reading = meter.TakeReading();
+    EXPECT_NEAR(reading.integrated_lufs, -23.0f, 0.1f);
+    EXPECT_NEAR(reading.short_term_lufs, -36.0f, 0.1f);
+
+    meter.Reset();
+    FeedSine(meter, 5.0, -30.0);
+    EXPECT_NEAR(meter.TakeReading().integrated_lufs, -30.0f, 0.1f);
+}
+
+TEST(MeterTest, TruePeakFindsPeaksBetweenSamples) {
+    hibiki::LoudnessMeter meter(kSampleRate);
+    // At fs/4, 45 degrees off, every sample misses the crest by 3 dB.
+    FeedSine(meter, 1.0, 0.0, kSampleRate / 4, std::numbers::pi / 4);
+    auto reading = meter.TakeReading();
+    EXPECT_NEAR(reading.peak_db, -3.01f, 0.05f);
+    EXPECT_NEAR(reading.true_peak_db, 0.0f, 0.2f);
+    EXPECT_NEAR(reading.true_peak_max_db, 0.0f, 0.2f);
+
+    // Silence, once the interpolator has rung out: the maximum stays, the
+    // rest reads the floor.
+    std::vector<float> silence(kBlockSize);
+    meter.Process(silence.data(), silence.data(), kBlockSize);
+    meter.TakeReading();
+    for (int i = 0; i < 100; ++i) meter.Process(silence.data(), silence.data(), kBlockSize);
+    reading = meter.TakeReading();
+    EXPECT_EQ(reading.true_peak_db, hibiki::kMeterFloorDb);
+    EXPECT_EQ(reading.rms_db, hibiki::kMeterFloorDb);
+    EXPECT_NEAR(reading.true_peak_max_db, 0.0f, 0.2f);
+}
+
+TEST(MeterTest, WorkerReportsEachSource) {
+    std::promise<hibiki::MeterReport> reported;
+    bool done = false;
+    hibiki::MeterWorker worker([&](const hibiki::MeterReport& report) {
+        if (done || report.sources.size() < 2) return;
+        done = true;
+        reported.set_value(report);
+    });
+    worker.SetSampleRate(kSampleRate);
+    worker.SetInterval(1);
+    std::vector<float> loud(kBlockSize, 0.5f), quiet(kBlockSize, 0.25f);
+    worker.Push(3, loud.data(), loud.data(), kBlockSize);
+    worker.Push(hibiki::MeterWorker::kMaster, quiet.data(), quiet.data(), kBlockSize);
+
+    auto report = reported.get_future().get();
+    ASSERT_EQ(report.sources.size(), 2u);
+    EXPECT_EQ(report.sources[0].track_index, hibiki::MeterWorker::kMaster);
+    EXPECT_NEAR(report.sources[0].reading.peak_db, -12.04f, 0.01f);
+    EXPECT_EQ(report.sources[1].track_index, 3);
+    EXPECT_NEAR(report.sources[1].reading.rms_db, -6.02f, 0.01f);
+}
+
+TEST(MeterTest, WorkerDropsBlocksWhenFull) {
+    std::promise<uint32_t> dropped;
+    bool done = false;
+    hibiki::MeterWorker worker([&](const hibiki::MeterReport& report) {
+        if (done) return;
+        done = true;
+        dropped.set_value(report.dropped_blocks);
+    }, {}, kBlockSize);
+    worker.SetInterval(0);
+    std::vector<float> block(kBlockSize, 0.1f);
+    // The ring holds one block and its header; the worker drains it every
+    // few milliseconds.
+    for (int i = 0; i < 100; ++i) worker.Push(0, block.data(), block.data(), kBlockSize);
+    worker.SetInterval(1);
+    EXPECT_GE(dropped.get_future().get(), 1u);
+}
+
+TEST(MeterTest, WorkerAnalyzesTappedSources) {
+    std::promise<hibiki::AnalysisFrame> analyzed;
+    bool done = false;
+    hibiki::MeterWorker worker({}, [&](const hibiki::AnalysisFrame& frame) {
+        if (done) return;
+        done = true;
+        analyzed.set_value(frame);
+    });
+    worker.SetSampleRate(kSampleRate);
+    hibiki::AnalyzerSettings settings;
+    settings.fft_size = 256;
+    settings.scope_points = 8;
+    settings.interval_ms = 1;
+    worker.SetTap(2, settings);
+    worker.SetTap(3, settings);
+    worker.RemoveTap(3);
+
+    // The worker picks the taps up on its next pass.
+    std::vector<float> block(kBlockSize, 0.5f);
+    auto future = analyzed.get_future();
+    do {
+        worker.Push(3, block.data(), block.data(), kBlockSize);
+        worker.Push(2, block.data(), block.data(), kBlockSize);
+    } while (future.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready);
+    auto frame = future.get();
+    EXPECT_EQ(frame.track_index, 2);
+    EXPECT_EQ(frame.fft_size, 256);
+    ASSERT_EQ(frame.spectrum.size(), 129u);
+    ASSERT_EQ(frame.scope.size(), 16u);
+    EXPECT_EQ(frame.scope.back(), 64);
+}
+
+} // namespace
@@ -0,0 +1,47 @@
+#include "mixer.hpp"
+#include "dsp.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace hibiki {
+
+MixerStrip::Gains MixerStrip::PanGains(float volume, float pan) {
+    volume = std::max(volume, 0.0f);
+    if (pan == 0.0f) return {volume, volume};
+    float theta = (std::clamp(pan, -1.0f, 1.0f) + 1.0f) * (float)(std::numbers::pi / 4);
+    float g = volume * std::numbers::sqrt2_v<float>;
+    return {g * std::cos(theta), g * std::sin(theta)};
+}
+
+void MixerStrip::Process(float* l, float* r, int num_samples, double sample_rate, bool audible) {
+    Gains target = audible ? PanGains(volume.load(std::memory_order_relaxed), pan.load(std::memory_order_relaxed))
+                           : Gains{0.0f, 0.0f};
+    if (snap_.exchange(false, std::memory_order_relaxed)) {
+        applied_ = ramp_to_ = target;
+        ramp_left_ = 0;
+    }
+    // A new target restarts the ramp from wherever the gains are now.
+    if (target.l != ramp_to_.l || target.r != ramp_to_.r) {
+        ramp_to_ = target;
+        ramp_left_ = std::max(1, (int)std::lround(kGainRampSeconds * sample_rate));
+    }
+    const int ramped = std::min(ramp_left_, num_samples);
+    if (ramped > 0) {
+        const float t = (float)ramped / (float)ramp_left_;
+        Gains end = ramped == ramp_left_ ? target
+                                         : Gains{applied_.l + (target.l - applied_.l) * t,
+                                                 applied_.r + (target.r - applied_.r) * t};
+        dsp::ApplyGainRamp(l, ramped, applied_.l, end.l);
+        dsp::ApplyGainRamp(r, ramped, applied_.r, end.r);
+        applied_ = end;
+        ramp_left_ -= ramped;
+    }
+    if (ramped < num_samples) {
+        dsp::ApplyGainRamp(l + ramped, num_samples - ramped, applied_.l, applied_.l);
+        dsp::ApplyGainRamp(r + ramped, num_samples - ramped, applied_.r, applied_.r);
+    }
+}
+
+} // namespace hibiki
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+
+namespace hibiki {
+
+// Time a gain change takes to reach its target, whatever the block size.
+constexpr double kGainRampSeconds = 0.01;
+
+// Built-in fader, pan, mute and solo for a track or the master bus.
+// The IPC thread writes the targets; the audio thread ramps the applied
+// gains towards them over kGainRampSeconds, across blocks, so changes never
+// click or zipper.
+class MixerStrip {
+public:
+    std::atomic<float> volume{1.0f}; // linear gain
+    std::atomic<float> pan{0.0f};    // -1 (left) .. 1 (right)
+    std::atomic<bool> mute{false};
+    std::atomic<bool> solo{false};
+
+    struct Gains {
+        float l;
+        float r;
+    };
+
+    // The targets the IPC thread sets, taken or stored together.
+    struct Targets {
+        float volume;
+        float pan;
+        bool mute;
+        bool solo;
+    };
+    Targets targets() const {
+        return {volume.load(std::memory_order_relaxed), pan.load(std::memory_order_relaxed),
+                mute.load(std::memory_order_relaxed), solo.load(std::memory_order_relaxed)};
+    }
+    void SetTargets(const Targets& targets) {
+        volume.store(targets.volume, std::memory_order_relaxed);
+        pan.store(targets.pan, std::memory_order_relaxed);
+        mute.store(targets.mute, std::memory_order_relaxed);
+        solo.store(targets.solo, std::memory_order_relaxed);
+    }
+
+    // Constant-power pan law, normalised so the centre position is unity gain.
+    static Gains PanGains(float volume, float pan);
+
+    // Applies the strip in place. audible = false (muted, or another track is
+    // soloed) fades the output to silence instead of cutting it.
+    void Process(float* l, float* r, int num_samples, double sample_rate, bool audible);
+
+    // Any thread: the next Process starts at the targets instead of ramping
+    // from the gains it had reached. New strips start so;
+    // a track snaps when it starts rendering again, since its targets may
+    // have changed while it was silent.
+    void Snap() { snap_.store(true, std::memory_order_relaxed); }
+
+    // True once the strip has fully faded out, so its output can be skipped.
+    bool IsSilent() const { return applied_.l == 0.0f && applied_.r == 0.0f; }
+
+private:
+    // Audio thread only: the gains reached at the end of the last block, and
+    // the target the running ramp heads for with the frames it has left.
+    Gains applied_{1.0f, 1.0f};
+    Gains ramp_to_{1.0f, 1.0f};
+    int ramp_left_ = 0;
+    std::atomic<bool> snap_{true};
+};
+
+// Mute/solo matrix: a strip is heard unless muted, or unless some other strip is soloed.
+inline bool IsAudible(const MixerStrip& strip, bool any_solo) {
+    if (strip.mute.load(std::memory_order_relaxed)) return false;
+    return !any_solo || strip.solo.load(std::memory_order_relaxed);
+}
+
+} // namespace hibiki
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "mixer.hpp"
+
+#include <cmath>
+#include <vector>
+
+TEST(MixerTest, CentrePanIsUnity) {
+    auto g = hibiki::MixerStrip::PanGains(1.0f, 0.0f);
+    EXPECT_FLOAT_EQ(g.l, 1.0f);
+    EXPECT_FLOAT_EQ(g.r, 1.0f);
+}
+
+TEST(MixerTest, PanIsConstantPower) {
+    for (float pan : {-1.0f, -0.5f, 0.25f, 1.0f}) {
+        auto g = hibiki::MixerStrip::PanGains(0.5f, pan);
+        EXPECT_NEAR(g.l * g.l + g.r * g.r, 2.0f * 0.25f, 1e-5f) << pan;
+    }
+    auto left = hibiki::MixerStrip::PanGains(1.0f, -1.0f);
+    EXPECT_NEAR(left.r, 0.0f, 1e-6f);
+}
+
+TEST(MixerTest, VolumeChangeIsRamped) {
+    constexpr double kSampleRate = 48000.0; // the ramp takes 480 frames
+    hibiki::MixerStrip strip;
+    std::vector<float> l(64, 1.0f), r(64, 1.0f);
+    strip.Process(l.data(), r.data(), 64, kSampleRate, true);
+    strip.volume = 0.0f;
+    std::fill(l.begin(), l.end(), 1.0f);
+    std::fill(r.begin(), r.end(), 1.0f);
+    strip.Process(l.data(), r.data(), 64, kSampleRate, true);
+    EXPECT_FLOAT_EQ(l.front(), 1.0f);
+    EXPECT_NEAR(l.back(), 1.0f - 64.0f / 480.0f, 5e-3f);
+    EXPECT_FALSE(strip.IsSilent());
+
+    // Later blocks carry on from where the ramp got to.
+    float last = l.back();
+    for (int block = 1; block < 8; ++block) {
+        std::fill(l.begin(), l.end(), 1.0f);
+        std::fill(r.begin(), r.end(), 1.0f);
+        strip.Process(l.data(), r.data(), 64, kSampleRate, true);
+        EXPECT_LE(l.front(), last);
+        last = l.back();
+    }
+    EXPECT_FLOAT_EQ(l.back(), 0.0f);
+    EXPECT_TRUE(strip.IsSilent());
+}
+
+TEST(MixerTest, RampLengthDoesNotDependOnBlockSize) {
+    constexpr double kSampleRate = 48000.0;
+    auto gain_after = [&](int block_size, int frames) {
+        hibiki::MixerStrip strip;
+        std::vector<float> l(block_size), r(block_size);
+        strip.Process(l.data(), r.data(), block_size, kSampleRate, true);
+        strip.volume = 0.5f;
+        float gain = 1.0f;
+        for (int done = 0; done < frames; done += block_size) {
+            std::fill(l.begin(), l.end(), 1.0f);
+            std::fill(r.begin(), r.end(), 1.0f);
+            strip.Process(l.data(), r.data(), block_size, kSampleRate, true);
+            gain = l.back();
+        }
+        return gain;
+    };
+    EXPECT_NEAR(gain_after(32, 256), gain_after(256, 256), 1e-4f);
+    EXPECT_GT(gain_after(256, 256), 0.5f);
+    EXPECT_FLOAT_EQ(gain_after(32, 512), 0.5f);
+    EXPECT_FLOAT_EQ(gain_after(512, 512), 0.5f);
+}
+
+TEST(MixerTest, SnapSkipsTheRamp) {
+    // A strip muted before it ever ran does not leak its first block.
+    hibiki::MixerStrip strip;
+    strip.mute = true;
+    std::vector<float> l(64, 1.0f), r(64, 1.0f);
+    strip.Process(l.data(), r.data(), 64, 48000.0, hibiki::IsAudible(strip, false));
+    EXPECT_FLOAT_EQ(l.front(), 0.0f);
+    EXPECT_TRUE(strip.IsSilent());
+
+    // Nor does a fader moved while it was not rendering ramp from the old gain.
+    strip.mute = false;
+    strip.volume = 0.5f;
+    strip.Snap();
+    std::fill(l.begin(), l.end(), 1.0f);
+    std::fill(r.begin(), r.end(), 1.0f);
+    strip.Process(l.data(), r.data(), 64, 48000.0, true);
+    EXPECT_FLOAT_EQ(l.front(), 0.5f);
+    EXPECT_FLOAT_EQ(r.back(), 0.5f);
+}
+
+TEST(MixerTest, MuteSoloMatrix) {
+    hibiki::MixerStrip plain, soloed, muted;
+    soloed.solo = true;
+    muted.mute = true;
+    EXPECT_TRUE(hibiki::IsAudible(plain, false));
+    EXPECT_FALSE(hibiki::IsAudible(plain, true));
+    EXPECT_TRUE(hibiki::IsAudible(soloed, true));
+    EXPECT_FALSE(hibiki::IsAudible(muted, false));
+    muted.solo = true;
+    EXPECT_FALSE(hibiki::IsAudible(muted, true));
+}
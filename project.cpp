@@ -1,17 +1,269 @@
 #include "project.hpp"
+#include "routing.hpp"
 #include "hibiki_project_generated.h"
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <thread>
+#include <utility>
 
 namespace hibiki {
 
+void WaitForBlockBoundary(ProjectState& state) {
+    // Pairs with the fence at the start of Engine::Process: either that block
+    // sees what was stored before this call, or it shows up here as running.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint64_t start = state.blocks_rendered.load(std::memory_order_acquire);
+    if (!state.rendering_block.load(std::memory_order_acquire)) return;
+    while (state.blocks_rendered.load(std::memory_order_acquire) == start) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+namespace {
+
+// Waits up to about 100 ms for the audio thread to finish a block; false if
+// none did, as no device is running.
+bool WaitForNextBlock(ProjectState& state) {
+    const uint64_t start = state.blocks_rendered.load(std::memory_order_acquire);
+    for (int i = 0; i < 100; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (state.blocks_rendered.load(std::memory_order_acquire) != start) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+void ReleaseRetiredPlugins(ProjectState& state, Track& track) {
+    std::vector<std::unique_ptr<PluginChain>> done;
+    for (int i = 0; i < 10 && track.TakeRetiredChains(done); ++i) {
+        // Nothing is rendering, so nothing moves on to the new chain.
+        if (!WaitForNextBlock(state)) break;
+    }
+    // The stats report of the running block may still list their plugins.
+    if (!done.empty()) WaitForBlockBoundary(state);
+}
+
+void ReleaseRetiredClips(ProjectState& state, Track& track) {
+    std::vector<std::unique_ptr<ClipSet>> done;
+    track.TakeRetiredClips(done);
+    // Later blocks load the published set.
+    if (!done.empty()) WaitForBlockBoundary(state);
+}
+
 Track* GetOrCreateTrack(ProjectState& state, int track_index) {
     if (state.tracks.find(track_index) == state.tracks.end()) {
         state.tracks[track_index] = std::make_unique<Track>(track_index);
+        RebuildRenderPlan(state);
     }
     return state.tracks[track_index].get();
 }
 
+namespace {
+
+void PublishRenderPlan(ProjectState& state, std::unique_ptr<RenderPlan> plan) {
+    state.render_plan.store(plan.get(), std::memory_order_release);
+    // Pairs with the fence at the start of Engine::Process; see render_plan.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (state.current_plan) {
+        state.retired_plans.emplace_back(state.blocks_rendered.load(std::memory_order_acquire), std::move(state.current_plan));
+    }
+    state.current_plan = std::move(plan);
+
+    // A retired plan may still be in use by the block that was running when it
+    // was replaced; once the block counter has moved past that, nobody holds it.
+    uint64_t rendered = state.blocks_rendered.load(std::memory_order_acquire);
+    std::erase_if(state.retired_plans, [rendered](const auto& retired) { return retired.first < rendered; });
+}
+
+// Return track a track's output is summed into, or -1 for the master bus.
+int EffectiveOutput(const ProjectState& state, const Track& track) {
+    if (track.output_index == track.index) return -1;
+    auto it = state.tracks.find(track.output_index);
+    return it != state.tracks.end() && it->second->is_return ? track.output_index : -1;
+}
+
+int EffectiveSidechain(const ProjectState& state, const Track& track) {
+    if (track.sidechain_source == track.index) return -1;
+    return state.tracks.count(track.sidechain_source) ? track.sidechain_source : -1;
+}
+
+} // namespace
+
+bool RebuildRenderPlan(ProjectState& state) {
+    std::vector<int> nodes;
+    std::vector<SendEdge> edges;
+    for (const auto& [idx, track] : state.tracks) {
+        nodes.push_back(idx);
+        for (const auto& [target, level] : track->sends) {
+            auto it = state.tracks.find(target);
+            if (it != state.tracks.end() && it->second->is_return) edges.push_back({idx, target});
+        }
+        int output = EffectiveOutput(state, *track);
+        if (output != -1) edges.push_back({idx, output});
+        int sidechain = EffectiveSidechain(state, *track);
+        if (sidechain != -1) edges.push_back({sidechain, idx});
+    }
+
+    auto order = TopologicalOrder(nodes, edges);
+    if (!order) return false;
+    if (state.publish_holds > 0) {
+        state.plan_stale = true;
+        return true;
+    }
+
+    // Send levels of the plan this one replaces. Its tracks may be gone, so
+    // they are only compared, never dereferenced.
+    std::map<std::pair<const Track*, const Track*>, float> previous_sends;
+    if (state.current_plan) {
+        for (const auto& node : state.current_plan->nodes) {
+            for (const auto& input : node.inputs) {
+                if (input.send) previous_sends[{state.current_plan->nodes[input.node].track, node.track}] = input.gain;
+            }
+        }
+    }
+
+    auto plan = std::make_unique<RenderPlan>();
+    plan->generation = state.current_plan ? state.current_plan->generation + 1 : 1;
+    std::map<int, int> position;
+    for (int idx : *order) {
+        position[idx] = (int)plan->nodes.size();
+        plan->nodes.push_back({state.tracks[idx].get()});
+    }
+
+    plan->graph = TaskGraph((int)plan->nodes.size());
+    for (int n = 0; n < (int)plan->nodes.size(); ++n) {
+        const Track& track = *plan->nodes[n].track;
+        for (const auto& [target, level] : track.sends) {
+            auto it = state.tracks.find(target);
+            if (it != state.tracks.end() && it->second->is_return && level > 0.0f) {
+                auto previous = previous_sends.find({&track, it->second.get()});
+                float previous_level = previous != previous_sends.end() ? previous->second : 0.0f;
+                plan->nodes[position[target]].inputs.push_back({n, level, previous_level, true});
+                plan->graph.AddEdge(n, position[target]);
+            }
+        }
+        int output = EffectiveOutput(state, track);
+        if (output != -1) {
+            plan->nodes[n].to_master = false;
+            plan->nodes[position[output]].inputs.push_back({n, 1.0f, 1.0f, false});
+            plan->graph.AddEdge(n, position[output]);
+        }
+        int sidechain = EffectiveSidechain(state, track);
+        if (sidechain != -1) {
+            plan->nodes[n].sidechain = position[sidechain];
+            plan->graph.AddEdge(position[sidechain], n);
+        }
+    }
+    PublishRenderPlan(state, std::move(plan));
+    return true;
+}
+
+void HoldPublishing(ProjectState& state) {
+    state.publish_holds++;
+}
+
+void ReleasePublishing(ProjectState& state) {
+    if (--state.publish_holds > 0) return;
+    for (const auto& [index, targets] : state.pending_mixer) {
+        if (index == kMasterStrip) {
+            state.master.SetTargets(targets);
+        } else if (auto it = state.tracks.find(index); it != state.tracks.end()) {
+            it->second->mixer.SetTargets(targets);
+        }
+    }
+    state.pending_mixer.clear();
+    if (std::exchange(state.plan_stale, false)) RebuildRenderPlan(state);
+}
+
+void SetMixer(ProjectState& state, int track_index, const std::function<void(MixerStrip::Targets&)>& change) {
+    MixerStrip& strip = track_index == kMasterStrip ? state.master : GetOrCreateTrack(state, track_index)->mixer;
+    if (state.publish_holds == 0) {
+        MixerStrip::Targets targets = strip.targets();
+        change(targets);
+        strip.SetTargets(targets);
+        return;
+    }
+    change(state.pending_mixer.try_emplace(track_index, strip.targets()).first->second);
+}
+
+bool SetSend(ProjectState& state, int track_index, int return_index, float level) {
+    auto target = state.tracks.find(return_index);
+    if (target == state.tracks.end() || !target->second->is_return) return false;
+
+    Track* track = GetOrCreateTrack(state, track_index);
+    auto previous = track->sends.find(return_index);
+    std::optional<float> old_level;
+    if (previous != track->sends.end()) old_level = previous->second;
+
+    if (level > 0.0f) {
+        track->sends[return_index] = level;
+    } else {
+        track->sends.erase(return_index);
+    }
+    if (RebuildRenderPlan(state)) return true;
+
+    // Feedback: restore the previous send.
+    if (old_level) {
+        track->sends[return_index] = *old_level;
+    } else {
+        track->sends.erase(return_index);
+    }
+    return false;
+}
+
+void SetReturnTrack(ProjectState& state, int track_index, bool is_return) {
+    Track* track = GetOrCreateTrack(state, track_index);
+    if (track->is_return == is_return) return;
+    track->is_return = is_return;
+    if (!is_return) {
+        for (auto& [idx, other] : state.tracks) {
+            other->sends.erase(track_index);
+            if (other->output_index == track_index) other->output_index = -1;
+        }
+    }
+    RebuildRenderPlan(state);
+}
+
+bool SetTrackOutput(ProjectState& state, int track_index, int output_index) {
+    if (output_index != -1) {
+        auto target = state.tracks.find(output_index);
+        if (target == state.tracks.end() || !target->second->is_return || output_index == track_index) return false;
+    }
+
+    Track* track = GetOrCreateTrack(state, track_index);
+    int previous = std::exchange(track->output_index, output_index);
+    if (RebuildRenderPlan(state)) return true;
+    track->output_index = previous;
+    return false;
+}
+
+bool SetSidechain(ProjectState& state, int track_index, int source_index) {
+    if (source_index != -1 && (!state.tracks.count(source_index) || source_index == track_index)) return false;
+
+    Track* track = GetOrCreateTrack(state, track_index);
+    int previous = std::exchange(track->sidechain_source, source_index);
+    if (RebuildRenderPlan(state)) return true;
+    track->sidechain_source = previous;
+    return false;
+}
+
+void WakeAudio(ProjectState& state) {
+    std::lock_guard<std::mutex> lock(state.wake_mutex);
+    state.wake_requested_at = StatsClock::now();
+    state.wake_generation.fetch_add(1);
+    state.wake_cv.notify_all();
+}
+
+StatsClock::time_point WaitForWake(ProjectState& state, uint64_t seen) {
+    std::unique_lock<std::mutex> lock(state.wake_mutex);
+    state.wake_cv.wait(lock, [&] { return state.wake_generation.load() != seen; });
+    return state.wake_requested_at;
+}
+
 bool SaveProject(const ProjectState& state, const std::string& path) {
     flatbuffers::FlatBufferBuilder builder;
 
@@ -41,16 +293,28 @@ bool SaveProject(const ProjectState& state, const std::string& path) {
         for (const auto& [slot, clip] : track->clips) {
             auto path_str = builder.CreateString(clip->path);
             auto clip_type = clip->type == Clip::Type::MIDI ? hibiki::project::ClipType::ClipType_MIDI : hibiki::project::ClipType::ClipType_AUDIO;
-            clip_offsets.push_back(hibiki::project::CreateClip(builder, slot, path_str, clip->is_loop, clip_type));
+            clip_offsets.push_back(hibiki::project::CreateClip(builder, slot, path_str, clip->is_loop, clip_type,
+                                                               (int)clip->follow_action, (float)clip->follow_beats));
+        }
+
+        std::vector<flatbuffers::Offset<hibiki::project::Send>> send_offsets;
+        for (const auto& [target, level] : track->sends) {
+            send_offsets.push_back(hibiki::project::CreateSend(builder, target, level));
         }
 
         auto plugins_vec = builder.CreateVector(plugin_offsets);
         auto clips_vec = builder.CreateVector(clip_offsets);
-        track_offsets.push_back(hibiki::project::CreateTrack(builder, idx, plugins_vec, clips_vec));
+        auto sends_vec = builder.CreateVector(send_offsets);
+        track_offsets.push_back(hibiki::project::CreateTrack(builder, idx, plugins_vec, clips_vec,
+                                                             track->mixer.volume, track->mixer.pan,
+                                                             track->mixer.mute, track->mixer.solo,
+                                                             track->is_return, sends_vec,
+                                                             track->output_index, track->sidechain_source));
     }
 
     auto tracks_vec = builder.CreateVector(track_offsets);
-    auto project_data = hibiki::project::CreateProject(builder, state.bpm, tracks_vec);
+    auto project_data = hibiki::project::CreateProject(builder, state.bpm, tracks_vec, state.master.volume,
+                                                       state.launch_quantization.load());
     builder.Finish(project_data);
 
     std::ofstream out(path, std::ios::binary);
@@ -63,6 +327,7 @@ bool SaveProject(const ProjectState& state, const std::string& path) {
 }
 
 bool LoadProject(ProjectState& state, const std::string& path) {
+    std::unique_lock<std::mutex> lock(state.tracks_mutex);
     std::ifstream in(path, std::ios::binary | std::ios::ate);
     if (!in) {
         std::cerr << "Failed to open project file for reading: " << path << "\n";
@@ -80,12 +345,30 @@ bool LoadProject(ProjectState& state, const std::string& path) {
 
     auto project_data = hibiki::project::GetProject(buffer.data());
     
+    // Targets set earlier in a batch were for the old project.
+    state.pending_mixer.clear();
     state.bpm = project_data->bpm();
+    state.master.volume = project_data->master_volume();
+    state.master.Snap();
+    state.launch_quantization = std::clamp(project_data->launch_quantization(), (int)LaunchQuantization::kNone,
+                                           (int)LaunchQuantization::kSixteenth);
+
+    // Detach the audio thread from the old tracks before destroying them, and
+    // let a running freeze job finish with its track. New jobs cannot claim
+    // one while tracks_mutex is held.
+    PublishRenderPlan(state, std::make_unique<RenderPlan>());
+    WaitForBlockBoundary(state);
+    state.freeze_jobs_cv.wait(lock, [&] { return state.freeze_jobs == 0; });
     state.tracks.clear();
 
     if (project_data->tracks()) {
         for (const auto* track_data : *project_data->tracks()) {
             auto track = GetOrCreateTrack(state, track_data->index());
+            track->mixer.volume = track_data->volume();
+            track->mixer.pan = track_data->pan();
+            track->mixer.mute = track_data->mute();
+            track->mixer.solo = track_data->solo();
+            track->is_return = track_data->is_return();
 
             if (track_data->plugins()) {
                 for (const auto* plugin_data : *track_data->plugins()) {
@@ -100,10 +383,32 @@ bool LoadProject(ProjectState& state, const std::string& path) {
             if (track_data->clips()) {
                 for (const auto* clip_data : *track_data->clips()) {
                     track->LoadClip(clip_data->slot_index(), clip_data->path()->str(), clip_data->is_loop());
+                    int action = std::clamp(clip_data->follow_action(), (int)FollowAction::kNone, (int)FollowAction::kFirst);
+                    track->SetFollowAction(clip_data->slot_index(), (FollowAction)action, clip_data->follow_beats());
+                }
+            }
+        }
+        // Sends and outputs may point at return tracks that appear later in the file.
+        for (const auto* track_data : *project_data->tracks()) {
+            if (track_data->sends()) {
+                for (const auto* send_data : *track_data->sends()) {
+                    if (!SetSend(state, track_data->index(), send_data->return_index(), send_data->level())) {
+                        std::cerr << "Dropping invalid send from track " << track_data->index()
+                                  << " to " << send_data->return_index() << "\n";
+                    }
                 }
             }
+            if (track_data->output_index() != -1 && !SetTrackOutput(state, track_data->index(), track_data->output_index())) {
+                std::cerr << "Dropping invalid output of track " << track_data->index() << "\n";
+            }
+            if (track_data->sidechain_source() != -1 && !SetSidechain(state, track_data->index(), track_data->sidechain_source())) {
+                std::cerr << "Dropping invalid sidechain of track " << track_data->index() << "\n";
+            }
         }
     }
+    // Nothing played from the new tracks' earlier clip sets.
+    for (auto& [index, track] : state.tracks) ReleaseRetiredClips(state, *track);
+    RebuildRenderPlan(state);
     return true;
 }
 
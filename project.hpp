@@ -1,29 +1,182 @@
 #pragma once
 
+#include "engine_stats.hpp"
+#include "launch.hpp"
+#include "mixer.hpp"
+#include "render_graph.hpp"
 #include "track.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace hibiki {
 
+// Immutable snapshot of the routing graph that the audio thread renders from.
+// It is rebuilt on the IPC thread whenever tracks or routing change.
+struct RenderPlan {
+    struct Input {
+        int node;
+        float gain;
+        // The engine ramps a send from the level the plan it replaces had
+        // (0 for a new send) over kGainRampSeconds; routed outputs are not ramped.
+        float previous_gain;
+        bool send;
+    };
+    struct Node {
+        Track* track;
+        std::vector<Input> inputs; // sends and routed outputs summed into a return track
+        int sidechain = -1;        // node feeding the sidechain input of the plugins
+        bool to_master = true;
+    };
+    std::vector<Node> nodes; // topological order
+    TaskGraph graph;         // edges from every input and sidechain node
+    uint64_t generation = 0; // counts the plans published, so the engine sees a new one
+};
+
+// The strip index SetMixer takes for the master bus.
+constexpr int kMasterStrip = -1;
+
 struct ProjectState {
     std::map<int, std::unique_ptr<Track>> tracks;
+    MixerStrip master;
+
+    // The audio thread sets rendering_block and issues a seq_cst fence before
+    // it loads render_plan, once per block, and bumps blocks_rendered and
+    // clears rendering_block afterwards. The IPC side fences between
+    // publishing and reading the counter, so a replaced plan is freed only
+    // once every block that may have loaded it has finished.
+    std::atomic<const RenderPlan*> render_plan{nullptr};
+    std::atomic<uint64_t> blocks_rendered{0};
+    std::atomic<bool> rendering_block{false};
+    std::unique_ptr<RenderPlan> current_plan;
+    std::vector<std::pair<uint64_t, std::unique_ptr<RenderPlan>>> retired_plans;
     double bpm = 120.0;
     bool is_playing = false;
+    // Transport position in frames at the start of the next block, counted
+    // from the first launch after everything had stopped; -1 while stopped.
+    // Advanced by the engine while clips play or launches are pending.
+    std::atomic<int64_t> transport_frame{-1};
+    // PlayClip, PlayScene and stop commands for the engine, and the grid
+    // they wait for (a LaunchQuantization).
+    LaunchQueue launches;
+    std::atomic<int> launch_quantization{(int)LaunchQuantization::kBar};
+    // While nonzero the engine leaves launches queued, so that those of a
+    // batch of requests are scheduled in the same block.
+    std::atomic<int> launch_holds{0};
+    // Publishing holds (see HoldPublishing); IPC thread only. plan_stale
+    // marks a routing change whose plan waits for the release, and
+    // pending_mixer the targets SetMixer left, by track index or kMasterStrip.
+    int publish_holds = 0;
+    bool plan_stale = false;
+    std::map<int, MixerStrip::Targets> pending_mixer;
     double sample_rate = 44100.0;
     std::vector<float> levels = {0.0f, 0.0f};
 
     std::map<int, std::pair<float, float>> track_levels;
+    // Telemetry subscriptions the playback and stats reporter threads apply (see Subscribe):
+    // the periods of LevelDeltas and Playhead, 0 for none, and the levels'
+    // threshold. level_subscriptions is bumped to send every level once.
+    std::atomic<int> level_interval_ms{100};
+    std::atomic<float> level_threshold_db{0.5f};
+    std::atomic<uint32_t> level_subscriptions{0};
+    std::atomic<int> playhead_interval_ms{50};
+    EngineStats stats;
+    // Adaptive buffer sizing, applied by the playback thread.
+    std::atomic<bool> adaptive_latency{false};
+    std::atomic<int> min_block_size{64};
+    std::atomic<int> max_block_size{kMaxBlockSize};
+    // Blocks that tracks without live input are rendered ahead (see
+    // anticipation.hpp), 0 for none. The playback thread rebuilds its engine
+    // when this changes.
+    std::atomic<int> lookahead_blocks{0};
+    // CPU governor settings. The engine applies them at its next stats report
+    // after governor_generation changes, restoring everything the governor
+    // had bypassed or cut.
+    std::atomic<int> governor_policy{0};
+    std::atomic<float> governor_track_budget{0.5f};
+    std::atomic<int> governor_overload_intervals{3};
+    std::atomic<uint32_t> governor_generation{0};
+    // Bumped by WakeAudio. The playback thread notes it at each block start and
+    // parks in idle until it changes, so a wake that raced with parking is kept.
+    std::atomic<uint64_t> wake_generation{0};
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    StatsClock::time_point wake_requested_at;
     std::mutex tracks_mutex;
+    // Freeze and unfreeze jobs holding a Track*, guarded by tracks_mutex.
+    // Tracks are only destroyed once it is back to zero; see freeze_jobs_cv.
+    int freeze_jobs = 0;
+    std::condition_variable freeze_jobs_cv;
     std::mutex levels_mutex;
     bool quit = false;
 };
 
+// Waits for the audio thread to finish the block it is rendering, if any, so
+// that a flag set before the call is seen by every later block and nothing
+// taken from the state by an earlier block is still in use. Returns at once
+// while no block is running, as when the device is idle or closed.
+void WaitForBlockBoundary(ProjectState& state);
+
+// Destroys the plugin chains the track has retired, with the plugins they
+// dropped, once the audio side has faded them out. Waits a few blocks for
+// that; chains still in use then are left for a later call.
+void ReleaseRetiredPlugins(ProjectState& state, Track& track);
+
+// Destroys the clip sets the track has retired, with the clips they dropped,
+// once the block that may still be playing from them has finished.
+void ReleaseRetiredClips(ProjectState& state, Track& track);
+
 // Returns a pointer to the track, creating it if it doesn't exist
 Track* GetOrCreateTrack(ProjectState& state, int track_index);
 
+// Recompiles the routing graph and publishes it to the audio thread.
+// Returns false, keeping the previous plan, if the sends form a feedback loop.
+// While publishing is held it only checks the routing.
+bool RebuildRenderPlan(ProjectState& state);
+
+// While held, routing changes and SetMixer leave the audio thread on the
+// previous render plan and mixer targets. Releasing the last hold publishes
+// the plan and the targets once, so that the changes of a Batch reach the
+// same block. Plugin chains are still swapped per command. Called with
+// tracks_mutex held.
+void HoldPublishing(ProjectState& state);
+void ReleasePublishing(ProjectState& state);
+
+// Changes the mixer targets of a track, creating it, or of the master bus
+// for kMasterStrip. Called with tracks_mutex held.
+void SetMixer(ProjectState& state, int track_index, const std::function<void(MixerStrip::Targets&)>& change);
+
+// Sets a post-fader send from a track into a return track; level <= 0 removes it.
+// Fails if the target is not a return track or the send would create feedback.
+bool SetSend(ProjectState& state, int track_index, int return_index, float level);
+
+// Turns a track into a return track or back. Sends and outputs into a track
+// that stops being a return are dropped.
+void SetReturnTrack(ProjectState& state, int track_index, bool is_return);
+
+// Routes a track's output into a return track, or to the master bus for -1.
+// Fails if the target is not a return track or the routing would create feedback.
+bool SetTrackOutput(ProjectState& state, int track_index, int output_index);
+
+// Feeds another track's output into the sidechain input of this track's plugins;
+// -1 disconnects it. Fails if the source does not exist or would create feedback.
+bool SetSidechain(ProjectState& state, int track_index, int source_index);
+
+// Releases the playback thread if it is parked in idle. Called by commands
+// that may start sound, and on quit.
+void WakeAudio(ProjectState& state);
+
+// Parks the calling thread until WakeAudio runs after the block that saw
+// wake_generation == seen. Returns when the wake was requested.
+StatsClock::time_point WaitForWake(ProjectState& state, uint64_t seen);
+
 bool SaveProject(const ProjectState& state, const std::string& path);
+// Takes tracks_mutex, and waits for running freeze jobs before it replaces the tracks.
 bool LoadProject(ProjectState& state, const std::string& path);
 
 } // namespace hibiki
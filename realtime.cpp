@@ -0,0 +1,250 @@
+#include "realtime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(HIBIKI_RTKIT)
+#include <systemd/sd-bus.h>
+#endif
+
+namespace hibiki::rt {
+
+namespace {
+
+std::atomic<bool> g_memory_locked{false};
+
+int DefaultPriority() {
+    const char* env = std::getenv("HIBIKI_RT_PRIORITY");
+    return env ? std::atoi(env) : 70;
+}
+
+std::vector<int> CpusFromEnv(const char* name) {
+    const char* env = std::getenv(name);
+    return env ? ParseCpuList(env) : std::vector<int>{};
+}
+
+#if defined(HIBIKI_RTKIT)
+constexpr const char* kRtkitName = "org.freedesktop.RealtimeKit1";
+constexpr const char* kRtkitPath = "/org/freedesktop/RealtimeKit1";
+
+// One system bus connection to rtkit for the whole process, set up by the
+// first thread that needs it. rtkit refuses threads without an RLIMIT_RTTIME
+// and caps the priority at its MaxRealtimePriority; both are settled once,
+// and when rtkit cannot be reached it is not asked again.
+struct Rtkit {
+    std::mutex mutex;  // sd_bus connections are not thread-safe
+    sd_bus* bus = nullptr;
+    int max_priority = 0;
+    std::string unavailable;
+
+    Rtkit() {
+        struct rlimit rl;
+        rl.rlim_cur = rl.rlim_max = 200000; // us of CPU without blocking
+        if (setrlimit(RLIMIT_RTTIME, &rl) != 0) {
+            unavailable = std::string("setrlimit(RLIMIT_RTTIME): ") + std::strerror(errno);
+            return;
+        }
+        int rc = sd_bus_open_system(&bus);
+        if (rc < 0) {
+            unavailable = std::string("system bus: ") + std::strerror(-rc);
+            bus = nullptr;
+            return;
+        }
+        sd_bus_error error{};
+        int32_t max = 0;
+        rc = sd_bus_get_property_trivial(bus, kRtkitName, kRtkitPath, kRtkitName, "MaxRealtimePriority", &error, 'i', &max);
+        if (rc < 0) {
+            unavailable = std::string("rtkit: ") + (error.message ? error.message : std::strerror(-rc));
+            sd_bus_error_free(&error);
+            bus = sd_bus_unref(bus);
+            return;
+        }
+        max_priority = max;
+    }
+};
+
+// Leaked on purpose, like the connection it holds.
+Rtkit& GetRtkit() {
+    static Rtkit* rtkit = new Rtkit;
+    return *rtkit;
+}
+
+// Asks rtkit for SCHED_FIFO on the calling thread; priority is lowered to
+// the rtkit cap, which is what was granted on success.
+bool RequestRealtimeFromRtkit(int& priority, std::string& detail) {
+    auto& rtkit = GetRtkit();
+    std::lock_guard<std::mutex> lock(rtkit.mutex);
+    if (!rtkit.bus) {
+        detail = rtkit.unavailable;
+        return false;
+    }
+    priority = std::min(priority, rtkit.max_priority);
+    sd_bus_error error{};
+    int rc = sd_bus_call_method(rtkit.bus, kRtkitName, kRtkitPath, kRtkitName, "MakeThreadRealtime", &error, nullptr,
+                                "tu", (uint64_t)syscall(SYS_gettid), (uint32_t)priority);
+    if (rc < 0) {
+        detail = std::string("rtkit: ") + (error.message ? error.message : std::strerror(-rc));
+        sd_bus_error_free(&error);
+        return false;
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+ThreadConfig AudioThreadConfig() {
+    return {DefaultPriority(), CpusFromEnv("HIBIKI_AUDIO_CPUS")};
+}
+
+ThreadConfig WorkerThreadConfig() {
+    return {DefaultPriority(), CpusFromEnv("HIBIKI_RENDER_CPUS")};
+}
+
+std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int first = 0, last = 0;
+        char dash = 0;
+        std::istringstream in(item);
+        if (!(in >> first) || first < 0) continue;
+        last = first;
+        if (in >> dash) {
+            if (dash != '-' || !(in >> last) || last < first) continue;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+std::vector<Status> ConfigureCurrentThread(const std::string& step_prefix, const ThreadConfig& config) {
+    std::vector<Status> statuses;
+    if (config.priority > 0) {
+        auto status = SetRealtimePriority(config.priority);
+        status.step = step_prefix + " priority";
+        statuses.push_back(std::move(status));
+    }
+    if (!config.cpus.empty()) {
+        auto status = SetAffinity(config.cpus);
+        status.step = step_prefix + " affinity";
+        statuses.push_back(std::move(status));
+    }
+    return statuses;
+}
+
+Status SetRealtimePriority(int priority) {
+    Status status{"priority", false, ""};
+#if defined(_WIN32)
+    status.detail = "not supported on Windows";
+#else
+    sched_param param{};
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err == 0) {
+        status.ok = true;
+        status.detail = "SCHED_FIFO " + std::to_string(priority);
+        return status;
+    }
+    status.detail = std::string("pthread_setschedparam: ") + std::strerror(err);
+#if defined(HIBIKI_RTKIT)
+    if (err == EPERM) {
+        int granted = priority;
+        std::string rtkit_detail;
+        if (RequestRealtimeFromRtkit(granted, rtkit_detail)) {
+            status.ok = true;
+            status.detail = "SCHED_FIFO " + std::to_string(granted) + " via rtkit";
+        } else {
+            status.detail += "; " + rtkit_detail;
+        }
+    }
+#endif
+#endif
+    return status;
+}
+
+Status SetAffinity(const std::vector<int>& cpus) {
+    Status status{"affinity", false, ""};
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::string list;
+    for (int cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) continue;
+        CPU_SET(cpu, &set);
+        list += (list.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    status.ok = err == 0;
+    status.detail = err == 0 ? "cpus " + list : std::string("pthread_setaffinity_np: ") + std::strerror(err);
+#else
+    status.detail = "not supported on this platform";
+#endif
+    return status;
+}
+
+Status LockMemory() {
+    Status status{"mlockall", false, ""};
+#if defined(_WIN32)
+    status.detail = "not supported on Windows";
+#else
+    if (const char* env = std::getenv("HIBIKI_MLOCK"); env && std::string(env) == "0") {
+        status.detail = "disabled by HIBIKI_MLOCK=0";
+        return status;
+    }
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        status.detail = "skipped: RLIMIT_MEMLOCK is " + std::to_string((unsigned long long)rl.rlim_cur) +
+                        " bytes; clip buffers are locked individually";
+        return status;
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        status.detail = std::string("mlockall: ") + std::strerror(errno);
+        return status;
+    }
+    g_memory_locked.store(true);
+    status.ok = true;
+    status.detail = "current and future pages locked";
+#endif
+    return status;
+}
+
+bool MemoryLocked() {
+    return g_memory_locked.load();
+}
+
+void Prefault(const void* data, size_t bytes) {
+    if (!data || bytes == 0) return;
+#if defined(_WIN32)
+    const size_t page = 4096;
+#else
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    const volatile char* p = static_cast<const volatile char*>(data);
+    for (size_t offset = 0; offset < bytes; offset += page) (void)p[offset];
+    (void)p[bytes - 1];
+#if !defined(_WIN32)
+    // Best effort: fails quietly once RLIMIT_MEMLOCK is used up.
+    if (!MemoryLocked()) mlock(data, bytes);
+#endif
+}
+
+} // namespace hibiki::rt
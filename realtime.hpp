@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace hibiki::rt {
+
+// Outcome of one setup step, reported to the GUI as a RealtimeStatus.
+struct Status {
+    std::string step;
+    bool ok = false;
+    std::string detail;
+};
+
+struct ThreadConfig {
+    // SCHED_FIFO priority; 0 leaves the thread at normal priority.
+    int priority = 0;
+    // CPUs to pin to; empty leaves the affinity alone.
+    std::vector<int> cpus;
+};
+
+// HIBIKI_RT_PRIORITY (default 70, 0 disables) and HIBIKI_AUDIO_CPUS.
+ThreadConfig AudioThreadConfig();
+// Same priority as the audio thread, since workers are on the same deadline,
+// pinned to HIBIKI_RENDER_CPUS.
+ThreadConfig WorkerThreadConfig();
+
+// "2,3" or "4-7" or a mix of both; invalid entries are skipped.
+std::vector<int> ParseCpuList(const std::string& list);
+
+// Applies the scheduling and affinity parts of config to the calling thread.
+// step_prefix names the thread in the returned statuses.
+std::vector<Status> ConfigureCurrentThread(const std::string& step_prefix, const ThreadConfig& config);
+
+// SCHED_FIFO for the calling thread, directly if the process may, otherwise
+// (when built with --define=rtkit=true) through rtkit over the system bus,
+// whose priority cap may lower the request.
+Status SetRealtimePriority(int priority);
+Status SetAffinity(const std::vector<int>& cpus);
+
+// Locks all current and future pages of the process, unless HIBIKI_MLOCK=0.
+// Skipped when RLIMIT_MEMLOCK is finite, because future allocations past the
+// limit would then fail.
+Status LockMemory();
+bool MemoryLocked();
+
+// Touches every page of a buffer that is about to be handed to the audio
+// thread and, unless all memory is already locked, locks it.
+void Prefault(const void* data, size_t bytes);
+
+} // namespace hibiki::rt
@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+#include "realtime.hpp"
+
+#include <vector>
+
+namespace {
+
+TEST(RealtimeTest, ParsesCpuLists) {
+    EXPECT_EQ(hibiki::rt::ParseCpuList("2,3"), (std::vector<int>{2, 3}));
+    EXPECT_EQ(hibiki::rt::ParseCpuList("0,4-6"), (std::vector<int>{0, 4, 5, 6}));
+    EXPECT_EQ(hibiki::rt::ParseCpuList("x,3-1,-2,7"), (std::vector<int>{7}));
+    EXPECT_TRUE(hibiki::rt::ParseCpuList("").empty());
+}
+
+TEST(RealtimeTest, ReportsEachConfiguredStep) {
+    EXPECT_TRUE(hibiki::rt::ConfigureCurrentThread("audio", {}).empty());
+    // Whether the priority is granted depends on the machine; the step is
+    // reported either way.
+    auto statuses = hibiki::rt::ConfigureCurrentThread("audio", {1, {0}});
+    ASSERT_EQ(statuses.size(), 2u);
+    EXPECT_EQ(statuses[0].step, "audio priority");
+    EXPECT_FALSE(statuses[0].detail.empty());
+    EXPECT_EQ(statuses[1].step, "audio affinity");
+#if defined(__linux__)
+    EXPECT_TRUE(statuses[1].ok) << statuses[1].detail;
+#endif
+}
+
+TEST(RealtimeTest, PrefaultTouchesWholeBuffer) {
+    std::vector<float> buffer(1 << 20, 1.0f);
+    hibiki::rt::Prefault(buffer.data(), buffer.size() * sizeof(float));
+    hibiki::rt::Prefault(nullptr, 0);
+    EXPECT_EQ(buffer.back(), 1.0f);
+}
+
+} // namespace
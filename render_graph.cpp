@@ -0,0 +1,136 @@
+#include "render_graph.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace hibiki {
+
+namespace {
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+} // namespace
+
+TaskGraph::TaskGraph(int num_nodes)
+    : successors(num_nodes),
+      num_dependencies(num_nodes, 0),
+      pending(new std::atomic<int>[num_nodes]),
+      ready(new std::atomic<int>[num_nodes]) {}
+
+void TaskGraph::AddEdge(int from, int to) {
+    successors[from].push_back(to);
+    num_dependencies[to]++;
+}
+
+GraphExecutor::GraphExecutor(int num_workers, std::function<void(int)> thread_init) {
+    for (int i = 0; i < num_workers; ++i) {
+        workers_.emplace_back([this, i, thread_init] { WorkerLoop(i, thread_init); });
+    }
+}
+
+GraphExecutor::~GraphExecutor() {
+    quit_.store(true);
+    generation_.fetch_add(1);
+    generation_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+int GraphExecutor::DefaultWorkerCount() {
+    if (const char* env = std::getenv("HIBIKI_RENDER_THREADS")) {
+        return std::max(0, std::atoi(env));
+    }
+    int cores = (int)std::thread::hardware_concurrency();
+    return std::clamp(cores - 1, 0, 15);
+}
+
+void GraphExecutor::Push(int node) {
+    int slot = push_index_.fetch_add(1, std::memory_order_acq_rel);
+    graph_->ready[slot].store(node, std::memory_order_release);
+}
+
+bool GraphExecutor::RunOne() {
+    int slot = pop_index_.load(std::memory_order_relaxed);
+    do {
+        if (slot >= push_index_.load(std::memory_order_acquire)) return false;
+    } while (!pop_index_.compare_exchange_weak(slot, slot + 1, std::memory_order_acq_rel));
+
+    // The pusher reserves the slot before storing the node id.
+    int node;
+    while ((node = graph_->ready[slot].load(std::memory_order_acquire)) < 0) CpuRelax();
+
+    fn_(ctx_, node);
+    for (int s : graph_->successors[node]) {
+        if (graph_->pending[s].fetch_sub(1, std::memory_order_acq_rel) == 1) Push(s);
+    }
+    remaining_.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void GraphExecutor::RunImpl(const TaskGraph& graph, NodeFn fn, void* ctx) {
+    const int n = graph.size();
+    if (n == 0) return;
+
+    graph_ = &graph;
+    fn_ = fn;
+    ctx_ = ctx;
+    for (int i = 0; i < n; ++i) {
+        graph.pending[i].store(graph.num_dependencies[i], std::memory_order_relaxed);
+        graph.ready[i].store(-1, std::memory_order_relaxed);
+    }
+    push_index_.store(0, std::memory_order_relaxed);
+    pop_index_.store(0, std::memory_order_relaxed);
+    remaining_.store(n, std::memory_order_relaxed);
+    for (int i = 0; i < n; ++i) {
+        if (graph.num_dependencies[i] == 0) Push(i);
+    }
+
+    bool parallel = !workers_.empty() && n > 1;
+    if (parallel) {
+        open_.store(true);
+        generation_.fetch_add(1, std::memory_order_release);
+        generation_.notify_all();
+    }
+
+    while (remaining_.load(std::memory_order_acquire) > 0) {
+        if (!RunOne()) CpuRelax();
+    }
+
+    if (parallel) {
+        // Keep the run state alive until no worker can still be looking at it.
+        open_.store(false);
+        while (busy_.load() != 0) CpuRelax();
+    }
+}
+
+void GraphExecutor::WorkerLoop(int index, const std::function<void(int)>& thread_init) {
+    trace::SetThreadName("render worker");
+    if (thread_init) thread_init(index);
+    uint64_t seen = 0;
+    while (true) {
+        generation_.wait(seen, std::memory_order_acquire);
+        seen = generation_.load(std::memory_order_acquire);
+        if (quit_.load()) return;
+
+        // Register before checking open_, so RunImpl cannot reset the run under us.
+        busy_.fetch_add(1);
+        if (open_.load()) {
+            while (remaining_.load(std::memory_order_acquire) > 0) {
+                if (!RunOne()) CpuRelax();
+            }
+        }
+        busy_.fetch_sub(1);
+    }
+}
+
+} // namespace hibiki
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace hibiki {
+
+// Dependency structure of a render plan; node indices are positions in the plan.
+// The per-run counters are allocated here, off the audio thread, so that
+// executing the graph never allocates.
+struct TaskGraph {
+    std::vector<std::vector<int>> successors;
+    std::vector<int> num_dependencies;
+
+    TaskGraph() = default;
+    explicit TaskGraph(int num_nodes);
+
+    void AddEdge(int from, int to);
+    int size() const { return (int)num_dependencies.size(); }
+
+    // Scratch state used by GraphExecutor::Run. A graph runs at most once at a time.
+    std::unique_ptr<std::atomic<int>[]> pending;
+    std::unique_ptr<std::atomic<int>[]> ready;
+};
+
+// Executes a TaskGraph on the calling thread plus a pool of worker threads.
+// Every node carries a counter of unfinished dependencies; whoever finishes the
+// last dependency of a node pushes it onto a lock-free ready list, where any idle
+// thread picks it up. Independent chains therefore run in parallel and a run
+// takes as long as its critical path rather than the sum of all nodes.
+class GraphExecutor {
+public:
+    // thread_init, if set, runs first on each worker thread with its index.
+    explicit GraphExecutor(int num_workers, std::function<void(int)> thread_init = {});
+    ~GraphExecutor();
+
+    GraphExecutor(const GraphExecutor&) = delete;
+    GraphExecutor& operator=(const GraphExecutor&) = delete;
+
+    // Calls fn(node) once for every node, respecting dependencies, and returns
+    // when all nodes are done. Writes made by fn are visible to the caller afterwards.
+    template <typename Fn>
+    void Run(const TaskGraph& graph, Fn&& fn) {
+        using F = std::remove_reference_t<Fn>;
+        RunImpl(graph, [](void* ctx, int node) { (*static_cast<F*>(ctx))(node); }, &fn);
+    }
+
+    int num_workers() const { return (int)workers_.size(); }
+    const std::vector<std::thread>& workers() const { return workers_; }
+
+    // Worker count from HIBIKI_RENDER_THREADS, or one less than the core count.
+    static int DefaultWorkerCount();
+
+private:
+    using NodeFn = void (*)(void*, int);
+
+    void RunImpl(const TaskGraph& graph, NodeFn fn, void* ctx);
+    void WorkerLoop(int index, const std::function<void(int)>& thread_init);
+    bool RunOne();
+    void Push(int node);
+
+    std::vector<std::thread> workers_;
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<bool> quit_{false};
+    std::atomic<bool> open_{false};
+    std::atomic<int> busy_{0};
+
+    // Current run; written before open_ is set.
+    const TaskGraph* graph_ = nullptr;
+    NodeFn fn_ = nullptr;
+    void* ctx_ = nullptr;
+    std::atomic<int> push_index_{0};
+    std::atomic<int> pop_index_{0};
+    std::atomic<int> remaining_{0};
+};
+
+} // namespace hibiki
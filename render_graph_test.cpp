@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "render_graph.hpp"
+
+#include <atomic>
+#include <vector>
+
+namespace {
+
+// 0 -> {1, 2} -> 3, plus an independent chain 4 -> 5.
+hibiki::TaskGraph DiamondGraph() {
+    hibiki::TaskGraph graph(6);
+    graph.AddEdge(0, 1);
+    graph.AddEdge(0, 2);
+    graph.AddEdge(1, 3);
+    graph.AddEdge(2, 3);
+    graph.AddEdge(4, 5);
+    return graph;
+}
+
+void CheckRuns(int num_workers) {
+    hibiki::GraphExecutor executor(num_workers);
+    auto graph = DiamondGraph();
+    for (int run = 0; run < 1000; ++run) {
+        std::vector<std::atomic<int>> finished(graph.size());
+        std::atomic<int> clock{0};
+        std::atomic<bool> ok{true};
+        executor.Run(graph, [&](int node) {
+            // Every dependency must have finished before the node starts.
+            for (int from = 0; from < graph.size(); ++from) {
+                for (int to : graph.successors[from]) {
+                    if (to == node && finished[from].load() == 0) ok = false;
+                }
+            }
+            finished[node].store(++clock);
+        });
+        ASSERT_TRUE(ok.load()) << "run " << run;
+        for (int i = 0; i < graph.size(); ++i) ASSERT_GT(finished[i].load(), 0) << i;
+        ASSERT_EQ(clock.load(), graph.size());
+    }
+}
+
+} // namespace
+
+TEST(RenderGraphTest, RunsInlineWithoutWorkers) {
+    CheckRuns(0);
+}
+
+TEST(RenderGraphTest, RunsOnWorkers) {
+    CheckRuns(3);
+}
+
+TEST(RenderGraphTest, EmptyGraph) {
+    hibiki::GraphExecutor executor(2);
+    hibiki::TaskGraph graph;
+    int calls = 0;
+    executor.Run(graph, [&](int) { ++calls; });
+    EXPECT_EQ(calls, 0);
+}
+
+TEST(RenderGraphTest, InitializesEachWorker) {
+    std::atomic<int> mask{0};
+    {
+        hibiki::GraphExecutor executor(3, [&](int worker) { mask |= 1 << worker; });
+    }
+    EXPECT_EQ(mask.load(), 0b111);
+}
+
+TEST(RenderGraphTest, IndependentNodesRunInParallel) {
+    hibiki::GraphExecutor executor(3);
+    hibiki::TaskGraph graph(4);
+    std::atomic<int> concurrent{0}, max_concurrent{0};
+    for (int run = 0; run < 50 && max_concurrent.load() < 2; ++run) {
+        executor.Run(graph, [&](int) {
+            int now = ++concurrent;
+            int prev = max_concurrent.load();
+            while (now > prev && !max_concurrent.compare_exchange_weak(prev, now)) {}
+            auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(2);
+            while (std::chrono::steady_clock::now() < until) {}
+            --concurrent;
+        });
+    }
+    EXPECT_GE(max_concurrent.load(), 2);
+}
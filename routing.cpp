@@ -0,0 +1,41 @@
+#include "routing.hpp"
+
+#include <map>
+
+namespace hibiki {
+
+std::optional<std::vector<int>> TopologicalOrder(const std::vector<int>& nodes, const std::vector<SendEdge>& edges) {
+    std::map<int, int> position;
+    for (size_t i = 0; i < nodes.size(); ++i) position[nodes[i]] = (int)i;
+
+    std::vector<int> in_degree(nodes.size(), 0);
+    std::vector<std::vector<int>> successors(nodes.size());
+    for (const auto& e : edges) {
+        auto from = position.find(e.from);
+        auto to = position.find(e.to);
+        if (from == position.end() || to == position.end()) continue;
+        successors[from->second].push_back(to->second);
+        in_degree[to->second]++;
+    }
+
+    // Kahn's algorithm; always emitting the earliest ready node keeps the order stable.
+    std::vector<int> order;
+    order.reserve(nodes.size());
+    std::vector<bool> done(nodes.size(), false);
+    while (order.size() < nodes.size()) {
+        int next = -1;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (!done[i] && in_degree[i] == 0) {
+                next = (int)i;
+                break;
+            }
+        }
+        if (next == -1) return std::nullopt; // every remaining node is on a cycle
+        done[next] = true;
+        order.push_back(nodes[next]);
+        for (int s : successors[next]) in_degree[s]--;
+    }
+    return order;
+}
+
+} // namespace hibiki
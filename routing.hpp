@@ -0,0 +1,19 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+namespace hibiki {
+
+// Audio of track `from` is sent into return track `to`.
+struct SendEdge {
+    int from;
+    int to;
+};
+
+// Orders `nodes` so that every track comes after all tracks that send into it,
+// keeping the given order among independent tracks. Returns std::nullopt if the
+// edges form a feedback loop.
+std::optional<std::vector<int>> TopologicalOrder(const std::vector<int>& nodes, const std::vector<SendEdge>& edges);
+
+} // namespace hibiki
@@ -0,0 +1,26 @@
+#include <gtest/gtest.h>
+#include "routing.hpp"
+
+TEST(RoutingTest, SourcesComeBeforeReturns) {
+    // 3 and 4 are returns; 4 also feeds 3.
+    auto order = hibiki::TopologicalOrder({0, 3, 1, 4}, {{0, 3}, {1, 4}, {4, 3}});
+    ASSERT_TRUE(order.has_value());
+    EXPECT_EQ(*order, (std::vector<int>{0, 1, 4, 3}));
+}
+
+TEST(RoutingTest, KeepsOrderWithoutSends) {
+    auto order = hibiki::TopologicalOrder({2, 0, 1}, {});
+    ASSERT_TRUE(order.has_value());
+    EXPECT_EQ(*order, (std::vector<int>{2, 0, 1}));
+}
+
+TEST(RoutingTest, RejectsFeedback) {
+    EXPECT_FALSE(hibiki::TopologicalOrder({0, 1, 2}, {{0, 1}, {1, 2}, {2, 1}}).has_value());
+    EXPECT_FALSE(hibiki::TopologicalOrder({0}, {{0, 0}}).has_value());
+}
+
+TEST(RoutingTest, IgnoresUnknownTracks) {
+    auto order = hibiki::TopologicalOrder({0, 1}, {{0, 7}, {9, 1}});
+    ASSERT_TRUE(order.has_value());
+    EXPECT_EQ(order->size(), 2u);
+}
@@ -8,6 +8,7 @@ import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
 import java.util.concurrent.ExecutorService;
 import java.util.concurrent.Executors;
+import java.util.concurrent.atomic.AtomicLong;
 import java.util.ArrayList;
 import java.util.List;
 import java.util.function.Consumer;
@@ -18,6 +19,7 @@ public class BackendManager {
     private DataOutputStream out;
     private final ExecutorService executor = Executors.newCachedThreadPool();
     private final List<Consumer<Notification>> listeners = new ArrayList<>();
+    private final AtomicLong sequence = new AtomicLong();
 
     private BackendManager() {
     }
@@ -118,6 +120,13 @@ public class BackendManager {
         }
     }
 
+    // A fresh sequence id for a request; the backend echoes it in the
+    // notifications that answer the request.
+    public long nextSequence() {
+        long next = sequence.incrementAndGet() & 0xFFFFFFFFL;
+        return next != 0 ? next : nextSequence();
+    }
+
     public synchronized void sendRequest(FlatBufferBuilder builder) {
         try {
             byte[] data = builder.sizedByteArray();
@@ -199,7 +199,7 @@ public class BrowserPane extends JPanel {
         FlatBufferBuilder builder = new FlatBufferBuilder(1024);
         int pathOffset = builder.createString(path);
         int loadPluginOffset = LoadPlugin.createLoadPlugin(builder, 1, pathOffset, pluginIndex); // Default to track 1
-        int requestOffset = Request.createRequest(builder, Command.LoadPlugin, loadPluginOffset);
+        int requestOffset = Request.createRequest(builder, Command.LoadPlugin, loadPluginOffset, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -208,7 +208,7 @@ public class BrowserPane extends JPanel {
         FlatBufferBuilder builder = new FlatBufferBuilder(1024);
         int pathOffset = builder.createString(path);
         int loadClipOffset = LoadClip.createLoadClip(builder, 1, 0, pathOffset, isLoop); // Default to track 1, slot 0
-        int requestOffset = Request.createRequest(builder, Command.LoadClip, loadClipOffset);
+        int requestOffset = Request.createRequest(builder, Command.LoadClip, loadClipOffset, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
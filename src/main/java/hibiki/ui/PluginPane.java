@@ -255,7 +255,7 @@ public class PluginPane extends JPanel {
         private void sendShowGui() {
             FlatBufferBuilder builder = new FlatBufferBuilder(128);
             int showGuiOffset = hibiki.ipc.ShowPluginGui.createShowPluginGui(builder, trackIndex, pluginIndex);
-            int requestOffset = Request.createRequest(builder, Command.ShowPluginGui, showGuiOffset);
+            int requestOffset = Request.createRequest(builder, Command.ShowPluginGui, showGuiOffset, BackendManager.getInstance().nextSequence());
             builder.finish(requestOffset);
             BackendManager.getInstance().sendRequest(builder);
         }
@@ -263,7 +263,7 @@ public class PluginPane extends JPanel {
         private void sendRemovePlugin() {
             FlatBufferBuilder builder = new FlatBufferBuilder(128);
             int removeOff = hibiki.ipc.RemovePlugin.createRemovePlugin(builder, trackIndex, pluginIndex);
-            int requestOffset = Request.createRequest(builder, Command.RemovePlugin, removeOff);
+            int requestOffset = Request.createRequest(builder, Command.RemovePlugin, removeOff, BackendManager.getInstance().nextSequence());
             builder.finish(requestOffset);
             BackendManager.getInstance().sendRequest(builder);
 
@@ -304,7 +304,7 @@ public class PluginPane extends JPanel {
             FlatBufferBuilder builder = new FlatBufferBuilder(128);
             int setParamOffset = SetParamValue.createSetParamValue(builder,
                     trackIndex, pluginIndex, (int) paramId, value);
-            int requestOffset = Request.createRequest(builder, Command.SetParamValue, setParamOffset);
+            int requestOffset = Request.createRequest(builder, Command.SetParamValue, setParamOffset, BackendManager.getInstance().nextSequence());
             builder.finish(requestOffset);
             BackendManager.getInstance().sendRequest(builder);
         }
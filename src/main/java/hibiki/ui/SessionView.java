@@ -18,8 +18,8 @@ import java.io.File;
 
 import hibiki.ipc.Response;
 import hibiki.ipc.ClipInfo;
-import hibiki.ipc.TrackLevels;
-import hibiki.ipc.TrackLevel;
+import hibiki.ipc.LevelDeltas;
+import hibiki.ipc.LevelDelta;
 import hibiki.ipc.ClipWaveform;
 
 public class SessionView extends JPanel {
@@ -71,11 +71,12 @@ public class SessionView extends JPanel {
                 }
             } else if (notification.responseType() == Response.ClearProject) {
                 clearAllSlots();
-            } else if (notification.responseType() == Response.TrackLevels) {
-                TrackLevels tl = (TrackLevels) notification.response(new TrackLevels());
-                for (int i = 0; i < tl.levelsLength(); i++) {
-                    TrackLevel l = tl.levels(i);
-                    updateLevel(l.trackIndex(), l.peakL(), l.peakR());
+            } else if (notification.responseType() == Response.LevelDeltas) {
+                LevelDeltas deltas = (LevelDeltas) notification.response(new LevelDeltas());
+                LevelDelta l = new LevelDelta();
+                for (int i = 0; i < deltas.levelsLength(); i++) {
+                    deltas.levels(l, i);
+                    updateLevel(l.trackIndex(), toLinear(l.peakL()), toLinear(l.peakR()));
                 }
             }
         });
@@ -116,6 +117,11 @@ public class SessionView extends JPanel {
         });
     }
 
+    // LevelDeltas peaks are in half dB above -127.5 dBFS, 0 for silence.
+    private static float toLinear(int level) {
+        return level == 0 ? 0.0f : (float) Math.pow(10.0, (level / 2.0 - 127.5) / 20.0);
+    }
+
     private void updateLevel(int trackIdx, float peakL, float peakR) {
         SwingUtilities.invokeLater(() -> {
             if (trackIdx >= 1 && trackIdx <= 4) {
@@ -337,7 +343,7 @@ public class SessionView extends JPanel {
         LoadClip.addPath(builder, pathOff);
         LoadClip.addIsLoop(builder, isLoop);
         int loadOff = LoadClip.endLoadClip(builder);
-        int requestOffset = Request.createRequest(builder, Command.LoadClip, loadOff);
+        int requestOffset = Request.createRequest(builder, Command.LoadClip, loadOff, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -349,7 +355,7 @@ public class SessionView extends JPanel {
         SetClipLoop.addSlotIndex(builder, slotIdx);
         SetClipLoop.addIsLoop(builder, isLoop);
         int setOff = SetClipLoop.endSetClipLoop(builder);
-        int requestOffset = Request.createRequest(builder, Command.SetClipLoop, setOff);
+        int requestOffset = Request.createRequest(builder, Command.SetClipLoop, setOff, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -360,7 +366,7 @@ public class SessionView extends JPanel {
         PlayClip.addTrackIndex(builder, trackIdx);
         PlayClip.addSlotIndex(builder, slotIdx);
         int playClipOffset = PlayClip.endPlayClip(builder);
-        int requestOffset = Request.createRequest(builder, Command.PlayClip, playClipOffset);
+        int requestOffset = Request.createRequest(builder, Command.PlayClip, playClipOffset, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -370,7 +376,7 @@ public class SessionView extends JPanel {
         StopTrack.startStopTrack(builder);
         StopTrack.addTrackIndex(builder, trackIdx);
         int stopTrackOffset = StopTrack.endStopTrack(builder);
-        int requestOffset = Request.createRequest(builder, Command.StopTrack, stopTrackOffset);
+        int requestOffset = Request.createRequest(builder, Command.StopTrack, stopTrackOffset, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -380,7 +386,7 @@ public class SessionView extends JPanel {
         PlayScene.startPlayScene(builder);
         PlayScene.addSlotIndex(builder, slotIdx);
         int playSceneOff = PlayScene.endPlayScene(builder);
-        int requestOffset = Request.createRequest(builder, Command.PlayScene, playSceneOff);
+        int requestOffset = Request.createRequest(builder, Command.PlayScene, playSceneOff, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -391,7 +397,7 @@ public class SessionView extends JPanel {
         DeleteClip.addTrackIndex(builder, trackIdx);
         DeleteClip.addSlotIndex(builder, slotIdx);
         int deleteOff = DeleteClip.endDeleteClip(builder);
-        int requestOffset = Request.createRequest(builder, Command.DeleteClip, deleteOff);
+        int requestOffset = Request.createRequest(builder, Command.DeleteClip, deleteOff, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
 
@@ -135,7 +135,7 @@ public class TopBar extends JPanel {
         FlatBufferBuilder builder = new FlatBufferBuilder(128);
         Play.startPlay(builder);
         int playOffset = Play.endPlay(builder);
-        int requestOffset = Request.createRequest(builder, Command.Play, playOffset);
+        int requestOffset = Request.createRequest(builder, Command.Play, playOffset, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -144,7 +144,7 @@ public class TopBar extends JPanel {
         FlatBufferBuilder builder = new FlatBufferBuilder(128);
         Stop.startStop(builder);
         int stopOffset = Stop.endStop(builder);
-        int requestOffset = Request.createRequest(builder, Command.Stop, stopOffset);
+        int requestOffset = Request.createRequest(builder, Command.Stop, stopOffset, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -167,7 +167,7 @@ public class TopBar extends JPanel {
         FlatBufferBuilder builder = new FlatBufferBuilder(512);
         int pathOff = builder.createString(path);
         int saveOff = SaveProject.createSaveProject(builder, pathOff);
-        int requestOffset = Request.createRequest(builder, Command.SaveProject, saveOff);
+        int requestOffset = Request.createRequest(builder, Command.SaveProject, saveOff, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -176,7 +176,7 @@ public class TopBar extends JPanel {
         FlatBufferBuilder builder = new FlatBufferBuilder(512);
         int pathOff = builder.createString(path);
         int loadOff = LoadProject.createLoadProject(builder, pathOff);
-        int requestOffset = Request.createRequest(builder, Command.LoadProject, loadOff);
+        int requestOffset = Request.createRequest(builder, Command.LoadProject, loadOff, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
     }
@@ -186,7 +186,7 @@ public class TopBar extends JPanel {
             float bpm = Float.parseFloat(bpmStr);
             FlatBufferBuilder builder = new FlatBufferBuilder(128);
             int setBpmOff = SetBpm.createSetBpm(builder, bpm);
-            int requestOffset = Request.createRequest(builder, Command.SetBpm, setBpmOff);
+            int requestOffset = Request.createRequest(builder, Command.SetBpm, setBpmOff, BackendManager.getInstance().nextSequence());
             builder.finish(requestOffset);
             BackendManager.getInstance().sendRequest(builder);
         } catch (NumberFormatException ex) {
@@ -73,7 +73,7 @@ public class WaveformPanel extends JPanel {
         DeleteClip.addTrackIndex(builder, trackIdx);
         DeleteClip.addSlotIndex(builder, slotIdx);
         int deleteOff = DeleteClip.endDeleteClip(builder);
-        int requestOffset = Request.createRequest(builder, Command.DeleteClip, deleteOff);
+        int requestOffset = Request.createRequest(builder, Command.DeleteClip, deleteOff, BackendManager.getInstance().nextSequence());
         builder.finish(requestOffset);
         BackendManager.getInstance().sendRequest(builder);
 
@@ -0,0 +1,224 @@
+#include "stats_reporter.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <utility>
+
+namespace hibiki {
+
+namespace {
+
+// How often the reporter looks for posted notifications.
+constexpr auto kPollInterval = std::chrono::milliseconds(5);
+
+} // namespace
+
+EngineStatsReport CollectStatsReport(ProjectState& state) {
+    EngineStatsReport report;
+    report.deadline_us = state.stats.deadline_us.load(std::memory_order_relaxed);
+    report.block = state.stats.block_render.Drain();
+    report.overruns = state.stats.overruns.exchange(0, std::memory_order_relaxed);
+    report.xruns = state.stats.xruns.exchange(0, std::memory_order_relaxed);
+    report.jitter = state.stats.jitter.Drain();
+    report.lookahead_misses = state.stats.lookahead_misses.exchange(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(state.tracks_mutex);
+    for (const auto& [index, track] : state.tracks) {
+        EngineStatsReport::Track entry{index, track->render_time.Drain(), {}};
+        std::lock_guard<std::mutex> track_lock(track->mutex);
+        for (size_t i = 0; i < track->plugins.size(); ++i) {
+            auto& p = track->plugins[i];
+            entry.plugins.push_back({(int)i, p->getName(), p->processTime().Drain()});
+        }
+        report.tracks.push_back(std::move(entry));
+    }
+    return report;
+}
+
+StatsReporter::StatsReporter(ProjectState& state, ReportCallback report, ActionCallback action, Telemetry telemetry)
+    : state_(state), report_(std::move(report)), action_(std::move(action)), telemetry_(std::move(telemetry)) {
+    for (auto& playhead : playheads_) playhead.tracks.reserve(PlayheadReport::kMaxTracks);
+    thread_ = std::thread([this] { Run(); });
+}
+
+StatsReporter::~StatsReporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void StatsReporter::SetLatencyPolicy(std::optional<LatencyPolicy> policy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (policy) {
+        controller_.emplace(*policy, block_size_);
+    } else {
+        controller_.reset();
+    }
+    decision_.reset();
+    latency_pending_.store(false, std::memory_order_release);
+}
+
+void StatsReporter::SetBlockSize(int block_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    block_size_ = block_size;
+    if (controller_) controller_->SetBlockSize(block_size);
+    decision_.reset();
+    latency_pending_.store(false, std::memory_order_release);
+}
+
+std::optional<LatencyDecision> StatsReporter::TakeLatencyDecision() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latency_pending_.store(false, std::memory_order_release);
+    return std::exchange(decision_, std::nullopt);
+}
+
+void StatsReporter::PostPlayhead(const PlayheadReport& report, StatsClock::time_point dac_time) {
+    PlayheadReport& slot = playheads_[playhead_back_];
+    slot.transport_frame = report.transport_frame;
+    slot.bpm = report.bpm;
+    slot.sample_rate = report.sample_rate;
+    slot.dac_time = dac_time;
+    slot.tracks.assign(report.tracks.begin(), report.tracks.begin() + std::min(report.tracks.size(), PlayheadReport::kMaxTracks));
+    playhead_back_ = playhead_middle_.exchange(playhead_back_ | kFresh, std::memory_order_acq_rel) & ~kFresh;
+}
+
+void StatsReporter::PostIdleState(bool idle, float wake_latency_us) {
+    const uint64_t write = idle_write_.load(std::memory_order_relaxed);
+    if (write - idle_read_.load(std::memory_order_acquire) == kIdleStates) return;
+    idle_states_[write % kIdleStates] = {idle, wake_latency_us};
+    idle_write_.store(write + 1, std::memory_order_release);
+}
+
+void StatsReporter::Run() {
+    trace::SetThreadName("stats");
+    StatsClock::time_point last_report = StatsClock::now();
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, kPollInterval, [&] { return stop_; });
+            if (stop_) return;
+        }
+        SendIdleStates();
+        SendPlayhead();
+        SendLevels();
+
+        const int interval_ms = state_.stats.interval_ms.load(std::memory_order_relaxed);
+        const auto now = StatsClock::now();
+        if (interval_ms <= 0 || now - last_report < std::chrono::milliseconds(interval_ms)) continue;
+        last_report = now;
+        ReportStats();
+    }
+}
+
+void StatsReporter::ReportStats() {
+    HIBIKI_TRACE_SCOPE("StatsReporter::Report");
+    auto report = CollectStatsReport(state_);
+    if (report.block.count == 0) return;
+    if (report_) report_(report);
+    RunGovernor(report);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (controller_) {
+        if (auto decision = controller_->Update(report)) {
+            decision_ = std::move(decision);
+            latency_pending_.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void StatsReporter::SendPlayhead() {
+    if (!(playhead_middle_.load(std::memory_order_acquire) & kFresh)) return;
+    playhead_front_ = playhead_middle_.exchange(playhead_front_, std::memory_order_acq_rel) & ~kFresh;
+    if (telemetry_.playhead) telemetry_.playhead(playheads_[playhead_front_]);
+}
+
+void StatsReporter::SendIdleStates() {
+    const uint64_t write = idle_write_.load(std::memory_order_acquire);
+    for (uint64_t read = idle_read_.load(std::memory_order_relaxed); read != write; ++read) {
+        const IdleState state = idle_states_[read % kIdleStates];
+        idle_read_.store(read + 1, std::memory_order_release);
+        if (telemetry_.idle) telemetry_.idle(state.idle, state.wake_latency_us);
+    }
+}
+
+void StatsReporter::SendLevels() {
+    const int interval_ms = state_.level_interval_ms.load(std::memory_order_relaxed);
+    const auto now = StatsClock::now();
+    if (interval_ms <= 0 || now - last_levels_ < std::chrono::milliseconds(interval_ms)) return;
+    last_levels_ = now;
+    if (uint32_t subscriptions = state_.level_subscriptions.load(); subscriptions != level_subscriptions_) {
+        level_subscriptions_ = subscriptions;
+        level_encoder_.Reset();
+    }
+    level_encoder_.SetThreshold(state_.level_threshold_db.load(std::memory_order_relaxed));
+    {
+        // Copying reuses the nodes of the last copy, so the engine waits on
+        // the lock no longer than that.
+        std::lock_guard<std::mutex> lock(state_.levels_mutex);
+        levels_ = state_.track_levels;
+    }
+    bool full = level_encoder_.Encode(levels_, level_deltas_);
+    if ((full || !level_deltas_.empty()) && telemetry_.levels) telemetry_.levels(level_deltas_, full);
+}
+
+void StatsReporter::RunGovernor(const EngineStatsReport& report) {
+    std::vector<GovernorAction> actions;
+    {
+        std::lock_guard<std::mutex> lock(state_.tracks_mutex);
+        uint32_t generation = state_.governor_generation.load(std::memory_order_acquire);
+        if (!governor_ || generation != governor_generation_) {
+            // New settings restore everything.
+            if (governor_) {
+                for (const auto& [index, track] : state_.tracks) {
+                    track->cut.store(false, std::memory_order_relaxed);
+                    std::lock_guard<std::mutex> track_lock(track->mutex);
+                    for (auto& p : track->plugins) p->setBypassed(false);
+                    track->Invalidate();
+                }
+            }
+            GovernorSettings settings;
+            settings.policy = (GovernorPolicy)state_.governor_policy.load(std::memory_order_relaxed);
+            settings.track_budget = state_.governor_track_budget.load(std::memory_order_relaxed);
+            settings.overload_intervals = state_.governor_overload_intervals.load(std::memory_order_relaxed);
+            governor_.emplace(settings);
+            governor_generation_ = generation;
+        }
+        if (governor_->settings().policy == GovernorPolicy::kOff) return;
+
+        std::set<int> essential;
+        for (const auto& [index, track] : state_.tracks) {
+            if (track->essential.load(std::memory_order_relaxed)) essential.insert(index);
+        }
+        for (auto& action : governor_->Update(report, essential)) {
+            auto it = state_.tracks.find(action.track_index);
+            if (it == state_.tracks.end()) continue;
+            Track* track = it->second.get();
+            std::lock_guard<std::mutex> track_lock(track->mutex);
+            const auto& plugins = track->plugins;
+            // A frozen render takes a background freeze, which the callee
+            // starts; until it is ready the heaviest plugin is bypassed.
+            if (action.kind == GovernorAction::Kind::kUseFrozen) {
+                if (action.plugin_index >= 0 && action.plugin_index < (int)plugins.size()) {
+                    plugins[action.plugin_index]->setBypassed(true);
+                    action.reason += "; plugin bypassed until the frozen render is ready";
+                }
+            } else if (action.kind == GovernorAction::Kind::kBypassPlugin) {
+                if (action.plugin_index < 0 || action.plugin_index >= (int)plugins.size()) continue;
+                plugins[action.plugin_index]->setBypassed(true);
+            } else {
+                track->cut.store(true, std::memory_order_relaxed);
+            }
+            track->Invalidate();
+            actions.push_back(std::move(action));
+        }
+    }
+    if (action_) {
+        for (const auto& action : actions) action_(action);
+    }
+}
+
+} // namespace hibiki
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "cpu_governor.hpp"
+#include "engine_stats.hpp"
+#include "latency_controller.hpp"
+#include "project.hpp"
+#include "telemetry.hpp"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace hibiki {
+
+// Drains the load counters that the engine, the render workers and the
+// device loop update into a report of everything since the previous call.
+// Takes state.tracks_mutex; not for the audio thread.
+EngineStatsReport CollectStatsReport(ProjectState& state);
+
+// Builds an EngineStatsReport every state.stats.interval_ms on a background
+// thread, so that the audio thread only ever bumps counters. Each report
+// goes to the callback and drives the CPU governor and, if it is set, the
+// latency controller. Intervals in which no block was rendered, as while
+// the device is idle, are not reported. The same thread sends the
+// notifications the audio thread posts, so that it never writes to the GUI.
+class StatsReporter {
+public:
+    using ReportCallback = std::function<void(const EngineStatsReport&)>;
+    // For the GUI; kUseFrozen actions ask the callee to freeze the track.
+    using ActionCallback = std::function<void(const GovernorAction&)>;
+    // Where the posted notifications go.
+    struct Telemetry {
+        std::function<void(const PlayheadReport&)> playhead;
+        // The track levels the engine leaves in the project state, every
+        // state.level_interval_ms while any moved; see LevelDeltaEncoder.
+        std::function<void(const std::vector<LevelDeltaEncoder::Delta>&, bool full)> levels;
+        std::function<void(bool idle, float wake_latency_us)> idle;
+    };
+
+    StatsReporter(ProjectState& state, ReportCallback report, ActionCallback action = {}, Telemetry telemetry = {});
+    ~StatsReporter();
+
+    StatsReporter(const StatsReporter&) = delete;
+    StatsReporter& operator=(const StatsReporter&) = delete;
+
+    // Turns adaptive block sizing on with a new controller, or off.
+    void SetLatencyPolicy(std::optional<LatencyPolicy> policy);
+    // After each reopen: the block size the device now runs. The controller
+    // keeps its backoff across reopens.
+    void SetBlockSize(int block_size);
+    // Audio thread: whether the latency controller wants another block size.
+    bool latency_change_pending() const { return latency_pending_.load(std::memory_order_acquire); }
+    // The decision behind latency_change_pending, once.
+    std::optional<LatencyDecision> TakeLatencyDecision();
+
+    // Audio thread: copies the playhead, at most PlayheadReport::kMaxTracks
+    // tracks of it, without allocating. Only the latest one is sent.
+    void PostPlayhead(const PlayheadReport& report, StatsClock::time_point dac_time);
+    // Audio thread: the device parked or woke, with the time from the wake
+    // request to the first block. Sent in order; dropped if kIdleStates are
+    // already waiting.
+    void PostIdleState(bool idle, float wake_latency_us);
+
+private:
+    void Run();
+    void ReportStats();
+    void RunGovernor(const EngineStatsReport& report);
+    void SendPlayhead();
+    void SendLevels();
+    void SendIdleStates();
+
+    ProjectState& state_;
+    ReportCallback report_;
+    ActionCallback action_;
+    Telemetry telemetry_;
+
+    // The playhead's triple buffer: the audio thread fills the back slot and
+    // swaps it with the middle one, marked fresh; the reporter swaps a fresh
+    // middle with the front slot and sends that.
+    static constexpr int kFresh = 4;
+    std::array<PlayheadReport, 3> playheads_;
+    int playhead_back_ = 0;
+    std::atomic<int> playhead_middle_{1};
+    int playhead_front_ = 2;
+
+    // Idle edges, a single-producer, single-consumer ring.
+    struct IdleState {
+        bool idle;
+        float wake_latency_us;
+    };
+    static constexpr size_t kIdleStates = 8;
+    std::array<IdleState, kIdleStates> idle_states_{};
+    std::atomic<uint64_t> idle_read_{0};
+    std::atomic<uint64_t> idle_write_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    int block_size_ = 0;
+    std::optional<LatencyController> controller_;
+    std::optional<LatencyDecision> decision_;
+    std::atomic<bool> latency_pending_{false};
+
+    // Reporter thread only.
+    std::optional<CpuGovernor> governor_;
+    uint32_t governor_generation_ = 0;
+    LevelDeltaEncoder level_encoder_;
+    std::map<int, std::pair<float, float>> levels_;
+    std::vector<LevelDeltaEncoder::Delta> level_deltas_;
+    uint32_t level_subscriptions_ = 0;
+    StatsClock::time_point last_levels_;
+    std::thread thread_;
+};
+
+} // namespace hibiki
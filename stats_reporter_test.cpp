@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "engine.hpp"
+#include "stats_reporter.hpp"
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 256;
+
+TEST(StatsReporterTest, CollectDrainsTheCounters) {
+    hibiki::ProjectState state;
+    hibiki::GetOrCreateTrack(state, 3);
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    engine.Process(l.data(), r.data());
+    state.stats.xruns += 2;
+
+    auto report = hibiki::CollectStatsReport(state);
+    EXPECT_EQ(report.block.count, 1u);
+    EXPECT_NEAR(report.deadline_us, kBlockSize * 1e6 / kSampleRate, 1e-3);
+    EXPECT_EQ(report.xruns, 2u);
+    ASSERT_EQ(report.tracks.size(), 1u);
+    EXPECT_EQ(report.tracks[0].track_index, 3);
+
+    report = hibiki::CollectStatsReport(state);
+    EXPECT_EQ(report.block.count, 0u);
+    EXPECT_EQ(report.xruns, 0u);
+}
+
+TEST(StatsReporterTest, ReportsWhileBlocksRender) {
+    hibiki::ProjectState state;
+    state.stats.interval_ms = 1;
+    std::promise<hibiki::EngineStatsReport> reported;
+    bool done = false;
+    hibiki::StatsReporter reporter(state, [&](const hibiki::EngineStatsReport& report) {
+        if (done) return;
+        done = true;
+        reported.set_value(report);
+    });
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    auto future = reported.get_future();
+    do {
+        engine.Process(l.data(), r.data());
+    } while (future.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready);
+    EXPECT_GE(future.get().block.count, 1u);
+}
+
+TEST(StatsReporterTest, LatencyDecisionWaitsForTheAudioThread) {
+    hibiki::ProjectState state;
+    state.stats.interval_ms = 1;
+    hibiki::StatsReporter reporter(state, {});
+    hibiki::LatencyPolicy policy;
+    policy.overload_intervals = 2;
+    reporter.SetBlockSize(kBlockSize);
+    reporter.SetLatencyPolicy(policy);
+
+    // Every interval has xruns until the controller asks for larger blocks.
+    hibiki::Engine engine(state, kSampleRate, kBlockSize, 0);
+    std::vector<float> l(kBlockSize), r(kBlockSize);
+    while (!reporter.latency_change_pending()) {
+        engine.Process(l.data(), r.data());
+        state.stats.xruns++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto decision = reporter.TakeLatencyDecision();
+    ASSERT_TRUE(decision.has_value());
+    EXPECT_EQ(decision->block_size, 2 * kBlockSize);
+    EXPECT_FALSE(reporter.latency_change_pending());
+    EXPECT_FALSE(reporter.TakeLatencyDecision().has_value());
+}
+
+TEST(StatsReporterTest, SendsPostedPlayheads) {
+    hibiki::ProjectState state;
+    std::promise<hibiki::PlayheadReport> sent;
+    hibiki::StatsReporter::Telemetry telemetry;
+    telemetry.playhead = [&](const hibiki::PlayheadReport& report) {
+        if (report.transport_frame == kBlockSize) sent.set_value(report);
+    };
+    hibiki::StatsReporter reporter(state, {}, {}, telemetry);
+
+    hibiki::PlayheadReport report;
+    report.transport_frame = 0;
+    reporter.PostPlayhead(report, {});
+    report.transport_frame = kBlockSize;
+    report.tracks.resize(hibiki::PlayheadReport::kMaxTracks + 1, {1, 2, 0.5, 1.0, true});
+    const auto dac_time = hibiki::StatsClock::now();
+    reporter.PostPlayhead(report, dac_time);
+
+    // Cut to kMaxTracks.
+    auto playhead = sent.get_future().get();
+    EXPECT_EQ(playhead.dac_time, dac_time);
+    ASSERT_EQ(playhead.tracks.size(), hibiki::PlayheadReport::kMaxTracks);
+    EXPECT_EQ(playhead.tracks[0].slot_index, 2);
+}
+
+TEST(StatsReporterTest, SendsLevelsThatMoved) {
+    hibiki::ProjectState state;
+    state.level_interval_ms = 1;
+    state.track_levels[0] = {0.5f, 0.5f};
+    std::promise<std::vector<hibiki::LevelDeltaEncoder::Delta>> first, second;
+    int sent = 0;
+    hibiki::StatsReporter::Telemetry telemetry;
+    telemetry.levels = [&](const std::vector<hibiki::LevelDeltaEncoder::Delta>& deltas, bool full) {
+        if (sent == 0) EXPECT_TRUE(full);
+        if (sent == 0) first.set_value(deltas);
+        if (sent == 1) second.set_value(deltas);
+        ++sent;
+    };
+    hibiki::StatsReporter reporter(state, {}, {}, telemetry);
+
+    auto deltas = first.get_future().get();
+    ASSERT_EQ(deltas.size(), 1u);
+    EXPECT_EQ(deltas[0].peak_l, hibiki::QuantizeLevel(0.5f));
+    {
+        std::lock_guard<std::mutex> lock(state.levels_mutex);
+        state.track_levels[1] = {0.25f, 0.25f};
+    }
+    // Only the track that moved.
+    deltas = second.get_future().get();
+    ASSERT_EQ(deltas.size(), 1u);
+    EXPECT_EQ(deltas[0].track_index, 1);
+}
+
+TEST(StatsReporterTest, SendsIdleStatesInOrder) {
+    hibiki::ProjectState state;
+    std::vector<std::pair<bool, float>> sent;
+    std::promise<void> done;
+    hibiki::StatsReporter::Telemetry telemetry;
+    telemetry.idle = [&](bool idle, float wake_latency_us) {
+        sent.push_back({idle, wake_latency_us});
+        if (sent.size() == 3) done.set_value();
+    };
+    hibiki::StatsReporter reporter(state, {}, {}, telemetry);
+    reporter.PostIdleState(true, 0.0f);
+    reporter.PostIdleState(false, 250.0f);
+    reporter.PostIdleState(true, 0.0f);
+    done.get_future().wait();
+    EXPECT_EQ(sent, (std::vector<std::pair<bool, float>>{{true, 0.0f}, {false, 250.0f}, {true, 0.0f}}));
+}
+
+} // namespace
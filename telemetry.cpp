@@ -0,0 +1,47 @@
+#include "telemetry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace hibiki {
+
+uint8_t QuantizeLevel(float peak) {
+    if (!(peak > 0.0f)) return 0;
+    const double db = 20.0 * std::log10((double)peak);
+    return (uint8_t)std::clamp(std::lround((db + 127.5) * 2.0), 0L, 255L);
+}
+
+void LevelDeltaEncoder::SetThreshold(float threshold_db) {
+    threshold_steps_ = std::max(1, (int)std::lround(threshold_db * 2.0f));
+}
+
+void LevelDeltaEncoder::Reset() {
+    full_ = true;
+}
+
+bool LevelDeltaEncoder::Encode(const std::map<int, std::pair<float, float>>& levels, std::vector<Delta>& out) {
+    out.clear();
+    const bool full = full_;
+    full_ = false;
+    auto moved = [&](uint8_t sent, uint8_t now) {
+        return std::abs(now - sent) >= threshold_steps_ || (now == 0 && sent != 0);
+    };
+    for (auto it = sent_.begin(); it != sent_.end();) {
+        if (levels.count(it->first)) {
+            ++it;
+            continue;
+        }
+        if (!full && (it->second.first != 0 || it->second.second != 0)) out.push_back({it->first, 0, 0});
+        it = sent_.erase(it);
+    }
+    for (const auto& [index, peaks] : levels) {
+        const uint8_t l = QuantizeLevel(peaks.first), r = QuantizeLevel(peaks.second);
+        auto [it, added] = sent_.try_emplace(index, l, r);
+        if (!full && !added && !moved(it->second.first, l) && !moved(it->second.second, r)) continue;
+        it->second = {l, r};
+        out.push_back({index, l, r});
+    }
+    return full;
+}
+
+} // namespace hibiki
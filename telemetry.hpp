@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace hibiki {
+
+// Telemetry the GUI subscribes to, with the values of the request's Topic.
+enum class TelemetryTopic { kLevels = 0, kTransport = 1, kStats = 2, kMeters = 3 };
+
+// A linear peak in the half-dB steps of LevelDeltas: 0 is -127.5 dBFS or
+// below, silence included, 255 is 0 dBFS or above.
+uint8_t QuantizeLevel(float peak);
+
+// Remembers the track levels last sent to the GUI and picks out those that
+// moved since, so that steady and silent tracks cost nothing.
+class LevelDeltaEncoder {
+public:
+    struct Delta {
+        int track_index;
+        uint8_t peak_l;
+        uint8_t peak_r;
+    };
+
+    // Smallest move that is sent; a drop to silence always is.
+    void SetThreshold(float threshold_db);
+    // The next Encode sends every track, for a new subscriber.
+    void Reset();
+    // Fills out with the tracks whose quantized levels moved by the threshold,
+    // and with silence for tracks gone since they were sent. Returns whether
+    // out holds every track.
+    bool Encode(const std::map<int, std::pair<float, float>>& levels, std::vector<Delta>& out);
+
+private:
+    std::map<int, std::pair<uint8_t, uint8_t>> sent_;
+    int threshold_steps_ = 1;
+    bool full_ = true;
+};
+
+} // namespace hibiki
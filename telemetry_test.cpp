@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include "telemetry.hpp"
+
+#include <cmath>
+
+namespace {
+
+std::vector<int> Tracks(const std::vector<hibiki::LevelDeltaEncoder::Delta>& deltas) {
+    std::vector<int> tracks;
+    for (const auto& delta : deltas) tracks.push_back(delta.track_index);
+    return tracks;
+}
+
+TEST(TelemetryTest, QuantizesLevelsInHalfDecibels) {
+    EXPECT_EQ(hibiki::QuantizeLevel(0.0f), 0);
+    EXPECT_EQ(hibiki::QuantizeLevel(1e-9f), 0);
+    EXPECT_EQ(hibiki::QuantizeLevel(1.0f), 255);
+    EXPECT_EQ(hibiki::QuantizeLevel(4.0f), 255);
+    EXPECT_EQ(hibiki::QuantizeLevel(0.1f), 215);
+}
+
+TEST(TelemetryTest, SendsOnlyWhatMoved) {
+    hibiki::LevelDeltaEncoder encoder;
+    encoder.SetThreshold(1.0f);
+    std::map<int, std::pair<float, float>> levels = {{1, {0.5f, 0.5f}}, {2, {0.25f, 0.0f}}, {3, {0.0f, 0.0f}}};
+    std::vector<hibiki::LevelDeltaEncoder::Delta> deltas;
+    EXPECT_TRUE(encoder.Encode(levels, deltas));
+    EXPECT_EQ(Tracks(deltas), (std::vector<int>{1, 2, 3}));
+
+    // Nothing moved: nothing to send.
+    EXPECT_FALSE(encoder.Encode(levels, deltas));
+    EXPECT_TRUE(deltas.empty());
+
+    // Half a decibel is under the threshold, two are not.
+    levels[1].first *= std::pow(10.0f, 0.5f / 20);
+    levels[2].second = 0.1f;
+    encoder.Encode(levels, deltas);
+    ASSERT_EQ(Tracks(deltas), (std::vector<int>{2}));
+    EXPECT_EQ(deltas[0].peak_r, 215);
+
+    // Going silent is always sent; a track that went is sent as silence.
+    levels[2] = {0.0f, 0.0f};
+    levels.erase(1);
+    encoder.Encode(levels, deltas);
+    ASSERT_EQ(Tracks(deltas), (std::vector<int>{1, 2}));
+    EXPECT_EQ(deltas[0].peak_l, 0);
+    EXPECT_EQ(deltas[1].peak_l, 0);
+
+    encoder.Reset();
+    EXPECT_TRUE(encoder.Encode(levels, deltas));
+    EXPECT_EQ(Tracks(deltas), (std::vector<int>{2, 3}));
+}
+
+} // namespace
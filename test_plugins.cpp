@@ -0,0 +1,284 @@
+// Synthetic VST3 plugins for tests and load benchmarks. One module exports
+// four audio processor classes, in this index order:
+//   0: Hibiki Test Sine     instrument, a sine per held note
+//   1: Hibiki Test Gain     effect, "Gain" scales by 0..2 (default 1)
+//   2: Hibiki Test Burn     effect, passes audio through after spinning for
+//                           "Burn" x 10 ms of wall time per block
+//   3: Hibiki Test Latency  effect, delays audio by kLatencySamples and
+//                           reports that latency and a kTailSamples tail
+// The burn default can be set with HIBIKI_TEST_BURN_US, so load tests can set
+// a CPU cost without going through the parameter path.
+
+#include "public.sdk/source/main/pluginfactory.h"
+#include "public.sdk/source/vst/vstaudioeffect.h"
+#include "public.sdk/source/vst/vsteditcontroller.h"
+#include "pluginterfaces/base/ustring.h"
+#include "pluginterfaces/vst/ivstevents.h"
+#include "pluginterfaces/vst/ivstparameterchanges.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+namespace {
+
+constexpr ParamID kGainParam = 0;
+constexpr ParamID kBurnParam = 0;
+constexpr double kMaxBurnUs = 10000.0;
+constexpr uint32 kLatencySamples = 256;
+constexpr uint32 kTailSamples = 4800;
+
+const FUID kSineUID(0x6869626B, 0x69537E01, 0x9E5A1C00, 0x00000001);
+const FUID kGainUID(0x6869626B, 0x69537E01, 0x9E5A1C00, 0x00000002);
+const FUID kBurnUID(0x6869626B, 0x69537E01, 0x9E5A1C00, 0x00000003);
+const FUID kLatencyUID(0x6869626B, 0x69537E01, 0x9E5A1C00, 0x00000004);
+const FUID kGainControllerUID(0x6869626B, 0x69537E01, 0x9E5A1C00, 0x00000102);
+const FUID kBurnControllerUID(0x6869626B, 0x69537E01, 0x9E5A1C00, 0x00000103);
+const FUID kEmptyControllerUID(0x6869626B, 0x69537E01, 0x9E5A1C00, 0x00000100);
+
+double DefaultBurn() {
+    const char* env = std::getenv("HIBIKI_TEST_BURN_US");
+    return env ? std::clamp(std::atof(env) / kMaxBurnUs, 0.0, 1.0) : 0.0;
+}
+
+// Stereo processor base: sets up the buses and hands the last value of each
+// incoming parameter change to OnParameter before Render.
+class TestProcessor : public AudioEffect {
+public:
+    TestProcessor(const FUID& controller, bool instrument) : instrument_(instrument) {
+        setControllerClass(controller);
+    }
+
+    tresult PLUGIN_API initialize(FUnknown* context) override {
+        tresult result = AudioEffect::initialize(context);
+        if (result != kResultOk) return result;
+        if (instrument_) {
+            addEventInput(STR16("Events In"), 1);
+        } else {
+            addAudioInput(STR16("Stereo In"), SpeakerArr::kStereo);
+        }
+        addAudioOutput(STR16("Stereo Out"), SpeakerArr::kStereo);
+        return kResultOk;
+    }
+
+    tresult PLUGIN_API setupProcessing(ProcessSetup& setup) override {
+        sample_rate_ = setup.sampleRate;
+        return AudioEffect::setupProcessing(setup);
+    }
+
+    tresult PLUGIN_API process(ProcessData& data) override {
+        if (IParameterChanges* changes = data.inputParameterChanges) {
+            for (int32 i = 0; i < changes->getParameterCount(); ++i) {
+                IParamValueQueue* queue = changes->getParameterData(i);
+                if (!queue || queue->getPointCount() == 0) continue;
+                int32 offset = 0;
+                ParamValue value = 0;
+                if (queue->getPoint(queue->getPointCount() - 1, offset, value) == kResultTrue) {
+                    OnParameter(queue->getParameterId(), value);
+                }
+            }
+        }
+        if (data.numOutputs == 0 || data.outputs[0].numChannels < 2) return kResultOk;
+
+        float* in[2] = {nullptr, nullptr};
+        if (!instrument_ && data.numInputs > 0 && data.inputs[0].numChannels >= 2) {
+            in[0] = data.inputs[0].channelBuffers32[0];
+            in[1] = data.inputs[0].channelBuffers32[1];
+        }
+        float** out = data.outputs[0].channelBuffers32;
+        data.outputs[0].silenceFlags = 0;
+        Render(data, in, out, data.numSamples);
+        return kResultOk;
+    }
+
+protected:
+    virtual void OnParameter(ParamID, ParamValue) {}
+    // in[0] and in[1] are null when there is no audio input.
+    virtual void Render(ProcessData& data, float** in, float** out, int32 n) = 0;
+
+    double sample_rate_ = 44100.0;
+
+private:
+    bool instrument_;
+};
+
+class SineProcessor : public TestProcessor {
+public:
+    SineProcessor() : TestProcessor(kEmptyControllerUID, true) {}
+    static FUnknown* createInstance(void*) { return (IAudioProcessor*)new SineProcessor; }
+
+protected:
+    // Renders the most recent held note; events are applied at their offsets.
+    void Render(ProcessData& data, float**, float** out, int32 n) override {
+        IEventList* events = data.inputEvents;
+        int32 num_events = events ? events->getEventCount() : 0;
+        int32 next = 0;
+        for (int32 i = 0; i < n; ++i) {
+            Event e = {};
+            while (next < num_events && events->getEvent(next, e) == kResultOk && e.sampleOffset <= i) {
+                if (e.type == Event::kNoteOnEvent && e.noteOn.velocity > 0) {
+                    pitch_ = e.noteOn.pitch;
+                    amplitude_ = 0.25f * e.noteOn.velocity;
+                } else if ((e.type == Event::kNoteOffEvent && e.noteOff.pitch == pitch_) ||
+                           (e.type == Event::kNoteOnEvent && e.noteOn.pitch == pitch_)) {
+                    amplitude_ = 0.0f;
+                }
+                next++;
+            }
+            float sample = 0.0f;
+            if (amplitude_ > 0.0f) {
+                double freq = 440.0 * std::pow(2.0, (pitch_ - 69) / 12.0);
+                phase_ = std::fmod(phase_ + freq / sample_rate_, 1.0);
+                sample = amplitude_ * (float)std::sin(2.0 * M_PI * phase_);
+            }
+            out[0][i] = sample;
+            out[1][i] = sample;
+        }
+    }
+
+private:
+    int16 pitch_ = 69;
+    float amplitude_ = 0.0f;
+    double phase_ = 0.0;
+};
+
+class GainProcessor : public TestProcessor {
+public:
+    GainProcessor() : TestProcessor(kGainControllerUID, false) {}
+    static FUnknown* createInstance(void*) { return (IAudioProcessor*)new GainProcessor; }
+
+protected:
+    void OnParameter(ParamID id, ParamValue value) override {
+        if (id == kGainParam) gain_ = 2.0f * (float)value;
+    }
+    void Render(ProcessData&, float** in, float** out, int32 n) override {
+        for (int c = 0; c < 2; ++c) {
+            for (int32 i = 0; i < n; ++i) out[c][i] = in[c] ? in[c][i] * gain_ : 0.0f;
+        }
+    }
+
+private:
+    float gain_ = 1.0f;
+};
+
+class BurnProcessor : public TestProcessor {
+public:
+    BurnProcessor() : TestProcessor(kBurnControllerUID, false), burn_us_(DefaultBurn() * kMaxBurnUs) {}
+    static FUnknown* createInstance(void*) { return (IAudioProcessor*)new BurnProcessor; }
+
+protected:
+    void OnParameter(ParamID id, ParamValue value) override {
+        if (id == kBurnParam) burn_us_ = value * kMaxBurnUs;
+    }
+    // Busy-waits rather than sleeping so the cost shows up as CPU load.
+    void Render(ProcessData&, float** in, float** out, int32 n) override {
+        auto until = std::chrono::steady_clock::now() + std::chrono::duration<double, std::micro>(burn_us_);
+        volatile double sink = 0.0;
+        while (std::chrono::steady_clock::now() < until) {
+            for (int i = 0; i < 64; ++i) sink = sink + std::sqrt((double)i);
+        }
+        for (int c = 0; c < 2; ++c) {
+            if (in[c]) {
+                std::copy_n(in[c], n, out[c]);
+            } else {
+                std::fill_n(out[c], n, 0.0f);
+            }
+        }
+    }
+
+private:
+    double burn_us_;
+};
+
+class LatencyProcessor : public TestProcessor {
+public:
+    LatencyProcessor() : TestProcessor(kEmptyControllerUID, false) {}
+    static FUnknown* createInstance(void*) { return (IAudioProcessor*)new LatencyProcessor; }
+
+    uint32 PLUGIN_API getLatencySamples() override { return kLatencySamples; }
+    uint32 PLUGIN_API getTailSamples() override { return kTailSamples; }
+
+    tresult PLUGIN_API setActive(TBool state) override {
+        for (auto& line : delay_) std::fill(line.begin(), line.end(), 0.0f);
+        pos_ = 0;
+        return AudioEffect::setActive(state);
+    }
+
+protected:
+    void Render(ProcessData&, float** in, float** out, int32 n) override {
+        for (int32 i = 0; i < n; ++i) {
+            for (int c = 0; c < 2; ++c) {
+                float delayed = delay_[c][pos_];
+                delay_[c][pos_] = in[c] ? in[c][i] : 0.0f;
+                out[c][i] = delayed;
+            }
+            pos_ = (pos_ + 1) % kLatencySamples;
+        }
+    }
+
+private:
+    std::array<std::array<float, kLatencySamples>, 2> delay_ = {};
+    uint32 pos_ = 0;
+};
+
+// Parameterless processors share an empty controller so hosts that require
+// one still find it.
+class TestController : public EditController {
+public:
+    explicit TestController(const char16* param_title = nullptr, ParamValue default_value = 0.0)
+        : param_title_(param_title), default_value_(default_value) {}
+
+    tresult PLUGIN_API initialize(FUnknown* context) override {
+        tresult result = EditController::initialize(context);
+        if (result != kResultOk) return result;
+        if (param_title_) {
+            parameters.addParameter(param_title_, nullptr, 0, default_value_, ParameterInfo::kCanAutomate, 0);
+        }
+        return kResultOk;
+    }
+
+    static FUnknown* createEmpty(void*) { return (IEditController*)new TestController; }
+    static FUnknown* createGain(void*) { return (IEditController*)new TestController(STR16("Gain"), 0.5); }
+    static FUnknown* createBurn(void*) { return (IEditController*)new TestController(STR16("Burn"), DefaultBurn()); }
+
+private:
+    const char16* param_title_;
+    ParamValue default_value_;
+};
+
+} // namespace
+
+bool InitModule() { return true; }
+bool DeinitModule() { return true; }
+
+BEGIN_FACTORY_DEF("Hibiki", "https://github.com/hibiki", "")
+
+DEF_CLASS2(INLINE_UID_FROM_FUID(kSineUID), PClassInfo::kManyInstances, kVstAudioEffectClass,
+           "Hibiki Test Sine", Vst::kDistributable, "Instrument|Synth", "1.0.0", kVstVersionString,
+           SineProcessor::createInstance)
+DEF_CLASS2(INLINE_UID_FROM_FUID(kGainUID), PClassInfo::kManyInstances, kVstAudioEffectClass,
+           "Hibiki Test Gain", Vst::kDistributable, "Fx", "1.0.0", kVstVersionString,
+           GainProcessor::createInstance)
+DEF_CLASS2(INLINE_UID_FROM_FUID(kBurnUID), PClassInfo::kManyInstances, kVstAudioEffectClass,
+           "Hibiki Test Burn", Vst::kDistributable, "Fx", "1.0.0", kVstVersionString,
+           BurnProcessor::createInstance)
+DEF_CLASS2(INLINE_UID_FROM_FUID(kLatencyUID), PClassInfo::kManyInstances, kVstAudioEffectClass,
+           "Hibiki Test Latency", Vst::kDistributable, "Fx", "1.0.0", kVstVersionString,
+           LatencyProcessor::createInstance)
+DEF_CLASS2(INLINE_UID_FROM_FUID(kEmptyControllerUID), PClassInfo::kManyInstances, kVstComponentControllerClass,
+           "Hibiki Test Controller", 0, "", "1.0.0", kVstVersionString,
+           TestController::createEmpty)
+DEF_CLASS2(INLINE_UID_FROM_FUID(kGainControllerUID), PClassInfo::kManyInstances, kVstComponentControllerClass,
+           "Hibiki Test Gain Controller", 0, "", "1.0.0", kVstVersionString,
+           TestController::createGain)
+DEF_CLASS2(INLINE_UID_FROM_FUID(kBurnControllerUID), PClassInfo::kManyInstances, kVstComponentControllerClass,
+           "Hibiki Test Burn Controller", 0, "", "1.0.0", kVstVersionString,
+           TestController::createBurn)
+
+END_FACTORY
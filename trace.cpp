@@ -0,0 +1,246 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+namespace hibiki::trace {
+
+std::atomic<bool> g_enabled{false};
+
+namespace {
+
+// Fields are atomics only so that a dump racing with the owning thread is
+// well-defined; the owner is the sole writer.
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start_ns{0};
+    std::atomic<uint64_t> end_ns{0};
+};
+
+// One per thread that ever traced or was named. The ring is only allocated
+// on the first Record while tracing is on, so naming a thread costs nothing.
+struct ThreadBuffer {
+    int tid = 0;
+    std::string name;                   // guarded by Registry::mutex
+    std::unique_ptr<Event[]> events;    // set by the owner under Registry::mutex
+    std::atomic<uint64_t> head{0};      // events ever written
+    std::atomic<uint64_t> first{0};     // oldest event not cleared
+    bool exited = false;                // guarded by Registry::mutex
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    int next_tid = 1;
+    int rings = 0;
+};
+
+// Leaked on purpose: threads may still record while static destructors run.
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+// Hands the buffer back when its thread exits. The events stay in dumps until
+// a new thread needs a ring and takes this one over.
+void Retire(ThreadBuffer* buffer) {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    buffer->exited = true;
+    if (!buffer->events) {
+        std::erase_if(registry.buffers, [&](const auto& b) { return b.get() == buffer; });
+    }
+}
+
+struct LocalHolder {
+    ThreadBuffer* buffer = nullptr;
+    ~LocalHolder() {
+        if (buffer) Retire(buffer);
+    }
+};
+
+ThreadBuffer& LocalBuffer() {
+    thread_local LocalHolder holder;
+    if (!holder.buffer) {
+        auto& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+        holder.buffer = registry.buffers.back().get();
+        holder.buffer->tid = registry.next_tid++;
+        holder.buffer->name = "thread " + std::to_string(holder.buffer->tid);
+    }
+    return *holder.buffer;
+}
+
+// Gives the calling thread's buffer the ring of an exited thread, or a new one.
+void AcquireRing(ThreadBuffer& buffer) {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = std::find_if(registry.buffers.begin(), registry.buffers.end(),
+                           [](const auto& b) { return b->exited && b->events; });
+    if (it != registry.buffers.end()) {
+        // Old slots lie outside [first, head) of the new owner and are never read.
+        buffer.events = std::move((*it)->events);
+        registry.buffers.erase(it);
+    } else {
+        buffer.events.reset(new Event[kEventsPerThread]);
+        registry.rings++;
+    }
+}
+
+std::string Escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char hex[8];
+            std::snprintf(hex, sizeof(hex), "\\u%04x", c);
+            out += hex;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+void SetEnabled(bool enabled) {
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SetThreadName(const std::string& name) {
+    auto& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+    buffer.name = name;
+}
+
+void Record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+    auto& buffer = LocalBuffer();
+    if (!buffer.events) {
+        if (!Enabled()) return;
+        AcquireRing(buffer);
+    }
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    Event& e = buffer.events[head % kEventsPerThread];
+    e.name.store(name, std::memory_order_relaxed);
+    e.start_ns.store(start_ns, std::memory_order_relaxed);
+    e.end_ns.store(end_ns, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+int RingsAllocated() {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.rings;
+}
+
+void Clear() {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& buffer : registry.buffers) {
+        buffer->first.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+std::string ToChromeJson() {
+    struct Copy {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t end_ns;
+    };
+
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::ostringstream out;
+    out.precision(3);
+    out << std::fixed << "{\"traceEvents\":[";
+    bool first_event = true;
+    auto separator = [&] {
+        if (!first_event) out << ",";
+        first_event = false;
+        out << "\n";
+    };
+
+    std::vector<Copy> copies;
+    for (const auto& buffer : registry.buffers) {
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << Escape(buffer->name) << "\"}}";
+
+        if (!buffer->events) continue;
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = std::max(buffer->first.load(std::memory_order_relaxed),
+                                  head > (uint64_t)kEventsPerThread ? head - kEventsPerThread : 0);
+        copies.clear();
+        for (uint64_t i = begin; i < head; ++i) {
+            const Event& e = buffer->events[i % kEventsPerThread];
+            copies.push_back({e.name.load(std::memory_order_relaxed), e.start_ns.load(std::memory_order_relaxed),
+                              e.end_ns.load(std::memory_order_relaxed)});
+        }
+        // The owner may have lapped the ring while we copied; the slot it is
+        // writing now held event (head - kEventsPerThread), so drop up to that.
+        uint64_t head_after = buffer->head.load(std::memory_order_acquire);
+        uint64_t valid_from = head_after >= (uint64_t)kEventsPerThread ? head_after - kEventsPerThread + 1 : 0;
+
+        for (uint64_t i = std::max(begin, valid_from); i < head; ++i) {
+            const Copy& c = copies[i - begin];
+            separator();
+            out << "{\"name\":\"" << Escape(c.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << c.start_ns / 1000.0 << ",\"dur\":" << (c.end_ns - c.start_ns) / 1000.0 << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.str();
+}
+
+bool WriteChromeJson(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open trace file for writing: " << path << "\n";
+        return false;
+    }
+    out << ToChromeJson();
+    return (bool)out;
+}
+
+void DumpOnSignal(int signo, const std::string& path) {
+#if !defined(_WIN32)
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, signo);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    std::thread([set, path] {
+        SetThreadName("trace signal");
+        for (;;) {
+            int sig = 0;
+            if (sigwait(&set, &sig) != 0) return;
+            if (WriteChromeJson(path)) std::cerr << "Trace written to " << path << "\n";
+        }
+    }).detach();
+#else
+    (void)signo;
+    (void)path;
+#endif
+}
+
+} // namespace hibiki::trace
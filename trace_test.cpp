@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "trace.hpp"
+
+#include <string>
+#include <thread>
+
+namespace {
+
+size_t Count(const std::string& haystack, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) count++;
+    return count;
+}
+
+class TraceTest : public testing::Test {
+protected:
+    void SetUp() override {
+        hibiki::trace::Clear();
+        hibiki::trace::SetEnabled(true);
+    }
+    void TearDown() override { hibiki::trace::SetEnabled(false); }
+};
+
+TEST_F(TraceTest, RecordsScopesPerThread) {
+    hibiki::trace::SetThreadName("main");
+    { HIBIKI_TRACE_SCOPE("outer"); }
+    std::thread worker([] {
+        hibiki::trace::SetThreadName("worker \"1\"");
+        HIBIKI_TRACE_SCOPE("inner");
+    });
+    worker.join();
+
+    std::string json = hibiki::trace::ToChromeJson();
+    EXPECT_EQ(Count(json, "\"name\":\"outer\",\"ph\":\"X\""), 1u);
+    EXPECT_EQ(Count(json, "\"name\":\"inner\",\"ph\":\"X\""), 1u);
+    EXPECT_NE(json.find("\"name\":\"main\""), std::string::npos);
+    EXPECT_NE(json.find("worker \\\"1\\\""), std::string::npos);
+}
+
+TEST_F(TraceTest, DisabledRecordsNothing) {
+    hibiki::trace::SetEnabled(false);
+    { HIBIKI_TRACE_SCOPE("hidden"); }
+    EXPECT_EQ(hibiki::trace::ToChromeJson().find("hidden"), std::string::npos);
+}
+
+TEST_F(TraceTest, RingKeepsNewestEvents) {
+    hibiki::trace::Record("old", 1000, 2000);
+    for (int i = 0; i < hibiki::trace::kEventsPerThread; ++i) hibiki::trace::Record("new", 3000, 4000);
+    std::string json = hibiki::trace::ToChromeJson();
+    EXPECT_EQ(json.find("\"old\""), std::string::npos);
+    // The slot the owner would overwrite next is never trusted by a dump.
+    EXPECT_GE(Count(json, "\"name\":\"new\""), (size_t)hibiki::trace::kEventsPerThread - 1);
+}
+
+TEST_F(TraceTest, ClearDropsEvents) {
+    { HIBIKI_TRACE_SCOPE("cleared"); }
+    hibiki::trace::Clear();
+    EXPECT_EQ(hibiki::trace::ToChromeJson().find("cleared"), std::string::npos);
+}
+
+TEST_F(TraceTest, NamingAThreadAllocatesNoRing) {
+    hibiki::trace::SetEnabled(false);
+    const int rings = hibiki::trace::RingsAllocated();
+    std::thread worker([] {
+        hibiki::trace::SetThreadName("idle");
+        HIBIKI_TRACE_SCOPE("hidden");
+    });
+    worker.join();
+    EXPECT_EQ(hibiki::trace::RingsAllocated(), rings);
+}
+
+TEST_F(TraceTest, ExitedThreadsHandTheirRingOn) {
+    std::thread([] { HIBIKI_TRACE_SCOPE("first"); }).join();
+    const int rings = hibiki::trace::RingsAllocated();
+    // The first thread's events last until its ring is taken over.
+    EXPECT_NE(hibiki::trace::ToChromeJson().find("\"first\""), std::string::npos);
+    for (int i = 0; i < 4; ++i) {
+        std::thread([] { HIBIKI_TRACE_SCOPE("later"); }).join();
+    }
+    EXPECT_EQ(hibiki::trace::RingsAllocated(), rings);
+    std::string json = hibiki::trace::ToChromeJson();
+    EXPECT_EQ(json.find("\"first\""), std::string::npos);
+    EXPECT_EQ(Count(json, "\"name\":\"later\""), 1u);
+}
+
+} // namespace
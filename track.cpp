@@ -1,18 +1,73 @@
 #include "track.hpp"
 #include "ipc.hpp"
 #include "audio_file.hpp"
+#include "dsp.hpp"
 #include "hibiki_response_generated.h"
+#include "launch.hpp"
+#include "realtime.hpp"
+#include "trace.hpp"
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <iterator>
+#include <utility>
 
 namespace hibiki {
 
+namespace {
+
+HostProcessContext MakeContext(const BlockInfo& block, double time_sec) {
+    HostProcessContext context;
+    context.sampleRate = block.sample_rate;
+    context.tempo = block.tempo;
+    context.timeSigNumerator = 4;
+    context.timeSigDenominator = 4;
+    context.continuousTimeSamples = time_sec * block.sample_rate;
+    context.projectTimeMusic = time_sec * (context.tempo / 60.0);
+    return context;
+}
+
+} // namespace
+
+int GatherMidiBlock(const Clip& clip, int first, double time_sec, double sample_rate, int block_size,
+                    std::vector<MidiNoteEvent>& out) {
+    HIBIKI_TRACE_SCOPE("Track::GatherMidi");
+    const auto& events = clip.midi_events;
+    const double block_end = time_sec + block_size / sample_rate;
+    int i = first;
+    for (; i < (int)events.size(); ++i) {
+        const auto& me = events[i];
+        if (me.seconds >= block_end) break;
+        if (me.seconds < time_sec || !(isNoteOn(me) || isNoteOff(me))) continue;
+
+        MidiNoteEvent e;
+        e.sampleOffset = std::clamp((int)((me.seconds - time_sec) * sample_rate), 0, block_size - 1);
+        e.channel = me.channel;
+        e.pitch = me.note;
+        if (isNoteOff(me)) {
+            e.isNoteOn = false;
+            e.velocity = 0;
+        } else {
+            e.isNoteOn = true;
+            e.velocity = me.velocity / 127.0f;
+        }
+        out.push_back(e);
+    }
+    return i;
+}
+
 int Track::LoadPlugin(const std::string& path, int plugin_index, double sample_rate) {
-    std::lock_guard<std::mutex> lock(mutex);
+    if (freeze_state.load() != FreezeState::kLive) return -1;
     auto plugin = std::make_unique<Vst3Plugin>();
     if (!plugin->load(path, plugin_index, sample_rate)) {
         return -1;
     }
+    return InsertPlugin(std::move(plugin));
+}
+
+int Track::InsertPlugin(std::unique_ptr<Vst3Plugin> plugin) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeze_state.load() != FreezeState::kLive) return -1;
 
     bool is_instrument = plugin->isInstrument();
     int target_idx = -1;
@@ -26,8 +81,9 @@ int Track::LoadPlugin(const std::string& path, int plugin_index, double sample_r
         }
     }
 
+    std::vector<std::unique_ptr<Vst3Plugin>> dropped;
     if (target_idx != -1) {
-        plugins[target_idx] = std::move(plugin);
+        dropped.push_back(std::exchange(plugins[target_idx], std::move(plugin)));
     } else if (is_instrument) {
         // New instrument, insert at 0
         plugins.insert(plugins.begin(), std::move(plugin));
@@ -42,40 +98,56 @@ int Track::LoadPlugin(const std::string& path, int plugin_index, double sample_r
     if (plugins.size() == 1) {
         current_time_sec = 0.0;
         current_midi_idx = 0;
+        seek_generation.fetch_add(1, std::memory_order_release);
     }
 
     // Exclusivity rule: If loading an instrument, clear audio clips
     if (is_instrument) {
-        std::vector<int> audio_slots;
-        for (auto const& [slot, clip] : clips) {
-            if (clip->type == Clip::Type::AUDIO) audio_slots.push_back(slot);
-        }
-        for (int slot : audio_slots) {
-            clips.erase(slot);
-            hibiki::sendClipInfo(index, slot, "", "");
+        std::vector<std::unique_ptr<Clip>> dropped_clips;
+        for (auto it = clips.begin(); it != clips.end();) {
+            if (it->second->type != Clip::Type::AUDIO) {
+                ++it;
+                continue;
+            }
+            hibiki::sendClipInfo(index, it->first, "", "");
+            dropped_clips.push_back(std::move(it->second));
+            it = clips.erase(it);
         }
+        if (!dropped_clips.empty()) PublishClips(std::move(dropped_clips));
     }
 
+    PublishChain(std::move(dropped));
     return target_idx;
 }
 
 bool Track::DeleteClip(int slot) {
     std::lock_guard<std::mutex> lock(mutex);
-    if (clips.count(slot)) {
-        clips.erase(slot);
+    if (freeze_state.load() != FreezeState::kLive) return false;
+    auto it = clips.find(slot);
+    if (it != clips.end()) {
+        std::vector<std::unique_ptr<Clip>> dropped;
+        dropped.push_back(std::move(it->second));
+        clips.erase(it);
+        PublishClips(std::move(dropped));
         if (playing_slot == slot) {
             playing_slot = -1;
         }
+        Invalidate();
         return true;
     }
     return false;
 }
 
 bool Track::LoadClip(int slot, const std::string& path, bool is_loop) {
-    std::lock_guard<std::mutex> lock(mutex);
-    
+    if (freeze_state.load() != FreezeState::kLive) return false;
     auto clip = hibiki::LoadClip(path, is_loop);
     if (!clip) return false;
+    return InsertClip(slot, std::move(clip));
+}
+
+bool Track::InsertClip(int slot, std::unique_ptr<Clip> clip) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeze_state.load() != FreezeState::kLive) return false;
 
     // Exclusivity rule: If loading an audio clip, clear instruments
     if (clip->type == Clip::Type::AUDIO) {
@@ -84,9 +156,15 @@ bool Track::LoadClip(int slot, const std::string& path, bool is_loop) {
                 hibiki::sendParamList(index, (int)i, "", true, {});
             }
         }
-        plugins.erase(std::remove_if(plugins.begin(), plugins.end(), [](const auto& p) {
-            return p->isInstrument();
-        }), plugins.end());
+        auto instruments = std::stable_partition(plugins.begin(), plugins.end(), [](const auto& p) {
+            return !p->isInstrument();
+        });
+        if (instruments != plugins.end()) {
+            std::vector<std::unique_ptr<Vst3Plugin>> dropped(std::make_move_iterator(instruments),
+                                                             std::make_move_iterator(plugins.end()));
+            plugins.erase(instruments, plugins.end());
+            PublishChain(std::move(dropped));
+        }
     }
 
     // Send waveform to GUI if generated
@@ -99,20 +177,39 @@ bool Track::LoadClip(int slot, const std::string& path, bool is_loop) {
         hibiki::sendNotification(builder.GetBufferPointer(), builder.GetSize());
     }
 
-    clips[slot] = std::move(clip);
+    // Fault the buffers in now rather than on first play.
+    rt::Prefault(clip->audio.data(), clip->audio.byte_size());
+    rt::Prefault(clip->midi_events.data(), clip->midi_events.size() * sizeof(MidiEvent));
+    std::vector<std::unique_ptr<Clip>> dropped;
+    auto& held = clips[slot];
+    if (held) dropped.push_back(std::move(held));
+    held = std::move(clip);
+    PublishClips(std::move(dropped));
 
     // If we are currently playing this slot, reset playback
     if (playing_slot == slot) {
         current_time_sec = 0.0;
         current_midi_idx = 0;
     }
+    Invalidate();
     return true;
 }
 
 void Track::SetClipLoop(int slot, bool is_loop) {
     std::lock_guard<std::mutex> lock(mutex);
+    if (freeze_state.load() != FreezeState::kLive) return;
     if (clips.count(slot)) {
         clips[slot]->is_loop = is_loop;
+        Invalidate();
+    }
+}
+
+void Track::SetFollowAction(int slot, FollowAction action, double beats) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (clips.count(slot)) {
+        clips[slot]->follow_action = action;
+        clips[slot]->follow_beats = std::max(beats, 0.0);
+        Invalidate();
     }
 }
 
@@ -122,19 +219,326 @@ void Track::PlayClip(int slot) {
         playing_slot = slot;
         current_time_sec = 0.0;
         current_midi_idx = 0;
+        launched_frame = -1;
+        follow_slot = slot;
+        seek_generation.fetch_add(1, std::memory_order_release);
+        Invalidate();
     }
 }
 
 void Track::Stop() {
     std::lock_guard<std::mutex> lock(mutex);
     playing_slot = -1;
+    follow_slot = -1;
+    seek_generation.fetch_add(1, std::memory_order_release);
+    Invalidate();
+}
+
+void Track::ScheduleLaunch(int slot, int64_t frame) {
+    launch_slot.store(slot, std::memory_order_relaxed);
+    launch_frame.store(frame, std::memory_order_release);
+    Invalidate();
 }
 
 bool Track::RemovePlugin(size_t pidx) {
     std::lock_guard<std::mutex> lock(mutex);
+    if (freeze_state.load() != FreezeState::kLive) return false;
     if (pidx >= plugins.size()) return false;
+    std::vector<std::unique_ptr<Vst3Plugin>> dropped;
+    dropped.push_back(std::move(plugins[pidx]));
     plugins.erase(plugins.begin() + pidx);
+    PublishChain(std::move(dropped));
+    return true;
+}
+
+bool Track::TakeRetiredChains(std::vector<std::unique_ptr<PluginChain>>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t in_use = chain_in_use.load(std::memory_order_acquire);
+    auto done = std::stable_partition(retired_chains_.begin(), retired_chains_.end(), [&](const auto& c) {
+        return c->generation >= in_use;
+    });
+    std::move(done, retired_chains_.end(), std::back_inserter(out));
+    retired_chains_.erase(done, retired_chains_.end());
+    return !retired_chains_.empty();
+}
+
+void Track::TakeRetiredClips(std::vector<std::unique_ptr<ClipSet>>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::move(retired_clips_.begin(), retired_clips_.end(), std::back_inserter(out));
+    retired_clips_.clear();
+}
+
+void Track::PublishClips(std::vector<std::unique_ptr<Clip>> dropped) {
+    auto next = std::make_unique<ClipSet>();
+    for (const auto& [slot, clip] : clips) next->clips[slot] = clip.get();
+    clip_set.store(next.get(), std::memory_order_release);
+    if (current_clips_) {
+        current_clips_->dropped = std::move(dropped);
+        retired_clips_.push_back(std::move(current_clips_));
+    }
+    current_clips_ = std::move(next);
+}
+
+void Track::PublishChain(std::vector<std::unique_ptr<Vst3Plugin>> dropped) {
+    auto next = std::make_unique<PluginChain>();
+    next->generation = current_chain_ ? current_chain_->generation + 1 : 0;
+    for (auto& p : plugins) next->plugins.push_back(p.get());
+    chain.store(next.get(), std::memory_order_release);
+    if (current_chain_) {
+        current_chain_->dropped = std::move(dropped);
+        retired_chains_.push_back(std::move(current_chain_));
+    }
+    current_chain_ = std::move(next);
+    Invalidate();
+}
+
+namespace {
+
+// Runs plugins [begin, end) of the chain. Positions count from the start of
+// the chain, where an instrument takes the notes.
+void RunChain(const PluginChain& chain, size_t begin, size_t end, float** out, int block_size,
+              const HostProcessContext& context, const std::vector<MidiNoteEvent>* events, float** sidechain) {
+    for (size_t i = begin; i < end; ++i) {
+        Vst3Plugin* p = chain.plugins[i];
+        if (p->isBypassed()) continue;
+        if (events && i == 0 && p->isInstrument()) {
+            p->process(nullptr, out, block_size, context, *events, sidechain);
+        } else if (events || !p->isInstrument()) { // Audio clips bypass instruments
+            p->process(out, out, block_size, context, {}, sidechain);
+        }
+    }
+}
+
+} // namespace
+
+void Track::ProcessChain(float* left, float* right, const BlockInfo& block, const HostProcessContext& context,
+                         const std::vector<MidiNoteEvent>* events, float** sidechain) {
+    const int block_size = block.block_size;
+    const PluginChain* current = chain.load(std::memory_order_acquire);
+    if (current != rendered_chain_) {
+        // A chain that was still fading out is cut short.
+        fading_chain_ = rendered_chain_;
+        fade_pos_ = 0;
+        rendered_chain_ = current;
+    }
+
+    float* outChannels[] = {left, right};
+    const size_t size = current->plugins.size();
+    size_t prefix = 0, suffix = 0;
+    if (fading_chain_) {
+        // Only the plugins between the ends both chains share are faded; each
+        // shared plugin runs once, on the faded signal if it comes after.
+        const auto& old_plugins = fading_chain_->plugins;
+        const auto& new_plugins = current->plugins;
+        while (prefix < old_plugins.size() && prefix < size && old_plugins[prefix] == new_plugins[prefix]) ++prefix;
+        while (suffix < old_plugins.size() - prefix && suffix < size - prefix &&
+               old_plugins[old_plugins.size() - 1 - suffix] == new_plugins[size - 1 - suffix]) {
+            ++suffix;
+        }
+        // A plugin that moved would still run twice: switch without a fade.
+        for (size_t i = prefix; i < old_plugins.size() - suffix && fading_chain_; ++i) {
+            for (size_t j = prefix; j < size - suffix; ++j) {
+                if (old_plugins[i] == new_plugins[j]) fading_chain_ = nullptr;
+            }
+        }
+    }
+    if (!fading_chain_) {
+        RunChain(*current, 0, size, outChannels, block_size, context, events, sidechain);
+    } else {
+        RunChain(*current, 0, prefix, outChannels, block_size, context, events, sidechain);
+        std::copy_n(left, block_size, fade_l_.data());
+        std::copy_n(right, block_size, fade_r_.data());
+        float* fadeChannels[] = {fade_l_.data(), fade_r_.data()};
+        RunChain(*fading_chain_, prefix, fading_chain_->plugins.size() - suffix, fadeChannels, block_size, context, events,
+                 sidechain);
+        RunChain(*current, prefix, size - suffix, outChannels, block_size, context, events, sidechain);
+
+        const int fade_len = std::max(1, (int)(kChainFadeSec * block.sample_rate));
+        const int n = std::min(block_size, fade_len - fade_pos_);
+        const float g0 = (float)fade_pos_ / fade_len;
+        const float g1 = (float)(fade_pos_ + n) / fade_len;
+        dsp::ApplyGainRamp(left, n, g0, g1);
+        dsp::ApplyGainRamp(right, n, g0, g1);
+        dsp::AddGainRamp(left, fade_l_.data(), n, 1.0f - g0, 1.0f - g1);
+        dsp::AddGainRamp(right, fade_r_.data(), n, 1.0f - g0, 1.0f - g1);
+        fade_pos_ += n;
+        RunChain(*current, size - suffix, size, outChannels, block_size, context, events, sidechain);
+        if (fade_pos_ >= fade_len) fading_chain_ = nullptr;
+    }
+    const PluginChain* oldest = fading_chain_ ? fading_chain_ : current;
+    chain_in_use.store(oldest->generation, std::memory_order_release);
+}
+
+void Track::SkipChain() {
+    rendered_chain_ = chain.load(std::memory_order_acquire);
+    fading_chain_ = nullptr;
+    chain_in_use.store(rendered_chain_->generation, std::memory_order_release);
+}
+
+bool Track::RenderBlock(const BlockInfo& block, float** sidechain) {
+    HIBIKI_TRACE_SCOPE("Track::RenderBlock");
+    ScopedTimer timer(render_time);
+    if (!is_return) return MixBlock(block, RenderClipBlock(block, sidechain, output_l.data(), output_r.data()));
+
+    // The caller has already summed the sends and routed tracks into output_l/r.
+    const int block_size = block.block_size;
+    const FreezeState freeze = freeze_state.load(std::memory_order_acquire);
+    if (cut.load(std::memory_order_relaxed) || freeze == FreezeState::kBusy) {
+        std::fill_n(output_l.data(), block_size, 0.0f);
+        std::fill_n(output_r.data(), block_size, 0.0f);
+        SkipChain();
+    } else {
+        ProcessChain(output_l.data(), output_r.data(), block, MakeContext(block, current_time_sec), nullptr, sidechain);
+    }
+    // Returns are solo-safe: soloing a source must not silence its reverb.
+    mixer.Process(output_l.data(), output_r.data(), block_size, block.sample_rate,
+                  !mixer.mute.load(std::memory_order_relaxed));
+
+    active = true;
+    peak_l = dsp::AbsPeak(output_l.data(), block_size);
+    peak_r = dsp::AbsPeak(output_r.data(), block_size);
+    return true;
+}
+
+bool Track::RenderClipBlock(const BlockInfo& block, float** sidechain, float* left, float* right) {
+    const int block_size = block.block_size;
+    const double sample_rate = block.sample_rate;
+    std::fill_n(left, block_size, 0.0f);
+    std::fill_n(right, block_size, 0.0f);
+    HostProcessContext context = MakeContext(block, current_time_sec);
+
+    // Cut tracks and tracks being frozen or unfrozen do not touch their plugins.
+    const FreezeState freeze = freeze_state.load(std::memory_order_acquire);
+    const bool silent = cut.load(std::memory_order_relaxed) || freeze == FreezeState::kBusy;
+
+    // The clip can change within the block, so its audio or notes are laid
+    // out segment by segment and the chain runs once over the whole block.
+    bool playing = false;
+    bool has_midi = false;
+    std::vector<MidiNoteEvent> blockEvents;
+    const ClipSet& set = *clip_set.load(std::memory_order_acquire);
+    for (int offset = 0; offset < block_size;) {
+        const int end = BeginSegment(block, offset, set);
+        const int n = end - offset;
+        auto clip_it = playing_slot == -1 ? set.clips.end() : set.clips.find(playing_slot);
+        if (clip_it != set.clips.end()) {
+            const Clip* clip = clip_it->second;
+            const Clip* frozen = nullptr;
+            if (freeze == FreezeState::kFrozen) {
+                auto frozen_it = frozen_clips.find(playing_slot);
+                if (frozen_it != frozen_clips.end()) frozen = frozen_it->second.get();
+            }
+            const int64_t start_frame = std::llround(current_time_sec * sample_rate);
+            if (silent || (freeze == FreezeState::kFrozen && !frozen)) {
+                // Silence, but the clip keeps its position.
+            } else if (frozen) {
+                // The plugin chain is part of the frozen render.
+                RenderAudioClip(*frozen, start_frame, left + offset, right + offset, n);
+            } else if (clip->type == Clip::Type::MIDI) {
+                const size_t first = blockEvents.size();
+                current_midi_idx = GatherMidiBlock(*clip, current_midi_idx, current_time_sec, sample_rate, n, blockEvents);
+                for (size_t i = first; i < blockEvents.size(); ++i) blockEvents[i].sampleOffset += offset;
+                has_midi = true;
+            } else if (clip->type == Clip::Type::AUDIO) {
+                RenderAudioClip(*clip, start_frame, left + offset, right + offset, n);
+            }
+            playing = true;
+            AdvanceClip(n / sample_rate, set);
+        }
+        offset = end;
+    }
+
+    if (!playing || silent || freeze == FreezeState::kFrozen) {
+        SkipChain();
+    } else {
+        // Audio clips bypass instruments.
+        ProcessChain(left, right, block, context, has_midi ? &blockEvents : nullptr, sidechain);
+    }
+    return playing;
+}
+
+bool Track::MixBlock(const BlockInfo& block, bool playing) {
+    if (!playing) {
+        if (active) mixer.Snap();
+        active = false;
+        peak_l = peak_r = 0.0f;
+        return false;
+    }
+    mixer.Process(output_l.data(), output_r.data(), block.block_size, block.sample_rate,
+                  IsAudible(mixer, block.any_solo));
+    active = true;
+    peak_l = dsp::AbsPeak(output_l.data(), block.block_size);
+    peak_r = dsp::AbsPeak(output_r.data(), block.block_size);
     return true;
 }
 
+void Track::AdvancePlayback(const BlockInfo& block) {
+    const ClipSet& set = *clip_set.load(std::memory_order_acquire);
+    for (int offset = 0; offset < block.block_size;) {
+        const int end = BeginSegment(block, offset, set);
+        AdvanceClip((end - offset) / block.sample_rate, set);
+        offset = end;
+    }
+}
+
+int64_t Track::FollowFrame(const BlockInfo& block, const ClipSet& set) const {
+    if (follow_slot == -1 || launched_frame < 0) return -1;
+    auto it = set.clips.find(follow_slot);
+    if (it == set.clips.end() || it->second->follow_action == FollowAction::kNone) return -1;
+    return launched_frame + FollowFrames(*it->second, block.tempo, block.sample_rate);
+}
+
+void Track::StartClip(int slot, int64_t frame, const ClipSet& set) {
+    // Launching an empty slot leaves the track as it was, as PlayClip does.
+    if (slot != -1 && !set.clips.count(slot)) return;
+    playing_slot = slot;
+    current_time_sec = 0.0;
+    current_midi_idx = 0;
+    launched_frame = frame;
+    follow_slot = playing_slot;
+}
+
+int Track::BeginSegment(const BlockInfo& block, int offset, const ClipSet& set) {
+    const int64_t frame = block.transport_frame + offset;
+    // A clip started by PlayClip counts its follow time from its first block.
+    if (follow_slot != -1 && launched_frame < 0) launched_frame = frame;
+
+    // An explicit launch wins over a follow action due at the same frame.
+    const int64_t launch = launch_frame.load(std::memory_order_acquire);
+    const int64_t follow = FollowFrame(block, set);
+    if (launch == frame) {
+        StartClip(launch_slot.load(std::memory_order_relaxed), frame, set);
+    } else if (follow >= 0 && follow <= frame) {
+        StartClip(FollowSlot(set.clips, follow_slot, set.clips.at(follow_slot)->follow_action), frame, set);
+    }
+
+    int64_t next = block.transport_frame + block.block_size;
+    if (launch > frame) next = std::min(next, launch);
+    const int64_t next_follow = FollowFrame(block, set);
+    if (next_follow > frame) next = std::min(next, next_follow);
+    return (int)(next - block.transport_frame);
+}
+
+void Track::AdvanceClip(double seconds, const ClipSet& set) {
+    auto clip_it = playing_slot == -1 ? set.clips.end() : set.clips.find(playing_slot);
+    if (clip_it == set.clips.end()) return;
+    const Clip* clip = clip_it->second;
+
+    // A frozen one-shot runs on until the end of its rendered tail.
+    double duration_sec = clip->duration_sec;
+    if (freeze_state.load(std::memory_order_acquire) == FreezeState::kFrozen) {
+        auto frozen_it = frozen_clips.find(playing_slot);
+        if (frozen_it != frozen_clips.end()) duration_sec = frozen_it->second->duration_sec;
+    }
+    current_time_sec += seconds;
+    if (current_time_sec >= duration_sec) {
+        if (clip->is_loop) {
+            current_time_sec = fmod(current_time_sec, duration_sec);
+            current_midi_idx = 0; // Reset MIDI search for next block
+        } else {
+            playing_slot = -1;
+        }
+    }
+}
+
 } // namespace hibiki
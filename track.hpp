@@ -1,36 +1,220 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <vector>
 #include <memory>
 #include <mutex>
 #include <string>
 #include "clip.hpp"
+#include "engine_stats.hpp"
+#include "mixer.hpp"
 #include "vst3_host.hpp"
 
 namespace hibiki {
 
+// Per-block parameters shared by every track rendered in that block.
+struct BlockInfo {
+    double sample_rate;
+    int block_size;
+    double tempo;
+    bool any_solo;
+    // Transport position of the block's first frame; see ProjectState::transport_frame.
+    int64_t transport_frame = 0;
+};
+
+// Note events of a MIDI clip between time_sec and the end of a block of
+// block_size samples, with sample offsets into the block. Scans from
+// events[first] on and returns where the next block's scan starts.
+int GatherMidiBlock(const Clip& clip, int first, double time_sec, double sample_rate, int block_size,
+                    std::vector<MidiNoteEvent>& out);
+
+// When a track's plugins change, the old chain fades out over this long
+// while the new one fades in.
+constexpr double kChainFadeSec = 0.01;
+
+// Immutable snapshot of a track's plugin chain, which the audio side renders
+// from. Every change to the plugins publishes a new one and retires the old
+// one; see Track::TakeRetiredChains.
+struct PluginChain {
+    uint32_t generation = 0;
+    std::vector<Vst3Plugin*> plugins;
+    // Plugins this chain used that its successor dropped; freed with it.
+    std::vector<std::unique_ptr<Vst3Plugin>> dropped;
+};
+
+// Immutable snapshot of a track's clips, which the audio side plays from.
+// Every change to the clips publishes a new one and retires the old one,
+// which is freed, with the clips only it still held, once no block can be
+// playing from it; see ReleaseRetiredClips.
+struct ClipSet {
+    std::map<int, const Clip*> clips;
+    // Clips this set held that its successor dropped; freed with it.
+    std::vector<std::unique_ptr<Clip>> dropped;
+};
+
 class Track {
 public:
     int index;
+    // The plugins as the control side sees them: changed only with mutex
+    // held, and never read by the audio side, which renders from chain.
     std::vector<std::unique_ptr<Vst3Plugin>> plugins;
+    // Likewise the clips: the audio side plays from clip_set.
     std::map<int, std::unique_ptr<Clip>> clips;
+    std::atomic<const ClipSet*> clip_set{nullptr};
+    MixerStrip mixer;
+
+    // A return track plays no clips. It doubles as a group bus: its input is the
+    // sum of the sends into it and of the tracks whose output is routed to it.
+    bool is_return = false;
+    // Post-fader send levels, keyed by return track index.
+    std::map<int, float> sends;
+    // Return track this track's output feeds instead of the master bus, or -1.
+    int output_index = -1;
+    // Track whose output feeds the sidechain input of this track's plugins, or -1.
+    int sidechain_source = -1;
+
+    // Working buffer: holds the summed input of a return track before RenderBlock
+    // and the post-fader output of every track after it.
+    std::vector<float> output_l = std::vector<float>(kMaxBlockSize);
+    std::vector<float> output_r = std::vector<float>(kMaxBlockSize);
+    // Results of the last RenderBlock.
+    bool active = false;
+    float peak_l = 0.0f;
+    float peak_r = 0.0f;
+    // Wall time of RenderBlock, plugins included.
+    TimingStats render_time;
+    // Set by the CPU governor: the track renders silence without running its
+    // plugins, but its clip keeps its position. Essential tracks are never cut.
+    std::atomic<bool> cut{false};
+    std::atomic<bool> essential{false};
+
+    // A frozen track plays frozen_clips, renders of its clips through the
+    // plugin chain, and its plugins are suspended. While a freeze renders,
+    // the track keeps playing live; while an unfreeze resumes the plugins, it
+    // is busy and plays silence. Either way it refuses changes to its plugins
+    // and clips. See freeze.hpp.
+    enum class FreezeState { kLive, kRendering, kBusy, kFrozen };
+    std::atomic<FreezeState> freeze_state{FreezeState::kLive};
+    std::map<int, std::unique_ptr<Clip>> frozen_clips;
+
+    // Bumped by every change to what RenderClipBlock produces: clips, plugins,
+    // parameters, freezing, the governor. PlayClip and Stop bump seek_generation
+    // too, as they also move the playback position. Blocks rendered ahead
+    // before a bump are thrown away (see anticipation.hpp).
+    std::atomic<uint32_t> render_generation{0};
+    std::atomic<uint32_t> seek_generation{0};
+    void Invalidate() { render_generation.fetch_add(1, std::memory_order_release); }
+
+    // The published plugin chain, and the generation of the oldest chain the
+    // audio side may still be rendering, the one it is fading out if any.
+    std::atomic<const PluginChain*> chain{nullptr};
+    std::atomic<uint32_t> chain_in_use{0};
+
+    // Quantized launch, set by the engine on the audio thread: at transport
+    // frame launch_frame the track switches to launch_slot, or stops for -1.
+    // launch_frame is -1 when none is pending.
+    std::atomic<int64_t> launch_frame{-1};
+    std::atomic<int> launch_slot{-1};
+    void ScheduleLaunch(int slot, int64_t frame);
 
     int playing_slot = -1;
     double current_time_sec = 0.0;
     int current_midi_idx = 0;
+    // Transport frame the playing clip was launched at (-1 until its first
+    // block after PlayClip), and the slot whose follow action counts from it,
+    // which outlives a one-shot that has ended.
+    int64_t launched_frame = -1;
+    int follow_slot = -1;
+    // Clip and position at the start of the block being heard, for the
+    // playhead. Set by the engine; playing_slot and current_time_sec run
+    // ahead of them for anticipated tracks.
+    int heard_slot = -1;
+    double heard_time_sec = 0.0;
 
     std::mutex mutex;
 
-    Track(int idx) : index(idx) {}
+    Track(int idx) : index(idx) {
+        PublishChain({});
+        PublishClips({});
+    }
 
+    // Loads a plugin and inserts it as InsertPlugin does. Loading happens on
+    // the calling thread; better load first, without locks, and insert.
     int LoadPlugin(const std::string& path, int plugin_index, double sample_rate);
+    // Inserts a loaded, active plugin: an instrument replaces the track's
+    // instrument or goes first, an effect goes last. Returns its index, or -1
+    // if the track is frozen.
+    int InsertPlugin(std::unique_ptr<Vst3Plugin> plugin);
     bool DeleteClip(int slot);
+    // Loads a clip and inserts it as InsertClip does.
     bool LoadClip(int slot, const std::string& path, bool is_loop = false);
+    // Puts a loaded clip in the slot, replacing the one there. An audio clip
+    // drops the track's instrument. Returns false if the track is frozen.
+    bool InsertClip(int slot, std::unique_ptr<Clip> clip);
     void SetClipLoop(int slot, bool is_loop);
+    void SetFollowAction(int slot, FollowAction action, double beats);
+    // Start or stop playback right away, from the next block on; the engine
+    // launches clips on the transport grid instead (see launch.hpp).
     void PlayClip(int slot);
     void Stop();
     bool RemovePlugin(size_t pidx);
+
+    // Renders one block of the playing clip (or, for a return track, of its
+    // summed input) through the plugin chain and mixer strip into output_l/r.
+    // sidechain is a stereo buffer pair or nullptr. Returns false if the track
+    // produced nothing because no clip is playing.
+    bool RenderBlock(const BlockInfo& block, float** sidechain);
+
+    // The two halves of RenderBlock for a clip track. RenderClipBlock renders
+    // the playing clip through the plugin chain into left/right, before the
+    // mixer strip, and advances the playback position, switching clips at the
+    // exact frame of a launch or follow action; it returns false, with
+    // left/right silent, if no clip played. MixBlock then applies the mixer
+    // strip to output_l/r and records the block's results.
+    bool RenderClipBlock(const BlockInfo& block, float** sidechain, float* left, float* right);
+    bool MixBlock(const BlockInfo& block, bool playing);
+
+    // Moves the playback position on as if the block had been rendered.
+    void AdvancePlayback(const BlockInfo& block);
+
+    // Moves the retired chains that the audio side is done with to out, so
+    // that they and their dropped plugins are destroyed by the caller, off the
+    // audio thread. Returns whether retired chains are left for later.
+    bool TakeRetiredChains(std::vector<std::unique_ptr<PluginChain>>& out);
+    // Moves every retired clip set to out. The caller frees them after a
+    // block boundary.
+    void TakeRetiredClips(std::vector<std::unique_ptr<ClipSet>>& out);
+
+private:
+    // Publishes the plugins as a new chain; called with mutex held.
+    void PublishChain(std::vector<std::unique_ptr<Vst3Plugin>> dropped);
+    // Publishes the clips as a new set; called with mutex held.
+    void PublishClips(std::vector<std::unique_ptr<Clip>> dropped);
+    // Audio side: runs the published chain over left/right in place, crossfading
+    // from the previous one while it fades out; plugins the two share run once.
+    // events is null for audio input, which skips instruments.
+    void ProcessChain(float* left, float* right, const BlockInfo& block, const HostProcessContext& context,
+                      const std::vector<MidiNoteEvent>* events, float** sidechain);
+    // Audio side: switches to the published chain without running it.
+    void SkipChain();
+    // Applies the launch or follow action due offset frames into the block
+    // and returns the offset of the next one, or the block size. Like the
+    // helpers below, it plays from the clip set loaded once for the block.
+    int BeginSegment(const BlockInfo& block, int offset, const ClipSet& set);
+    int64_t FollowFrame(const BlockInfo& block, const ClipSet& set) const;
+    void StartClip(int slot, int64_t frame, const ClipSet& set);
+    void AdvanceClip(double seconds, const ClipSet& set);
+
+    std::unique_ptr<PluginChain> current_chain_;
+    std::vector<std::unique_ptr<PluginChain>> retired_chains_;
+    std::unique_ptr<ClipSet> current_clips_;
+    std::vector<std::unique_ptr<ClipSet>> retired_clips_;
+    const PluginChain* rendered_chain_ = nullptr;
+    const PluginChain* fading_chain_ = nullptr;
+    int fade_pos_ = 0;
+    std::vector<float> fade_l_ = std::vector<float>(kMaxBlockSize);
+    std::vector<float> fade_r_ = std::vector<float>(kMaxBlockSize);
 };
 
 } // namespace hibiki
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "track.hpp"
+#include "test_utils.hpp"
+
+// Tests that load the synthetic plugins, which only build on Linux x86_64.
+
+void Vst3Plugin::stopEditor() {} // for test
+
+TEST(TrackChainTest, PluginChangesCrossfade) {
+    constexpr double kSampleRate = 48000.0;
+    constexpr int kBlockSize = 256;
+    std::string so = hibiki::find_test_file("hibiki_test_plugins.vst3/Contents/x86_64-linux/hibiki_test_plugins.so");
+    const std::string bundle = so.substr(0, so.find(".vst3") + 5);
+
+    hibiki::Track track(0);
+    auto clip = std::make_unique<hibiki::Clip>();
+    clip->type = hibiki::Clip::Type::AUDIO;
+    clip->sample_rate = kSampleRate;
+    clip->audio = hibiki::PlanarAudio(2, (int64_t)kSampleRate);
+    for (int c = 0; c < 2; ++c) std::fill_n(clip->audio.channel(c), (int64_t)kSampleRate, 0.5f);
+    clip->duration_sec = 1.0;
+    clip->is_loop = true;
+    track.InsertClip(0, std::move(clip));
+    track.PlayClip(0);
+    ASSERT_EQ(track.LoadPlugin(bundle, 1, kSampleRate), 0); // Gain
+    track.plugins[0]->setParameterValue(0, 0.25);           // gain 0.5
+
+    const hibiki::BlockInfo block{kSampleRate, kBlockSize, 120.0, false};
+    for (int i = 0; i < 8; ++i) track.RenderClipBlock(block, nullptr, track.output_l.data(), track.output_r.data());
+    EXPECT_NEAR(track.output_l[kBlockSize - 1], 0.25f, 1e-4f);
+
+    // The empty chain the plugin replaced is no longer in use.
+    std::vector<std::unique_ptr<hibiki::PluginChain>> done;
+    EXPECT_FALSE(track.TakeRetiredChains(done));
+    EXPECT_EQ(done.size(), 1u);
+    done.clear();
+
+    // Removing the plugin fades its output out instead of stepping to the dry signal.
+    ASSERT_TRUE(track.RemovePlugin(0));
+    EXPECT_TRUE(track.TakeRetiredChains(done));
+    EXPECT_TRUE(done.empty());
+    track.RenderClipBlock(block, nullptr, track.output_l.data(), track.output_r.data());
+    EXPECT_NEAR(track.output_l[0], 0.25f, 1e-3f);
+    EXPECT_GT(track.output_l[kBlockSize - 1], 0.25f);
+    EXPECT_LT(track.output_l[kBlockSize - 1], 0.5f);
+    track.RenderClipBlock(block, nullptr, track.output_l.data(), track.output_r.data());
+    EXPECT_FLOAT_EQ(track.output_l[kBlockSize - 1], 0.5f);
+
+    // Once faded out, the old chain and its plugin are handed back to be freed.
+    EXPECT_FALSE(track.TakeRetiredChains(done));
+    ASSERT_EQ(done.size(), 1u);
+    EXPECT_EQ(done[0]->dropped.size(), 1u);
+}
+
+TEST(TrackChainTest, CrossfadeRunsSharedPluginsOnce) {
+    constexpr double kSampleRate = 48000.0;
+    constexpr int kBlockSize = 256;
+    std::string so = hibiki::find_test_file("hibiki_test_plugins.vst3/Contents/x86_64-linux/hibiki_test_plugins.so");
+    const std::string bundle = so.substr(0, so.find(".vst3") + 5);
+
+    // Two tracks holding the same note on the sine instrument; one of them
+    // gains a unity gain effect, which must not change what it plays.
+    hibiki::Track reference(0), changed(1);
+    for (auto* track : {&reference, &changed}) {
+        auto clip = std::make_unique<hibiki::Clip>();
+        clip->type = hibiki::Clip::Type::MIDI;
+        clip->midi_events.push_back({0.0, 0x90, 0, 69, 127});
+        clip->duration_sec = 1.0;
+        track->InsertClip(0, std::move(clip));
+        ASSERT_EQ(track->LoadPlugin(bundle, 0, kSampleRate), 0); // Sine
+        track->PlayClip(0);
+    }
+
+    const hibiki::BlockInfo block{kSampleRate, kBlockSize, 120.0, false};
+    auto render = [&](hibiki::Track& track) {
+        track.RenderClipBlock(block, nullptr, track.output_l.data(), track.output_r.data());
+    };
+    for (int i = 0; i < 4; ++i) {
+        render(reference);
+        render(changed);
+    }
+    // While the chains crossfade, the sine is shared by both and must keep
+    // its phase: run twice a block it would play an octave up.
+    ASSERT_EQ(changed.LoadPlugin(bundle, 1, kSampleRate), 1); // Gain, unity by default
+    for (int i = 0; i < 4; ++i) {
+        render(reference);
+        render(changed);
+        for (int s = 0; s < kBlockSize; s += 17) EXPECT_NEAR(changed.output_l[s], reference.output_l[s], 1e-5f);
+    }
+}
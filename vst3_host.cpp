@@ -1,5 +1,6 @@
 #include "vst3_host.hpp"
 #include "vst3_host_impl.hpp"
+#include "trace.hpp"
 
 #include <atomic>
 
@@ -119,9 +120,7 @@ Vst3Plugin::Vst3Plugin() : impl(std::make_unique<Vst3PluginImpl>()) {}
 Vst3Plugin::~Vst3Plugin() {
     stopEditor();
     
-    if (impl->processor) {
-        impl->processor->setProcessing(false);
-    }
+    suspend();
 
     if (impl->controller) {
         impl->controller->setComponentHandler(nullptr);
@@ -129,7 +128,6 @@ Vst3Plugin::~Vst3Plugin() {
     }
 
     if (impl->component) {
-        impl->component->setActive(false);
         impl->component->terminate();
     }
 }
@@ -235,6 +233,7 @@ bool Vst3Plugin::load(const std::string& path, int plugin_index, double sample_r
 
     // Activate audio buses
     int numInBuses = impl->component->getBusCount(Steinberg::Vst::kAudio, Steinberg::Vst::kInput);
+    impl->numInputBuses = numInBuses;
     for (int i = 0; i < numInBuses; i++) {
         impl->component->activateBus(Steinberg::Vst::kAudio, Steinberg::Vst::kInput, i, true);
     }
@@ -249,28 +248,54 @@ bool Vst3Plugin::load(const std::string& path, int plugin_index, double sample_r
         impl->component->activateBus(Steinberg::Vst::kEvent, Steinberg::Vst::kInput, i, true);
     }
 
-    if (impl->component->setActive(true) != Steinberg::kResultTrue) {
-        std::cerr << "Failed to activate component" << std::endl;
-        return false;
-    }
+    impl->sampleRate = sample_rate;
+    if (!startProcessing(Steinberg::Vst::kRealtime)) return false;
+
+    std::cerr << "Plugin: " << info.name() << " - Audio Buses - In: " << numInBuses << ", Out: " << numOutBuses << "\n";
+
+    return true;
+}
 
+// setupProcessing is only allowed while the component is inactive, and
+// activating it again resets the plugin's processing state.
+bool Vst3Plugin::startProcessing(int process_mode) {
     Steinberg::Vst::ProcessSetup setup;
-    setup.processMode = Steinberg::Vst::kRealtime;
+    setup.processMode = process_mode;
     setup.symbolicSampleSize = Steinberg::Vst::kSample32;
-    setup.maxSamplesPerBlock = 512;
-    setup.sampleRate = sample_rate;
-    
+    // Covers every block size the engine may switch to, so a latency change
+    // never has to set the plugin up again.
+    setup.maxSamplesPerBlock = hibiki::kMaxBlockSize;
+    setup.sampleRate = impl->sampleRate;
+
     if (impl->processor->setupProcessing(setup) != Steinberg::kResultTrue) {
         std::cerr << "Failed to setup processing" << std::endl;
-        impl->component->setActive(false);
         return false;
     }
+    if (impl->component->setActive(true) != Steinberg::kResultTrue) {
+        std::cerr << "Failed to activate component" << std::endl;
+        return false;
+    }
+    impl->processMode = process_mode;
+    impl->processor->setProcessing(true);
+    impl->active = true;
+    return true;
+}
 
-    std::cerr << "Plugin: " << info.name() << " - Audio Buses - In: " << numInBuses << ", Out: " << numOutBuses << "\n";
+void Vst3Plugin::suspend() {
+    if (!impl->processor || !impl->active) return;
+    impl->processor->setProcessing(false);
+    impl->component->setActive(false);
+    impl->active = false;
+}
 
-    impl->processor->setProcessing(true);
+bool Vst3Plugin::resume(bool offline) {
+    if (!impl->processor) return false;
+    suspend();
+    return startProcessing(offline ? Steinberg::Vst::kOffline : Steinberg::Vst::kRealtime);
+}
 
-    return true;
+bool Vst3Plugin::isSuspended() const {
+    return !impl->active;
 }
 
 
@@ -297,18 +322,43 @@ void Vst3Plugin::listPlugins(const std::string& path) {
 
 void Vst3Plugin::process(float** inputs, float** outputs, int numSamples, 
                         const HostProcessContext& context, 
-                        const std::vector<MidiNoteEvent>& events) {
-    if (!impl->processor) return;
-
-    Steinberg::Vst::AudioBusBuffers inBuses = {}, outBuses = {};
-    inBuses.numChannels = inputs ? 2 : 0; // Fixed: 0 channels if no inputs
-    inBuses.silenceFlags = 0;
-    inBuses.channelBuffers32 = inputs;
+                        const std::vector<MidiNoteEvent>& events,
+                        float** sidechain) {
+    if (!impl->processor || !impl->active) return;
+    HIBIKI_TRACE_SCOPE("Vst3Plugin::process");
+    hibiki::ScopedTimer timer(impl->processTime);
+
+    // Bus 0 is the main input; bus 1, if the plugin has one, is its sidechain.
+    Steinberg::Vst::AudioBusBuffers inBuses[2] = {}, outBuses = {};
+    inBuses[0].numChannels = inputs ? 2 : 0; // Fixed: 0 channels if no inputs
+    inBuses[0].silenceFlags = 0;
+    inBuses[0].channelBuffers32 = inputs;
+    int numInputs = 1;
+    if (sidechain && impl->numInputBuses > 1) {
+        inBuses[1].numChannels = 2;
+        inBuses[1].silenceFlags = 0;
+        inBuses[1].channelBuffers32 = sidechain;
+        numInputs = 2;
+    }
 
     outBuses.numChannels = 2;
     outBuses.silenceFlags = 0;
     outBuses.channelBuffers32 = outputs;
 
+    // Changes queued since the last block are delivered at its first sample;
+    // repeated changes of one parameter collapse into the newest value.
+    impl->inputChanges.clearQueue();
+    uint32_t head = impl->paramHead.load(std::memory_order_acquire);
+    uint32_t tail = impl->paramTail.load(std::memory_order_relaxed);
+    for (; tail != head; ++tail) {
+        const auto& change = impl->paramQueue[tail % Vst3PluginImpl::kParamQueueSize];
+        Steinberg::int32 index = 0;
+        if (auto* queue = impl->inputChanges.addParameterData(change.id, index)) {
+            queue->addPoint(0, change.value, index);
+        }
+    }
+    impl->paramTail.store(tail, std::memory_order_release);
+
     VstEventList eventList;
     for (const auto& me : events) {
         Steinberg::Vst::Event e = {};
@@ -337,14 +387,14 @@ void Vst3Plugin::process(float** inputs, float** outputs, int numSamples,
     vstContext.projectTimeMusic = context.projectTimeMusic;
 
     Steinberg::Vst::ProcessData data;
-    data.processMode = Steinberg::Vst::kRealtime;
+    data.processMode = impl->processMode;
     data.symbolicSampleSize = Steinberg::Vst::kSample32;
     data.numSamples = numSamples;
-    data.numInputs = 1;
-    data.inputs = &inBuses;
+    data.numInputs = numInputs;
+    data.inputs = inBuses;
     data.numOutputs = 1;
     data.outputs = &outBuses;
-    data.inputParameterChanges = nullptr; // TODO: Implement if needed for real-time automation
+    data.inputParameterChanges = &impl->inputChanges;
     data.outputParameterChanges = nullptr;
     data.inputEvents = &eventList;
     data.outputEvents = nullptr;
@@ -376,6 +426,13 @@ void Vst3Plugin::setParameterValue(uint32_t id, double valueNormalized) {
     if (impl->controller) {
         impl->controller->setParamNormalized(id, valueNormalized);
     }
+    // Also hand the change to the processor. When the audio thread has fallen
+    // a full queue behind, the change only reaches the controller.
+    uint32_t head = impl->paramHead.load(std::memory_order_relaxed);
+    if (head - impl->paramTail.load(std::memory_order_acquire) < Vst3PluginImpl::kParamQueueSize) {
+        impl->paramQueue[head % Vst3PluginImpl::kParamQueueSize] = {id, valueNormalized};
+        impl->paramHead.store(head + 1, std::memory_order_release);
+    }
 }
 
 double Vst3Plugin::getParameterValue(uint32_t id) const {
@@ -396,3 +453,23 @@ int Vst3Plugin::getPluginIndex() const {
 bool Vst3Plugin::isInstrument() const {
     return impl->isInstrument;
 }
+
+uint32_t Vst3Plugin::getLatencySamples() const {
+    return impl->processor ? impl->processor->getLatencySamples() : 0;
+}
+
+uint32_t Vst3Plugin::getTailSamples() const {
+    return impl->processor ? impl->processor->getTailSamples() : 0;
+}
+
+void Vst3Plugin::setBypassed(bool bypassed) {
+    impl->bypassed.store(bypassed, std::memory_order_relaxed);
+}
+
+bool Vst3Plugin::isBypassed() const {
+    return impl->bypassed.load(std::memory_order_relaxed);
+}
+
+hibiki::TimingStats& Vst3Plugin::processTime() {
+    return impl->processTime;
+}
@@ -5,6 +5,16 @@
 #include <string>
 #include <vector>
 
+#include "engine_stats.hpp"
+
+namespace hibiki {
+
+// Largest block the engine renders; plugins are set up for it and it sizes
+// the per-track buffers.
+constexpr int kMaxBlockSize = 2048;
+
+} // namespace hibiki
+
 struct HostProcessContext {
     double sampleRate;
     double tempo;
@@ -40,7 +50,8 @@ public:
     void stopEditor();
     void process(float** inputs, float** outputs, int num_samples, 
                  const HostProcessContext& context, 
-                 const std::vector<MidiNoteEvent>& events);
+                 const std::vector<MidiNoteEvent>& events,
+                 float** sidechain = nullptr);
 
     int getParameterCount() const;
     bool getParameterInfo(int index, VstParamInfo& info) const;
@@ -50,10 +61,28 @@ public:
     const std::string& getPath() const;
     int getPluginIndex() const;
     bool isInstrument() const;
+    // Processing delay and tail reported by the processor, in samples.
+    uint32_t getLatencySamples() const;
+    uint32_t getTailSamples() const;
+    // Deactivates the plugin; process() does nothing until resume(), which
+    // also resets it. Offline mode lets the plugin render at any speed and
+    // is meant for bounces such as track freezing.
+    void suspend();
+    bool resume(bool offline = false);
+    bool isSuspended() const;
+
+    // A bypassed plugin is skipped by the track: effects pass their input
+    // through, instruments fall silent. Safe to set from any thread.
+    void setBypassed(bool bypassed);
+    bool isBypassed() const;
+    // Wall time spent in process(), drained by the engine stats reporter.
+    hibiki::TimingStats& processTime();
 
     static void listPlugins(const std::string& path);
 
 private:
+    bool startProcessing(int process_mode);
+
     std::unique_ptr<Vst3PluginImpl> impl;
 };
 
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <thread>
 #include <memory>
+#include "engine_stats.hpp"
 #include "public.sdk/source/vst/hosting/module.h"
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
 #include "pluginterfaces/vst/ivstcomponent.h"
 #include "pluginterfaces/vst/ivstaudioprocessor.h"
 #include "pluginterfaces/vst/ivsteditcontroller.h"
@@ -20,6 +23,24 @@ struct Vst3PluginImpl {
     std::string path;
     int pluginIndex = 0;
     bool isInstrument = false;
+    int numInputBuses = 0;
+    hibiki::TimingStats processTime;
+    double sampleRate = 44100.0;
+    Steinberg::int32 processMode = Steinberg::Vst::kRealtime;
+    bool active = false;
+    std::atomic<bool> bypassed{false};
+
+    // Parameter changes on their way to the processor. Single producer (the
+    // thread calling setParameterValue), single consumer (process()).
+    struct ParamChange {
+        uint32_t id;
+        double value;
+    };
+    static constexpr uint32_t kParamQueueSize = 1024;
+    std::array<ParamChange, kParamQueueSize> paramQueue;
+    std::atomic<uint32_t> paramHead{0};
+    std::atomic<uint32_t> paramTail{0};
+    Steinberg::Vst::ParameterChanges inputChanges{64};
     std::thread editorThread;
     std::atomic<bool> editorRunning{false};
     std::atomic<uint64_t> editorWindow{0};
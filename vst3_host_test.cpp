@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "test_utils.hpp"
+#include "vst3_host.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 256;
+
+// Index of each class in the hibiki_test_plugins module.
+constexpr int kSine = 0;
+constexpr int kGain = 1;
+constexpr int kBurn = 2;
+constexpr int kLatency = 3;
+
+std::string BundlePath() {
+    std::string so = hibiki::find_test_file("hibiki_test_plugins.vst3/Contents/x86_64-linux/hibiki_test_plugins.so");
+    return so.substr(0, so.find(".vst3") + 5);
+}
+
+struct Block {
+    std::vector<float> in_l = std::vector<float>(kBlockSize), in_r = std::vector<float>(kBlockSize);
+    std::vector<float> out_l = std::vector<float>(kBlockSize), out_r = std::vector<float>(kBlockSize);
+    float* in[2] = {in_l.data(), in_r.data()};
+    float* out[2] = {out_l.data(), out_r.data()};
+
+    void Process(Vst3Plugin& plugin, const std::vector<MidiNoteEvent>& events = {}) {
+        HostProcessContext context{kSampleRate, 120.0, 4, 4, 0, 0.0};
+        plugin.process(plugin.isInstrument() ? nullptr : in, out, kBlockSize, context, events);
+    }
+    float Peak() const {
+        float peak = 0.0f;
+        for (float s : out_l) peak = std::max(peak, std::abs(s));
+        return peak;
+    }
+};
+
+TEST(Vst3HostTest, LoadsTestPlugins) {
+    Vst3Plugin sine, gain;
+    ASSERT_TRUE(sine.load(BundlePath(), kSine, kSampleRate));
+    ASSERT_TRUE(gain.load(BundlePath(), kGain, kSampleRate));
+    EXPECT_EQ(sine.getName(), "Hibiki Test Sine");
+    EXPECT_TRUE(sine.isInstrument());
+    EXPECT_FALSE(gain.isInstrument());
+    ASSERT_EQ(gain.getParameterCount(), 1);
+}
+
+TEST(Vst3HostTest, InstrumentPlaysHeldNote) {
+    Vst3Plugin sine;
+    ASSERT_TRUE(sine.load(BundlePath(), kSine, kSampleRate));
+    Block block;
+    block.Process(sine, {{0, 0, 69, 1.0f, true}});
+    EXPECT_GT(block.Peak(), 0.2f);
+    block.Process(sine, {{0, 0, 69, 0.0f, false}});
+    EXPECT_EQ(block.Peak(), 0.0f);
+}
+
+TEST(Vst3HostTest, ParameterChangesReachProcessor) {
+    Vst3Plugin gain;
+    ASSERT_TRUE(gain.load(BundlePath(), kGain, kSampleRate));
+    Block block;
+    std::fill(block.in_l.begin(), block.in_l.end(), 1.0f);
+    std::fill(block.in_r.begin(), block.in_r.end(), 1.0f);
+    block.Process(gain);
+    EXPECT_FLOAT_EQ(block.out_l[0], 1.0f);
+
+    gain.setParameterValue(0, 0.1);
+    gain.setParameterValue(0, 0.25);
+    block.Process(gain);
+    EXPECT_FLOAT_EQ(block.out_l[0], 0.5f);
+    EXPECT_FLOAT_EQ(block.out_r[kBlockSize - 1], 0.5f);
+    EXPECT_DOUBLE_EQ(gain.getParameterValue(0), 0.25);
+}
+
+TEST(Vst3HostTest, BurnTakesConfiguredTime) {
+    Vst3Plugin burn;
+    ASSERT_TRUE(burn.load(BundlePath(), kBurn, kSampleRate));
+    burn.setParameterValue(0, 0.05); // 500 us
+    Block block;
+    auto start = std::chrono::steady_clock::now();
+    block.Process(burn);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::microseconds(500));
+    EXPECT_EQ(burn.processTime().Drain().count, 1u);
+}
+
+TEST(Vst3HostTest, ReportsLatencyAndTail) {
+    Vst3Plugin latency;
+    ASSERT_TRUE(latency.load(BundlePath(), kLatency, kSampleRate));
+    EXPECT_EQ(latency.getLatencySamples(), 256u);
+    EXPECT_EQ(latency.getTailSamples(), 4800u);
+
+    Block block;
+    block.in_l[0] = 1.0f;
+    block.Process(latency);
+    EXPECT_EQ(block.Peak(), 0.0f);
+    block.in_l[0] = 0.0f;
+    block.Process(latency);
+    EXPECT_EQ(block.out_l[256 - kBlockSize], 1.0f);
+}
+
+} // namespace
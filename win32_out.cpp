@@ -14,8 +14,14 @@ struct Win32Playback::Impl {
   HANDLE hEvent = nullptr;
 };
 
-Win32Playback::Win32Playback(int rate, int ch)
-    : sample_rate(rate), channels(ch) {
+namespace {
+hibiki::AudioDeviceRegistration registration("wasapi", 100, [](const hibiki::AudioDeviceOptions &options) {
+  return std::unique_ptr<hibiki::AudioDevice>(new Win32Playback(options.sample_rate, options.channels, options.block_size));
+});
+} // namespace
+
+Win32Playback::Win32Playback(int rate, int ch, int block)
+    : sample_rate(rate), channels(ch), block_size(block) {
   impl = new Impl();
 
   HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
@@ -110,6 +116,25 @@ Win32Playback::~Win32Playback() {
 
 bool Win32Playback::is_ready() const { return impl->pRenderClient != nullptr; }
 
+void Win32Playback::pause() {
+  if (!impl->pAudioClient)
+    return;
+  // Let the queued frames play out, then stop the stream.
+  UINT32 padding = 0;
+  while (SUCCEEDED(impl->pAudioClient->GetCurrentPadding(&padding)) && padding > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  impl->pAudioClient->Stop();
+  started = false;
+}
+
+void Win32Playback::resume() {
+  if (!impl->pAudioClient)
+    return;
+  impl->pAudioClient->Reset();
+  impl->pAudioClient->Start();
+}
+
 
 void Win32Playback::write(const std::vector<float> &interleaved_data,
                           int num_frames) {
@@ -119,6 +144,9 @@ void Win32Playback::write(const std::vector<float> &interleaved_data,
   // Simple back-pressure: if the buffer is too full, wait a bit
   UINT32 padding = 0;
   int retry = 0;
+  if (started && SUCCEEDED(impl->pAudioClient->GetCurrentPadding(&padding)) && padding == 0) {
+    xruns++;
+  }
   while (SUCCEEDED(impl->pAudioClient->GetCurrentPadding(&padding)) && retry < 100) {
       if (impl->bufferFrameCount - padding >= (UINT32)num_frames) {
           break;
@@ -139,6 +167,7 @@ void Win32Playback::write(const std::vector<float> &interleaved_data,
         floatData[i] = sample;
     }
     impl->pRenderClient->ReleaseBuffer(num_frames, 0);
+    started = true;
   } else if (hr == AUDCLNT_E_BUFFER_TOO_LARGE) {
     std::this_thread::sleep_for(std::chrono::milliseconds(1));
   }
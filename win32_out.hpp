@@ -1,18 +1,31 @@
 #pragma once
 
+#include "audio_device.hpp"
+
+#include <cstdint>
 #include <vector>
 
-class Win32Playback {
+class Win32Playback : public hibiki::BlockingAudioDevice {
     struct Impl;
     Impl* impl;
     int sample_rate;
     int channels;
+    int block_size;
+    uint32_t xruns = 0;
+    bool started = false;
 public:
-    Win32Playback(int rate = 44100, int ch = 2);
+    // The shared-mode mix format overrides the requested rate and channels.
+    Win32Playback(int rate = 44100, int ch = 2, int block = 512);
     ~Win32Playback();
 
-    int get_sample_rate() const { return sample_rate; }
-    int get_channels() const { return channels; }
-    bool is_ready() const;
-    void write(const std::vector<float>& interleaved_data, int num_frames);
+    int get_sample_rate() const override { return sample_rate; }
+    int get_channels() const override { return channels; }
+    int get_block_size() const override { return block_size; }
+    bool is_ready() const override;
+    void write(const std::vector<float>& interleaved_data, int num_frames) override;
+    // Times the device buffer had run dry when the next block arrived.
+    uint32_t xrun_count() const override { return xruns; }
+    bool can_pause() const override { return true; }
+    void pause() override;
+    void resume() override;
 };